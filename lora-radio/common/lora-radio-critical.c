@@ -0,0 +1,65 @@
+/*!
+ * \file      lora-radio-critical.c
+ *
+ * \brief     measures the interrupts-disabled windows opened by
+ *            LORA_RADIO_CRITICAL_SECTION_BEGIN/END
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_CRITICAL_SECTION_STATS
+
+/* only touched with interrupts disabled */
+static uint32_t critical_nesting;
+static uint32_t critical_start_us;
+static const char *critical_func;
+static LoRaRadioCriticalSectionStats_t critical_stats;
+
+void lora_radio_critical_section_enter( const char *func )
+{
+    if( critical_nesting++ == 0 )
+    {
+        critical_func = func;
+        critical_start_us = LORA_RADIO_TIMESTAMP_US( );
+    }
+}
+
+void lora_radio_critical_section_exit( void )
+{
+    uint32_t elapsed;
+
+    if( --critical_nesting != 0 )
+    {
+        return;
+    }
+    elapsed = LORA_RADIO_TIMESTAMP_US( ) - critical_start_us;
+
+    critical_stats.Count++;
+    critical_stats.TotalUs += elapsed;
+    if( elapsed >= critical_stats.MaxUs )
+    {
+        critical_stats.MaxUs = elapsed;
+        critical_stats.MaxFunc = critical_func;
+    }
+}
+
+void lora_radio_critical_section_stats_get( LoRaRadioCriticalSectionStats_t *stats )
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    *stats = critical_stats;
+    rt_hw_interrupt_enable(level);
+}
+
+void lora_radio_critical_section_stats_reset( void )
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    rt_memset(&critical_stats, 0, sizeof(critical_stats));
+    rt_hw_interrupt_enable(level);
+}
+
+#endif
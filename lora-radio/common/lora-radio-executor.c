@@ -0,0 +1,466 @@
+/*!
+ * \file      lora-radio-executor.c
+ *
+ * \brief     deferred radio callbacks, the PHY thread posts them to a message
+ *            queue and goes back to the radio at once
+ *
+ * The chip driver calls the callbacks below from its PHY thread (or the
+ * timer thread for the rt_timer timeouts), on SX127x with interrupts
+ * masked. They copy the arguments into one message and return: the radio is
+ * re-armed, the next queued frame started and the next DIO handled without
+ * waiting for the application. An RxDone payload received into an RX pool
+ * slot stays there, the message carries the slot and the slot is queued to
+ * the application right before RxDone is called; only the static buffer of
+ * the driver is copied. The worker thread calls the callbacks of the instance, without
+ * the driver lock, in the order the driver posted them. A full queue never
+ * drops a completion: the callbacks without payload of the instance are
+ * merged into its pending mask until the worker emptied the queue, only an
+ * RxDone is lost then, its pool slot is still queued.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-executor.h"
+#include "lora-radio-rx-pool.h"
+#include <stddef.h>
+
+#ifdef LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+
+#ifndef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+    #error "LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR queues the callbacks with LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD"
+#endif
+
+typedef enum
+{
+    EXECUTOR_TX_DONE = 0,
+    EXECUTOR_TX_TIMEOUT,
+    EXECUTOR_RX_DONE,
+    EXECUTOR_RX_TIMEOUT,
+    EXECUTOR_RX_ERROR,
+    EXECUTOR_FHSS_CHANGE_CHANNEL,
+    EXECUTOR_CAD_DONE,
+}ExecutorCallback_t;
+
+typedef struct
+{
+    uint32_t PostedUs;                              //!< LORA_RADIO_TIMESTAMP_US( ) in the driver
+    uint8_t Callback;                               //!< ExecutorCallback_t
+    uint8_t Instance;
+    uint8_t Argument;                               //!< FHSS channel, CAD activity
+    int8_t Snr;
+    int16_t Rssi;
+    uint16_t Size;
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+    LoRaRadioRxPacket_t *Packet;                    //!< slot holding the RxDone payload, RT_NULL if copied to Payload
+#endif
+    uint8_t Payload[255];                           //!< only the copied bytes are queued
+}ExecutorMsg_t;
+
+#define EXECUTOR_MSG_HEADER                         offsetof( ExecutorMsg_t, Payload )
+
+/*!
+ * Room for the kernel message header and the alignment of each message
+ */
+#define EXECUTOR_MSG_SLOT                           ( ( ( sizeof( ExecutorMsg_t ) + 7 ) & ~7UL ) + 2 * sizeof( void * ) )
+
+/*!
+ * Callbacks of one instance merged while the queue was full
+ */
+typedef struct
+{
+    uint32_t Callbacks;                             //!< 1 << ExecutorCallback_t
+    uint32_t PostedUs;                              //!< LORA_RADIO_TIMESTAMP_US( ) of the first of them
+    uint8_t Channel;                                //!< last FHSS channel
+    uint8_t Activity;                               //!< last CAD activity
+}ExecutorPending_t;
+
+static struct rt_messagequeue ExecutorQueue;
+static rt_uint8_t ExecutorPool[LORA_RADIO_EXECUTOR_QUEUE_SIZE * EXECUTOR_MSG_SLOT];
+static bool ExecutorInitialized = false;
+static LoRaRadioExecutorStats_t ExecutorStats;
+static ExecutorPending_t ExecutorPending[LORA_RADIO_DRIVER_INSTANCE_NUM];
+
+#ifndef LORA_RADIO_EXECUTOR_USING_APP_THREAD
+static struct rt_thread ExecutorThread;
+static rt_uint8_t ExecutorThreadStack[LORA_RADIO_EXECUTOR_THREAD_STACK_SIZE];
+
+static void ExecutorThreadEntry( void *parameter )
+{
+    while( 1 )
+    {
+        lora_radio_executor_dispatch( RT_WAITING_FOREVER );
+    }
+}
+#endif
+
+static void ExecutorInit( void )
+{
+    if( ExecutorInitialized == true )
+    {
+        return;
+    }
+    rt_enter_critical( );
+    if( ExecutorInitialized == false )
+    {
+        rt_mq_init( &ExecutorQueue, "lr_cb", ExecutorPool, sizeof( ExecutorMsg_t ),
+                    sizeof( ExecutorPool ), RT_IPC_FLAG_FIFO );
+#ifndef LORA_RADIO_EXECUTOR_USING_APP_THREAD
+        rt_thread_init( &ExecutorThread, "lr-cb", ExecutorThreadEntry, RT_NULL,
+                        &ExecutorThreadStack[0], sizeof( ExecutorThreadStack ),
+                        LORA_RADIO_EXECUTOR_THREAD_PRIORITY, 20 );
+        rt_thread_startup( &ExecutorThread );
+#endif
+        ExecutorInitialized = true;
+    }
+    rt_exit_critical( );
+}
+
+/*!
+ * \brief Queues \a msg with the first \a copied bytes of its payload. Once
+ *        the queue was full, the callbacks of the instance wait in its
+ *        pending mask, after the queued ones; an RxDone is not queued then.
+ *
+ * \retval posted false if an RxDone was lost
+ */
+static bool ExecutorPost( ExecutorMsg_t *msg, ExecutorCallback_t callback, uint16_t copied )
+{
+    ExecutorPending_t *pending;
+    rt_err_t ret = -RT_EFULL;
+    rt_base_t level;
+
+    msg->PostedUs = LORA_RADIO_TIMESTAMP_US( );
+    msg->Callback = callback;
+    msg->Instance = lora_radio_current( )->Index;
+    pending = &ExecutorPending[msg->Instance];
+    // the driver lock serializes the posts of one instance
+    if( pending->Callbacks == 0 )
+    {
+        ret = rt_mq_send( &ExecutorQueue, msg, EXECUTOR_MSG_HEADER + copied );
+    }
+
+    level = rt_hw_interrupt_disable( );
+    if( ret == RT_EOK )
+    {
+        ExecutorStats.Posted++;
+    }
+    else if( callback == EXECUTOR_RX_DONE )
+    {
+        ExecutorStats.Dropped++;
+    }
+    else
+    {
+        if( pending->Callbacks == 0 )
+        {
+            pending->PostedUs = msg->PostedUs;
+        }
+        pending->Callbacks |= 1UL << callback;
+        if( callback == EXECUTOR_FHSS_CHANGE_CHANNEL )
+        {
+            pending->Channel = msg->Argument;
+        }
+        else if( callback == EXECUTOR_CAD_DONE )
+        {
+            pending->Activity = msg->Argument;
+        }
+        ExecutorStats.Posted++;
+        ExecutorStats.Coalesced++;
+        ret = RT_EOK;
+    }
+    rt_hw_interrupt_enable( level );
+    return ( ret == RT_EOK );
+}
+
+/*!
+ * \brief Takes one callback of the pending masks into \a msg, the queue is
+ *        empty so every callback queued before it was called
+ *
+ * \retval taken false if nothing is pending
+ */
+static bool ExecutorTakePending( ExecutorMsg_t *msg )
+{
+    ExecutorPending_t *pending;
+    uint8_t instance, callback;
+    bool taken = false;
+    rt_base_t level = rt_hw_interrupt_disable( );
+
+    for( instance = 0; ( instance < LORA_RADIO_DRIVER_INSTANCE_NUM ) && ( taken == false ); instance++ )
+    {
+        pending = &ExecutorPending[instance];
+        if( pending->Callbacks == 0 )
+        {
+            continue;
+        }
+        for( callback = 0; ( pending->Callbacks & ( 1UL << callback ) ) == 0; callback++ );
+        // a later callback of the instance is merged until the last is taken
+        pending->Callbacks &= ~( 1UL << callback );
+        msg->PostedUs = pending->PostedUs;
+        msg->Callback = callback;
+        msg->Instance = instance;
+        msg->Argument = ( callback == EXECUTOR_CAD_DONE ) ? pending->Activity : pending->Channel;
+        msg->Snr = 0;
+        msg->Rssi = 0;
+        msg->Size = 0;
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+        msg->Packet = RT_NULL;
+#endif
+        taken = true;
+    }
+    rt_hw_interrupt_enable( level );
+    return taken;
+}
+
+static void ExecutorPostEvent( ExecutorCallback_t callback, uint8_t argument )
+{
+    ExecutorMsg_t msg;
+
+    msg.Argument = argument;
+    msg.Snr = 0;
+    msg.Rssi = 0;
+    msg.Size = 0;
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+    msg.Packet = RT_NULL;
+#endif
+    ( void )ExecutorPost( &msg, callback, 0 );
+}
+
+static void ExecutorOnTxDone( void )
+{
+    ExecutorPostEvent( EXECUTOR_TX_DONE, 0 );
+}
+
+static void ExecutorOnTxTimeout( void )
+{
+    ExecutorPostEvent( EXECUTOR_TX_TIMEOUT, 0 );
+}
+
+static void ExecutorOnRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
+{
+    ExecutorMsg_t msg;
+
+    msg.Argument = 0;
+    msg.Size = ( size < sizeof( msg.Payload ) ) ? size : sizeof( msg.Payload );
+    msg.Rssi = rssi;
+    msg.Snr = snr;
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+    msg.Packet = lora_radio_rx_pool_packet( payload );
+    if( msg.Packet != RT_NULL )
+    {
+        if( ExecutorPost( &msg, EXECUTOR_RX_DONE, 0 ) == false )
+        {
+            // the callback is lost, the packet is not
+            lora_radio_rx_pool_ready( msg.Packet );
+        }
+        return;
+    }
+#endif
+    rt_memcpy( msg.Payload, payload, msg.Size );
+    ( void )ExecutorPost( &msg, EXECUTOR_RX_DONE, msg.Size );
+}
+
+static void ExecutorOnRxTimeout( void )
+{
+    ExecutorPostEvent( EXECUTOR_RX_TIMEOUT, 0 );
+}
+
+static void ExecutorOnRxError( void )
+{
+    ExecutorPostEvent( EXECUTOR_RX_ERROR, 0 );
+}
+
+static void ExecutorOnFhssChangeChannel( uint8_t currentChannel )
+{
+    ExecutorPostEvent( EXECUTOR_FHSS_CHANGE_CHANNEL, currentChannel );
+}
+
+static void ExecutorOnCadDone( bool channelActivityDetected )
+{
+    ExecutorPostEvent( EXECUTOR_CAD_DONE, ( channelActivityDetected == true ) ? 1 : 0 );
+}
+
+static RadioEvents_t ExecutorEvents =
+{
+    .TxDone = ExecutorOnTxDone,
+    .TxTimeout = ExecutorOnTxTimeout,
+    .RxDone = ExecutorOnRxDone,
+    .RxTimeout = ExecutorOnRxTimeout,
+    .RxError = ExecutorOnRxError,
+    .FhssChangeChannel = ExecutorOnFhssChangeChannel,
+    .CadDone = ExecutorOnCadDone,
+};
+
+RadioEvents_t *lora_radio_executor_events( void )
+{
+    ExecutorInit( );
+    return &ExecutorEvents;
+}
+
+/*!
+ * \brief Calls the callback of \a msg registered by lora_radio_init, or by
+ *        Radio.Init for instance 0
+ */
+static void ExecutorCall( const ExecutorMsg_t *msg )
+{
+    LoRaRadio_t *radio = lora_radio_get( msg->Instance );
+    const LoRaRadioEvents_t *events = radio->Events;
+    RadioEvents_t *legacy = radio->LegacyEvents;
+    uint8_t *payload = ( uint8_t * )msg->Payload;
+
+    if( ( events == RT_NULL ) && ( legacy == RT_NULL ) )
+    {
+        return;
+    }
+    switch( msg->Callback )
+    {
+    case EXECUTOR_TX_DONE:
+        if( ( events != RT_NULL ) && ( events->TxDone != RT_NULL ) )
+        {
+            events->TxDone( radio->Context );
+        }
+        else if( ( events == RT_NULL ) && ( legacy->TxDone != RT_NULL ) )
+        {
+            legacy->TxDone( );
+        }
+        break;
+    case EXECUTOR_TX_TIMEOUT:
+        if( ( events != RT_NULL ) && ( events->TxTimeout != RT_NULL ) )
+        {
+            events->TxTimeout( radio->Context );
+        }
+        else if( ( events == RT_NULL ) && ( legacy->TxTimeout != RT_NULL ) )
+        {
+            legacy->TxTimeout( );
+        }
+        break;
+    case EXECUTOR_RX_DONE:
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+        if( msg->Packet != RT_NULL )
+        {
+            // as without the executor, the slot can be taken from RxDone on
+            payload = msg->Packet->Payload;
+            lora_radio_rx_pool_ready( msg->Packet );
+        }
+#endif
+        if( ( events != RT_NULL ) && ( events->RxDone != RT_NULL ) )
+        {
+            events->RxDone( radio->Context, payload, msg->Size, msg->Rssi, msg->Snr );
+        }
+        else if( ( events == RT_NULL ) && ( legacy->RxDone != RT_NULL ) )
+        {
+            legacy->RxDone( payload, msg->Size, msg->Rssi, msg->Snr );
+        }
+        break;
+    case EXECUTOR_RX_TIMEOUT:
+        if( ( events != RT_NULL ) && ( events->RxTimeout != RT_NULL ) )
+        {
+            events->RxTimeout( radio->Context );
+        }
+        else if( ( events == RT_NULL ) && ( legacy->RxTimeout != RT_NULL ) )
+        {
+            legacy->RxTimeout( );
+        }
+        break;
+    case EXECUTOR_RX_ERROR:
+        if( ( events != RT_NULL ) && ( events->RxError != RT_NULL ) )
+        {
+            events->RxError( radio->Context );
+        }
+        else if( ( events == RT_NULL ) && ( legacy->RxError != RT_NULL ) )
+        {
+            legacy->RxError( );
+        }
+        break;
+    case EXECUTOR_FHSS_CHANGE_CHANNEL:
+        if( ( events != RT_NULL ) && ( events->FhssChangeChannel != RT_NULL ) )
+        {
+            events->FhssChangeChannel( radio->Context, msg->Argument );
+        }
+        else if( ( events == RT_NULL ) && ( legacy->FhssChangeChannel != RT_NULL ) )
+        {
+            legacy->FhssChangeChannel( msg->Argument );
+        }
+        break;
+    case EXECUTOR_CAD_DONE:
+        if( ( events != RT_NULL ) && ( events->CadDone != RT_NULL ) )
+        {
+            events->CadDone( radio->Context, msg->Argument != 0 );
+        }
+        else if( ( events == RT_NULL ) && ( legacy->CadDone != RT_NULL ) )
+        {
+            legacy->CadDone( msg->Argument != 0 );
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static uint8_t ExecutorHistogramBin( uint32_t latencyUs )
+{
+    uint8_t bin = 0;
+
+    while( ( bin < ( LORA_RADIO_EXECUTOR_HISTOGRAM_BINS - 1 ) ) && ( ( latencyUs >> ( bin + 4 ) ) != 0 ) )
+    {
+        bin++;
+    }
+    return bin;
+}
+
+rt_err_t lora_radio_executor_dispatch( rt_int32_t timeout )
+{
+    // one consumer thread, the message does not need to live on its stack
+    static ExecutorMsg_t msg;
+    uint32_t start, latency, elapsed;
+    rt_base_t level;
+
+    ExecutorInit( );
+    // RT-Thread 5 returns the message length, older kernels RT_EOK
+    if( ( rt_mq_recv( &ExecutorQueue, &msg, sizeof( msg ), RT_WAITING_NO ) < 0 ) &&
+        ( ExecutorTakePending( &msg ) == false ) &&
+        ( rt_mq_recv( &ExecutorQueue, &msg, sizeof( msg ), timeout ) < 0 ) )
+    {
+        return -RT_ETIMEOUT;
+    }
+
+    start = LORA_RADIO_TIMESTAMP_US( );
+    latency = start - msg.PostedUs;
+    ExecutorCall( &msg );
+    elapsed = LORA_RADIO_TIMESTAMP_US( ) - start;
+
+    level = rt_hw_interrupt_disable( );
+    ExecutorStats.Dispatched++;
+    ExecutorStats.LatencyTotalUs += latency;
+    if( latency > ExecutorStats.LatencyMaxUs )
+    {
+        ExecutorStats.LatencyMaxUs = latency;
+    }
+    if( elapsed > ExecutorStats.CallbackMaxUs )
+    {
+        ExecutorStats.CallbackMaxUs = elapsed;
+    }
+    ExecutorStats.Histogram[ExecutorHistogramBin( latency )]++;
+    rt_hw_interrupt_enable( level );
+
+    return RT_EOK;
+}
+
+void lora_radio_executor_stats_get( LoRaRadioExecutorStats_t *stats )
+{
+    rt_base_t level = rt_hw_interrupt_disable( );
+
+    *stats = ExecutorStats;
+    rt_hw_interrupt_enable( level );
+}
+
+void lora_radio_executor_stats_reset( void )
+{
+    rt_base_t level = rt_hw_interrupt_disable( );
+
+    rt_memset( &ExecutorStats, 0, sizeof( ExecutorStats ) );
+    rt_hw_interrupt_enable( level );
+}
+
+#endif // LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
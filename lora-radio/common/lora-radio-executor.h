@@ -0,0 +1,75 @@
+/*!
+ * \file      lora-radio-executor.h
+ *
+ * \brief     deferred radio callbacks, the PHY thread posts them to a message
+ *            queue and goes back to the radio at once
+ *
+ * \copyright SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#ifndef __LORA_RADIO_EXECUTOR_H__
+#define __LORA_RADIO_EXECUTOR_H__
+
+#include "lora-radio.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+
+#ifndef LORA_RADIO_EXECUTOR_QUEUE_SIZE
+#define LORA_RADIO_EXECUTOR_QUEUE_SIZE              8
+#endif
+
+/*!
+ * Worker thread calling the application callbacks. With
+ * LORA_RADIO_EXECUTOR_USING_APP_THREAD no worker is created, the application
+ * calls lora_radio_executor_dispatch from one of its threads instead.
+ */
+#ifndef LORA_RADIO_EXECUTOR_THREAD_PRIORITY
+#define LORA_RADIO_EXECUTOR_THREAD_PRIORITY         8
+#endif
+
+#ifndef LORA_RADIO_EXECUTOR_THREAD_STACK_SIZE
+#define LORA_RADIO_EXECUTOR_THREAD_STACK_SIZE       2048
+#endif
+
+/*!
+ * Dispatch latency histogram, post by the driver -> callback start. Bin 0
+ * counts below 16 us, bin n from 2^(n+3) us up to twice that, the last bin
+ * everything from 16 ms.
+ */
+#define LORA_RADIO_EXECUTOR_HISTOGRAM_BINS          12
+
+typedef struct
+{
+    uint32_t Posted;                                //!< callbacks queued by the driver
+    uint32_t Dropped;                               //!< RxDone callbacks lost, the queue was full
+    uint32_t Coalesced;                             //!< callbacks merged into the pending mask, the queue was full
+    uint32_t Dispatched;                            //!< callbacks called
+    uint32_t LatencyMaxUs;
+    uint64_t LatencyTotalUs;
+    uint32_t CallbackMaxUs;                         //!< longest time spent in one application callback
+    uint32_t Histogram[LORA_RADIO_EXECUTOR_HISTOGRAM_BINS];
+}LoRaRadioExecutorStats_t;
+
+/*!
+ * \brief Chip level callbacks that queue the event for the callbacks of the
+ *        selected instance, handed to the chip driver by lora_radio_init /
+ *        Radio.Init. Creates the queue and the worker thread, once.
+ */
+RadioEvents_t *lora_radio_executor_events( void );
+
+/*!
+ * \brief Calls the application callback of the oldest queued event, waits
+ *        up to \a timeout ticks for one. One thread only, the worker thread
+ *        unless LORA_RADIO_EXECUTOR_USING_APP_THREAD is defined.
+ *
+ * \retval RT_EOK, -RT_ETIMEOUT when no event was queued
+ */
+rt_err_t lora_radio_executor_dispatch( rt_int32_t timeout );
+
+void lora_radio_executor_stats_get( LoRaRadioExecutorStats_t *stats );
+void lora_radio_executor_stats_reset( void );
+
+#endif // LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+
+#endif // __LORA_RADIO_EXECUTOR_H__
@@ -0,0 +1,281 @@
+/*!
+ * \file      lora-radio-hrtimer.c
+ *
+ * \brief     microsecond driver timers on one hardware compare, the
+ *            callbacks run on the PHY thread of their radio instance
+ *
+ * Each radio instance keeps its armed timers in a binary min-heap ordered by
+ * deadline, the board compare is programmed for the earliest deadline of all
+ * instances. The compare interrupt only posts EV_LORA_RADIO_TIMER_FIRED, the
+ * PHY thread pops the expired timers with the driver lock held. A heap
+ * signalled to its PHY thread is left out of the compare until processed.
+ * Heaps and compare are touched with interrupts disabled.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-timer.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+
+#if !defined( LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD ) || defined( PKG_USING_MULTI_RTIMER )
+    #error "LORA_RADIO_DRIVER_USING_HRTIMER runs the timer callbacks on the PHY threads of LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD, without Multi-Rtimer"
+#endif
+
+#if ( LORA_RADIO_HRTIMER_MAX < 1 ) || ( LORA_RADIO_HRTIMER_MAX > 64 )
+    #error "LORA_RADIO_HRTIMER_MAX must be between 1 and 64"
+#endif
+
+#define HRTIMER_VALUE_MAX_US                        0x7FFFFFFFUL
+
+/*!
+ * Deadlines are compared on the wrapping 32 bits us counter
+ */
+#define HRTIMER_BEFORE( a, b )                      ( ( int32_t )( ( a ) - ( b ) ) < 0 )
+
+typedef struct
+{
+    lora_radio_hrtimer_t *Timers[LORA_RADIO_HRTIMER_MAX];
+    uint8_t Count;
+    bool Signalled;                                 //!< EV_LORA_RADIO_TIMER_FIRED posted, not processed yet
+}HrTimerHeap_t;
+
+static HrTimerHeap_t HrTimerHeaps[LORA_RADIO_DRIVER_INSTANCE_NUM];
+static uint32_t HrTimerCompare;
+static bool HrTimerArmed = false;
+
+static void HrTimerPlace( HrTimerHeap_t *heap, uint8_t index, lora_radio_hrtimer_t *obj )
+{
+    heap->Timers[index] = obj;
+    obj->Slot = index + 1;
+}
+
+static void HrTimerSiftUp( HrTimerHeap_t *heap, uint8_t index, lora_radio_hrtimer_t *obj )
+{
+    uint8_t parent;
+
+    while( index > 0 )
+    {
+        parent = ( index - 1 ) / 2;
+        if( HRTIMER_BEFORE( obj->Deadline, heap->Timers[parent]->Deadline ) == false )
+        {
+            break;
+        }
+        HrTimerPlace( heap, index, heap->Timers[parent] );
+        index = parent;
+    }
+    HrTimerPlace( heap, index, obj );
+}
+
+static void HrTimerSiftDown( HrTimerHeap_t *heap, uint8_t index, lora_radio_hrtimer_t *obj )
+{
+    uint8_t child;
+
+    while( ( child = 2 * index + 1 ) < heap->Count )
+    {
+        if( ( ( child + 1 ) < heap->Count ) &&
+            HRTIMER_BEFORE( heap->Timers[child + 1]->Deadline, heap->Timers[child]->Deadline ) )
+        {
+            child++;
+        }
+        if( HRTIMER_BEFORE( heap->Timers[child]->Deadline, obj->Deadline ) == false )
+        {
+            break;
+        }
+        HrTimerPlace( heap, index, heap->Timers[child] );
+        index = child;
+    }
+    HrTimerPlace( heap, index, obj );
+}
+
+static void HrTimerRemove( HrTimerHeap_t *heap, lora_radio_hrtimer_t *obj )
+{
+    uint8_t index = obj->Slot - 1;
+    lora_radio_hrtimer_t *last;
+
+    obj->Slot = 0;
+    last = heap->Timers[--heap->Count];
+    if( last == obj )
+    {
+        return;
+    }
+    // the last timer fills the hole and moves up or down from there
+    if( ( index > 0 ) && HRTIMER_BEFORE( last->Deadline, heap->Timers[( index - 1 ) / 2]->Deadline ) )
+    {
+        HrTimerSiftUp( heap, index, last );
+    }
+    else
+    {
+        HrTimerSiftDown( heap, index, last );
+    }
+}
+
+/*!
+ * \brief Programs the compare for the earliest deadline of the heaps not
+ *        waiting for their PHY thread, interrupts disabled
+ */
+static void HrTimerArm( void )
+{
+    HrTimerHeap_t *heap;
+    uint32_t deadline = 0;
+    bool found = false;
+    uint8_t i;
+
+    for( i = 0; i < LORA_RADIO_DRIVER_INSTANCE_NUM; i++ )
+    {
+        heap = &HrTimerHeaps[i];
+        if( ( heap->Count == 0 ) || ( heap->Signalled == true ) )
+        {
+            continue;
+        }
+        if( ( found == false ) || HRTIMER_BEFORE( heap->Timers[0]->Deadline, deadline ) )
+        {
+            deadline = heap->Timers[0]->Deadline;
+            found = true;
+        }
+    }
+
+    if( found == false )
+    {
+        if( HrTimerArmed == true )
+        {
+            HrTimerArmed = false;
+            lora_radio_hrtimer_port_cancel( );
+        }
+        return;
+    }
+    // starting a later timer leaves the compare as it is
+    if( ( HrTimerArmed == false ) || ( deadline != HrTimerCompare ) )
+    {
+        HrTimerCompare = deadline;
+        HrTimerArmed = true;
+        lora_radio_hrtimer_port_set_compare( deadline );
+    }
+}
+
+void lora_radio_hrtimer_init( lora_radio_hrtimer_t *obj, void ( *callback )( void* context ) )
+{
+    obj->Deadline = 0;
+    obj->ValueUs = 1000000;
+    obj->Instance = 0;
+    obj->Slot = 0;
+    obj->Callback = callback;
+    obj->Context = RT_NULL;
+}
+
+void lora_radio_hrtimer_start( lora_radio_hrtimer_t *obj )
+{
+    HrTimerHeap_t *heap = &HrTimerHeaps[obj->Instance];
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    if( obj->Slot != 0 )
+    {
+        HrTimerRemove( heap, obj );
+    }
+    RT_ASSERT( heap->Count < LORA_RADIO_HRTIMER_MAX );
+    obj->Deadline = LORA_RADIO_TIMESTAMP_US( ) + obj->ValueUs;
+    heap->Count++;
+    HrTimerSiftUp( heap, heap->Count - 1, obj );
+    HrTimerArm( );
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+void lora_radio_hrtimer_stop( lora_radio_hrtimer_t *obj )
+{
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    if( obj->Slot != 0 )
+    {
+        HrTimerRemove( &HrTimerHeaps[obj->Instance], obj );
+        HrTimerArm( );
+    }
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+void lora_radio_hrtimer_reset( lora_radio_hrtimer_t *obj )
+{
+    lora_radio_hrtimer_start( obj );
+}
+
+void lora_radio_hrtimer_set_value( lora_radio_hrtimer_t *obj, uint32_t value )
+{
+    lora_radio_hrtimer_set_value_us( obj, ( value < ( HRTIMER_VALUE_MAX_US / 1000 ) ) ? value * 1000 : HRTIMER_VALUE_MAX_US );
+}
+
+void lora_radio_hrtimer_set_value_us( lora_radio_hrtimer_t *obj, uint32_t valueUs )
+{
+    obj->ValueUs = ( valueUs < HRTIMER_VALUE_MAX_US ) ? valueUs : HRTIMER_VALUE_MAX_US;
+}
+
+void lora_radio_hrtimer_set_context( lora_radio_hrtimer_t *obj, void *context )
+{
+    // the heap of an armed timer cannot change
+    RT_ASSERT( obj->Slot == 0 );
+
+    obj->Context = context;
+    obj->Instance = ( context != RT_NULL ) ? ( ( LoRaRadio_t * )context )->Index : 0;
+}
+
+void lora_radio_hrtimer_isr( void )
+{
+    uint32_t now = LORA_RADIO_TIMESTAMP_US( );
+    HrTimerHeap_t *heap;
+    uint8_t i;
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    HrTimerArmed = false;
+    for( i = 0; i < LORA_RADIO_DRIVER_INSTANCE_NUM; i++ )
+    {
+        heap = &HrTimerHeaps[i];
+        if( ( heap->Count != 0 ) && ( heap->Signalled == false ) &&
+            ( HRTIMER_BEFORE( now, heap->Timers[0]->Deadline ) == false ) )
+        {
+            // until lora_radio_hrtimer_process, unless the PHY thread will not run it
+            heap->Signalled = lora_radio_notify( lora_radio_get( i ), EV_LORA_RADIO_TIMER_FIRED );
+        }
+    }
+    // an early interrupt programs the same deadline again
+    HrTimerArm( );
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+void lora_radio_hrtimer_process( uint8_t instance )
+{
+    HrTimerHeap_t *heap = &HrTimerHeaps[instance];
+    lora_radio_hrtimer_t *obj;
+
+    do
+    {
+        LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+        obj = RT_NULL;
+        if( ( heap->Count != 0 ) &&
+            ( HRTIMER_BEFORE( LORA_RADIO_TIMESTAMP_US( ), heap->Timers[0]->Deadline ) == false ) )
+        {
+            obj = heap->Timers[0];
+            HrTimerRemove( heap, obj );
+        }
+        else
+        {
+            heap->Signalled = false;
+            HrTimerArm( );
+        }
+
+        LORA_RADIO_CRITICAL_SECTION_END( );
+
+        // the callback may start timers again, they go through the heap
+        if( obj != RT_NULL )
+        {
+            obj->Callback( obj->Context );
+        }
+    }while( obj != RT_NULL );
+}
+
+#endif
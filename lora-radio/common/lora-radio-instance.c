@@ -0,0 +1,1009 @@
+/*!
+ * \file      lora-radio-instance.c
+ *
+ * \brief     radio instances: per-instance PHY thread and event object,
+ *            context callbacks and the Radio shim of instance 0
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-timer.h"
+#include "lora-radio-executor.h"
+#include "lora-radio-rx-policy.h"
+
+#define LOG_TAG "PHY.LoRa.Instance"
+#define LOG_LEVEL  LOG_LVL_DBG
+#include "lora-radio-debug.h"
+
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+#ifndef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+    #error "LORA_RADIO_DRIVER_INSTANCE_NUM > 1 needs the PHY threads of LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD"
+#endif
+#ifdef PKG_USING_MULTI_RTIMER
+    #error "LORA_RADIO_DRIVER_INSTANCE_NUM > 1 needs the rt_timer backend, the timer callbacks carry the radio instance"
+#endif
+#endif
+
+#if defined( LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP ) && !defined( LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD )
+    #error "LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP latches the DIO edges in lora_radio_notify of LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD"
+#endif
+
+#define EV_LORA_RADIO_IRQ_ALL          0x003F // DIO0 | DIO1 | DIO2 | DIO3 | DIO4 | DIO5
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+#define EV_LORA_RADIO_PHY_ALL          ( EV_LORA_RADIO_IRQ_ALL | EV_LORA_RADIO_TIMER_FIRED )
+#else
+#define EV_LORA_RADIO_PHY_ALL          EV_LORA_RADIO_IRQ_ALL
+#endif
+
+#ifndef LORA_RADIO_PHY_THREAD_PRIORITY
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X )
+#define LORA_RADIO_PHY_THREAD_PRIORITY 0
+#else
+#define LORA_RADIO_PHY_THREAD_PRIORITY 1      // highest priority
+#endif
+#endif
+
+static LoRaRadio_t lora_radio_instances[LORA_RADIO_DRIVER_INSTANCE_NUM];
+
+/*!
+ * Instance the chip driver state points to, see lora_radio_chip_select()
+ */
+static LoRaRadio_t *lora_radio_selected = &lora_radio_instances[0];
+
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+/*!
+ * Driver lock, the PHY thread holds it across RadioIrqProcess so its SPI
+ * sequences do not interleave with the ones of the application calls
+ */
+static struct rt_mutex lora_radio_mutex;
+static bool lora_radio_mutex_init = false;
+static rt_thread_t lora_radio_owner = RT_NULL;  //!< thread holding lora_radio_mutex
+static uint32_t lora_radio_depth = 0;           //!< times the owner took it
+#endif
+
+LoRaRadio_t *lora_radio_get( uint8_t index )
+{
+    LoRaRadio_t *radio;
+
+    if( index >= LORA_RADIO_DRIVER_INSTANCE_NUM )
+    {
+        return RT_NULL;
+    }
+    radio = &lora_radio_instances[index];
+    radio->Index = index;
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+    radio->Hw = &lora_radio_hw[index];
+#endif
+    return radio;
+}
+
+LoRaRadio_t *lora_radio_current( void )
+{
+    return lora_radio_selected;
+}
+
+LoRaRadio_t *lora_radio_lock( LoRaRadio_t *radio )
+{
+    LoRaRadio_t *previous;
+
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+    // Multi-Rtimer callbacks may run in interrupt context, they cannot block
+    if( rt_interrupt_get_nest( ) != 0 )
+    {
+        return lora_radio_selected;
+    }
+    if( lora_radio_mutex_init == false )
+    {
+        rt_enter_critical( );
+        if( lora_radio_mutex_init == false )
+        {
+            rt_mutex_init( &lora_radio_mutex, "lr_lock", RT_IPC_FLAG_PRIO );
+            lora_radio_mutex_init = true;
+        }
+        rt_exit_critical( );
+    }
+    // recursive, a callback may call the API of the same or another instance
+    rt_mutex_take( &lora_radio_mutex, RT_WAITING_FOREVER );
+    lora_radio_owner = rt_thread_self( );
+    lora_radio_depth++;
+#endif
+    previous = lora_radio_selected;
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+    if( ( radio != RT_NULL ) && ( radio != lora_radio_selected ) )
+    {
+        lora_radio_selected = radio;
+        lora_radio_chip_select( radio->Index );
+    }
+#endif
+    return previous;
+}
+
+void lora_radio_unlock( LoRaRadio_t *previous )
+{
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+    if( previous != lora_radio_selected )
+    {
+        lora_radio_selected = previous;
+        lora_radio_chip_select( previous->Index );
+    }
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+    if( rt_interrupt_get_nest( ) == 0 )
+    {
+        if( --lora_radio_depth == 0 )
+        {
+            lora_radio_owner = RT_NULL;
+        }
+        rt_mutex_release( &lora_radio_mutex );
+    }
+#endif
+}
+
+/*!
+ * \brief Gives the driver lock up entirely for an application callback, the
+ *        other threads and instances do not wait for the application
+ *
+ * \retval depth times the lock was held, to be given to lora_radio_callback_end
+ */
+static uint32_t lora_radio_callback_begin( void )
+{
+    uint32_t depth = 0;
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+    uint32_t i;
+
+    if( ( rt_interrupt_get_nest( ) == 0 ) && ( lora_radio_owner == rt_thread_self( ) ) )
+    {
+        depth = lora_radio_depth;
+        lora_radio_depth = 0;
+        lora_radio_owner = RT_NULL;
+        for( i = 0; i < depth; i++ )
+        {
+            rt_mutex_release( &lora_radio_mutex );
+        }
+    }
+#endif
+    return depth;
+}
+
+/*!
+ * \brief Takes the driver lock back after the callback and selects \a radio
+ *        again, another thread may have worked on an other instance meanwhile
+ */
+static void lora_radio_callback_end( LoRaRadio_t *radio, uint32_t depth )
+{
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+    uint32_t i;
+
+    for( i = 0; i < depth; i++ )
+    {
+        rt_mutex_take( &lora_radio_mutex, RT_WAITING_FOREVER );
+    }
+    if( depth != 0 )
+    {
+        lora_radio_owner = rt_thread_self( );
+        lora_radio_depth = depth;
+    }
+#endif
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+    if( radio != lora_radio_selected )
+    {
+        lora_radio_selected = radio;
+        lora_radio_chip_select( radio->Index );
+    }
+#endif
+}
+
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+static void lora_radio_latch_dio( LoRaRadio_t *radio, uint32_t events, uint32_t now )
+{
+    uint8_t dio;
+
+    for( dio = 0; dio < 6; dio++ )
+    {
+        if( ( events & ( 1UL << dio ) ) != 0 )
+        {
+            radio->DioIrqUs[dio] = now;
+        }
+    }
+}
+#endif
+
+/*!
+ * \brief Hands the events of one wakeup to the chip driver and the timers,
+ *        driver lock held
+ */
+static void lora_radio_dispatch( LoRaRadio_t *radio, uint32_t events )
+{
+    if( ( events & EV_LORA_RADIO_IRQ_ALL ) != 0 )
+    {
+        lora_radio_chip_irq_process( events & EV_LORA_RADIO_IRQ_ALL );
+    }
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+    // a DIO that ends the operation first stops its timeout timer
+    if( ( events & EV_LORA_RADIO_TIMER_FIRED ) != 0 )
+    {
+        lora_radio_hrtimer_process( radio->Index );
+    }
+#endif
+}
+
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+#define LORA_RADIO_EVENT_RING_MASK     ( LORA_RADIO_EVENT_RING_SIZE - 1 )
+
+/*
+ * The ring of an instance has one consumer, its PHY thread, which reads
+ * without locking. The producers are the DIO and timer interrupts, they may
+ * nest on some MCUs and fill a slot with interrupts masked for a few stores.
+ * Only the post that makes the ring non-empty releases the semaphore, the
+ * other ones do not go through the scheduler. No event is lost: once the
+ * ring is full the events are ORed into RingOverflow until the PHY thread
+ * took it, which it does after the ring, so the order is kept.
+ */
+bool lora_radio_notify( LoRaRadio_t *radio, uint32_t events )
+{
+    uint32_t now = LORA_RADIO_TIMESTAMP_US( );
+    LoRaRadioIrqEvent_t *entry;
+    uint32_t tail, used;
+    rt_base_t level;
+
+    if( radio == RT_NULL )
+    {
+        radio = &lora_radio_instances[0];
+    }
+
+    level = rt_hw_interrupt_disable( );
+    tail = radio->RingTail;
+    used = tail - LORA_RADIO_LOAD_ACQUIRE( &radio->RingHead );
+    radio->RingSequence++;
+    if( ( used >= LORA_RADIO_EVENT_RING_SIZE ) || ( radio->RingOverflow != 0 ) )
+    {
+        // the ring is not empty, the PHY thread is already woken
+        if( radio->RingOverflow == 0 )
+        {
+            radio->RingOverflowUs = now;
+        }
+        radio->RingOverflow |= events;
+        radio->RingStats.Overflowed++;
+        rt_hw_interrupt_enable( level );
+        return true;
+    }
+    entry = &radio->Ring[tail & LORA_RADIO_EVENT_RING_MASK];
+    entry->Events = events;
+    entry->Timestamp = now;
+    entry->Sequence = radio->RingSequence;
+    radio->RingStats.Posted++;
+    if( ( used + 1 ) > radio->RingStats.HighWater )
+    {
+        radio->RingStats.HighWater = used + 1;
+    }
+    if( used == 0 )
+    {
+        radio->RingStats.Wakeups++;
+    }
+    LORA_RADIO_STORE_RELEASE( &radio->RingTail, tail + 1 );
+    rt_hw_interrupt_enable( level );
+
+    if( used == 0 )
+    {
+        rt_sem_release( &radio->Wakeup );
+    }
+    return true;
+}
+
+/*!
+ * \brief Handles one event of the ring or the overflow, driver lock held
+ */
+static void lora_radio_handle( LoRaRadio_t *radio, uint32_t events, uint32_t timestamp )
+{
+    uint32_t latency = LORA_RADIO_TIMESTAMP_US( ) - timestamp;
+
+    radio->RingStats.Handled++;
+    radio->RingStats.LatencyTotalUs += latency;
+    if( latency > radio->RingStats.LatencyMaxUs )
+    {
+        radio->RingStats.LatencyMaxUs = latency;
+    }
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+    lora_radio_latch_dio( radio, events, timestamp );
+#endif
+    lora_radio_dispatch( radio, events );
+}
+
+/**
+  * @brief  lora_radio_thread_entry, PHY thread of a radio instance
+  * @param  parameter the radio instance
+  * @retval None
+  */
+static void lora_radio_thread_entry( void* parameter )
+{
+    LoRaRadio_t *radio = parameter;
+    LoRaRadio_t *previous;
+    LoRaRadioIrqEvent_t entry;
+    uint32_t head, overflow, timestamp;
+    rt_base_t level;
+
+    while( 1 )
+    {
+        if( rt_sem_take( &radio->Wakeup, RT_WAITING_FOREVER ) != RT_EOK )
+        {
+            continue;
+        }
+        previous = lora_radio_lock( radio );
+        // the slot is given back once handled, a post meanwhile does not wake the thread again
+        for( head = radio->RingHead; head != LORA_RADIO_LOAD_ACQUIRE( &radio->RingTail ); head++ )
+        {
+            entry = radio->Ring[head & LORA_RADIO_EVENT_RING_MASK];
+            lora_radio_handle( radio, entry.Events, entry.Timestamp );
+            LORA_RADIO_STORE_RELEASE( &radio->RingHead, head + 1 );
+        }
+        // posted after every event of the ring, a post from now on goes to the ring again
+        level = rt_hw_interrupt_disable( );
+        overflow = radio->RingOverflow;
+        timestamp = radio->RingOverflowUs;
+        radio->RingOverflow = 0;
+        rt_hw_interrupt_enable( level );
+        if( overflow != 0 )
+        {
+            lora_radio_handle( radio, overflow, timestamp );
+        }
+        lora_radio_unlock( previous );
+    }
+}
+
+void lora_radio_event_ring_stats_get( LoRaRadio_t *radio, LoRaRadioEventRingStats_t *stats )
+{
+    LoRaRadio_t *previous;
+    rt_base_t level;
+
+    if( radio == RT_NULL )
+    {
+        radio = &lora_radio_instances[0];
+    }
+    previous = lora_radio_lock( RT_NULL );
+    level = rt_hw_interrupt_disable( );
+    *stats = radio->RingStats;
+    rt_hw_interrupt_enable( level );
+    lora_radio_unlock( previous );
+}
+
+void lora_radio_event_ring_stats_reset( LoRaRadio_t *radio )
+{
+    LoRaRadio_t *previous;
+    rt_base_t level;
+
+    if( radio == RT_NULL )
+    {
+        radio = &lora_radio_instances[0];
+    }
+    previous = lora_radio_lock( RT_NULL );
+    level = rt_hw_interrupt_disable( );
+    rt_memset( &radio->RingStats, 0, sizeof( radio->RingStats ) );
+    rt_hw_interrupt_enable( level );
+    lora_radio_unlock( previous );
+}
+#else
+bool lora_radio_notify( LoRaRadio_t *radio, uint32_t events )
+{
+    if( radio == RT_NULL )
+    {
+        radio = &lora_radio_instances[0];
+    }
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+    // latched first thing, the edge time does not depend on the PHY thread wakeup
+    lora_radio_latch_dio( radio, events, LORA_RADIO_TIMESTAMP_US( ) );
+#endif
+    return ( rt_event_send( &radio->Event, events ) == RT_EOK );
+}
+
+/**
+  * @brief  lora_radio_thread_entry, PHY thread of a radio instance
+  * @param  parameter the radio instance
+  * @retval None
+  */
+static void lora_radio_thread_entry( void* parameter )
+{
+    LoRaRadio_t *radio = parameter;
+    LoRaRadio_t *previous;
+    rt_uint32_t ev;
+
+    while( 1 )
+    {
+        if( rt_event_recv( &radio->Event, EV_LORA_RADIO_PHY_ALL,
+                           RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
+                           RT_WAITING_FOREVER, &ev ) == RT_EOK )
+        {
+            previous = lora_radio_lock( radio );
+            lora_radio_dispatch( radio, ev );
+            lora_radio_unlock( previous );
+        }
+    }
+}
+#endif // LORA_RADIO_DRIVER_USING_EVENT_RING
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+void lora_radio_timestamp_capture( bool tx, uint8_t dio, uint32_t timeOnAirUs )
+{
+    LoRaRadio_t *radio = lora_radio_current( );
+    LoRaRadioTimestamp_t *timestamp = ( tx == true ) ? &radio->TxTimestamp : &radio->RxTimestamp;
+
+    timestamp->IrqUs = radio->DioIrqUs[dio];
+    timestamp->EndUs = timestamp->IrqUs - ( ( tx == true ) ? LORA_RADIO_TX_DONE_LATENCY_US : LORA_RADIO_RX_DONE_LATENCY_US );
+    timestamp->StartUs = timestamp->EndUs - timeOnAirUs;
+    timestamp->TimeOnAirUs = timeOnAirUs;
+    timestamp->LatencyUs = LORA_RADIO_TIMESTAMP_US( ) - timestamp->IrqUs;
+    timestamp->Valid = true;
+}
+
+static bool lora_radio_timestamp_get( LoRaRadio_t *radio, bool tx, LoRaRadioTimestamp_t *timestamp )
+{
+    LoRaRadio_t *previous;
+
+    if( radio == RT_NULL )
+    {
+        radio = &lora_radio_instances[0];
+    }
+    // the PHY thread updates it with the driver lock held
+    previous = lora_radio_lock( RT_NULL );
+    *timestamp = ( tx == true ) ? radio->TxTimestamp : radio->RxTimestamp;
+    lora_radio_unlock( previous );
+    return timestamp->Valid;
+}
+
+bool lora_radio_get_tx_timestamp( LoRaRadio_t *radio, LoRaRadioTimestamp_t *timestamp )
+{
+    return lora_radio_timestamp_get( radio, true, timestamp );
+}
+
+bool lora_radio_get_rx_timestamp( LoRaRadio_t *radio, LoRaRadioTimestamp_t *timestamp )
+{
+    return lora_radio_timestamp_get( radio, false, timestamp );
+}
+#endif
+
+/*!
+ * \brief Creates the event object and the PHY thread of \a radio, once
+ */
+static void lora_radio_start( LoRaRadio_t *radio )
+{
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+    char ev_name[RT_NAME_MAX];
+    char thread_name[RT_NAME_MAX];
+
+    if( radio->Started == true )
+    {
+        return;
+    }
+    // instance 0 keeps the historical names
+    rt_snprintf( ev_name, sizeof( ev_name ), "ev_phy%d", radio->Index % 10 );
+    rt_snprintf( thread_name, sizeof( thread_name ), "lr-phy%d", radio->Index % 10 );
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+    rt_sem_init( &radio->Wakeup, ( radio->Index == 0 ) ? "ev_phy" : ev_name, 0, RT_IPC_FLAG_PRIO );
+#else
+    rt_event_init( &radio->Event, ( radio->Index == 0 ) ? "ev_phy" : ev_name, RT_IPC_FLAG_PRIO );
+#endif
+    rt_thread_init( &radio->Thread,
+                    ( radio->Index == 0 ) ? "lora-phy" : thread_name,
+                    lora_radio_thread_entry,
+                    radio,
+                    &radio->ThreadStack[0],
+                    sizeof( radio->ThreadStack ),
+                    LORA_RADIO_PHY_THREAD_PRIORITY,
+                    20 );
+    rt_thread_startup( &radio->Thread );
+#endif
+    radio->Started = true;
+}
+
+/*
+ * Callbacks handed to the chip driver, they call the ones registered by
+ * lora_radio_init, or by Radio.Init without context. The chip only calls
+ * them with the driver lock held and the instance selected; the lock is
+ * given up while the application runs.
+ */
+#define LORA_RADIO_CALLBACK( radio, name, args, legacyArgs )                             \
+    do                                                                                  \
+    {                                                                                   \
+        uint32_t depth = lora_radio_callback_begin( );                                  \
+        if( ( radio->Events != RT_NULL ) && ( radio->Events->name != RT_NULL ) )        \
+        {                                                                               \
+            radio->Events->name args;                                                   \
+        }                                                                               \
+        else if( ( radio->Events == RT_NULL ) && ( radio->LegacyEvents != RT_NULL ) &&  \
+                 ( radio->LegacyEvents->name != RT_NULL ) )                             \
+        {                                                                               \
+            radio->LegacyEvents->name legacyArgs;                                       \
+        }                                                                               \
+        lora_radio_callback_end( radio, depth );                                        \
+    }while( 0 )
+
+static void lora_radio_on_tx_done( void )
+{
+    LoRaRadio_t *radio = lora_radio_current( );
+
+    LORA_RADIO_CALLBACK( radio, TxDone, ( radio->Context ), ( ) );
+}
+
+static void lora_radio_on_tx_timeout( void )
+{
+    LoRaRadio_t *radio = lora_radio_current( );
+
+    LORA_RADIO_CALLBACK( radio, TxTimeout, ( radio->Context ), ( ) );
+}
+
+static void lora_radio_on_rx_done( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
+{
+    LoRaRadio_t *radio = lora_radio_current( );
+
+    LORA_RADIO_CALLBACK( radio, RxDone, ( radio->Context, payload, size, rssi, snr ), ( payload, size, rssi, snr ) );
+}
+
+static void lora_radio_on_rx_timeout( void )
+{
+    LoRaRadio_t *radio = lora_radio_current( );
+
+    LORA_RADIO_CALLBACK( radio, RxTimeout, ( radio->Context ), ( ) );
+}
+
+static void lora_radio_on_rx_error( void )
+{
+    LoRaRadio_t *radio = lora_radio_current( );
+
+    LORA_RADIO_CALLBACK( radio, RxError, ( radio->Context ), ( ) );
+}
+
+static void lora_radio_on_fhss_change_channel( uint8_t currentChannel )
+{
+    LoRaRadio_t *radio = lora_radio_current( );
+
+    LORA_RADIO_CALLBACK( radio, FhssChangeChannel, ( radio->Context, currentChannel ), ( currentChannel ) );
+}
+
+static void lora_radio_on_cad_done( bool channelActivityDetected )
+{
+    LoRaRadio_t *radio = lora_radio_current( );
+
+    LORA_RADIO_CALLBACK( radio, CadDone, ( radio->Context, channelActivityDetected ), ( channelActivityDetected ) );
+}
+
+static RadioEvents_t lora_radio_context_events =
+{
+    .TxDone = lora_radio_on_tx_done,
+    .TxTimeout = lora_radio_on_tx_timeout,
+    .RxDone = lora_radio_on_rx_done,
+    .RxTimeout = lora_radio_on_rx_timeout,
+    .RxError = lora_radio_on_rx_error,
+    .FhssChangeChannel = lora_radio_on_fhss_change_channel,
+    .CadDone = lora_radio_on_cad_done,
+};
+
+/*!
+ * \brief Initializes the chip of \a radio with the chip level callbacks \a chip_events
+ */
+static bool lora_radio_chip_init( LoRaRadio_t *radio, RadioEvents_t *chip_events )
+{
+    LoRaRadio_t *previous;
+    bool ret;
+
+    lora_radio_start( radio );
+#ifdef LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+    // the chip posts its callbacks, the executor calls the ones registered on the instance
+    chip_events = lora_radio_executor_events( );
+#endif
+
+    previous = lora_radio_lock( radio );
+    ret = LoRaRadioOps.Init( chip_events );
+    lora_radio_unlock( previous );
+
+    LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "radio %d init %s\n", radio->Index, ( ret == true ) ? "succeed" : "failed");
+    return ret;
+}
+
+bool lora_radio_init( LoRaRadio_t *radio, const LoRaRadioEvents_t *events, void *context )
+{
+    radio->Events = events;
+    radio->Context = context;
+    radio->LegacyEvents = RT_NULL;
+
+    return lora_radio_chip_init( radio, &lora_radio_context_events );
+}
+
+/*
+ * Radio_s operations on a radio instance
+ */
+#define LORA_RADIO_CALL( radio, call )                  \
+    do                                                  \
+    {                                                   \
+        LoRaRadio_t *previous = lora_radio_lock( radio );\
+        call;                                           \
+        lora_radio_unlock( previous );                  \
+    }while( 0 )
+
+RadioState_t lora_radio_get_status( LoRaRadio_t *radio )
+{
+    RadioState_t status;
+
+    LORA_RADIO_CALL( radio, status = LoRaRadioOps.GetStatus( ) );
+    return status;
+}
+
+void lora_radio_set_modem( LoRaRadio_t *radio, RadioModems_t modem )
+{
+    LORA_RADIO_CALL( radio, LoRaRadioOps.SetModem( modem ) );
+}
+
+void lora_radio_set_channel( LoRaRadio_t *radio, uint32_t freq )
+{
+    LORA_RADIO_CALL( radio, LoRaRadioOps.SetChannel( freq ) );
+}
+
+bool lora_radio_is_channel_free( LoRaRadio_t *radio, RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime )
+{
+    bool free;
+
+    LORA_RADIO_CALL( radio, lora_radio_rx_policy_cancel( ); free = LoRaRadioOps.IsChannelFree( modem, freq, rssiThresh, maxCarrierSenseTime ) );
+    return free;
+}
+
+uint32_t lora_radio_random( LoRaRadio_t *radio )
+{
+    uint32_t rnd;
+
+    LORA_RADIO_CALL( radio, rnd = LoRaRadioOps.Random( ) );
+    return rnd;
+}
+
+void lora_radio_set_rx_config( LoRaRadio_t *radio, RadioModems_t modem, uint32_t bandwidth,
+                               uint32_t datarate, uint8_t coderate,
+                               uint32_t bandwidthAfc, uint16_t preambleLen,
+                               uint16_t symbTimeout, bool fixLen,
+                               uint8_t payloadLen,
+                               bool crcOn, bool freqHopOn, uint8_t hopPeriod,
+                               bool iqInverted, bool rxContinuous )
+{
+    LORA_RADIO_CALL( radio, LoRaRadioOps.SetRxConfig( modem, bandwidth, datarate, coderate, bandwidthAfc,
+                                                      preambleLen, symbTimeout, fixLen, payloadLen,
+                                                      crcOn, freqHopOn, hopPeriod, iqInverted, rxContinuous ) );
+}
+
+void lora_radio_set_tx_config( LoRaRadio_t *radio, RadioModems_t modem, int8_t power, uint32_t fdev,
+                               uint32_t bandwidth, uint32_t datarate,
+                               uint8_t coderate, uint16_t preambleLen,
+                               bool fixLen, bool crcOn, bool freqHopOn,
+                               uint8_t hopPeriod, bool iqInverted, uint32_t timeout )
+{
+    LORA_RADIO_CALL( radio, LoRaRadioOps.SetTxConfig( modem, power, fdev, bandwidth, datarate, coderate,
+                                                      preambleLen, fixLen, crcOn, freqHopOn, hopPeriod,
+                                                      iqInverted, timeout ) );
+}
+
+bool lora_radio_check_rf_frequency( LoRaRadio_t *radio, uint32_t frequency )
+{
+    bool ok;
+
+    LORA_RADIO_CALL( radio, ok = LoRaRadioOps.CheckRfFrequency( frequency ) );
+    return ok;
+}
+
+uint32_t lora_radio_time_on_air( LoRaRadio_t *radio, RadioModems_t modem, uint32_t bandwidth,
+                                 uint32_t datarate, uint8_t coderate,
+                                 uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
+                                 bool crcOn )
+{
+    uint32_t toa;
+
+    LORA_RADIO_CALL( radio, toa = LoRaRadioOps.TimeOnAir( modem, bandwidth, datarate, coderate,
+                                                          preambleLen, fixLen, payloadLen, crcOn ) );
+    return toa;
+}
+
+void lora_radio_send( LoRaRadio_t *radio, uint8_t *buffer, uint8_t size )
+{
+    LORA_RADIO_CALL( radio, lora_radio_rx_policy_cancel( ); LoRaRadioOps.Send( buffer, size ) );
+}
+
+void lora_radio_sleep( LoRaRadio_t *radio )
+{
+    LORA_RADIO_CALL( radio, lora_radio_rx_policy_cancel( ); LoRaRadioOps.Sleep( ) );
+}
+
+void lora_radio_standby( LoRaRadio_t *radio )
+{
+    LORA_RADIO_CALL( radio, lora_radio_rx_policy_cancel( ); LoRaRadioOps.Standby( ) );
+}
+
+void lora_radio_rx( LoRaRadio_t *radio, uint32_t timeout )
+{
+    LORA_RADIO_CALL( radio, lora_radio_rx_policy_start( ); LoRaRadioOps.Rx( timeout ) );
+}
+
+void lora_radio_start_cad( LoRaRadio_t *radio )
+{
+    LORA_RADIO_CALL( radio, lora_radio_rx_policy_cancel( ); LoRaRadioOps.StartCad( ) );
+}
+
+void lora_radio_set_tx_continuous_wave( LoRaRadio_t *radio, uint32_t freq, int8_t power, uint16_t time )
+{
+    LORA_RADIO_CALL( radio, lora_radio_rx_policy_cancel( ); LoRaRadioOps.SetTxContinuousWave( freq, power, time ) );
+}
+
+int16_t lora_radio_rssi( LoRaRadio_t *radio, RadioModems_t modem )
+{
+    int16_t rssi;
+
+    LORA_RADIO_CALL( radio, rssi = LoRaRadioOps.Rssi( modem ) );
+    return rssi;
+}
+
+void lora_radio_write( LoRaRadio_t *radio, uint16_t addr, uint8_t data )
+{
+    LORA_RADIO_CALL( radio, LoRaRadioOps.Write( addr, data ) );
+}
+
+uint8_t lora_radio_read( LoRaRadio_t *radio, uint16_t addr )
+{
+    uint8_t data;
+
+    LORA_RADIO_CALL( radio, data = LoRaRadioOps.Read( addr ) );
+    return data;
+}
+
+void lora_radio_set_max_payload_length( LoRaRadio_t *radio, RadioModems_t modem, uint8_t max )
+{
+    LORA_RADIO_CALL( radio, LoRaRadioOps.SetMaxPayloadLength( modem, max ) );
+}
+
+void lora_radio_set_public_network( LoRaRadio_t *radio, bool enable )
+{
+    LORA_RADIO_CALL( radio, LoRaRadioOps.SetPublicNetwork( enable ) );
+}
+
+uint32_t lora_radio_get_wakeup_time( LoRaRadio_t *radio )
+{
+    uint32_t time;
+
+    LORA_RADIO_CALL( radio, time = LoRaRadioOps.GetWakeupTime( ) );
+    return time;
+}
+
+uint8_t lora_radio_check( LoRaRadio_t *radio )
+{
+    uint8_t ret;
+
+    LORA_RADIO_CALL( radio, ret = LoRaRadioOps.Check( ) );
+    return ret;
+}
+
+void lora_radio_rx_boosted( LoRaRadio_t *radio, uint32_t timeout )
+{
+    if( LoRaRadioOps.RxBoosted != RT_NULL )
+    {
+        LORA_RADIO_CALL( radio, lora_radio_rx_policy_start( ); LoRaRadioOps.RxBoosted( timeout ) );
+    }
+    else
+    {
+        lora_radio_rx( radio, timeout );
+    }
+}
+
+void lora_radio_set_rx_duty_cycle( LoRaRadio_t *radio, uint32_t rxTime, uint32_t sleepTime )
+{
+    if( LoRaRadioOps.SetRxDutyCycle != RT_NULL )
+    {
+        LORA_RADIO_CALL( radio, lora_radio_rx_policy_cancel( ); LoRaRadioOps.SetRxDutyCycle( rxTime, sleepTime ) );
+    }
+}
+
+/*
+ * Radio shim: the historical single radio interface, bound to instance 0
+ * and its callbacks without context
+ */
+static bool RadioShimInit( RadioEvents_t *events )
+{
+    LoRaRadio_t *radio = lora_radio_get( 0 );
+
+    radio->Events = RT_NULL;
+    radio->Context = RT_NULL;
+    radio->LegacyEvents = events;
+
+    return lora_radio_chip_init( radio, &lora_radio_context_events );
+}
+
+static RadioState_t RadioShimGetStatus( void )
+{
+    return lora_radio_get_status( &lora_radio_instances[0] );
+}
+
+static void RadioShimSetModem( RadioModems_t modem )
+{
+    lora_radio_set_modem( &lora_radio_instances[0], modem );
+}
+
+static void RadioShimSetChannel( uint32_t freq )
+{
+    lora_radio_set_channel( &lora_radio_instances[0], freq );
+}
+
+static bool RadioShimIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime )
+{
+    return lora_radio_is_channel_free( &lora_radio_instances[0], modem, freq, rssiThresh, maxCarrierSenseTime );
+}
+
+static uint32_t RadioShimRandom( void )
+{
+    return lora_radio_random( &lora_radio_instances[0] );
+}
+
+static void RadioShimSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
+                                  uint32_t datarate, uint8_t coderate,
+                                  uint32_t bandwidthAfc, uint16_t preambleLen,
+                                  uint16_t symbTimeout, bool fixLen,
+                                  uint8_t payloadLen,
+                                  bool crcOn, bool freqHopOn, uint8_t hopPeriod,
+                                  bool iqInverted, bool rxContinuous )
+{
+    lora_radio_set_rx_config( &lora_radio_instances[0], modem, bandwidth, datarate, coderate, bandwidthAfc,
+                              preambleLen, symbTimeout, fixLen, payloadLen,
+                              crcOn, freqHopOn, hopPeriod, iqInverted, rxContinuous );
+}
+
+static void RadioShimSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
+                                  uint32_t bandwidth, uint32_t datarate,
+                                  uint8_t coderate, uint16_t preambleLen,
+                                  bool fixLen, bool crcOn, bool freqHopOn,
+                                  uint8_t hopPeriod, bool iqInverted, uint32_t timeout )
+{
+    lora_radio_set_tx_config( &lora_radio_instances[0], modem, power, fdev, bandwidth, datarate, coderate,
+                              preambleLen, fixLen, crcOn, freqHopOn, hopPeriod, iqInverted, timeout );
+}
+
+static bool RadioShimCheckRfFrequency( uint32_t frequency )
+{
+    return lora_radio_check_rf_frequency( &lora_radio_instances[0], frequency );
+}
+
+static uint32_t RadioShimTimeOnAir( RadioModems_t modem, uint32_t bandwidth,
+                                    uint32_t datarate, uint8_t coderate,
+                                    uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
+                                    bool crcOn )
+{
+    return lora_radio_time_on_air( &lora_radio_instances[0], modem, bandwidth, datarate, coderate,
+                                   preambleLen, fixLen, payloadLen, crcOn );
+}
+
+static void RadioShimSend( uint8_t *buffer, uint8_t size )
+{
+    lora_radio_send( &lora_radio_instances[0], buffer, size );
+}
+
+static void RadioShimSleep( void )
+{
+    lora_radio_sleep( &lora_radio_instances[0] );
+}
+
+static void RadioShimStandby( void )
+{
+    lora_radio_standby( &lora_radio_instances[0] );
+}
+
+static void RadioShimRx( uint32_t timeout )
+{
+    lora_radio_rx( &lora_radio_instances[0], timeout );
+}
+
+static void RadioShimStartCad( void )
+{
+    lora_radio_start_cad( &lora_radio_instances[0] );
+}
+
+static void RadioShimSetTxContinuousWave( uint32_t freq, int8_t power, uint16_t time )
+{
+    lora_radio_set_tx_continuous_wave( &lora_radio_instances[0], freq, power, time );
+}
+
+static int16_t RadioShimRssi( RadioModems_t modem )
+{
+    return lora_radio_rssi( &lora_radio_instances[0], modem );
+}
+
+static void RadioShimWrite( uint16_t addr, uint8_t data )
+{
+    lora_radio_write( &lora_radio_instances[0], addr, data );
+}
+
+static uint8_t RadioShimRead( uint16_t addr )
+{
+    return lora_radio_read( &lora_radio_instances[0], addr );
+}
+
+static void RadioShimSetMaxPayloadLength( RadioModems_t modem, uint8_t max )
+{
+    lora_radio_set_max_payload_length( &lora_radio_instances[0], modem, max );
+}
+
+static void RadioShimSetPublicNetwork( bool enable )
+{
+    lora_radio_set_public_network( &lora_radio_instances[0], enable );
+}
+
+static uint32_t RadioShimGetWakeupTime( void )
+{
+    return lora_radio_get_wakeup_time( &lora_radio_instances[0] );
+}
+
+static uint8_t RadioShimCheck( void )
+{
+    return lora_radio_check( &lora_radio_instances[0] );
+}
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X )
+static void RadioShimIrqProcess( void )
+{
+    LORA_RADIO_CALL( &lora_radio_instances[0], LoRaRadioOps.IrqProcess( ) );
+}
+
+static void RadioShimRxBoosted( uint32_t timeout )
+{
+    LORA_RADIO_CALL( &lora_radio_instances[0], lora_radio_rx_policy_start( ); LoRaRadioOps.RxBoosted( timeout ) );
+}
+#endif
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X ) || defined( LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE )
+static void RadioShimSetRxDutyCycle( uint32_t rxTime, uint32_t sleepTime )
+{
+    LORA_RADIO_CALL( &lora_radio_instances[0], lora_radio_rx_policy_cancel( ); LoRaRadioOps.SetRxDutyCycle( rxTime, sleepTime ) );
+}
+#endif
+
+/*!
+ * Radio driver structure initialization, the operations the chip driver
+ * does not implement stay NULL as before
+ */
+const struct Radio_s Radio =
+{
+    RadioShimInit,
+    RadioShimGetStatus,
+    RadioShimSetModem,
+    RadioShimSetChannel,
+    RadioShimIsChannelFree,
+    RadioShimRandom,
+    RadioShimSetRxConfig,
+    RadioShimSetTxConfig,
+    RadioShimCheckRfFrequency,
+    RadioShimTimeOnAir,
+    RadioShimSend,
+    RadioShimSleep,
+    RadioShimStandby,
+    RadioShimRx,
+    RadioShimStartCad,
+    RadioShimSetTxContinuousWave,
+    RadioShimRssi,
+    RadioShimWrite,
+    RadioShimRead,
+    //RadioShimWriteBuffer,
+    //RadioShimReadBuffer,
+    RadioShimSetMaxPayloadLength,
+    RadioShimSetPublicNetwork,
+    RadioShimGetWakeupTime,
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X )
+    RadioShimIrqProcess,
+    RadioShimCheck,
+    RadioShimRxBoosted,
+    RadioShimSetRxDutyCycle,
+#else
+    NULL, // void ( *IrqProcess )( void )
+    RadioShimCheck,
+    //SX126x Only
+    NULL, // void ( *RxBoosted )( uint32_t timeout )
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE
+    RadioShimSetRxDutyCycle,
+#else
+    NULL, // void ( *SetRxDutyCycle )( uint32_t rxTime, uint32_t sleepTime )
+#endif
+#endif
+};
@@ -0,0 +1,356 @@
+/*!
+ * \file      lora-radio-lbt.c
+ *
+ * \brief     non-blocking listen before talk, CAD or sampled RSSI on the
+ *            driver timers with a random back-off, optionally sending the
+ *            frame as soon as the channel is clear
+ *
+ * A request is a small state machine per instance: assess (CAD, or RSSI
+ * readings spaced by the driver timer), then either clear or busy. A busy
+ * channel puts the radio to sleep for a back-off drawn in a window that
+ * doubles with each attempt. The caller and the PHY thread are never held
+ * for the sense time as with Radio.IsChannelFree.
+ *
+ * The module mutex is taken after the driver lock, by the API, the timer
+ * callback and the CadDone hook.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-timer.h"
+#include "lora-radio-lbt.h"
+#include "lora-radio-rx-policy.h"
+#include "lora-radio-noise-floor.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_LBT
+
+typedef enum
+{
+    LBT_IDLE = 0,
+    LBT_CAD,                                        //!< CAD in progress, ends on CadDone
+    LBT_RSSI,                                       //!< receiver on, timer armed for the next reading
+    LBT_BACKOFF,                                    //!< radio asleep, timer armed for the next assessment
+}LbtState_t;
+
+typedef struct
+{
+    LbtState_t State;
+    LoRaRadioLbtParams_t Params;
+    uint8_t *Buffer;                                //!< frame of a send request, RT_NULL otherwise
+    uint8_t Size;
+    uint8_t Attempt;                                //!< assessments of the request so far
+    uint32_t SamplesLeft;                           //!< RSSI readings left in the assessment
+    int16_t RssiThresh;                             //!< [dBm] of the assessment in progress
+    TimerEvent_t Timer;
+    bool TimerReady;
+    LoRaRadioLbtStats_t Stats;
+}Lbt_t;
+
+static Lbt_t Lbts[LORA_RADIO_DRIVER_INSTANCE_NUM];
+static uint32_t LbtSeed = 0;
+static struct rt_mutex LbtMutex;
+static bool LbtMutexInit = false;
+
+static void LbtLock( void )
+{
+    if( LbtMutexInit == false )
+    {
+        rt_enter_critical( );
+        if( LbtMutexInit == false )
+        {
+            rt_mutex_init( &LbtMutex, "lr_lbt", RT_IPC_FLAG_PRIO );
+            LbtMutexInit = true;
+        }
+        rt_exit_critical( );
+    }
+    // recursive, a callback may start the next request
+    rt_mutex_take( &LbtMutex, RT_WAITING_FOREVER );
+}
+
+static void LbtUnlock( void )
+{
+    rt_mutex_release( &LbtMutex );
+}
+
+static Lbt_t *LbtOf( LoRaRadio_t *radio )
+{
+    return &Lbts[( radio != RT_NULL ) ? radio->Index : 0];
+}
+
+/*!
+ * \brief xorshift32, only spreads the back-off of stations that collided,
+ *        the chip random generator would need the radio
+ */
+static uint32_t LbtRandom( void )
+{
+    if( LbtSeed == 0 )
+    {
+        LbtSeed = LORA_RADIO_TIMESTAMP_US( ) | 1;
+    }
+    LbtSeed ^= LbtSeed << 13;
+    LbtSeed ^= LbtSeed >> 17;
+    LbtSeed ^= LbtSeed << 5;
+    return LbtSeed;
+}
+
+static void LbtEnd( Lbt_t *lbt, LoRaRadioLbtResult_t result )
+{
+    void ( *callback )( void *context, LoRaRadioLbtResult_t result ) = lbt->Params.Callback;
+
+    // idle first, the callback may start the next request
+    lbt->State = LBT_IDLE;
+    lbt->Buffer = RT_NULL;
+    if( callback != RT_NULL )
+    {
+        callback( lbt->Params.Context, result );
+    }
+}
+
+static void LbtAssess( Lbt_t *lbt )
+{
+    lbt->Attempt++;
+    lbt->Stats.Assessments++;
+    lora_radio_rx_policy_cancel( );
+
+    if( lbt->Params.Mode == LORA_RADIO_LBT_CAD )
+    {
+        lbt->State = LBT_CAD;
+        if( lbt->Params.Frequency != 0 )
+        {
+            LoRaRadioOps.SetChannel( lbt->Params.Frequency );
+        }
+        LoRaRadioOps.StartCad( );
+    }
+    else
+    {
+        lbt->State = LBT_RSSI;
+        lbt->SamplesLeft = lbt->Params.SenseTime / lbt->Params.SamplePeriod;
+        if( lbt->SamplesLeft == 0 )
+        {
+            lbt->SamplesLeft = 1;
+        }
+        lora_radio_chip_rssi_start( lbt->Params.Modem, lbt->Params.Frequency );
+        lbt->RssiThresh = lbt->Params.RssiThresh;
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+        if( lbt->RssiThresh == LORA_RADIO_RSSI_THRESH_AUTO )
+        {
+            // the estimate may have moved since the previous assessment
+            lbt->RssiThresh = lora_radio_noise_floor_threshold( lora_radio_current( ), lbt->Params.Frequency );
+        }
+#endif
+        // the first reading also leaves the receiver time to settle
+        TimerSetValue( &lbt->Timer, lbt->Params.SamplePeriod );
+        TimerStart( &lbt->Timer );
+    }
+}
+
+static void LbtClear( Lbt_t *lbt )
+{
+    lbt->Stats.Clear++;
+    if( lbt->Params.Mode == LORA_RADIO_LBT_RSSI )
+    {
+        LoRaRadioOps.Standby( );
+    }
+    if( lbt->Buffer != RT_NULL )
+    {
+        LoRaRadioOps.Send( lbt->Buffer, lbt->Size );
+        lbt->Stats.Sent++;
+    }
+    LbtEnd( lbt, LORA_RADIO_LBT_CLEAR );
+}
+
+static void LbtBusy( Lbt_t *lbt )
+{
+    uint32_t window, backoff;
+
+    lbt->Stats.Busy++;
+    LoRaRadioOps.Sleep( );
+
+    if( lbt->Attempt >= lbt->Params.MaxAttempts )
+    {
+        lbt->Stats.GaveUp++;
+        LbtEnd( lbt, LORA_RADIO_LBT_BUSY );
+        return;
+    }
+
+    // binary exponential: [Min, Min << attempt], capped to Max
+    window = lbt->Params.BackoffMax;
+    if( ( lbt->Attempt < 32 ) && ( ( lbt->Params.BackoffMax >> lbt->Attempt ) >= lbt->Params.BackoffMin ) )
+    {
+        window = lbt->Params.BackoffMin << lbt->Attempt;
+    }
+    backoff = lbt->Params.BackoffMin + LbtRandom( ) % ( window - lbt->Params.BackoffMin + 1 );
+
+    if( backoff > lbt->Stats.BackoffMaxMs )
+    {
+        lbt->Stats.BackoffMaxMs = backoff;
+    }
+    lbt->Stats.BackoffTotalMs += backoff;
+
+    lbt->State = LBT_BACKOFF;
+    TimerSetValue( &lbt->Timer, backoff );
+    TimerStart( &lbt->Timer );
+}
+
+static void LbtOnTimer( void *context )
+{
+    LoRaRadio_t *previous = lora_radio_lock( context );
+    Lbt_t *lbt = LbtOf( context );
+
+    LbtLock( );
+    switch( lbt->State )
+    {
+    case LBT_BACKOFF:
+        LbtAssess( lbt );
+        break;
+    case LBT_RSSI:
+        lbt->Stats.Samples++;
+        if( LoRaRadioOps.Rssi( lbt->Params.Modem ) > lbt->RssiThresh )
+        {
+            LbtBusy( lbt );
+        }
+        else if( --lbt->SamplesLeft == 0 )
+        {
+            LbtClear( lbt );
+        }
+        else
+        {
+            TimerStart( &lbt->Timer );
+        }
+        break;
+    default:
+        // aborted meanwhile
+        break;
+    }
+    LbtUnlock( );
+    lora_radio_unlock( previous );
+}
+
+static rt_err_t LbtStart( LoRaRadio_t *radio, const LoRaRadioLbtParams_t *params, uint8_t *buffer, uint8_t size )
+{
+    Lbt_t *lbt;
+    LoRaRadio_t *previous;
+    rt_err_t result = RT_EOK;
+
+    if( radio == RT_NULL )
+    {
+        radio = lora_radio_get( 0 );
+    }
+    lbt = LbtOf( radio );
+    previous = lora_radio_lock( radio );
+
+    LbtLock( );
+    if( lbt->State != LBT_IDLE )
+    {
+        result = -RT_EBUSY;
+    }
+    else
+    {
+        if( lbt->TimerReady == false )
+        {
+            TimerInit( &lbt->Timer, LbtOnTimer );
+            TimerSetContext( &lbt->Timer, radio );
+            lbt->TimerReady = true;
+        }
+        lbt->Params = *params;
+        if( lbt->Params.SamplePeriod == 0 )
+        {
+            lbt->Params.SamplePeriod = 1;
+        }
+        if( lbt->Params.MaxAttempts == 0 )
+        {
+            lbt->Params.MaxAttempts = 1;
+        }
+        if( lbt->Params.BackoffMin == 0 )
+        {
+            lbt->Params.BackoffMin = 1;
+        }
+        if( lbt->Params.BackoffMax < lbt->Params.BackoffMin )
+        {
+            lbt->Params.BackoffMax = lbt->Params.BackoffMin;
+        }
+        lbt->Buffer = buffer;
+        lbt->Size = size;
+        lbt->Attempt = 0;
+        lbt->Stats.Requests++;
+        LbtAssess( lbt );
+    }
+    LbtUnlock( );
+    lora_radio_unlock( previous );
+    return result;
+}
+
+rt_err_t lora_radio_lbt_start( LoRaRadio_t *radio, const LoRaRadioLbtParams_t *params )
+{
+    return LbtStart( radio, params, RT_NULL, 0 );
+}
+
+rt_err_t lora_radio_lbt_send( LoRaRadio_t *radio, const LoRaRadioLbtParams_t *params, uint8_t *buffer, uint8_t size )
+{
+    return LbtStart( radio, params, buffer, size );
+}
+
+void lora_radio_lbt_abort( LoRaRadio_t *radio )
+{
+    Lbt_t *lbt;
+    LoRaRadio_t *previous;
+
+    if( radio == RT_NULL )
+    {
+        radio = lora_radio_get( 0 );
+    }
+    lbt = LbtOf( radio );
+    previous = lora_radio_lock( radio );
+
+    LbtLock( );
+    if( lbt->State != LBT_IDLE )
+    {
+        TimerStop( &lbt->Timer );
+        LoRaRadioOps.Standby( );
+        LbtEnd( lbt, LORA_RADIO_LBT_ABORTED );
+    }
+    LbtUnlock( );
+    lora_radio_unlock( previous );
+}
+
+void lora_radio_lbt_stats_get( LoRaRadio_t *radio, LoRaRadioLbtStats_t *stats )
+{
+    LbtLock( );
+    *stats = LbtOf( radio )->Stats;
+    LbtUnlock( );
+}
+
+void lora_radio_lbt_stats_reset( LoRaRadio_t *radio )
+{
+    LbtLock( );
+    rt_memset( &LbtOf( radio )->Stats, 0, sizeof( LoRaRadioLbtStats_t ) );
+    LbtUnlock( );
+}
+
+bool lora_radio_lbt_cad_done( bool channelActivityDetected )
+{
+    Lbt_t *lbt = LbtOf( lora_radio_current( ) );
+
+    LbtLock( );
+    if( lbt->State != LBT_CAD )
+    {
+        LbtUnlock( );
+        return false;
+    }
+    if( channelActivityDetected == true )
+    {
+        LbtBusy( lbt );
+    }
+    else
+    {
+        LbtClear( lbt );
+    }
+    LbtUnlock( );
+    return true;
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*!
+ * \file      lora-radio-lbt.h
+ *
+ * \brief     non-blocking listen before talk, CAD or sampled RSSI on the
+ *            driver timers with a random back-off, optionally sending the
+ *            frame as soon as the channel is clear
+ *
+ * \copyright SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#ifndef __LORA_RADIO_LBT_H__
+#define __LORA_RADIO_LBT_H__
+
+#include "lora-radio.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_LBT
+
+typedef enum
+{
+    LORA_RADIO_LBT_CAD = 0,                         //!< one CAD per assessment, LoRa configuration in use
+    LORA_RADIO_LBT_RSSI,                            //!< RSSI sampled at a fixed period for SenseTime
+}LoRaRadioLbtMode_t;
+
+/*!
+ * Outcome of a request, passed to its callback
+ */
+typedef enum
+{
+    LORA_RADIO_LBT_CLEAR = 0,                       //!< channel clear, the frame of a send request is on air
+    LORA_RADIO_LBT_BUSY,                            //!< still busy after MaxAttempts assessments
+    LORA_RADIO_LBT_ABORTED,                         //!< removed by lora_radio_lbt_abort
+}LoRaRadioLbtResult_t;
+
+typedef struct
+{
+    LoRaRadioLbtMode_t Mode;
+    RadioModems_t Modem;                            //!< RSSI mode, modem the channel is sensed with
+    uint32_t Frequency;                             //!< [Hz] 0: channel in use
+    int16_t RssiThresh;                             //!< [dBm] RSSI mode, busy above, LORA_RADIO_RSSI_THRESH_AUTO: noise floor + margin
+    uint32_t SenseTime;                             //!< [ms] RSSI mode, the channel must stay below RssiThresh that long
+    uint32_t SamplePeriod;                          //!< [ms] RSSI mode, between two readings, 0: 1 ms
+    uint8_t MaxAttempts;                            //!< assessments before LORA_RADIO_LBT_BUSY, 0: 1
+    uint32_t BackoffMin;                            //!< [ms] shortest back-off, 0: 1 ms
+    uint32_t BackoffMax;                            //!< [ms] the back-off window doubles up to it
+    void ( *Callback )( void *context, LoRaRadioLbtResult_t result );  //!< may be RT_NULL
+    void *Context;
+}LoRaRadioLbtParams_t;
+
+typedef struct
+{
+    uint32_t Requests;                              //!< requests accepted
+    uint32_t Assessments;                           //!< CAD runs or RSSI windows
+    uint32_t Samples;                               //!< RSSI readings
+    uint32_t Busy;                                  //!< assessments that found the channel busy
+    uint32_t Clear;                                 //!< requests that found the channel clear
+    uint32_t GaveUp;                                //!< requests ended with LORA_RADIO_LBT_BUSY
+    uint32_t Sent;                                  //!< frames started when clear
+    uint32_t BackoffMaxMs;
+    uint64_t BackoffTotalMs;
+}LoRaRadioLbtStats_t;
+
+/*!
+ * \brief Assesses the channel of \a radio (RT_NULL for instance 0) and
+ *        returns at once, the callback reports the outcome. Each busy
+ *        assessment puts the radio to sleep for a random back-off, drawn in
+ *        [BackoffMin, BackoffMin << n] after the n-th one and capped to
+ *        BackoffMax, before the next.
+ *
+ * The callback runs with the driver lock held, from the PHY thread or the
+ * driver timer, and may start the next request. Do not use the radio for
+ * anything else while a request is pending. The radio is left in standby
+ * when clear.
+ *
+ * \retval RT_EOK, -RT_EBUSY when a request is already pending on \a radio
+ */
+rt_err_t lora_radio_lbt_start( LoRaRadio_t *radio, const LoRaRadioLbtParams_t *params );
+
+/*!
+ * \brief Send when clear: as lora_radio_lbt_start, the frame is sent as soon
+ *        as the channel is found clear, before the callback. Buffer is not
+ *        copied, it must stay valid until TxDone. TxDone / TxTimeout are
+ *        reported through RadioEvents as for Radio.Send.
+ */
+rt_err_t lora_radio_lbt_send( LoRaRadio_t *radio, const LoRaRadioLbtParams_t *params, uint8_t *buffer, uint8_t size );
+
+/*!
+ * \brief Ends the request pending on \a radio, if any, the radio is left
+ *        in standby
+ */
+void lora_radio_lbt_abort( LoRaRadio_t *radio );
+
+void lora_radio_lbt_stats_get( LoRaRadio_t *radio, LoRaRadioLbtStats_t *stats );
+void lora_radio_lbt_stats_reset( LoRaRadio_t *radio );
+
+/*!
+ * \brief Called by the chip driver, driver lock held, on CadDone of the
+ *        selected instance
+ *
+ * \retval true when the CAD belonged to a request, the driver then does not
+ *         call RadioEvents
+ */
+bool lora_radio_lbt_cad_done( bool channelActivityDetected );
+
+#else
+#define lora_radio_lbt_cad_done( channelActivityDetected )  ( false )
+#endif // LORA_RADIO_DRIVER_USING_LBT
+
+#endif // __LORA_RADIO_LBT_H__
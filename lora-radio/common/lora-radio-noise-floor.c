@@ -0,0 +1,187 @@
+/*!
+ * \file      lora-radio-noise-floor.c
+ *
+ * \brief     per channel noise floor, estimated from RSSI readings taken
+ *            by the chip drivers whenever the receiver is left idle
+ *
+ * The chip drivers read the RSSI once when they leave RX with no frame being
+ * received: end of a continuous window, Standby / Sleep / Send from RX,
+ * Radio.IsChannelFree, LBT and scan channels. A reading costs the SPI
+ * transactions of the RSSI (and frame detection) registers, no timer and no
+ * extra time in RX.
+ *
+ * Each instance keeps a small table of channels with an exponentially
+ * weighted estimate in 1/16 dB. The table and the statistics are updated in
+ * a critical section, the hooks run with the driver lock held.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-noise-floor.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+
+#define NOISE_FLOOR_SCALE       16                  //!< estimates in 1/16 dB
+
+typedef struct
+{
+    uint32_t Frequency;                             //!< 0: free entry
+    int16_t Floor;                                  //!< [1/16 dBm]
+    uint16_t Samples;                               //!< saturates at 0xFFFF
+}NoiseFloorEntry_t;
+
+typedef struct
+{
+    NoiseFloorEntry_t Entries[LORA_RADIO_NOISE_FLOOR_CHANNELS];
+    uint8_t Next;                                   //!< entry replaced when the table is full
+    LoRaRadioNoiseFloorStats_t Stats;
+}NoiseFloor_t;
+
+static NoiseFloor_t NoiseFloors[LORA_RADIO_DRIVER_INSTANCE_NUM];
+
+static NoiseFloor_t *NoiseFloorOf( LoRaRadio_t *radio )
+{
+    return &NoiseFloors[( radio != RT_NULL ) ? radio->Index : 0];
+}
+
+static NoiseFloorEntry_t *NoiseFloorFind( NoiseFloor_t *nf, uint32_t freq )
+{
+    uint8_t i;
+
+    for( i = 0; i < nf->Stats.Channels; i++ )
+    {
+        if( nf->Entries[i].Frequency == freq )
+        {
+            return &nf->Entries[i];
+        }
+    }
+    return RT_NULL;
+}
+
+void lora_radio_noise_floor_sample( uint32_t freq, int16_t rssi )
+{
+    NoiseFloor_t *nf = NoiseFloorOf( lora_radio_current( ) );
+    NoiseFloorEntry_t *entry;
+    int32_t delta;
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    entry = NoiseFloorFind( nf, freq );
+    if( entry == RT_NULL )
+    {
+        if( nf->Stats.Channels < LORA_RADIO_NOISE_FLOOR_CHANNELS )
+        {
+            entry = &nf->Entries[nf->Stats.Channels++];
+        }
+        else
+        {
+            // oldest channel, the table is filled in order
+            entry = &nf->Entries[nf->Next];
+            nf->Next = ( nf->Next + 1 ) % LORA_RADIO_NOISE_FLOOR_CHANNELS;
+            nf->Stats.Evictions++;
+        }
+        entry->Frequency = freq;
+        entry->Floor = rssi * NOISE_FLOOR_SCALE;
+        entry->Samples = 0;
+    }
+    else
+    {
+        delta = rssi * NOISE_FLOOR_SCALE - entry->Floor;
+        entry->Floor += ( int16_t )( delta / ( ( delta < 0 ) ? ( 1 << LORA_RADIO_NOISE_FLOOR_FALL_SHIFT ) :
+                                                               ( 1 << LORA_RADIO_NOISE_FLOOR_RISE_SHIFT ) ) );
+    }
+    if( entry->Samples != 0xFFFF )
+    {
+        entry->Samples++;
+    }
+    nf->Stats.Samples++;
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+void lora_radio_noise_floor_skip( void )
+{
+    NoiseFloorOf( lora_radio_current( ) )->Stats.Skipped++;
+}
+
+int16_t lora_radio_noise_floor_get( LoRaRadio_t *radio, uint32_t freq )
+{
+    NoiseFloor_t *nf = NoiseFloorOf( radio );
+    NoiseFloorEntry_t *entry;
+    int16_t floor = LORA_RADIO_NOISE_FLOOR_UNKNOWN;
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    entry = NoiseFloorFind( nf, freq );
+    if( entry != RT_NULL )
+    {
+        // rounded to the nearest dB
+        floor = ( int16_t )( ( entry->Floor + ( ( entry->Floor < 0 ) ? -( NOISE_FLOOR_SCALE / 2 ) : ( NOISE_FLOOR_SCALE / 2 ) ) ) /
+                             NOISE_FLOOR_SCALE );
+    }
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+    return floor;
+}
+
+int16_t lora_radio_noise_floor_threshold( LoRaRadio_t *radio, uint32_t freq )
+{
+    LoRaRadio_t *previous;
+    int16_t floor;
+
+    if( freq == 0 )
+    {
+        if( radio == RT_NULL )
+        {
+            radio = lora_radio_get( 0 );
+        }
+        previous = lora_radio_lock( radio );
+        freq = lora_radio_chip_get_channel( );
+        lora_radio_unlock( previous );
+    }
+    floor = lora_radio_noise_floor_get( radio, freq );
+    if( floor == LORA_RADIO_NOISE_FLOOR_UNKNOWN )
+    {
+        return LORA_RADIO_NOISE_FLOOR_DEFAULT_THRESH;
+    }
+    return floor + LORA_RADIO_NOISE_FLOOR_MARGIN;
+}
+
+void lora_radio_noise_floor_clear( LoRaRadio_t *radio )
+{
+    NoiseFloor_t *nf = NoiseFloorOf( radio );
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    rt_memset( nf->Entries, 0, sizeof( nf->Entries ) );
+    nf->Next = 0;
+    nf->Stats.Channels = 0;
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+void lora_radio_noise_floor_stats_get( LoRaRadio_t *radio, LoRaRadioNoiseFloorStats_t *stats )
+{
+    NoiseFloor_t *nf = NoiseFloorOf( radio );
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    *stats = nf->Stats;
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+void lora_radio_noise_floor_stats_reset( LoRaRadio_t *radio )
+{
+    NoiseFloor_t *nf = NoiseFloorOf( radio );
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    // the table is kept, see lora_radio_noise_floor_clear
+    nf->Stats.Samples = 0;
+    nf->Stats.Skipped = 0;
+    nf->Stats.Evictions = 0;
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+#endif
@@ -0,0 +1,108 @@
+/*!
+ * \file      lora-radio-noise-floor.h
+ *
+ * \brief     per channel noise floor, estimated from RSSI readings taken
+ *            by the chip drivers whenever the receiver is left idle
+ *
+ * \copyright SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#ifndef __LORA_RADIO_NOISE_FLOOR_H__
+#define __LORA_RADIO_NOISE_FLOOR_H__
+
+#include "lora-radio.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+
+/*!
+ * Channels tracked per instance, the oldest one is replaced when the table
+ * is full
+ */
+#ifndef LORA_RADIO_NOISE_FLOOR_CHANNELS
+#define LORA_RADIO_NOISE_FLOOR_CHANNELS             16
+#endif
+
+/*!
+ * [dB] added to the noise floor by the auto threshold
+ */
+#ifndef LORA_RADIO_NOISE_FLOOR_MARGIN
+#define LORA_RADIO_NOISE_FLOOR_MARGIN               10
+#endif
+
+/*!
+ * [dBm] auto threshold of a channel without estimate yet
+ */
+#ifndef LORA_RADIO_NOISE_FLOOR_DEFAULT_THRESH
+#define LORA_RADIO_NOISE_FLOOR_DEFAULT_THRESH       -90
+#endif
+
+/*!
+ * Weight of a new reading, 1 / 2^shift. Readings below the estimate are
+ * followed quickly, readings above it (interference, frames of other
+ * networks) slowly, so the estimate stays close to the floor.
+ */
+#ifndef LORA_RADIO_NOISE_FLOOR_FALL_SHIFT
+#define LORA_RADIO_NOISE_FLOOR_FALL_SHIFT           2
+#endif
+#ifndef LORA_RADIO_NOISE_FLOOR_RISE_SHIFT
+#define LORA_RADIO_NOISE_FLOOR_RISE_SHIFT           5
+#endif
+
+/*!
+ * rssiThresh of Radio.IsChannelFree and RssiThresh of the LBT parameters:
+ * noise floor of the channel + LORA_RADIO_NOISE_FLOOR_MARGIN
+ */
+#define LORA_RADIO_RSSI_THRESH_AUTO                 ( ( int16_t )0x7FFF )
+
+/*!
+ * lora_radio_noise_floor_get of a channel without estimate
+ */
+#define LORA_RADIO_NOISE_FLOOR_UNKNOWN              ( ( int16_t )0x7FFF )
+
+typedef struct
+{
+    uint32_t Samples;                               //!< readings taken into the estimates
+    uint32_t Skipped;                               //!< receiver left while a frame was received
+    uint32_t Evictions;                             //!< channels replaced in the table
+    uint8_t Channels;                               //!< channels in the table
+}LoRaRadioNoiseFloorStats_t;
+
+/*!
+ * \brief Noise floor estimate of \a freq on \a radio (RT_NULL for instance 0)
+ *
+ * \retval [dBm] or LORA_RADIO_NOISE_FLOOR_UNKNOWN
+ */
+int16_t lora_radio_noise_floor_get( LoRaRadio_t *radio, uint32_t freq );
+
+/*!
+ * \brief Auto threshold of \a freq: noise floor + LORA_RADIO_NOISE_FLOOR_MARGIN,
+ *        LORA_RADIO_NOISE_FLOOR_DEFAULT_THRESH without estimate
+ *
+ * \param [IN] freq  0 for the channel the radio is tuned to
+ */
+int16_t lora_radio_noise_floor_threshold( LoRaRadio_t *radio, uint32_t freq );
+
+/*!
+ * \brief Forgets every estimate of \a radio
+ */
+void lora_radio_noise_floor_clear( LoRaRadio_t *radio );
+
+void lora_radio_noise_floor_stats_get( LoRaRadio_t *radio, LoRaRadioNoiseFloorStats_t *stats );
+void lora_radio_noise_floor_stats_reset( LoRaRadio_t *radio );
+
+/*!
+ * \brief Called by the chip driver of the selected instance when it leaves
+ *        RX with no frame being received, \a rssi read just before
+ */
+void lora_radio_noise_floor_sample( uint32_t freq, int16_t rssi );
+
+/*!
+ * \brief Called by the chip driver of the selected instance when it leaves
+ *        RX while a frame is being received, no reading is taken
+ */
+void lora_radio_noise_floor_skip( void );
+
+#endif // LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+
+#endif // __LORA_RADIO_NOISE_FLOOR_H__
@@ -0,0 +1,180 @@
+/*!
+ * \file      lora-radio-rx-policy.c
+ *
+ * \brief     receiver policy of a radio instance, the driver restarts a
+ *            single RX window itself and measures the receiver blind time
+ *
+ * A single window ends in standby on RxDone, RxTimeout or RxError. The chip
+ * driver reports it before the callback; under LORA_RADIO_RX_AUTO_REARM the
+ * next window starts right there, otherwise the receiver stays off until the
+ * application calls Rx again. The policy is latched per window so the chip
+ * driver sees the same receiver mode from Rx to the end of the window.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-timer.h"
+#include "lora-radio-rx-policy.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_RX_POLICY
+
+typedef struct
+{
+    LoRaRadioRxPolicy_t Policy;                     //!< selected by the application
+    LoRaRadioRxPolicy_t Active;                     //!< latched when the window in progress started
+    uint32_t Window;                                //!< [ms] RX timeout of the windows started by the driver
+    bool Blind;                                     //!< receiver off since BlindStartUs
+    uint32_t BlindStartUs;
+    TimerTime_t ResetTick;                          //!< TimerGetCurrentTime( ) of the last reset
+    LoRaRadioRxPolicyStats_t Stats;
+}RxPolicy_t;
+
+static RxPolicy_t RxPolicies[LORA_RADIO_DRIVER_INSTANCE_NUM];
+
+static RxPolicy_t *RxPolicyOf( LoRaRadio_t *radio )
+{
+    return &RxPolicies[( radio != RT_NULL ) ? radio->Index : 0];
+}
+
+/*!
+ * \brief Ends the blind interval in progress, if any
+ */
+static void RxPolicyClose( RxPolicy_t *rx )
+{
+    uint32_t blind;
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    if( rx->Blind == true )
+    {
+        rx->Blind = false;
+        blind = LORA_RADIO_TIMESTAMP_US( ) - rx->BlindStartUs;
+        if( blind > rx->Stats.BlindMaxUs )
+        {
+            rx->Stats.BlindMaxUs = blind;
+        }
+        rx->Stats.BlindTotalUs += blind;
+        rx->Stats.Gaps++;
+    }
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+void lora_radio_set_rx_policy( LoRaRadio_t *radio, LoRaRadioRxPolicy_t policy, uint32_t window )
+{
+    RxPolicy_t *rx;
+    LoRaRadio_t *previous;
+
+    if( radio == RT_NULL )
+    {
+        radio = lora_radio_get( 0 );
+    }
+    rx = RxPolicyOf( radio );
+    previous = lora_radio_lock( radio );
+    rx->Policy = policy;
+    rx->Window = window;
+    lora_radio_unlock( previous );
+}
+
+void lora_radio_rx_policy_stats_get( LoRaRadio_t *radio, LoRaRadioRxPolicyStats_t *stats )
+{
+    RxPolicy_t *rx = RxPolicyOf( radio );
+    TimerTime_t observed;
+    uint64_t perHour;
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    *stats = rx->Stats;
+    observed = TimerGetCurrentTime( ) - rx->ResetTick;
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+
+    // kept in ticks, a LORA_RADIO_TIMESTAMP_US( ) window would wrap after 71 minutes
+    stats->ObservedMs = ( uint32_t )( ( uint64_t )observed * 1000 / RT_TICK_PER_SECOND );
+    if( stats->ObservedMs != 0 )
+    {
+        perHour = stats->BlindTotalUs * 3600000ULL / stats->ObservedMs;
+        stats->BlindUsPerHour = ( perHour < 0xFFFFFFFFULL ) ? ( uint32_t )perHour : 0xFFFFFFFFUL;
+    }
+}
+
+void lora_radio_rx_policy_stats_reset( LoRaRadio_t *radio )
+{
+    RxPolicy_t *rx = RxPolicyOf( radio );
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    rt_memset( &rx->Stats, 0, sizeof( rx->Stats ) );
+    rx->ResetTick = TimerGetCurrentTime( );
+    // an interval in progress is counted from now on
+    if( rx->Blind == true )
+    {
+        rx->BlindStartUs = LORA_RADIO_TIMESTAMP_US( );
+    }
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+bool lora_radio_rx_policy_continuous( bool configured )
+{
+    switch( RxPolicyOf( lora_radio_current( ) )->Active )
+    {
+    case LORA_RADIO_RX_SINGLE:
+    case LORA_RADIO_RX_AUTO_REARM:
+        return false;
+    case LORA_RADIO_RX_CONTINUOUS:
+        return true;
+    default:
+        return configured;
+    }
+}
+
+void lora_radio_rx_policy_start( void )
+{
+    RxPolicy_t *rx = RxPolicyOf( lora_radio_current( ) );
+
+    rx->Active = rx->Policy;
+    RxPolicyClose( rx );
+}
+
+void lora_radio_rx_policy_cancel( void )
+{
+    RxPolicy_t *rx = RxPolicyOf( lora_radio_current( ) );
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    rx->Blind = false;
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+bool lora_radio_rx_policy_end( void )
+{
+    RxPolicy_t *rx = RxPolicyOf( lora_radio_current( ) );
+    bool rearm;
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+
+    rx->Stats.Windows++;
+    rx->Blind = true;
+    rx->BlindStartUs = LORA_RADIO_TIMESTAMP_US( );
+    // the window that ends follows the policy it was opened with
+    rearm = ( rx->Active == LORA_RADIO_RX_AUTO_REARM );
+    if( rearm == true )
+    {
+        rx->Stats.Rearms++;
+    }
+
+    LORA_RADIO_CRITICAL_SECTION_END( );
+
+    if( rearm == false )
+    {
+        return false;
+    }
+    // the gap covers the restart of the receiver too
+    rx->Active = rx->Policy;
+    LoRaRadioOps.Rx( rx->Window );
+    RxPolicyClose( rx );
+    return true;
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*!
+ * \file      lora-radio-rx-policy.h
+ *
+ * \brief     receiver policy of a radio instance, the driver restarts a
+ *            single RX window itself and measures the receiver blind time
+ *
+ * \copyright SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#ifndef __LORA_RADIO_RX_POLICY_H__
+#define __LORA_RADIO_RX_POLICY_H__
+
+#include "lora-radio.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_RX_POLICY
+
+typedef enum
+{
+    LORA_RADIO_RX_DEFAULT = 0,                      //!< rxContinuous of SetRxConfig, the application restarts single windows
+    LORA_RADIO_RX_SINGLE,                           //!< single windows whatever SetRxConfig says
+    LORA_RADIO_RX_CONTINUOUS,                       //!< continuous receiver whatever SetRxConfig says
+    LORA_RADIO_RX_AUTO_REARM,                       //!< single windows, the driver starts the next one before the callback
+}LoRaRadioRxPolicy_t;
+
+/*!
+ * Blind time is the receiver off between the end of a single window and
+ * the start of the next one, windows followed by Send / Sleep / Standby /
+ * CAD instead are not counted.
+ */
+typedef struct
+{
+    uint32_t Windows;                               //!< single windows ended, receiver off
+    uint32_t Rearms;                                //!< windows restarted by the driver
+    uint32_t Gaps;                                  //!< blind intervals measured
+    uint32_t BlindMaxUs;
+    uint64_t BlindTotalUs;
+    uint32_t ObservedMs;                            //!< since the last reset
+    uint32_t BlindUsPerHour;                        //!< BlindTotalUs scaled to one hour of ObservedMs
+}LoRaRadioRxPolicyStats_t;
+
+/*!
+ * \brief Selects the receiver policy of \a radio (RT_NULL for instance 0),
+ *        applied from the next Rx. With LORA_RADIO_RX_CONTINUOUS the symbol
+ *        timeout of a single window configuration stays, configure 0.
+ *
+ * \param [IN] window  [ms] RX timeout of the windows started by the driver
+ *                     under LORA_RADIO_RX_AUTO_REARM, 0: none
+ */
+void lora_radio_set_rx_policy( LoRaRadio_t *radio, LoRaRadioRxPolicy_t policy, uint32_t window );
+
+void lora_radio_rx_policy_stats_get( LoRaRadio_t *radio, LoRaRadioRxPolicyStats_t *stats );
+void lora_radio_rx_policy_stats_reset( LoRaRadio_t *radio );
+
+/*!
+ * Chip driver and instance hooks, driver lock held, on the selected instance
+ */
+
+/*!
+ * \brief Receiver mode of the window in progress, \a configured is the
+ *        rxContinuous of SetRxConfig
+ */
+bool lora_radio_rx_policy_continuous( bool configured );
+
+/*!
+ * \brief A receiver is started, closes the blind interval
+ */
+void lora_radio_rx_policy_start( void );
+
+/*!
+ * \brief The radio is given another job than receiving
+ */
+void lora_radio_rx_policy_cancel( void );
+
+/*!
+ * \brief Called by the chip driver when a single window ended by itself,
+ *        payload read and timers stopped, before the callback
+ *
+ * \retval true when the driver started the next window
+ */
+bool lora_radio_rx_policy_end( void );
+
+#define LORA_RADIO_RX_CONTINUOUS( configured )      lora_radio_rx_policy_continuous( configured )
+
+#else
+#define LORA_RADIO_RX_CONTINUOUS( configured )      ( configured )
+#define lora_radio_rx_policy_start( )
+#define lora_radio_rx_policy_cancel( )
+#define lora_radio_rx_policy_end( )                 ( false )
+#endif // LORA_RADIO_DRIVER_USING_RX_POLICY
+
+#endif // __LORA_RADIO_RX_POLICY_H__
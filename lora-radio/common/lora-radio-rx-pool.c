@@ -0,0 +1,187 @@
+/*!
+ * \file      lora-radio-rx-pool.c
+ *
+ * \brief     fixed-size pool of RX packet descriptors, handed from the
+ *            driver to the application without copying
+ *
+ * Slots move through two single-producer / single-consumer rings of slot
+ * indexes: the free ring (application -> driver) and the ready ring
+ * (driver -> application). Each index is written by one side only, so
+ * neither side takes a lock or disables interrupts. Several radio instances
+ * share the pool, their PHY threads are serialized by the driver lock. With
+ * the callback executor, the executor thread pushes to the ready ring before
+ * it calls RxDone, with the driver lock held as well.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-rx-pool.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+
+#define RX_POOL_INDEX_MASK                          ( LORA_RADIO_RX_POOL_SIZE - 1 )
+
+typedef struct
+{
+    volatile uint32_t Head;                         //!< written by the consumer
+    volatile uint32_t Tail;                         //!< written by the producer
+    uint8_t Slot[LORA_RADIO_RX_POOL_SIZE];
+}RxPoolRing_t;
+
+static LoRaRadioRxPacket_t RxPoolPackets[LORA_RADIO_RX_POOL_SIZE];
+static RxPoolRing_t RxPoolFree;
+static RxPoolRing_t RxPoolReady;
+static bool RxPoolInitialized = false;
+
+/*
+ * Driver side counters, InUse is Allocated - Released
+ */
+static uint32_t RxPoolAllocated;
+static uint32_t RxPoolReceived;
+static uint32_t RxPoolDropped;
+static uint32_t RxPoolHighWater;
+/*
+ * Application side counter
+ */
+static volatile uint32_t RxPoolReleased;
+
+static bool RxPoolPush( RxPoolRing_t *ring, uint8_t index )
+{
+    uint32_t tail = ring->Tail;
+
+    if( ( tail - LORA_RADIO_LOAD_ACQUIRE( &ring->Head ) ) >= LORA_RADIO_RX_POOL_SIZE )
+    {
+        return false;
+    }
+    ring->Slot[tail & RX_POOL_INDEX_MASK] = index;
+    LORA_RADIO_STORE_RELEASE( &ring->Tail, tail + 1 );
+    return true;
+}
+
+static bool RxPoolPop( RxPoolRing_t *ring, uint8_t *index )
+{
+    uint32_t head = ring->Head;
+
+    if( head == LORA_RADIO_LOAD_ACQUIRE( &ring->Tail ) )
+    {
+        return false;
+    }
+    *index = ring->Slot[head & RX_POOL_INDEX_MASK];
+    LORA_RADIO_STORE_RELEASE( &ring->Head, head + 1 );
+    return true;
+}
+
+LoRaRadioRxPacket_t *lora_radio_rx_pool_alloc( void )
+{
+    uint32_t inUse;
+    uint8_t index;
+
+    // the application cannot release before the first packet was queued
+    if( RxPoolInitialized == false )
+    {
+        for( index = 0; index < LORA_RADIO_RX_POOL_SIZE; index++ )
+        {
+            RxPoolFree.Slot[index] = index;
+        }
+        LORA_RADIO_STORE_RELEASE( &RxPoolFree.Tail, LORA_RADIO_RX_POOL_SIZE );
+        RxPoolInitialized = true;
+    }
+
+    if( RxPoolPop( &RxPoolFree, &index ) == false )
+    {
+        RxPoolDropped++;
+        return RT_NULL;
+    }
+    RxPoolAllocated++;
+    inUse = RxPoolAllocated - LORA_RADIO_LOAD_ACQUIRE( &RxPoolReleased );
+    if( inUse > RxPoolHighWater )
+    {
+        RxPoolHighWater = inUse;
+    }
+    return &RxPoolPackets[index];
+}
+
+void lora_radio_rx_pool_commit( LoRaRadioRxPacket_t *packet )
+{
+    packet->Instance = lora_radio_current( )->Index;
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+    packet->Timestamp = lora_radio_current( )->RxTimestamp.EndUs;
+#else
+    packet->Timestamp = LORA_RADIO_TIMESTAMP_US( );
+#endif
+    RxPoolReceived++;
+#ifndef LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+    // a slot comes from the free ring, the ready ring always has room for it
+    ( void )RxPoolPush( &RxPoolReady, ( uint8_t )( packet - RxPoolPackets ) );
+#endif
+}
+
+#ifdef LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+LoRaRadioRxPacket_t *lora_radio_rx_pool_packet( const uint8_t *payload )
+{
+    uint8_t index;
+
+    for( index = 0; index < LORA_RADIO_RX_POOL_SIZE; index++ )
+    {
+        if( payload == RxPoolPackets[index].Payload )
+        {
+            return &RxPoolPackets[index];
+        }
+    }
+    return RT_NULL;
+}
+
+void lora_radio_rx_pool_ready( LoRaRadioRxPacket_t *packet )
+{
+    LoRaRadio_t *previous = lora_radio_lock( RT_NULL );
+
+    ( void )RxPoolPush( &RxPoolReady, ( uint8_t )( packet - RxPoolPackets ) );
+    lora_radio_unlock( previous );
+}
+#endif
+
+LoRaRadioRxPacket_t *lora_radio_rx_pool_take( void )
+{
+    uint8_t index;
+
+    if( RxPoolPop( &RxPoolReady, &index ) == false )
+    {
+        return RT_NULL;
+    }
+    return &RxPoolPackets[index];
+}
+
+void lora_radio_rx_pool_release( LoRaRadioRxPacket_t *packet )
+{
+    RT_ASSERT( ( packet >= RxPoolPackets ) && ( packet < &RxPoolPackets[LORA_RADIO_RX_POOL_SIZE] ) );
+
+    LORA_RADIO_STORE_RELEASE( &RxPoolReleased, RxPoolReleased + 1 );
+    ( void )RxPoolPush( &RxPoolFree, ( uint8_t )( packet - RxPoolPackets ) );
+}
+
+void lora_radio_rx_pool_stats_get( LoRaRadioRxPoolStats_t *stats )
+{
+    LoRaRadio_t *previous = lora_radio_lock( RT_NULL );
+
+    stats->Received = RxPoolReceived;
+    stats->Dropped = RxPoolDropped;
+    stats->InUse = RxPoolAllocated - LORA_RADIO_LOAD_ACQUIRE( &RxPoolReleased );
+    stats->HighWater = RxPoolHighWater;
+    lora_radio_unlock( previous );
+}
+
+void lora_radio_rx_pool_stats_reset( void )
+{
+    LoRaRadio_t *previous = lora_radio_lock( RT_NULL );
+
+    RxPoolReceived = 0;
+    RxPoolDropped = 0;
+    RxPoolHighWater = RxPoolAllocated - LORA_RADIO_LOAD_ACQUIRE( &RxPoolReleased );
+    lora_radio_unlock( previous );
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*!
+ * \file      lora-radio-rx-pool.h
+ *
+ * \brief     fixed-size pool of RX packet descriptors, handed from the
+ *            driver to the application without copying
+ *
+ * \copyright SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#ifndef __LORA_RADIO_RX_POOL_H__
+#define __LORA_RADIO_RX_POOL_H__
+
+#include "lora-radio.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+
+#ifndef LORA_RADIO_RX_POOL_SIZE
+#define LORA_RADIO_RX_POOL_SIZE                     8
+#endif
+
+#if ( LORA_RADIO_RX_POOL_SIZE < 2 ) || ( LORA_RADIO_RX_POOL_SIZE > 128 ) || \
+    ( ( LORA_RADIO_RX_POOL_SIZE & ( LORA_RADIO_RX_POOL_SIZE - 1 ) ) != 0 )
+    #error "LORA_RADIO_RX_POOL_SIZE must be a power of two between 2 and 128"
+#endif
+
+/*!
+ * Received packet, owned by the driver while it is filled and by the
+ * application from RxDone until lora_radio_rx_pool_release
+ */
+typedef struct
+{
+    uint8_t Payload[255];
+    uint8_t Size;
+    uint8_t Instance;                               //!< index of the radio that received it
+    RadioModems_t Modem;
+    int16_t Rssi;                                   //!< [dBm]
+    int8_t Snr;                                     //!< [dB], 0 for FSK
+    uint32_t Timestamp;                             //!< LORA_RADIO_TIMESTAMP_US( ) when the driver processed RxDone,
+                                                    //!< end of the frame on air with LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+    uint32_t Frequency;                             //!< [Hz]
+    uint32_t Datarate;                              //!< LoRa: spreading factor, FSK: [bps]
+}LoRaRadioRxPacket_t;
+
+typedef struct
+{
+    uint32_t Received;                              //!< packets queued to the application
+    uint32_t Dropped;                               //!< packets received with no free slot
+    uint32_t InUse;                                 //!< slots queued or held by the application
+    uint32_t HighWater;                             //!< maximum of InUse
+}LoRaRadioRxPoolStats_t;
+
+/*
+ * Application side. The ready and free queues are single-producer /
+ * single-consumer: take and release must be called from one thread.
+ */
+
+/*!
+ * \brief Takes the oldest received packet, in reception order
+ *
+ * \retval packet The packet, RT_NULL if none is pending. Its payload is the
+ *                one RxDone was called with and stays valid until released.
+ */
+LoRaRadioRxPacket_t *lora_radio_rx_pool_take( void );
+
+/*!
+ * \brief Gives a packet obtained by lora_radio_rx_pool_take back to the driver
+ */
+void lora_radio_rx_pool_release( LoRaRadioRxPacket_t *packet );
+
+void lora_radio_rx_pool_stats_get( LoRaRadioRxPoolStats_t *stats );
+
+/*!
+ * \brief Clears Received, Dropped and restarts HighWater from InUse
+ */
+void lora_radio_rx_pool_stats_reset( void );
+
+/*
+ * Driver side, called with the driver lock held
+ */
+
+/*!
+ * \brief Gets a free slot to receive a packet into
+ *
+ * \retval packet The slot, RT_NULL when every slot is in use. The packet is
+ *                then counted as dropped, the driver delivers it from its
+ *                static buffer as before.
+ */
+LoRaRadioRxPacket_t *lora_radio_rx_pool_alloc( void );
+
+/*!
+ * \brief Queues a slot filled by the driver to the application. With
+ *        LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR the slot only becomes
+ *        ready when the executor calls RxDone, see lora_radio_rx_pool_ready
+ */
+void lora_radio_rx_pool_commit( LoRaRadioRxPacket_t *packet );
+
+#ifdef LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+/*!
+ * \brief Returns the slot \a payload was received into, RT_NULL for the
+ *        static buffer of the driver
+ */
+LoRaRadioRxPacket_t *lora_radio_rx_pool_packet( const uint8_t *payload );
+
+/*!
+ * \brief Queues a committed slot to the application, called by the executor
+ *        right before RxDone, so the slot cannot be released and reused
+ *        while the RxDone message waits in the executor queue
+ */
+void lora_radio_rx_pool_ready( LoRaRadioRxPacket_t *packet );
+#endif
+
+#endif // LORA_RADIO_DRIVER_USING_RX_POOL
+
+#endif // __LORA_RADIO_RX_POOL_H__
@@ -0,0 +1,300 @@
+/*!
+ * \file      lora-radio-scan.c
+ *
+ * \brief     spectrum scan, the receiver sweeps a list of channels and
+ *            samples the RSSI of each one on the driver timer
+ *
+ * The receiver is started once, as Radio.IsChannelFree does, then only
+ * retuned from one channel to the next. The readings of a dwell go to a
+ * histogram so the percentile costs no sample buffer.
+ *
+ * The module mutex is taken after the driver lock, by the API and the timer
+ * callback.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-timer.h"
+#include "lora-radio-scan.h"
+#include "lora-radio-rx-policy.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_SCAN
+
+#define SCAN_HISTOGRAM_BINS     ( LORA_RADIO_SCAN_RSSI_MAX - LORA_RADIO_SCAN_RSSI_MIN + 1 )
+
+typedef struct
+{
+    bool Running;
+    LoRaRadioScanParams_t Params;
+    LoRaRadioScanChannel_t *Results;
+    uint32_t Sweep;
+    uint8_t Index;                                  //!< channel being sampled
+    uint32_t SamplesLeft;
+    int32_t RssiSum;
+    int16_t RssiMax;
+    uint16_t Above;                                 //!< readings above OccupancyThresh
+    uint16_t Histogram[SCAN_HISTOGRAM_BINS];
+    TimerEvent_t Timer;
+    bool TimerReady;
+}Scan_t;
+
+static Scan_t Scans[LORA_RADIO_DRIVER_INSTANCE_NUM];
+static struct rt_mutex ScanMutex;
+static bool ScanMutexInit = false;
+
+static void ScanLock( void )
+{
+    if( ScanMutexInit == false )
+    {
+        rt_enter_critical( );
+        if( ScanMutexInit == false )
+        {
+            rt_mutex_init( &ScanMutex, "lr_scan", RT_IPC_FLAG_PRIO );
+            ScanMutexInit = true;
+        }
+        rt_exit_critical( );
+    }
+    // recursive, OnDone may start the next scan
+    rt_mutex_take( &ScanMutex, RT_WAITING_FOREVER );
+}
+
+static void ScanUnlock( void )
+{
+    rt_mutex_release( &ScanMutex );
+}
+
+static Scan_t *ScanOf( LoRaRadio_t *radio )
+{
+    return &Scans[( radio != RT_NULL ) ? radio->Index : 0];
+}
+
+static void ScanDwellStart( Scan_t *scan )
+{
+    scan->SamplesLeft = scan->Params.DwellTime / scan->Params.SamplePeriod;
+    if( scan->SamplesLeft == 0 )
+    {
+        scan->SamplesLeft = 1;
+    }
+    scan->RssiSum = 0;
+    scan->RssiMax = LORA_RADIO_SCAN_RSSI_MIN;
+    scan->Above = 0;
+    rt_memset( scan->Histogram, 0, sizeof( scan->Histogram ) );
+    // the first reading also leaves the receiver time to settle
+    TimerSetValue( &scan->Timer, scan->Params.SamplePeriod );
+    TimerStart( &scan->Timer );
+}
+
+static void ScanDwellEnd( Scan_t *scan, LoRaRadioScanChannel_t *channel )
+{
+    uint32_t samples = 0, rank, count;
+    uint16_t bin;
+
+    for( bin = 0; bin < SCAN_HISTOGRAM_BINS; bin++ )
+    {
+        samples += scan->Histogram[bin];
+    }
+    // smallest RSSI with Percentile % of the readings at or below it
+    rank = ( samples * scan->Params.Percentile + 99 ) / 100;
+    for( bin = 0, count = 0; bin < SCAN_HISTOGRAM_BINS - 1; bin++ )
+    {
+        count += scan->Histogram[bin];
+        if( count >= rank )
+        {
+            break;
+        }
+    }
+
+    channel->Frequency = scan->Params.Frequencies[scan->Index];
+    channel->Samples = ( uint16_t )samples;
+    channel->RssiMean = ( int16_t )( scan->RssiSum / ( int32_t )samples );
+    channel->RssiMax = scan->RssiMax;
+    channel->RssiPercentile = LORA_RADIO_SCAN_RSSI_MIN + bin;
+    channel->Occupancy = ( uint8_t )( scan->Above * 100 / samples );
+}
+
+static void ScanEnd( Scan_t *scan, bool stopped )
+{
+    void ( *onDone )( void *context, bool stopped ) = scan->Params.OnDone;
+
+    TimerStop( &scan->Timer );
+    LoRaRadioOps.Standby( );
+    // stopped first, OnDone may start the next scan
+    scan->Running = false;
+    if( onDone != RT_NULL )
+    {
+        onDone( scan->Params.Context, stopped );
+    }
+}
+
+static void ScanOnTimer( void *context )
+{
+    LoRaRadio_t *previous = lora_radio_lock( context );
+    Scan_t *scan = ScanOf( context );
+    int16_t rssi;
+    int32_t bin;
+
+    ScanLock( );
+    if( scan->Running == false )
+    {
+        // stopped meanwhile
+        ScanUnlock( );
+        lora_radio_unlock( previous );
+        return;
+    }
+
+    rssi = LoRaRadioOps.Rssi( scan->Params.Modem );
+    scan->RssiSum += rssi;
+    if( rssi > scan->RssiMax )
+    {
+        scan->RssiMax = rssi;
+    }
+    if( rssi > scan->Params.OccupancyThresh )
+    {
+        scan->Above++;
+    }
+    bin = rssi - LORA_RADIO_SCAN_RSSI_MIN;
+    bin = ( bin < 0 ) ? 0 : ( bin >= SCAN_HISTOGRAM_BINS ) ? SCAN_HISTOGRAM_BINS - 1 : bin;
+    scan->Histogram[bin]++;
+
+    if( --scan->SamplesLeft != 0 )
+    {
+        TimerStart( &scan->Timer );
+    }
+    else
+    {
+        ScanDwellEnd( scan, &scan->Results[scan->Index] );
+        if( scan->Params.OnChannel != RT_NULL )
+        {
+            scan->Params.OnChannel( scan->Params.Context, scan->Sweep, scan->Index, &scan->Results[scan->Index] );
+        }
+        // OnChannel may have stopped the scan
+        if( scan->Running == true )
+        {
+            if( ++scan->Index == scan->Params.Count )
+            {
+                scan->Index = 0;
+                scan->Sweep++;
+            }
+            if( ( scan->Params.Sweeps != 0 ) && ( scan->Sweep == scan->Params.Sweeps ) )
+            {
+                ScanEnd( scan, false );
+            }
+            else
+            {
+                if( scan->Params.Count > 1 )
+                {
+                    lora_radio_chip_rssi_retune( scan->Params.Frequencies[scan->Index] );
+                }
+                ScanDwellStart( scan );
+            }
+        }
+    }
+    ScanUnlock( );
+    lora_radio_unlock( previous );
+}
+
+rt_err_t lora_radio_scan_start( LoRaRadio_t *radio, const LoRaRadioScanParams_t *params, LoRaRadioScanChannel_t *results )
+{
+    Scan_t *scan;
+    LoRaRadio_t *previous;
+    rt_err_t result = RT_EOK;
+
+    if( ( params->Count == 0 ) || ( params->Frequencies == RT_NULL ) || ( results == RT_NULL ) )
+    {
+        return -RT_EINVAL;
+    }
+    if( radio == RT_NULL )
+    {
+        radio = lora_radio_get( 0 );
+    }
+    scan = ScanOf( radio );
+    previous = lora_radio_lock( radio );
+
+    ScanLock( );
+    if( scan->Running == true )
+    {
+        result = -RT_EBUSY;
+    }
+    else
+    {
+        if( scan->TimerReady == false )
+        {
+            TimerInit( &scan->Timer, ScanOnTimer );
+            TimerSetContext( &scan->Timer, radio );
+            scan->TimerReady = true;
+        }
+        scan->Params = *params;
+        if( scan->Params.SamplePeriod == 0 )
+        {
+            scan->Params.SamplePeriod = 1;
+        }
+        if( ( scan->Params.Percentile == 0 ) || ( scan->Params.Percentile > 100 ) )
+        {
+            scan->Params.Percentile = 90;
+        }
+        scan->Results = results;
+        scan->Sweep = 0;
+        scan->Index = 0;
+        scan->Running = true;
+
+        lora_radio_rx_policy_cancel( );
+        lora_radio_chip_rssi_start( scan->Params.Modem, scan->Params.Frequencies[0] );
+        ScanDwellStart( scan );
+    }
+    ScanUnlock( );
+    lora_radio_unlock( previous );
+    return result;
+}
+
+void lora_radio_scan_stop( LoRaRadio_t *radio )
+{
+    Scan_t *scan;
+    LoRaRadio_t *previous;
+
+    if( radio == RT_NULL )
+    {
+        radio = lora_radio_get( 0 );
+    }
+    scan = ScanOf( radio );
+    previous = lora_radio_lock( radio );
+
+    ScanLock( );
+    if( scan->Running == true )
+    {
+        ScanEnd( scan, true );
+    }
+    ScanUnlock( );
+    lora_radio_unlock( previous );
+}
+
+int lora_radio_scan_best( const LoRaRadioScanChannel_t *results, uint8_t count )
+{
+    int best;
+    uint8_t i;
+
+    if( count == 0 )
+    {
+        return -1;
+    }
+    best = 0;
+    for( i = 1; i < count; i++ )
+    {
+        const LoRaRadioScanChannel_t *c = &results[i];
+        const LoRaRadioScanChannel_t *b = &results[best];
+
+        if( ( c->RssiPercentile < b->RssiPercentile ) ||
+            ( ( c->RssiPercentile == b->RssiPercentile ) &&
+              ( ( c->Occupancy < b->Occupancy ) ||
+                ( ( c->Occupancy == b->Occupancy ) && ( c->RssiMean < b->RssiMean ) ) ) ) )
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+
+#endif
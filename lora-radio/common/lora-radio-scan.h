@@ -0,0 +1,90 @@
+/*!
+ * \file      lora-radio-scan.h
+ *
+ * \brief     spectrum scan, the receiver sweeps a list of channels and
+ *            samples the RSSI of each one on the driver timer
+ *
+ * \copyright SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#ifndef __LORA_RADIO_SCAN_H__
+#define __LORA_RADIO_SCAN_H__
+
+#include "lora-radio.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_SCAN
+
+/*!
+ * RSSI histogram of the channel being sampled, 1 dB bins, readings outside
+ * are counted in the first / last bin
+ */
+#define LORA_RADIO_SCAN_RSSI_MIN                    -140
+#define LORA_RADIO_SCAN_RSSI_MAX                    -20
+
+/*!
+ * One dwell on one channel
+ */
+typedef struct
+{
+    uint32_t Frequency;
+    uint16_t Samples;
+    int16_t RssiMean;                               //!< [dBm]
+    int16_t RssiMax;                                //!< [dBm]
+    int16_t RssiPercentile;                         //!< [dBm] Percentile % of the readings are at or below it
+    uint8_t Occupancy;                              //!< [%] readings above OccupancyThresh
+}LoRaRadioScanChannel_t;
+
+typedef struct
+{
+    RadioModems_t Modem;                            //!< set once, the channels are only retuned
+    const uint32_t *Frequencies;                    //!< [Hz] not copied, valid until OnDone
+    uint8_t Count;
+    uint32_t DwellTime;                             //!< [ms] per channel
+    uint32_t SamplePeriod;                          //!< [ms] between two readings, 0: 1 ms
+    uint8_t Percentile;                             //!< [%] of RssiPercentile, 0: 90
+    int16_t OccupancyThresh;                        //!< [dBm]
+    uint32_t Sweeps;                                //!< 0: streaming, until lora_radio_scan_stop
+    /*!
+     * Called after each dwell, may be RT_NULL
+     */
+    void ( *OnChannel )( void *context, uint32_t sweep, uint8_t index, const LoRaRadioScanChannel_t *channel );
+    /*!
+     * Called once the last sweep is done or the scan is stopped, may be RT_NULL
+     */
+    void ( *OnDone )( void *context, bool stopped );
+    void *Context;
+}LoRaRadioScanParams_t;
+
+/*!
+ * \brief Starts scanning on \a radio (RT_NULL for instance 0) and returns at
+ *        once. The receiver is set up once for params->Modem, each channel
+ *        then only retunes it.
+ *
+ * The callbacks run with the driver lock held, from the PHY thread or the
+ * driver timer. Do not use the radio for anything else while the scan runs,
+ * it is left in standby afterwards.
+ *
+ * \param [OUT] results  Count entries, the last dwell of each channel
+ *
+ * \retval RT_EOK, -RT_EBUSY when a scan already runs on \a radio,
+ *         -RT_EINVAL without channels
+ */
+rt_err_t lora_radio_scan_start( LoRaRadio_t *radio, const LoRaRadioScanParams_t *params, LoRaRadioScanChannel_t *results );
+
+/*!
+ * \brief Stops the scan running on \a radio, if any, OnDone is called
+ */
+void lora_radio_scan_stop( LoRaRadio_t *radio );
+
+/*!
+ * \brief Quietest channel of a scan: lowest RssiPercentile, then lowest
+ *        occupancy, then lowest mean
+ *
+ * \retval index in \a results, -1 when \a count is 0
+ */
+int lora_radio_scan_best( const LoRaRadioScanChannel_t *results, uint8_t count );
+
+#endif // LORA_RADIO_DRIVER_USING_SCAN
+
+#endif // __LORA_RADIO_SCAN_H__
@@ -15,14 +15,15 @@
 #if defined ( LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD ) || defined ( LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD_NANO )
 #ifndef PKG_USING_MULTI_RTIMER
 
-void rtick_timer_init( rtick_timer_event_t *obj, void ( *callback )( void ) )
+#ifndef LORA_RADIO_DRIVER_USING_HRTIMER
+void rtick_timer_init( rtick_timer_event_t *obj, void ( *callback )( void* context ) )
 {
-    int count = 0;
+    static int count = 0;
     
     char name[RT_NAME_MAX];
-    rt_snprintf(name,8,"rtk_%d",count++);
+    rt_snprintf(name,sizeof(name),"rtk_%d",count++);
 
-    rt_timer_init(&(obj->timer),name,(void (*)(void*))callback,RT_NULL,1000,RT_TIMER_FLAG_ONE_SHOT|RT_TIMER_FLAG_SOFT_TIMER);
+    rt_timer_init(&(obj->timer),name,callback,RT_NULL,1000,RT_TIMER_FLAG_ONE_SHOT|RT_TIMER_FLAG_SOFT_TIMER);
 }
 
 void rtick_timer_start( rtick_timer_event_t *obj )
@@ -47,6 +48,12 @@ void rtick_timer_set_value( rtick_timer_event_t *obj, uint32_t value )
     rt_timer_control(&(obj->timer),RT_TIMER_CTRL_SET_TIME,&tick);
 }
 
+void rtick_timer_set_context( rtick_timer_event_t *obj, void *context )
+{
+    obj->timer.parameter = context;
+}
+#endif
+
 TimerTime_t rtick_timer_get_current_time( void )
 {
     uint32_t now = rt_tick_get();
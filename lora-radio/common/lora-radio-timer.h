@@ -10,15 +10,49 @@
 #include "multi_rtimer.h"
 #include "hw_rtc_stm32l.h"
 
+#ifndef TimerSetContext
+/*!
+ * single radio instance only, the callbacks find their instance through lora_radio_current()
+ */
+#define TimerSetContext( obj, context )  ( void )( context )
+#endif
+
 #else
 
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+#define TimerInit            lora_radio_hrtimer_init
+#define TimerStart           lora_radio_hrtimer_start
+#define TimerStop            lora_radio_hrtimer_stop
+#define TimerReset           lora_radio_hrtimer_reset
+#define TimerSetValue        lora_radio_hrtimer_set_value
+#define TimerSetValueUs      lora_radio_hrtimer_set_value_us
+#define TimerSetContext      lora_radio_hrtimer_set_context
+#define TimerEvent_t         lora_radio_hrtimer_t
+
+#ifndef LORA_RADIO_HRTIMER_MAX
+#define LORA_RADIO_HRTIMER_MAX                      8   //!< timers armed at once on one radio instance
+#endif
+
+/*!
+ * \brief High resolution timer object. Its callback runs on the PHY thread
+ *        of the radio instance given by TimerSetContext, driver lock held.
+ */
+typedef struct TimerEvent_s
+{
+    uint32_t Deadline;                              //!< LORA_RADIO_TIMESTAMP_US( ) at which it expires
+    uint32_t ValueUs;
+    uint8_t Instance;                               //!< heap it is armed in
+    uint8_t Slot;                                   //!< position in the heap + 1, 0 when not armed
+    void ( *Callback )( void *context );
+    void *Context;
+}lora_radio_hrtimer_t;
+#else
 #define TimerInit            rtick_timer_init
 #define TimerStart           rtick_timer_start
 #define TimerStop            rtick_timer_stop   
 #define TimerReset           rtick_timer_reset
 #define TimerSetValue        rtick_timer_set_value
-#define TimerGetCurrentTime  rtick_timer_get_current_time
-#define TimerGetElapsedTime  rtick_timer_get_elapsed_time
+#define TimerSetContext      rtick_timer_set_context
 #define TimerEvent_t         rtick_timer_event_t
 
 /*!
@@ -28,6 +62,9 @@ typedef struct TimerEvent_s
 {
     struct rt_timer timer; 
 }rtick_timer_event_t;
+#endif
+#define TimerGetCurrentTime  rtick_timer_get_current_time
+#define TimerGetElapsedTime  rtick_timer_get_elapsed_time
 
 /*!
  * \brief Timer time variable definition
@@ -36,7 +73,68 @@ typedef struct TimerEvent_s
 typedef uint32_t TimerTime_t;
 #define TIMERTIME_T_MAX                             ( ( uint32_t )~0 )
 
-void rtick_timer_init( rtick_timer_event_t *obj, void ( *callback )( void ) );
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+void lora_radio_hrtimer_init( lora_radio_hrtimer_t *obj, void ( *callback )( void* context ) );
+
+/*!
+ * \brief (Re)arms the timer to expire ValueUs from now, O(log n) in the
+ *        timers armed on its instance
+ */
+void lora_radio_hrtimer_start( lora_radio_hrtimer_t *obj );
+
+/*!
+ * \brief Disarms the timer. Called with the driver lock held, the callback is
+ *        not called afterwards even if the compare interrupt already fired.
+ */
+void lora_radio_hrtimer_stop( lora_radio_hrtimer_t *obj );
+
+void lora_radio_hrtimer_reset( lora_radio_hrtimer_t *obj );
+
+/*!
+ * \brief Sets the timeout in ms, as rtick_timer_set_value
+ */
+void lora_radio_hrtimer_set_value( lora_radio_hrtimer_t *obj, uint32_t value );
+
+/*!
+ * \brief Sets the timeout in us, up to 2^31 - 1
+ */
+void lora_radio_hrtimer_set_value_us( lora_radio_hrtimer_t *obj, uint32_t valueUs );
+
+/*!
+ * \brief Sets the radio instance ( LoRaRadio_t * ) the timer belongs to, its
+ *        callback is called with it. RT_NULL selects instance 0.
+ */
+void lora_radio_hrtimer_set_context( lora_radio_hrtimer_t *obj, void *context );
+
+/*!
+ * \brief Runs the callbacks of the expired timers of the radio instance,
+ *        called by its PHY thread on EV_LORA_RADIO_TIMER_FIRED, driver lock held
+ */
+void lora_radio_hrtimer_process( uint8_t instance );
+
+/*!
+ * \brief To be called by the board from the compare interrupt
+ */
+void lora_radio_hrtimer_isr( void );
+
+/*
+ * Board port. LORA_RADIO_TIMESTAMP_US( ) must read the free running us
+ * counter the compare belongs to.
+ */
+
+/*!
+ * \brief Programs the compare interrupt at \a deadlineUs, replacing the
+ *        previous one. A deadline that has already passed fires at once.
+ *        Called with interrupts disabled.
+ */
+void lora_radio_hrtimer_port_set_compare( uint32_t deadlineUs );
+
+/*!
+ * \brief Disables the compare interrupt, called with interrupts disabled
+ */
+void lora_radio_hrtimer_port_cancel( void );
+#else
+void rtick_timer_init( rtick_timer_event_t *obj, void ( *callback )( void* context ) );
 
 void rtick_timer_start( rtick_timer_event_t *obj );
 
@@ -46,6 +144,12 @@ void rtick_timer_reset( rtick_timer_event_t *obj );
 
 void rtick_timer_set_value( rtick_timer_event_t *obj, uint32_t value );
 
+/*!
+ * \brief Sets the argument the timer callback is called with
+ */
+void rtick_timer_set_context( rtick_timer_event_t *obj, void *context );
+#endif
+
 TimerTime_t rtick_timer_get_current_time( void );
 
 TimerTime_t rtick_timer_get_elapsed_time( TimerTime_t past );
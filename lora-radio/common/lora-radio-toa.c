@@ -0,0 +1,227 @@
+/*!
+ * \file      lora-radio-toa.c
+ *
+ * \brief     time on air of LoRa and (G)FSK frames, shared by the chip
+ *            drivers, with inverse queries for the uplink schedulers
+ *
+ * At 125, 250 and 500 kHz a LoRa quarter symbol lasts 2^( SF + 1 - BW ) us,
+ * BW being the API index, so the time of a frame in quarter symbols is
+ * converted to us with a shift. The block count of the payload divides by
+ * 4 x ( SF - 2 x LDRO ), done with the reciprocal kept in the symbol table.
+ * A frame format is prepared once, each payload size then costs a multiply
+ * and a shift, the ms of Radio.TimeOnAir one more division by a constant.
+ *
+ * LDRO follows the drivers: SF11 / SF12 at 125 kHz, SF12 at 250 kHz.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-toa.h"
+
+#define TOA_SF_MIN              5
+#define TOA_SF_MAX              12
+#define TOA_BW_COUNT            3                   //!< 125, 250 and 500 kHz
+#define TOA_RECIPROCAL_SHIFT    20
+
+#define TOA_BLOCK_BITS( sf, ldro )                  ( 4 * ( ( sf ) - 2 * ( ldro ) ) )
+#define TOA_SYMBOLS( sf, bw, ldro )                                                             \
+    { ( sf ) + 1 - ( bw ), TOA_BLOCK_BITS( sf, ldro ),                                          \
+      ( ( 1UL << TOA_RECIPROCAL_SHIFT ) + TOA_BLOCK_BITS( sf, ldro ) - 1 ) / TOA_BLOCK_BITS( sf, ldro ) }
+
+typedef struct
+{
+    uint8_t QuarterShift;
+    uint8_t BlockBits;
+    uint16_t Reciprocal;
+}ToaSymbols_t;
+
+static const ToaSymbols_t ToaSymbols[TOA_BW_COUNT][TOA_SF_MAX - TOA_SF_MIN + 1] =
+{
+    {   // 125 kHz
+        TOA_SYMBOLS( 5, 0, 0 ), TOA_SYMBOLS( 6, 0, 0 ), TOA_SYMBOLS( 7, 0, 0 ), TOA_SYMBOLS( 8, 0, 0 ),
+        TOA_SYMBOLS( 9, 0, 0 ), TOA_SYMBOLS( 10, 0, 0 ), TOA_SYMBOLS( 11, 0, 1 ), TOA_SYMBOLS( 12, 0, 1 ),
+    },
+    {   // 250 kHz
+        TOA_SYMBOLS( 5, 1, 0 ), TOA_SYMBOLS( 6, 1, 0 ), TOA_SYMBOLS( 7, 1, 0 ), TOA_SYMBOLS( 8, 1, 0 ),
+        TOA_SYMBOLS( 9, 1, 0 ), TOA_SYMBOLS( 10, 1, 0 ), TOA_SYMBOLS( 11, 1, 0 ), TOA_SYMBOLS( 12, 1, 1 ),
+    },
+    {   // 500 kHz
+        TOA_SYMBOLS( 5, 2, 0 ), TOA_SYMBOLS( 6, 2, 0 ), TOA_SYMBOLS( 7, 2, 0 ), TOA_SYMBOLS( 8, 2, 0 ),
+        TOA_SYMBOLS( 9, 2, 0 ), TOA_SYMBOLS( 10, 2, 0 ), TOA_SYMBOLS( 11, 2, 0 ), TOA_SYMBOLS( 12, 2, 0 ),
+    },
+};
+
+uint32_t lora_radio_toa_symbol_us( uint32_t bandwidth, uint32_t datarate )
+{
+    if( ( bandwidth >= TOA_BW_COUNT ) || ( datarate < TOA_SF_MIN ) || ( datarate > TOA_SF_MAX ) )
+    {
+        return 0;
+    }
+    return 4UL << ToaSymbols[bandwidth][datarate - TOA_SF_MIN].QuarterShift;
+}
+
+bool lora_radio_toa_lora( LoRaRadioToa_t *toa, LoRaRadioToaRules_t rules, uint32_t bandwidth,
+                          uint32_t datarate, uint8_t coderate, uint16_t preambleLen,
+                          bool fixLen, bool crcOn )
+{
+    const ToaSymbols_t *symbols;
+    uint32_t headerSymbols = 12;                    // 4.25 preamble + 8 header symbols, the .25 below
+    int16_t offset;
+
+    if( ( bandwidth >= TOA_BW_COUNT ) || ( datarate < TOA_SF_MIN ) || ( datarate > TOA_SF_MAX ) ||
+        ( coderate < 1 ) || ( coderate > 4 ) )
+    {
+        return false;
+    }
+    symbols = &ToaSymbols[bandwidth][datarate - TOA_SF_MIN];
+
+    offset = ( int16_t )( ( crcOn ? 16 : 0 ) - 4 * ( int16_t )datarate + ( fixLen ? 0 : 20 ) );
+    if( ( rules == LORA_RADIO_TOA_SX126X ) && ( datarate <= 6 ) )
+    {
+        // SX126x SF5 / SF6: the preamble is at least 12 symbols, the header
+        // takes 2 more symbols instead of the 8 bits of the ceil
+        if( preambleLen < 12 )
+        {
+            preambleLen = 12;
+        }
+        headerSymbols += 2;
+    }
+    else
+    {
+        offset += 8;
+    }
+
+    toa->Base = 4 * ( ( uint32_t )preambleLen + headerSymbols ) + 1;
+    toa->Datarate = 0;
+    toa->Reciprocal = symbols->Reciprocal;
+    toa->PayloadOffset = offset;
+    toa->BlockBits = symbols->BlockBits;
+    toa->BlockQuarters = 4 * ( coderate + 4 );
+    toa->QuarterShift = symbols->QuarterShift;
+    return true;
+}
+
+bool lora_radio_toa_fsk( LoRaRadioToa_t *toa, uint32_t datarate, uint16_t preambleLen,
+                         bool fixLen, bool crcOn )
+{
+    const uint8_t syncWordLength = 3;
+
+    if( datarate == 0 )
+    {
+        return false;
+    }
+    rt_memset( toa, 0, sizeof( LoRaRadioToa_t ) );
+    toa->Base = ( ( uint32_t )preambleLen + syncWordLength + ( fixLen ? 0 : 1 ) + ( crcOn ? 2 : 0 ) ) << 3;
+    toa->Datarate = datarate;
+    return true;
+}
+
+/*!
+ * \brief Payload blocks of a \a size bytes LoRa frame
+ */
+static uint32_t ToaLoRaBlocks( const LoRaRadioToa_t *toa, uint8_t size )
+{
+    int32_t bits = ( ( int32_t )size << 3 ) + toa->PayloadOffset;
+
+    if( bits <= 0 )
+    {
+        return 0;
+    }
+    // integral ceil(), exact below 2^20 / BlockBits
+    return ( ( ( uint32_t )bits + toa->BlockBits - 1 ) * toa->Reciprocal ) >> TOA_RECIPROCAL_SHIFT;
+}
+
+/*!
+ * \brief (G)FSK time [us] of \a bits, rounded up and saturated
+ */
+static uint32_t ToaFskUs( const LoRaRadioToa_t *toa, uint32_t bits )
+{
+    uint64_t us = ( ( uint64_t )bits * 1000000U + toa->Datarate - 1 ) / toa->Datarate;
+
+    return ( us > 0xFFFFFFFFU ) ? 0xFFFFFFFFU : ( uint32_t )us;
+}
+
+uint32_t lora_radio_toa_us( const LoRaRadioToa_t *toa, uint8_t size )
+{
+    if( toa->Datarate != 0 )
+    {
+        return ToaFskUs( toa, toa->Base + ( ( uint32_t )size << 3 ) );
+    }
+    return ( toa->Base + ToaLoRaBlocks( toa, size ) * toa->BlockQuarters ) << toa->QuarterShift;
+}
+
+uint32_t lora_radio_toa_ms( const LoRaRadioToa_t *toa, uint8_t size )
+{
+    // ceil( ceil( x ) / 1000 ) is ceil( x / 1000 )
+    return ( lora_radio_toa_us( toa, size ) + 999 ) / 1000;
+}
+
+int16_t lora_radio_toa_max_payload( const LoRaRadioToa_t *toa, uint32_t budgetUs )
+{
+    uint32_t quarters, blocks, limit;
+    int32_t bits;
+
+    if( lora_radio_toa_us( toa, 0 ) > budgetUs )
+    {
+        return -1;
+    }
+    if( toa->Datarate != 0 )
+    {
+        bits = ( int32_t )( ( ( uint64_t )budgetUs * toa->Datarate / 1000000U ) - toa->Base );
+        return ( bits >= ( 255 << 3 ) ) ? 255 : ( int16_t )( bits >> 3 );
+    }
+
+    // frames whose payload still fits in the blocks left by the budget
+    quarters = budgetUs >> toa->QuarterShift;
+    blocks = ( quarters - toa->Base ) / toa->BlockQuarters;
+    // blocks of a 255 byte payload, PayloadOffset never outweighs its 2040 bits
+    limit = ( uint32_t )( ( 255 << 3 ) + toa->PayloadOffset + toa->BlockBits - 1 ) / toa->BlockBits;
+    if( blocks >= limit )
+    {
+        return 255;
+    }
+    bits = ( int32_t )( blocks * toa->BlockBits ) - toa->PayloadOffset;
+    return ( int16_t )( bits >> 3 );
+}
+
+uint64_t lora_radio_toa_range_us( const LoRaRadioToa_t *toa, uint8_t first, uint8_t last, uint32_t *us )
+{
+    uint64_t total = 0;
+    uint32_t blocks, size;
+    int32_t bits, limit;
+
+    if( first > last )
+    {
+        return 0;
+    }
+    if( toa->Datarate != 0 )
+    {
+        for( size = first; size <= last; size++ )
+        {
+            us[size - first] = ToaFskUs( toa, toa->Base + ( size << 3 ) );
+            total += us[size - first];
+        }
+        return total;
+    }
+
+    // one division for the first size, the next ones step the block count
+    blocks = ToaLoRaBlocks( toa, first );
+    bits = ( ( int32_t )first << 3 ) + toa->PayloadOffset;
+    limit = ( int32_t )( blocks * toa->BlockBits );
+    for( size = first; size <= last; size++ )
+    {
+        if( bits > limit )
+        {
+            blocks++;
+            limit += toa->BlockBits;
+        }
+        us[size - first] = ( toa->Base + blocks * toa->BlockQuarters ) << toa->QuarterShift;
+        total += us[size - first];
+        bits += 8;
+    }
+    return total;
+}
@@ -0,0 +1,101 @@
+/*!
+ * \file      lora-radio-toa.h
+ *
+ * \brief     time on air of LoRa and (G)FSK frames, shared by the chip
+ *            drivers, with inverse queries for the uplink schedulers
+ *
+ * \copyright SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#ifndef __LORA_RADIO_TOA_H__
+#define __LORA_RADIO_TOA_H__
+
+#include "lora-radio.h"
+
+/*!
+ * Formula of the chip family for the LoRa header and the short spreading
+ * factors
+ */
+typedef enum
+{
+    LORA_RADIO_TOA_SX126X = 0,                      //!< SF5 / SF6: 12 preamble symbols at least, 2 more header symbols
+    LORA_RADIO_TOA_SX127X,                          //!< SX1276 datasheet formula for every spreading factor
+}LoRaRadioToaRules_t;
+
+/*!
+ * Frame format prepared by lora_radio_toa_lora / lora_radio_toa_fsk, then
+ * used for any number of payload sizes
+ */
+typedef struct
+{
+    uint32_t Base;                                  //!< LoRa: quarter symbols without payload blocks, FSK: bits without payload
+    uint32_t Datarate;                              //!< FSK [bps], 0 for LoRa
+    uint16_t Reciprocal;                            //!< LoRa: 2^20 / BlockBits rounded up, exact division of the block count
+    int16_t PayloadOffset;                          //!< LoRa: added to 8 x size before the block count
+    uint8_t BlockBits;                              //!< LoRa: bits per block, 4 x ( SF - 2 x LDRO )
+    uint8_t BlockQuarters;                          //!< LoRa: quarter symbols per block, 4 x ( CR + 4 )
+    uint8_t QuarterShift;                           //!< LoRa: quarter symbol is 2^QuarterShift us
+}LoRaRadioToa_t;
+
+/*!
+ * \brief LoRa symbol time [us], exact at 125, 250 and 500 kHz
+ *
+ * \param [IN] bandwidth   0: 125 kHz, 1: 250 kHz, 2: 500 kHz
+ * \param [IN] datarate    spreading factor, 5 to 12
+ *
+ * \retval 0 for parameters out of range
+ */
+uint32_t lora_radio_toa_symbol_us( uint32_t bandwidth, uint32_t datarate );
+
+/*!
+ * \brief Prepares a LoRa frame format
+ *
+ * \param [IN] bandwidth   0: 125 kHz, 1: 250 kHz, 2: 500 kHz
+ * \param [IN] datarate    spreading factor, 5 to 12
+ * \param [IN] coderate    1: 4/5, 2: 4/6, 3: 4/7, 4: 4/8
+ *
+ * \retval false for parameters out of range, \a toa is then left untouched
+ */
+bool lora_radio_toa_lora( LoRaRadioToa_t *toa, LoRaRadioToaRules_t rules, uint32_t bandwidth,
+                          uint32_t datarate, uint8_t coderate, uint16_t preambleLen,
+                          bool fixLen, bool crcOn );
+
+/*!
+ * \brief Prepares a (G)FSK frame format: 3 bytes sync word, no address
+ *
+ * \param [IN] datarate    [bps]
+ * \param [IN] preambleLen [bytes]
+ *
+ * \retval false for a null datarate
+ */
+bool lora_radio_toa_fsk( LoRaRadioToa_t *toa, uint32_t datarate, uint16_t preambleLen,
+                         bool fixLen, bool crcOn );
+
+/*!
+ * \brief Time on air [us] of a \a size bytes frame, rounded up
+ */
+uint32_t lora_radio_toa_us( const LoRaRadioToa_t *toa, uint8_t size );
+
+/*!
+ * \brief Time on air [ms] of a \a size bytes frame, rounded up as
+ *        Radio.TimeOnAir
+ */
+uint32_t lora_radio_toa_ms( const LoRaRadioToa_t *toa, uint8_t size );
+
+/*!
+ * \brief Largest payload whose time on air fits in \a budgetUs
+ *
+ * \retval [bytes] 0 to 255, -1 when even an empty frame does not fit
+ */
+int16_t lora_radio_toa_max_payload( const LoRaRadioToa_t *toa, uint32_t budgetUs );
+
+/*!
+ * \brief Time on air [us] of every payload size from \a first to \a last,
+ *        written to \a us[0] .. us[last - first]
+ *
+ * \retval sum of the times written
+ */
+uint64_t lora_radio_toa_range_us( const LoRaRadioToa_t *toa, uint8_t first, uint8_t last, uint32_t *us );
+
+#endif // __LORA_RADIO_TOA_H__
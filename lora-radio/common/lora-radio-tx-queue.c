@@ -0,0 +1,275 @@
+/*!
+ * \file      lora-radio-tx-queue.c
+ *
+ * \brief     bounded TX queue with priorities, the PHY thread starts the
+ *            next frame as soon as the previous one is done
+ *
+ * The queue of an instance is touched by the application threads that
+ * submit frames and by the PHY thread on TxDone. The module mutex is taken
+ * after the driver lock on both paths.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-timer.h"
+#include "lora-radio-tx-queue.h"
+#include "lora-radio-rx-policy.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_TX_QUEUE
+
+typedef struct
+{
+    LoRaRadioTxFrame_t Frame;
+    TimerTime_t Expiry;                             //!< [tick] TimerGetCurrentTime( ) after which the frame expires
+    uint32_t Sequence;                              //!< submission order among equal priorities
+    bool Used;
+}TxQueueEntry_t;
+
+typedef struct
+{
+    TxQueueEntry_t Entries[LORA_RADIO_TX_QUEUE_SIZE];
+    uint32_t Pending;
+    uint32_t Sequence;
+    bool InFlight;                                  //!< a queued frame is on air
+    LoRaRadioTxFrame_t Current;
+    LoRaRadioTxQueueStats_t Stats;
+}TxQueue_t;
+
+static TxQueue_t TxQueues[LORA_RADIO_DRIVER_INSTANCE_NUM];
+static struct rt_mutex TxQueueMutex;
+static bool TxQueueMutexInit = false;
+
+static void TxQueueLock( void )
+{
+    if( TxQueueMutexInit == false )
+    {
+        rt_enter_critical( );
+        if( TxQueueMutexInit == false )
+        {
+            rt_mutex_init( &TxQueueMutex, "lr_txq", RT_IPC_FLAG_PRIO );
+            TxQueueMutexInit = true;
+        }
+        rt_exit_critical( );
+    }
+    // recursive, a frame callback may queue the next frame
+    rt_mutex_take( &TxQueueMutex, RT_WAITING_FOREVER );
+}
+
+static void TxQueueUnlock( void )
+{
+    rt_mutex_release( &TxQueueMutex );
+}
+
+static TxQueue_t *TxQueueOf( LoRaRadio_t *radio )
+{
+    return &TxQueues[( radio != RT_NULL ) ? radio->Index : 0];
+}
+
+static void TxQueueReport( const LoRaRadioTxFrame_t *frame, LoRaRadioTxResult_t result )
+{
+    if( frame->Callback != RT_NULL )
+    {
+        frame->Callback( frame->Context, result );
+    }
+}
+
+/*!
+ * \brief Removes the highest priority frame, the oldest among equals
+ */
+static bool TxQueuePop( TxQueue_t *queue, TxQueueEntry_t *entry )
+{
+    TxQueueEntry_t *best = RT_NULL;
+    uint32_t i;
+
+    for( i = 0; i < LORA_RADIO_TX_QUEUE_SIZE; i++ )
+    {
+        TxQueueEntry_t *e = &queue->Entries[i];
+
+        if( e->Used == false )
+        {
+            continue;
+        }
+        if( ( best == RT_NULL ) || ( e->Frame.Priority > best->Frame.Priority ) ||
+            ( ( e->Frame.Priority == best->Frame.Priority ) && ( ( int32_t )( e->Sequence - best->Sequence ) < 0 ) ) )
+        {
+            best = e;
+        }
+    }
+    if( best == RT_NULL )
+    {
+        return false;
+    }
+    *entry = *best;
+    best->Used = false;
+    queue->Pending--;
+    return true;
+}
+
+/*!
+ * \brief Starts the next frame that has not expired, driver lock held
+ *
+ * \retval true when a frame went on air
+ */
+static bool TxQueueStartNext( TxQueue_t *queue )
+{
+    TxQueueEntry_t entry;
+
+    while( TxQueuePop( queue, &entry ) == true )
+    {
+        if( ( entry.Frame.MaxDelay != 0 ) && ( ( int32_t )( TimerGetCurrentTime( ) - entry.Expiry ) > 0 ) )
+        {
+            queue->Stats.Expired++;
+            TxQueueReport( &entry.Frame, LORA_RADIO_TX_EXPIRED );
+            continue;
+        }
+        queue->Current = entry.Frame;
+        queue->InFlight = true;
+        lora_radio_rx_policy_cancel( );
+        LoRaRadioOps.Send( entry.Frame.Buffer, entry.Frame.Size );
+        return true;
+    }
+    return false;
+}
+
+static void TxQueueFlush( TxQueue_t *queue )
+{
+    TxQueueEntry_t entry;
+
+    while( TxQueuePop( queue, &entry ) == true )
+    {
+        queue->Stats.Flushed++;
+        TxQueueReport( &entry.Frame, LORA_RADIO_TX_FLUSHED );
+    }
+}
+
+rt_err_t lora_radio_tx_queue_send( LoRaRadio_t *radio, const LoRaRadioTxFrame_t *frame )
+{
+    TxQueue_t *queue;
+    LoRaRadio_t *previous;
+    rt_err_t result = RT_EOK;
+    uint32_t i;
+
+    if( radio == RT_NULL )
+    {
+        radio = lora_radio_get( 0 );
+    }
+    queue = TxQueueOf( radio );
+    previous = lora_radio_lock( radio );
+
+    TxQueueLock( );
+    if( queue->Pending >= LORA_RADIO_TX_QUEUE_SIZE )
+    {
+        result = -RT_EFULL;
+    }
+    else
+    {
+        for( i = 0; queue->Entries[i].Used == true; i++ );
+        queue->Entries[i].Frame = *frame;
+        queue->Entries[i].Expiry = TimerGetCurrentTime( ) + rt_tick_from_millisecond( frame->MaxDelay );
+        queue->Entries[i].Sequence = queue->Sequence++;
+        queue->Entries[i].Used = true;
+        queue->Pending++;
+        queue->Stats.Queued++;
+        if( queue->Pending > queue->Stats.HighWater )
+        {
+            queue->Stats.HighWater = queue->Pending;
+        }
+        if( queue->InFlight == false )
+        {
+            ( void )TxQueueStartNext( queue );
+        }
+    }
+    TxQueueUnlock( );
+    lora_radio_unlock( previous );
+    return result;
+}
+
+void lora_radio_tx_queue_flush( LoRaRadio_t *radio )
+{
+    LoRaRadio_t *previous;
+
+    if( radio == RT_NULL )
+    {
+        radio = lora_radio_get( 0 );
+    }
+    previous = lora_radio_lock( radio );
+
+    TxQueueLock( );
+    TxQueueFlush( TxQueueOf( radio ) );
+    TxQueueUnlock( );
+    lora_radio_unlock( previous );
+}
+
+uint32_t lora_radio_tx_queue_pending( LoRaRadio_t *radio )
+{
+    return TxQueueOf( radio )->Pending;
+}
+
+void lora_radio_tx_queue_stats_get( LoRaRadio_t *radio, LoRaRadioTxQueueStats_t *stats )
+{
+    TxQueueLock( );
+    *stats = TxQueueOf( radio )->Stats;
+    TxQueueUnlock( );
+}
+
+void lora_radio_tx_queue_stats_reset( LoRaRadio_t *radio )
+{
+    TxQueue_t *queue = TxQueueOf( radio );
+
+    TxQueueLock( );
+    rt_memset( &queue->Stats, 0, sizeof( queue->Stats ) );
+    queue->Stats.HighWater = queue->Pending;
+    TxQueueUnlock( );
+}
+
+bool lora_radio_tx_queue_complete( LoRaRadioTxResult_t result )
+{
+    TxQueue_t *queue = TxQueueOf( lora_radio_current( ) );
+    LoRaRadioTxFrame_t finished;
+    uint32_t start, gap;
+
+    TxQueueLock( );
+    if( queue->InFlight == false )
+    {
+        TxQueueUnlock( );
+        return false;
+    }
+    finished = queue->Current;
+    queue->InFlight = false;
+
+    if( result == LORA_RADIO_TX_DONE )
+    {
+        queue->Stats.Sent++;
+        // the next frame goes on air before the finished one is reported
+        start = LORA_RADIO_TIMESTAMP_US( );
+        if( TxQueueStartNext( queue ) == true )
+        {
+            gap = LORA_RADIO_TIMESTAMP_US( ) - start;
+            if( ( queue->Stats.Gaps == 0 ) || ( gap < queue->Stats.GapMinUs ) )
+            {
+                queue->Stats.GapMinUs = gap;
+            }
+            if( gap > queue->Stats.GapMaxUs )
+            {
+                queue->Stats.GapMaxUs = gap;
+            }
+            queue->Stats.GapTotalUs += gap;
+            queue->Stats.Gaps++;
+        }
+        TxQueueReport( &finished, result );
+    }
+    else
+    {
+        queue->Stats.TimedOut++;
+        TxQueueReport( &finished, result );
+        TxQueueFlush( queue );
+    }
+    TxQueueUnlock( );
+    return true;
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*!
+ * \file      lora-radio-tx-queue.h
+ *
+ * \brief     bounded TX queue with priorities, the PHY thread starts the
+ *            next frame as soon as the previous one is done
+ *
+ * \copyright SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#ifndef __LORA_RADIO_TX_QUEUE_H__
+#define __LORA_RADIO_TX_QUEUE_H__
+
+#include "lora-radio.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_TX_QUEUE
+
+#ifndef LORA_RADIO_TX_QUEUE_SIZE
+#define LORA_RADIO_TX_QUEUE_SIZE                    8
+#endif
+
+/*!
+ * Outcome of a queued frame, passed to its callback
+ */
+typedef enum
+{
+    LORA_RADIO_TX_DONE = 0,                         //!< sent
+    LORA_RADIO_TX_TIMEOUT,                          //!< started, TX timeout
+    LORA_RADIO_TX_EXPIRED,                          //!< its deadline passed before it could start
+    LORA_RADIO_TX_FLUSHED,                          //!< removed by lora_radio_tx_queue_flush
+}LoRaRadioTxResult_t;
+
+/*!
+ * Frame to send. Buffer is not copied, it must stay valid until the callback.
+ */
+typedef struct
+{
+    uint8_t *Buffer;
+    uint8_t Size;
+    uint8_t Priority;                               //!< higher first, same priority in submission order
+    uint32_t MaxDelay;                              //!< [ms] the frame expires if it cannot start within, 0: never
+    void ( *Callback )( void *context, LoRaRadioTxResult_t result );  //!< may be RT_NULL
+    void *Context;
+}LoRaRadioTxFrame_t;
+
+typedef struct
+{
+    uint32_t Queued;
+    uint32_t Sent;
+    uint32_t TimedOut;
+    uint32_t Expired;
+    uint32_t Flushed;
+    uint32_t HighWater;                             //!< most frames waiting at once
+    uint32_t Gaps;                                  //!< back-to-back starts measured
+    uint32_t GapMinUs;                              //!< TxDone processing -> next frame in TX
+    uint32_t GapMaxUs;
+    uint64_t GapTotalUs;
+}LoRaRadioTxQueueStats_t;
+
+/*!
+ * \brief Queues a frame on \a radio, it starts at once when the radio is not
+ *        sending a queued frame.
+ *
+ * Frames sent through the queue report to their callback only, not to
+ * RadioEvents->TxDone / TxTimeout. Do not mix with Radio.Send while the
+ * queue is busy. After a TX timeout the waiting frames are flushed, the
+ * radio has to be configured again (SX127x resets the chip).
+ *
+ * \retval RT_EOK, -RT_EFULL when LORA_RADIO_TX_QUEUE_SIZE frames are waiting
+ */
+rt_err_t lora_radio_tx_queue_send( LoRaRadio_t *radio, const LoRaRadioTxFrame_t *frame );
+
+/*!
+ * \brief Removes the frames waiting on \a radio, the one on air completes
+ */
+void lora_radio_tx_queue_flush( LoRaRadio_t *radio );
+
+/*!
+ * \brief Number of frames waiting on \a radio, not counting the one on air
+ */
+uint32_t lora_radio_tx_queue_pending( LoRaRadio_t *radio );
+
+void lora_radio_tx_queue_stats_get( LoRaRadio_t *radio, LoRaRadioTxQueueStats_t *stats );
+void lora_radio_tx_queue_stats_reset( LoRaRadio_t *radio );
+
+/*!
+ * \brief Called by the chip driver, driver lock held, when the TX of the
+ *        selected instance ends. Starts the next frame before reporting the
+ *        finished one.
+ *
+ * \retval true when the frame was a queued one, the driver then does not
+ *         call RadioEvents
+ */
+bool lora_radio_tx_queue_complete( LoRaRadioTxResult_t result );
+
+#else
+#define lora_radio_tx_queue_complete( result )      ( false )
+#endif // LORA_RADIO_DRIVER_USING_TX_QUEUE
+
+#endif // __LORA_RADIO_TX_QUEUE_H__
@@ -25,8 +25,47 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "lora-radio-rtos-config.h"
 
 
+/*!
+ * Free running microsecond counter used by the driver statistics.
+ * The default only has tick resolution, a port should map it to a cycle
+ * counter (eg. DWT->CYCCNT) to see durations shorter than one tick.
+ */
+#ifndef LORA_RADIO_TIMESTAMP_US
+#define LORA_RADIO_TIMESTAMP_US( ) ( ( uint32_t )rt_tick_get( ) * ( 1000000UL / RT_TICK_PER_SECOND ) )
+#define LORA_RADIO_TIMESTAMP_US_FROM_TICK
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_CRITICAL_SECTION_STATS
+
+/*!
+ * \brief Interrupts-disabled windows of the driver, see lora_radio_critical_section_stats_get()
+ */
+typedef struct
+{
+    uint32_t Count;         //!< critical sections left since the last reset
+    uint32_t MaxUs;         //!< longest interrupts-disabled window
+    uint64_t TotalUs;       //!< cumulated interrupts-disabled time
+    const char *MaxFunc;    //!< function that held the longest window
+}LoRaRadioCriticalSectionStats_t;
+
+void lora_radio_critical_section_enter( const char *func );
+void lora_radio_critical_section_exit( void );
+void lora_radio_critical_section_stats_get( LoRaRadioCriticalSectionStats_t *stats );
+void lora_radio_critical_section_stats_reset( void );
+
+/*!
+ * Begins critical section
+ */
+#define LORA_RADIO_CRITICAL_SECTION_BEGIN( ) register rt_base_t level; level = rt_hw_interrupt_disable(); lora_radio_critical_section_enter( __FUNCTION__ )
+
+/*!
+ * Ends critical section
+ */
+#define LORA_RADIO_CRITICAL_SECTION_END( ) lora_radio_critical_section_exit( ); rt_hw_interrupt_enable(level)
+#else
 /*!
  * Begins critical section
  */
@@ -36,6 +75,21 @@
  * Ends critical section
  */
 #define LORA_RADIO_CRITICAL_SECTION_END( ) rt_hw_interrupt_enable(level)
+#endif
+
+/*!
+ * Index publication for the lock-free queues between the driver and the
+ * application: the producer stores its index after the slot it fills, the
+ * consumer loads it before reading the slot. Other compilers rely on the
+ * index being volatile and on a single core MCU.
+ */
+#if defined( __GNUC__ )
+#define LORA_RADIO_LOAD_ACQUIRE( ptr )              __atomic_load_n( ptr, __ATOMIC_ACQUIRE )
+#define LORA_RADIO_STORE_RELEASE( ptr, value )      __atomic_store_n( ptr, value, __ATOMIC_RELEASE )
+#else
+#define LORA_RADIO_LOAD_ACQUIRE( ptr )              ( *( ptr ) )
+#define LORA_RADIO_STORE_RELEASE( ptr, value )      ( *( ptr ) = ( value ) )
+#endif
 
 /*!
  * Radio driver supported modems
@@ -68,6 +122,7 @@ typedef enum
     EV_LORA_RADIO_IRQ3_FIRED    =   0x0008,
     EV_LORA_RADIO_IRQ4_FIRED    =   0x0010,
     EV_LORA_RADIO_IRQ5_FIRED    =   0x0020,
+    EV_LORA_RADIO_TIMER_FIRED   =   0x0040,   //!< a LORA_RADIO_DRIVER_USING_HRTIMER timer of the instance expired
 }RadioDioIrqEvent_t;
 
 /*!
@@ -163,7 +218,9 @@ struct Radio_s
      *
      * \param [IN] modem      Radio modem to be used [0: FSK, 1: LoRa]
      * \param [IN] freq       Channel RF frequency
-     * \param [IN] rssiThresh RSSI threshold
+     * \param [IN] rssiThresh RSSI threshold, LORA_RADIO_RSSI_THRESH_AUTO for
+     *                        the noise floor of the channel + margin
+     *                        (LORA_RADIO_DRIVER_USING_NOISE_FLOOR)
      * \param [IN] maxCarrierSenseTime Max time while the RSSI is measured
      *
      * \retval isFree         [true: Channel is free, false: Channel is not free]
@@ -434,6 +491,308 @@ struct Radio_s
  */
 extern const struct Radio_s Radio;
 
+/*!
+ * Number of radios driven at the same time, each one with its own chip
+ * state, PHY thread and event object
+ */
+#ifndef LORA_RADIO_DRIVER_INSTANCE_NUM
+#define LORA_RADIO_DRIVER_INSTANCE_NUM              1
+#endif
+
+#ifndef LORA_RADIO_PHY_THREAD_STACK_SIZE
+#define LORA_RADIO_PHY_THREAD_STACK_SIZE            4096
+#endif
+
+/*!
+ * \brief Radio driver callback functions of a radio instance, \a context is
+ *        the pointer given to lora_radio_init()
+ */
+typedef struct
+{
+    void    ( *TxDone )( void *context );
+    void    ( *TxTimeout )( void *context );
+    void    ( *RxDone )( void *context, uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr );
+    void    ( *RxTimeout )( void *context );
+    void    ( *RxError )( void *context );
+    void    ( *FhssChangeChannel )( void *context, uint8_t currentChannel );
+    void    ( *CadDone )( void *context, bool channelActivityDetected );
+}LoRaRadioEvents_t;
+
+/*!
+ * \brief Wiring of a radio instance. Boards driving more than one radio
+ *        provide lora_radio_hw[LORA_RADIO_DRIVER_INSTANCE_NUM], instance 0
+ *        otherwise uses the LORA_RADIO0_xxx / LORA_RADIO_xxx_PIN settings.
+ */
+typedef struct
+{
+    const char *SpiBusName;
+    const char *SpiDeviceName;
+    int32_t NssPin;
+    int32_t ResetPin;
+    int32_t BusyPin;                                //!< SX126x only
+    int32_t DioPins[6];                             //!< -1 when not wired
+    int32_t RfSw1Pin;                               //!< -1 when not wired
+    int32_t RfSw2Pin;                               //!< -1 when not wired
+}LoRaRadioHw_t;
+
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+extern const LoRaRadioHw_t lora_radio_hw[LORA_RADIO_DRIVER_INSTANCE_NUM];
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+/*!
+ * Delay from the last bit on air to the TxDone / RxDone DIO edge, board and
+ * chip specific, subtracted from the latched edge
+ */
+#ifndef LORA_RADIO_TX_DONE_LATENCY_US
+#define LORA_RADIO_TX_DONE_LATENCY_US               0
+#endif
+#ifndef LORA_RADIO_RX_DONE_LATENCY_US
+#define LORA_RADIO_RX_DONE_LATENCY_US               0
+#endif
+
+/*!
+ * \brief Timing of the last frame sent or received by an instance, all in
+ *        LORA_RADIO_TIMESTAMP_US( ) time
+ */
+typedef struct
+{
+    uint32_t IrqUs;                                 //!< TxDone / RxDone DIO edge, latched in the ISR
+    uint32_t EndUs;                                 //!< last bit on air, IrqUs - LORA_RADIO_xX_DONE_LATENCY_US
+    uint32_t StartUs;                               //!< first preamble bit on air, EndUs - TimeOnAirUs
+    uint32_t TimeOnAirUs;                           //!< of the frame, from the packet parameters in use
+    uint32_t LatencyUs;                             //!< DIO edge -> the driver handled the event
+    bool Valid;                                     //!< false until the first frame
+}LoRaRadioTimestamp_t;
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+#ifndef LORA_RADIO_EVENT_RING_SIZE
+#define LORA_RADIO_EVENT_RING_SIZE                  16
+#endif
+
+#if ( LORA_RADIO_EVENT_RING_SIZE < 2 ) || ( LORA_RADIO_EVENT_RING_SIZE > 256 ) || \
+    ( ( LORA_RADIO_EVENT_RING_SIZE & ( LORA_RADIO_EVENT_RING_SIZE - 1 ) ) != 0 )
+    #error "LORA_RADIO_EVENT_RING_SIZE must be a power of two between 2 and 256"
+#endif
+
+/*!
+ * \brief Event posted by lora_radio_notify to the PHY thread of an instance
+ */
+typedef struct
+{
+    uint32_t Events;                                //!< EV_LORA_RADIO_xxx_FIRED bits
+    uint32_t Timestamp;                             //!< LORA_RADIO_TIMESTAMP_US( ) in the ISR
+    uint32_t Sequence;                              //!< post order on the instance, overflowed events leave a gap
+}LoRaRadioIrqEvent_t;
+
+typedef struct
+{
+    uint32_t Posted;                                //!< events queued
+    uint32_t Overflowed;                            //!< events merged into RingOverflow, the ring was full
+    uint32_t Wakeups;                               //!< PHY thread wakeups, the ring went from empty to non-empty
+    uint32_t HighWater;                             //!< most events waiting at once
+    uint32_t Handled;                               //!< events dequeued by the PHY thread
+    uint32_t LatencyMaxUs;                          //!< ISR -> PHY thread dequeue
+    uint64_t LatencyTotalUs;
+}LoRaRadioEventRingStats_t;
+#endif
+
+/*!
+ * \brief Radio instance
+ */
+typedef struct LoRaRadio_s
+{
+    uint8_t Index;
+    const LoRaRadioHw_t *Hw;                        //!< RT_NULL for a single radio
+    const LoRaRadioEvents_t *Events;
+    void *Context;
+    RadioEvents_t *LegacyEvents;                    //!< callbacks given to Radio.Init
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+    struct rt_semaphore Wakeup;                     //!< released on the empty -> non-empty transition of Ring
+    LoRaRadioIrqEvent_t Ring[LORA_RADIO_EVENT_RING_SIZE];
+    volatile uint32_t RingHead;                     //!< written by the PHY thread
+    volatile uint32_t RingTail;                     //!< written in interrupt context
+    uint32_t RingSequence;
+    volatile uint32_t RingOverflow;                 //!< events of a full ring, handled after the ring
+    uint32_t RingOverflowUs;                        //!< LORA_RADIO_TIMESTAMP_US( ) of the first of them
+    LoRaRadioEventRingStats_t RingStats;
+#else
+    struct rt_event Event;
+#endif
+    struct rt_thread Thread;
+    rt_uint8_t ThreadStack[LORA_RADIO_PHY_THREAD_STACK_SIZE];
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+    volatile uint32_t DioIrqUs[6];                  //!< last edge of each DIO, latched by lora_radio_notify,
+                                                    //!< with LORA_RADIO_DRIVER_USING_EVENT_RING the edge being handled
+    LoRaRadioTimestamp_t TxTimestamp;
+    LoRaRadioTimestamp_t RxTimestamp;
+#endif
+    bool Started;
+}LoRaRadio_t;
+
+/*!
+ * \brief Returns the radio instance \a index, RT_NULL if out of range
+ */
+LoRaRadio_t *lora_radio_get( uint8_t index );
+
+/*!
+ * \brief Returns the radio instance the chip driver currently works on
+ */
+LoRaRadio_t *lora_radio_current( void );
+
+/*!
+ * \brief Selects \a radio for the chip driver and takes the driver lock,
+ *        calls to different instances are serialized, the radios themselves
+ *        receive and transmit in parallel. On RT-Thread the lock is taken
+ *        with one instance too, it keeps the application calls out of the
+ *        IRQ handling of the PHY thread. The application callbacks run
+ *        without it.
+ *
+ * \retval previous  Instance selected before, to be given to lora_radio_unlock
+ */
+LoRaRadio_t *lora_radio_lock( LoRaRadio_t *radio );
+void lora_radio_unlock( LoRaRadio_t *previous );
+
+/*!
+ * \brief Posts DIO events to the PHY thread of \a radio, ISR safe. With
+ *        LORA_RADIO_DRIVER_USING_EVENT_RING every call is one event, handled
+ *        in order, the events of a full ring merge into one handled after
+ *        it; otherwise the events are flags that merge until handled.
+ *
+ * \retval posted false if the events will not be handled
+ */
+bool lora_radio_notify( LoRaRadio_t *radio, uint32_t events );
+
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+/*!
+ * \brief Gets / clears the event ring counters of \a radio (RT_NULL for
+ *        instance 0)
+ */
+void lora_radio_event_ring_stats_get( LoRaRadio_t *radio, LoRaRadioEventRingStats_t *stats );
+void lora_radio_event_ring_stats_reset( LoRaRadio_t *radio );
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+/*!
+ * \brief Timing of the last frame sent / received by \a radio (RT_NULL for
+ *        instance 0). Valid from the TxDone / RxDone callback on, queued
+ *        frames included.
+ *
+ * \retval false when no frame was sent / received yet
+ */
+bool lora_radio_get_tx_timestamp( LoRaRadio_t *radio, LoRaRadioTimestamp_t *timestamp );
+bool lora_radio_get_rx_timestamp( LoRaRadio_t *radio, LoRaRadioTimestamp_t *timestamp );
+#endif
+
+/*!
+ * \brief Initializes a radio instance and starts its PHY thread
+ *
+ * \param [IN] events   Callbacks, called from the PHY thread of the instance
+ * \param [IN] context  Passed back as first argument of every callback
+ */
+bool lora_radio_init( LoRaRadio_t *radio, const LoRaRadioEvents_t *events, void *context );
+
+/*!
+ * \brief Radio_s operations on a radio instance
+ */
+RadioState_t lora_radio_get_status( LoRaRadio_t *radio );
+void lora_radio_set_modem( LoRaRadio_t *radio, RadioModems_t modem );
+void lora_radio_set_channel( LoRaRadio_t *radio, uint32_t freq );
+bool lora_radio_is_channel_free( LoRaRadio_t *radio, RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime );
+uint32_t lora_radio_random( LoRaRadio_t *radio );
+void lora_radio_set_rx_config( LoRaRadio_t *radio, RadioModems_t modem, uint32_t bandwidth,
+                               uint32_t datarate, uint8_t coderate,
+                               uint32_t bandwidthAfc, uint16_t preambleLen,
+                               uint16_t symbTimeout, bool fixLen,
+                               uint8_t payloadLen,
+                               bool crcOn, bool freqHopOn, uint8_t hopPeriod,
+                               bool iqInverted, bool rxContinuous );
+void lora_radio_set_tx_config( LoRaRadio_t *radio, RadioModems_t modem, int8_t power, uint32_t fdev,
+                               uint32_t bandwidth, uint32_t datarate,
+                               uint8_t coderate, uint16_t preambleLen,
+                               bool fixLen, bool crcOn, bool freqHopOn,
+                               uint8_t hopPeriod, bool iqInverted, uint32_t timeout );
+bool lora_radio_check_rf_frequency( LoRaRadio_t *radio, uint32_t frequency );
+uint32_t lora_radio_time_on_air( LoRaRadio_t *radio, RadioModems_t modem, uint32_t bandwidth,
+                                 uint32_t datarate, uint8_t coderate,
+                                 uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
+                                 bool crcOn );
+void lora_radio_send( LoRaRadio_t *radio, uint8_t *buffer, uint8_t size );
+void lora_radio_sleep( LoRaRadio_t *radio );
+void lora_radio_standby( LoRaRadio_t *radio );
+void lora_radio_rx( LoRaRadio_t *radio, uint32_t timeout );
+void lora_radio_start_cad( LoRaRadio_t *radio );
+void lora_radio_set_tx_continuous_wave( LoRaRadio_t *radio, uint32_t freq, int8_t power, uint16_t time );
+int16_t lora_radio_rssi( LoRaRadio_t *radio, RadioModems_t modem );
+void lora_radio_write( LoRaRadio_t *radio, uint16_t addr, uint8_t data );
+uint8_t lora_radio_read( LoRaRadio_t *radio, uint16_t addr );
+void lora_radio_set_max_payload_length( LoRaRadio_t *radio, RadioModems_t modem, uint8_t max );
+void lora_radio_set_public_network( LoRaRadio_t *radio, bool enable );
+uint32_t lora_radio_get_wakeup_time( LoRaRadio_t *radio );
+uint8_t lora_radio_check( LoRaRadio_t *radio );
+void lora_radio_rx_boosted( LoRaRadio_t *radio, uint32_t timeout );
+void lora_radio_set_rx_duty_cycle( LoRaRadio_t *radio, uint32_t rxTime, uint32_t sleepTime );
+
+/*!
+ * Chip driver hooks, implemented by the sx126x / sx127x driver
+ */
+
+/*!
+ * \brief Operations of the chip driver, applied to the selected instance
+ */
+extern const struct Radio_s LoRaRadioOps;
+
+/*!
+ * \brief Points the chip driver state to instance \a index
+ */
+void lora_radio_chip_select( uint8_t index );
+
+/*!
+ * \brief Handles the DIO events received by the PHY thread of the selected instance
+ */
+void lora_radio_chip_irq_process( uint32_t events );
+
+/*!
+ * \brief Starts the receiver of the selected instance for RSSI readings, as
+ *        Radio.IsChannelFree does before it samples. \a freq 0 keeps the
+ *        channel in use.
+ */
+void lora_radio_chip_rssi_start( RadioModems_t modem, uint32_t freq );
+
+/*!
+ * \brief Moves the receiver started by lora_radio_chip_rssi_start to \a freq,
+ *        the modem and its configuration are kept
+ */
+void lora_radio_chip_rssi_retune( uint32_t freq );
+
+/*!
+ * \brief Returns the RF frequency the selected instance is tuned to [Hz]
+ */
+uint32_t lora_radio_chip_get_channel( void );
+
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+/*!
+ * \brief Called by the chip driver on TxDone / RxDone of the selected
+ *        instance, before any callback, with the DIO the event came on and
+ *        the time on air of the frame
+ */
+void lora_radio_timestamp_capture( bool tx, uint8_t dio, uint32_t timeOnAirUs );
+#endif
+
+/*!
+ * \brief SPI bus / device of the instance being initialized
+ */
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+#define LORA_RADIO_SPI_BUS_NAME                     ( lora_radio_current( )->Hw->SpiBusName )
+#define LORA_RADIO_DEVICE_NAME                      ( lora_radio_current( )->Hw->SpiDeviceName )
+#else
+#define LORA_RADIO_SPI_BUS_NAME                     LORA_RADIO0_SPI_BUS_NAME
+#define LORA_RADIO_DEVICE_NAME                      LORA_RADIO0_DEVICE_NAME
+#endif
+
 
 
 #endif // __RADIO_H__
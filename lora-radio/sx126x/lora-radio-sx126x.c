@@ -26,21 +26,18 @@
 #include <string.h>
 #include "lora-radio-timer.h"
 #include "lora-radio.h"
+#include "lora-radio-rx-pool.h"
+#include "lora-radio-tx-queue.h"
+#include "lora-radio-rx-policy.h"
+#include "lora-radio-lbt.h"
+#include "lora-radio-noise-floor.h"
+#include "lora-radio-toa.h"
 #include "sx126x-board.h"
 
 #define LOG_TAG "PHY.LoRa.SX126X"
 #define LOG_LEVEL  LOG_LVL_DBG
 #include "lora-radio-debug.h"
 
-#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-
-#define EV_LORA_RADIO_IRQ_FIRED       0x0001
-
-static struct rt_event lora_radio_event;
-static struct rt_thread lora_radio_thread;
-static rt_uint8_t rt_lora_radio_thread_stack[4096];
-#endif
-
 /*!
  * \brief Initializes the radio
  *
@@ -353,9 +350,10 @@ void RadioRxBoosted( uint32_t timeout );
 void RadioSetRxDutyCycle( uint32_t rxTime, uint32_t sleepTime );
 
 /*!
- * Radio driver structure initialization
+ * Radio driver structure initialization, called through the Radio shim
+ * and the lora_radio_xxx API with the radio instance selected
  */
-const struct Radio_s Radio =
+const struct Radio_s LoRaRadioOps =
 {
     RadioInit,
     RadioGetStatus,
@@ -433,19 +431,6 @@ const FskBandwidth_t FskBandwidths[] =
 
 const RadioLoRaBandwidths_t Bandwidths[] = { LORA_BW_125, LORA_BW_250, LORA_BW_500 };
 
-uint8_t MaxPayloadLength = 0xFF;
-
-uint32_t TxTimeout = 0;
-uint32_t RxTimeout = 0;
-
-bool RxContinuous = false;
-
-
-PacketStatus_t RadioPktStatus;
-uint8_t RadioRxPayload[255];
-
-bool IrqFired = false;
-
 /*
  * SX126x DIO IRQ callback functions prototype
  */
@@ -458,12 +443,12 @@ void RadioOnDioIrq( void* context );
 /*!
  * \brief Tx timeout timer callback
  */
-void RadioOnTxTimeoutIrq( void/** context*/ );
+void RadioOnTxTimeoutIrq( void* context );
 
 /*!
  * \brief Rx timeout timer callback
  */
-void RadioOnRxTimeoutIrq( void/** context*/);
+void RadioOnRxTimeoutIrq( void* context );
 
 /*
  * \brief spi initilize
@@ -473,37 +458,25 @@ extern struct rt_spi_device *lora_radio_spi_init(const char *bus_name,const char
  * Private global variables
  */
 
-
-/*!
- * Holds the current network type for the radio
- */
-typedef struct
-{
-    bool Previous;
-    bool Current;
-}RadioPublicNetwork_t;
-
-static RadioPublicNetwork_t RadioPublicNetwork = { false };
-
 /*!
- * Radio callbacks variable
+ * Radio hardware and global parameters, one per radio instance
  */
-static RadioEvents_t* RadioEvents;
+static SX126x_t SX126xInstances[LORA_RADIO_DRIVER_INSTANCE_NUM];
 
 /*
  * Public global variables
  */
 
 /*!
- * Radio hardware and global parameters
+ * Radio hardware and global parameters of the selected instance
  */
-SX126x_t SX126x;
+SX126x_t *SX126x = &SX126xInstances[0];
 
 /*!
- * Tx and Rx timers
+ * Command sequences of RadioSend, RadioRx and RadioSetRxConfig are encoded
+ * here and sent back to back
  */
-TimerEvent_t TxTimeoutTimer;
-TimerEvent_t RxTimeoutTimer;
+static SX126xBatch_t RadioBatch;
 
 
 /*
@@ -513,9 +486,9 @@ uint8_t RadioCheck(void)
 {
     uint8_t test = 0;
 
-    if( SX126x.PacketParams.PacketType == PACKET_TYPE_LORA )
+    if( SX126x->PacketParams.PacketType == PACKET_TYPE_LORA )
     {
-        LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "Packet Type is %s\n",( SX126x.PacketParams.PacketType == PACKET_TYPE_LORA )? "LoRa":"FSK");
+        LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "Packet Type is %s\n",( SX126x->PacketParams.PacketType == PACKET_TYPE_LORA )? "LoRa":"FSK");
         
         /*SPI Check*/
         SX126xWriteRegister(REG_LR_PAYLOADLENGTH, 0x55); 
@@ -556,35 +529,23 @@ static uint8_t RadioGetFskBandwidthRegValue( uint32_t bandwidth )
     while( 1 );
 }
 
-#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-/**
-  * @brief  lora_radio_thread_entry
-  * @param  None
-  * @retval None
-  */
-static void lora_radio_thread_entry(void* parameter)
+void lora_radio_chip_select( uint8_t index )
 {
-    rt_uint32_t ev;
-    
-    while(1)
-    {
-        if (rt_event_recv(&lora_radio_event, EV_LORA_RADIO_IRQ_FIRED,
-                                RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
-                                RT_WAITING_FOREVER, &ev) == RT_EOK)
-        {
-            RadioIrqProcess();
-        }
-    }
+    SX126x = &SX126xInstances[index];
 }
 
-#endif
+void lora_radio_chip_irq_process( uint32_t events )
+{
+    RadioIrqProcess( );
+}
 
 bool RadioInit( RadioEvents_t *events )
 {
-    RadioEvents = events;
+    SX126x->RadioEvents = events;
+    SX126x->MaxPayloadLength = 0xFF;
 
-    SX126x.spi = lora_radio_spi_init(LORA_RADIO0_SPI_BUS_NAME, LORA_RADIO0_DEVICE_NAME, RT_NULL);
-    if (SX126x.spi == RT_NULL)
+    SX126x->spi = lora_radio_spi_init(LORA_RADIO_SPI_BUS_NAME, LORA_RADIO_DEVICE_NAME, RT_NULL);
+    if (SX126x->spi == RT_NULL)
     {
         LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "SX126x SPI Init Failed\n");
         return false;
@@ -607,27 +568,15 @@ bool RadioInit( RadioEvents_t *events )
     #endif
 
     // Initialize driver timeout timers
-    TimerInit( &TxTimeoutTimer, RadioOnTxTimeoutIrq );
-    TimerInit( &RxTimeoutTimer, RadioOnRxTimeoutIrq );
+    TimerInit( &SX126x->TxTimeoutTimer, RadioOnTxTimeoutIrq );
+    TimerSetContext( &SX126x->TxTimeoutTimer, lora_radio_current( ) );
+    TimerInit( &SX126x->RxTimeoutTimer, RadioOnRxTimeoutIrq );
+    TimerSetContext( &SX126x->RxTimeoutTimer, lora_radio_current( ) );
 
-    #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-        rt_event_init(&lora_radio_event, "ev_phy", RT_IPC_FLAG_PRIO);//RT_IPC_FLAG_FIFO);
-
-        rt_thread_init(&lora_radio_thread,               	  
-                       "lora-phy",                     	  
-                       lora_radio_thread_entry,          	  
-                       RT_NULL,                    	  
-                       &rt_lora_radio_thread_stack[0],       
-                       sizeof(rt_lora_radio_thread_stack),  
-                       0,                          	  
-                       20);                           
-                                   
-        rt_thread_startup(&lora_radio_thread);    
-                               
-    #else
-        IrqFired = false;
+    #ifndef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+        SX126x->IrqFired = false;
     #endif
-                       
+
     return true;
 }
 
@@ -654,16 +603,16 @@ void RadioSetModem( RadioModems_t modem )
         case MODEM_FSK:
             SX126xSetPacketType( PACKET_TYPE_GFSK );
             // When switching to GFSK mode the LoRa SyncWord register value is reset
-            // Thus, we also reset the RadioPublicNetwork variable
-            RadioPublicNetwork.Current = false;
+            // Thus, we also reset the PublicNetwork state
+            SX126x->PublicNetwork.Current = false;
             break;
         case MODEM_LORA:
             SX126xSetPacketType( PACKET_TYPE_LORA );
             // Public/Private network register is reset when switching modems
-            if( RadioPublicNetwork.Current != RadioPublicNetwork.Previous )
+            if( SX126x->PublicNetwork.Current != SX126x->PublicNetwork.Previous )
             {
-                RadioPublicNetwork.Current = RadioPublicNetwork.Previous;
-                RadioSetPublicNetwork( RadioPublicNetwork.Current );
+                SX126x->PublicNetwork.Current = SX126x->PublicNetwork.Previous;
+                RadioSetPublicNetwork( SX126x->PublicNetwork.Current );
             }
             break;
     }
@@ -674,19 +623,47 @@ void RadioSetChannel( uint32_t freq )
     SX126xSetRfFrequency( freq );
 }
 
-bool RadioIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime )
+void lora_radio_chip_rssi_start( RadioModems_t modem, uint32_t freq )
 {
-    bool status = true;
-    int16_t rssi = 0;
-    uint32_t carrierSenseTime = 0;
-
     RadioSleep( );
 
     RadioSetModem( modem );
 
+    if( freq != 0 )
+    {
+        RadioSetChannel( freq );
+    }
+
+    RadioRx( 0 );
+}
+
+void lora_radio_chip_rssi_retune( uint32_t freq )
+{
+    SX126xSetStandby( STDBY_RC );
+
     RadioSetChannel( freq );
 
     RadioRx( 0 );
+}
+
+uint32_t lora_radio_chip_get_channel( void )
+{
+    return SX126x->Frequency;
+}
+
+bool RadioIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime )
+{
+    bool status = true;
+    int16_t rssi = 0;
+    uint32_t carrierSenseTime = 0;
+
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+    if( rssiThresh == LORA_RADIO_RSSI_THRESH_AUTO )
+    {
+        rssiThresh = lora_radio_noise_floor_threshold( lora_radio_current( ), freq );
+    }
+#endif
+    lora_radio_chip_rssi_start( modem, freq );
 
     DelayMs( 1 );
 
@@ -726,6 +703,33 @@ uint32_t RadioRandom( void )
     return rnd;
 }
 
+/*!
+ * \brief Puts the chip in standby, running the given modem, before it is
+ *        configured.
+ *
+ * \remark With LORA_RADIO_DRIVER_USING_CONFIG_DIFF a chip already in standby
+ *         or sleep is left there, the first configuration command sent wakes
+ *         it up, and the packet type is only sent when it changes
+ */
+static void RadioConfigPrepare( RadioModems_t modem )
+{
+#ifdef LORA_RADIO_DRIVER_USING_CONFIG_DIFF
+    uint8_t packetType = ( modem == MODEM_FSK ) ? PACKET_TYPE_GFSK : PACKET_TYPE_LORA;
+
+    if( ( SX126xGetOperatingMode( ) != MODE_STDBY_RC ) && ( SX126xGetOperatingMode( ) != MODE_SLEEP ) )
+    {
+        RadioStandby( );
+    }
+    if( SX126xConfigChanged( SX126X_CONFIG_PACKET_TYPE, &packetType, 1 ) )
+    {
+        RadioSetModem( modem );
+    }
+#else
+    RadioStandby( );
+    RadioSetModem( modem );
+#endif
+}
+
 void RadioSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
                          uint32_t datarate, uint8_t coderate,
                          uint32_t bandwidthAfc, uint16_t preambleLen,
@@ -735,107 +739,110 @@ void RadioSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
                          bool iqInverted, bool rxContinuous )
 {
 
-    RxContinuous = rxContinuous;
+    SX126x->RxContinuous = rxContinuous;
     if( rxContinuous == true )
     {
         symbTimeout = 0;
     }
     if( fixLen == true )
     {
-        MaxPayloadLength = payloadLen;
+        SX126x->MaxPayloadLength = payloadLen;
     }
     else
     {
-        MaxPayloadLength = 0xFF;
+        SX126x->MaxPayloadLength = 0xFF;
     }
 
+    SX126xBatchBegin( &RadioBatch );
     switch( modem )
     {
         case MODEM_FSK:
             SX126xSetStopRxTimerOnPreambleDetect( false );
-            SX126x.ModulationParams.PacketType = PACKET_TYPE_GFSK;
-
-            SX126x.ModulationParams.Params.Gfsk.BitRate = datarate;
-            SX126x.ModulationParams.Params.Gfsk.ModulationShaping = MOD_SHAPING_G_BT_1;
-            SX126x.ModulationParams.Params.Gfsk.Bandwidth = RadioGetFskBandwidthRegValue( bandwidth );
-
-            SX126x.PacketParams.PacketType = PACKET_TYPE_GFSK;
-            SX126x.PacketParams.Params.Gfsk.PreambleLength = ( preambleLen << 3 ); // convert byte into bit
-            SX126x.PacketParams.Params.Gfsk.PreambleMinDetect = RADIO_PREAMBLE_DETECTOR_08_BITS;
-            SX126x.PacketParams.Params.Gfsk.SyncWordLength = 3 << 3; // convert byte into bit
-            SX126x.PacketParams.Params.Gfsk.AddrComp = RADIO_ADDRESSCOMP_FILT_OFF;
-            SX126x.PacketParams.Params.Gfsk.HeaderType = ( fixLen == true ) ? RADIO_PACKET_FIXED_LENGTH : RADIO_PACKET_VARIABLE_LENGTH;
-            SX126x.PacketParams.Params.Gfsk.PayloadLength = MaxPayloadLength;
+            SX126x->ModulationParams.PacketType = PACKET_TYPE_GFSK;
+
+            SX126x->ModulationParams.Params.Gfsk.BitRate = datarate;
+            SX126x->ModulationParams.Params.Gfsk.ModulationShaping = MOD_SHAPING_G_BT_1;
+            SX126x->ModulationParams.Params.Gfsk.Bandwidth = RadioGetFskBandwidthRegValue( bandwidth );
+
+            SX126x->PacketParams.PacketType = PACKET_TYPE_GFSK;
+            SX126x->PacketParams.Params.Gfsk.PreambleLength = ( preambleLen << 3 ); // convert byte into bit
+            SX126x->PacketParams.Params.Gfsk.PreambleMinDetect = RADIO_PREAMBLE_DETECTOR_08_BITS;
+            SX126x->PacketParams.Params.Gfsk.SyncWordLength = 3 << 3; // convert byte into bit
+            SX126x->PacketParams.Params.Gfsk.AddrComp = RADIO_ADDRESSCOMP_FILT_OFF;
+            SX126x->PacketParams.Params.Gfsk.HeaderType = ( fixLen == true ) ? RADIO_PACKET_FIXED_LENGTH : RADIO_PACKET_VARIABLE_LENGTH;
+            SX126x->PacketParams.Params.Gfsk.PayloadLength = SX126x->MaxPayloadLength;
             if( crcOn == true )
             {
-                SX126x.PacketParams.Params.Gfsk.CrcLength = RADIO_CRC_2_BYTES_CCIT;
+                SX126x->PacketParams.Params.Gfsk.CrcLength = RADIO_CRC_2_BYTES_CCIT;
             }
             else
             {
-                SX126x.PacketParams.Params.Gfsk.CrcLength = RADIO_CRC_OFF;
+                SX126x->PacketParams.Params.Gfsk.CrcLength = RADIO_CRC_OFF;
             }
-            SX126x.PacketParams.Params.Gfsk.DcFree = RADIO_DC_FREEWHITENING;
+            SX126x->PacketParams.Params.Gfsk.DcFree = RADIO_DC_FREEWHITENING;
 
-            RadioStandby( );
-            RadioSetModem( ( SX126x.ModulationParams.PacketType == PACKET_TYPE_GFSK ) ? MODEM_FSK : MODEM_LORA );
-            SX126xSetModulationParams( &SX126x.ModulationParams );
-            SX126xSetPacketParams( &SX126x.PacketParams );
+            RadioConfigPrepare( ( SX126x->ModulationParams.PacketType == PACKET_TYPE_GFSK ) ? MODEM_FSK : MODEM_LORA );
+            SX126xSetModulationParams( &SX126x->ModulationParams );
+            SX126xSetPacketParams( &SX126x->PacketParams );
             SX126xSetSyncWord( ( uint8_t[] ){ 0xC1, 0x94, 0xC1, 0x00, 0x00, 0x00, 0x00, 0x00 } );
             SX126xSetWhiteningSeed( 0x01FF );
 
-            RxTimeout = ( uint32_t )( symbTimeout * ( ( 1.0 / ( double )datarate ) * 8.0 ) * 1000 );
+            SX126x->RxTimeout = ( uint32_t )( symbTimeout * ( ( 1.0 / ( double )datarate ) * 8.0 ) * 1000 );
             break;
 
         case MODEM_LORA:
             SX126xSetStopRxTimerOnPreambleDetect( false );
-            SX126x.ModulationParams.PacketType = PACKET_TYPE_LORA;
-            SX126x.ModulationParams.Params.LoRa.SpreadingFactor = ( RadioLoRaSpreadingFactors_t )datarate;
-            SX126x.ModulationParams.Params.LoRa.Bandwidth = Bandwidths[bandwidth];
-            SX126x.ModulationParams.Params.LoRa.CodingRate = ( RadioLoRaCodingRates_t )coderate;
+            SX126x->ModulationParams.PacketType = PACKET_TYPE_LORA;
+            SX126x->ModulationParams.Params.LoRa.SpreadingFactor = ( RadioLoRaSpreadingFactors_t )datarate;
+            SX126x->ModulationParams.Params.LoRa.Bandwidth = Bandwidths[bandwidth];
+            SX126x->ModulationParams.Params.LoRa.CodingRate = ( RadioLoRaCodingRates_t )coderate;
 
             if( ( ( bandwidth == 0 ) && ( ( datarate == 11 ) || ( datarate == 12 ) ) ) ||
             ( ( bandwidth == 1 ) && ( datarate == 12 ) ) )
             {
-                SX126x.ModulationParams.Params.LoRa.LowDatarateOptimize = 0x01;
+                SX126x->ModulationParams.Params.LoRa.LowDatarateOptimize = 0x01;
             }
             else
             {
-                SX126x.ModulationParams.Params.LoRa.LowDatarateOptimize = 0x00;
+                SX126x->ModulationParams.Params.LoRa.LowDatarateOptimize = 0x00;
             }
 
-            SX126x.PacketParams.PacketType = PACKET_TYPE_LORA;
+            SX126x->PacketParams.PacketType = PACKET_TYPE_LORA;
 
-            if( ( SX126x.ModulationParams.Params.LoRa.SpreadingFactor == LORA_SF5 ) ||
-                ( SX126x.ModulationParams.Params.LoRa.SpreadingFactor == LORA_SF6 ) )
+            if( ( SX126x->ModulationParams.Params.LoRa.SpreadingFactor == LORA_SF5 ) ||
+                ( SX126x->ModulationParams.Params.LoRa.SpreadingFactor == LORA_SF6 ) )
             {
                 if( preambleLen < 12 )
                 {
-                    SX126x.PacketParams.Params.LoRa.PreambleLength = 12;
+                    SX126x->PacketParams.Params.LoRa.PreambleLength = 12;
                 }
                 else
                 {
-                    SX126x.PacketParams.Params.LoRa.PreambleLength = preambleLen;
+                    SX126x->PacketParams.Params.LoRa.PreambleLength = preambleLen;
                 }
             }
             else
             {
-                SX126x.PacketParams.Params.LoRa.PreambleLength = preambleLen;
+                SX126x->PacketParams.Params.LoRa.PreambleLength = preambleLen;
             }
 
-            SX126x.PacketParams.Params.LoRa.HeaderType = ( RadioLoRaPacketLengthsMode_t )fixLen;
+            SX126x->PacketParams.Params.LoRa.HeaderType = ( RadioLoRaPacketLengthsMode_t )fixLen;
 
-            SX126x.PacketParams.Params.LoRa.PayloadLength = MaxPayloadLength;
-            SX126x.PacketParams.Params.LoRa.CrcMode = ( RadioLoRaCrcModes_t )crcOn;
-            SX126x.PacketParams.Params.LoRa.InvertIQ = ( RadioLoRaIQModes_t )iqInverted;
+            SX126x->PacketParams.Params.LoRa.PayloadLength = SX126x->MaxPayloadLength;
+            SX126x->PacketParams.Params.LoRa.CrcMode = ( RadioLoRaCrcModes_t )crcOn;
+            SX126x->PacketParams.Params.LoRa.InvertIQ = ( RadioLoRaIQModes_t )iqInverted;
             
-            RadioStandby( );
-            RadioSetModem( ( SX126x.ModulationParams.PacketType == PACKET_TYPE_GFSK ) ? MODEM_FSK : MODEM_LORA );
-            SX126xSetModulationParams( &SX126x.ModulationParams );
-            SX126xSetPacketParams( &SX126x.PacketParams );
+            RadioConfigPrepare( ( SX126x->ModulationParams.PacketType == PACKET_TYPE_GFSK ) ? MODEM_FSK : MODEM_LORA );
+            SX126xSetModulationParams( &SX126x->ModulationParams );
+            SX126xSetPacketParams( &SX126x->PacketParams );
             SX126xSetLoRaSymbNumTimeout( symbTimeout );
             
             // WORKAROUND - Optimizing the Inverted IQ Operation, see DS_SX1261-2_V1.2 datasheet chapter 15.4
-            if( SX126x.PacketParams.Params.LoRa.InvertIQ == LORA_IQ_INVERTED )
+            if( SX126xConfigChanged( SX126X_CONFIG_IQ_POLARITY, ( uint8_t* )&iqInverted, 1 ) == false )
+            {
+                // RegIqPolaritySetup already holds it
+            }
+            else if( SX126x->PacketParams.Params.LoRa.InvertIQ == LORA_IQ_INVERTED )
             {
                 // RegIqPolaritySetup = @address 0x0736
                 SX126xWriteRegister( 0x0736, SX126xReadRegister( 0x0736 ) & ~( 1 << 2 ) );
@@ -848,10 +855,11 @@ void RadioSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
             // WORKAROUND END
 
             // Timeout Max, Timeout handled directly in SetRx function
-            RxTimeout = 0xFFFF;
+            SX126x->RxTimeout = 0xFFFF;
 
             break;
     }
+    SX126xBatchEnd( &RadioBatch );
 }
 
 void RadioSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
@@ -860,91 +868,95 @@ void RadioSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
                         bool fixLen, bool crcOn, bool freqHopOn,
                         uint8_t hopPeriod, bool iqInverted, uint32_t timeout )
 {
+    uint8_t bw500;
 
     switch( modem )
     {
         case MODEM_FSK:
-            SX126x.ModulationParams.PacketType = PACKET_TYPE_GFSK;
-            SX126x.ModulationParams.Params.Gfsk.BitRate = datarate;
+            SX126x->ModulationParams.PacketType = PACKET_TYPE_GFSK;
+            SX126x->ModulationParams.Params.Gfsk.BitRate = datarate;
 
-            SX126x.ModulationParams.Params.Gfsk.ModulationShaping = MOD_SHAPING_G_BT_1;
-            SX126x.ModulationParams.Params.Gfsk.Bandwidth = RadioGetFskBandwidthRegValue( bandwidth );
-            SX126x.ModulationParams.Params.Gfsk.Fdev = fdev;
+            SX126x->ModulationParams.Params.Gfsk.ModulationShaping = MOD_SHAPING_G_BT_1;
+            SX126x->ModulationParams.Params.Gfsk.Bandwidth = RadioGetFskBandwidthRegValue( bandwidth );
+            SX126x->ModulationParams.Params.Gfsk.Fdev = fdev;
 
-            SX126x.PacketParams.PacketType = PACKET_TYPE_GFSK;
-            SX126x.PacketParams.Params.Gfsk.PreambleLength = ( preambleLen << 3 ); // convert byte into bit
-            SX126x.PacketParams.Params.Gfsk.PreambleMinDetect = RADIO_PREAMBLE_DETECTOR_08_BITS;
-            SX126x.PacketParams.Params.Gfsk.SyncWordLength = 3 << 3 ; // convert byte into bit
-            SX126x.PacketParams.Params.Gfsk.AddrComp = RADIO_ADDRESSCOMP_FILT_OFF;
-            SX126x.PacketParams.Params.Gfsk.HeaderType = ( fixLen == true ) ? RADIO_PACKET_FIXED_LENGTH : RADIO_PACKET_VARIABLE_LENGTH;
+            SX126x->PacketParams.PacketType = PACKET_TYPE_GFSK;
+            SX126x->PacketParams.Params.Gfsk.PreambleLength = ( preambleLen << 3 ); // convert byte into bit
+            SX126x->PacketParams.Params.Gfsk.PreambleMinDetect = RADIO_PREAMBLE_DETECTOR_08_BITS;
+            SX126x->PacketParams.Params.Gfsk.SyncWordLength = 3 << 3 ; // convert byte into bit
+            SX126x->PacketParams.Params.Gfsk.AddrComp = RADIO_ADDRESSCOMP_FILT_OFF;
+            SX126x->PacketParams.Params.Gfsk.HeaderType = ( fixLen == true ) ? RADIO_PACKET_FIXED_LENGTH : RADIO_PACKET_VARIABLE_LENGTH;
 
             if( crcOn == true )
             {
-                SX126x.PacketParams.Params.Gfsk.CrcLength = RADIO_CRC_2_BYTES_CCIT;
+                SX126x->PacketParams.Params.Gfsk.CrcLength = RADIO_CRC_2_BYTES_CCIT;
             }
             else
             {
-                SX126x.PacketParams.Params.Gfsk.CrcLength = RADIO_CRC_OFF;
+                SX126x->PacketParams.Params.Gfsk.CrcLength = RADIO_CRC_OFF;
             }
-            SX126x.PacketParams.Params.Gfsk.DcFree = RADIO_DC_FREEWHITENING;
+            SX126x->PacketParams.Params.Gfsk.DcFree = RADIO_DC_FREEWHITENING;
 
-            RadioStandby( );
-            RadioSetModem( ( SX126x.ModulationParams.PacketType == PACKET_TYPE_GFSK ) ? MODEM_FSK : MODEM_LORA );
-            SX126xSetModulationParams( &SX126x.ModulationParams );
-            SX126xSetPacketParams( &SX126x.PacketParams );
+            RadioConfigPrepare( ( SX126x->ModulationParams.PacketType == PACKET_TYPE_GFSK ) ? MODEM_FSK : MODEM_LORA );
+            SX126xSetModulationParams( &SX126x->ModulationParams );
+            SX126xSetPacketParams( &SX126x->PacketParams );
             SX126xSetSyncWord( ( uint8_t[] ){ 0xC1, 0x94, 0xC1, 0x00, 0x00, 0x00, 0x00, 0x00 } );
             SX126xSetWhiteningSeed( 0x01FF );
             break;
 
         case MODEM_LORA:
-            SX126x.ModulationParams.PacketType = PACKET_TYPE_LORA;
-            SX126x.ModulationParams.Params.LoRa.SpreadingFactor = ( RadioLoRaSpreadingFactors_t ) datarate;
-            SX126x.ModulationParams.Params.LoRa.Bandwidth =  Bandwidths[bandwidth];
-            SX126x.ModulationParams.Params.LoRa.CodingRate= ( RadioLoRaCodingRates_t )coderate;
+            SX126x->ModulationParams.PacketType = PACKET_TYPE_LORA;
+            SX126x->ModulationParams.Params.LoRa.SpreadingFactor = ( RadioLoRaSpreadingFactors_t ) datarate;
+            SX126x->ModulationParams.Params.LoRa.Bandwidth =  Bandwidths[bandwidth];
+            SX126x->ModulationParams.Params.LoRa.CodingRate= ( RadioLoRaCodingRates_t )coderate;
 
             if( ( ( bandwidth == 0 ) && ( ( datarate == 11 ) || ( datarate == 12 ) ) ) ||
             ( ( bandwidth == 1 ) && ( datarate == 12 ) ) )
             {
-                SX126x.ModulationParams.Params.LoRa.LowDatarateOptimize = 0x01;
+                SX126x->ModulationParams.Params.LoRa.LowDatarateOptimize = 0x01;
             }
             else
             {
-                SX126x.ModulationParams.Params.LoRa.LowDatarateOptimize = 0x00;
+                SX126x->ModulationParams.Params.LoRa.LowDatarateOptimize = 0x00;
             }
 
-            SX126x.PacketParams.PacketType = PACKET_TYPE_LORA;
+            SX126x->PacketParams.PacketType = PACKET_TYPE_LORA;
 
-            if( ( SX126x.ModulationParams.Params.LoRa.SpreadingFactor == LORA_SF5 ) ||
-                ( SX126x.ModulationParams.Params.LoRa.SpreadingFactor == LORA_SF6 ) )
+            if( ( SX126x->ModulationParams.Params.LoRa.SpreadingFactor == LORA_SF5 ) ||
+                ( SX126x->ModulationParams.Params.LoRa.SpreadingFactor == LORA_SF6 ) )
             {
                 if( preambleLen < 12 )
                 {
-                    SX126x.PacketParams.Params.LoRa.PreambleLength = 12;
+                    SX126x->PacketParams.Params.LoRa.PreambleLength = 12;
                 }
                 else
                 {
-                    SX126x.PacketParams.Params.LoRa.PreambleLength = preambleLen;
+                    SX126x->PacketParams.Params.LoRa.PreambleLength = preambleLen;
                 }
             }
             else
             {
-                SX126x.PacketParams.Params.LoRa.PreambleLength = preambleLen;
+                SX126x->PacketParams.Params.LoRa.PreambleLength = preambleLen;
             }
 
-            SX126x.PacketParams.Params.LoRa.HeaderType = ( RadioLoRaPacketLengthsMode_t )fixLen;
-            SX126x.PacketParams.Params.LoRa.PayloadLength = MaxPayloadLength;
-            SX126x.PacketParams.Params.LoRa.CrcMode = ( RadioLoRaCrcModes_t )crcOn;
-            SX126x.PacketParams.Params.LoRa.InvertIQ = ( RadioLoRaIQModes_t )iqInverted;
+            SX126x->PacketParams.Params.LoRa.HeaderType = ( RadioLoRaPacketLengthsMode_t )fixLen;
+            SX126x->PacketParams.Params.LoRa.PayloadLength = SX126x->MaxPayloadLength;
+            SX126x->PacketParams.Params.LoRa.CrcMode = ( RadioLoRaCrcModes_t )crcOn;
+            SX126x->PacketParams.Params.LoRa.InvertIQ = ( RadioLoRaIQModes_t )iqInverted;
 
-            RadioStandby( );
-            RadioSetModem( ( SX126x.ModulationParams.PacketType == PACKET_TYPE_GFSK ) ? MODEM_FSK : MODEM_LORA );
-            SX126xSetModulationParams( &SX126x.ModulationParams );
-            SX126xSetPacketParams( &SX126x.PacketParams );
+            RadioConfigPrepare( ( SX126x->ModulationParams.PacketType == PACKET_TYPE_GFSK ) ? MODEM_FSK : MODEM_LORA );
+            SX126xSetModulationParams( &SX126x->ModulationParams );
+            SX126xSetPacketParams( &SX126x->PacketParams );
             break;
     }
 
     // WORKAROUND - Modulation Quality with 500 kHz LoRa Bandwidth, see DS_SX1261-2_V1.2 datasheet chapter 15.1
-    if( ( modem == MODEM_LORA ) && ( SX126x.ModulationParams.Params.LoRa.Bandwidth == LORA_BW_500 ) )
+    bw500 = ( modem == MODEM_LORA ) && ( SX126x->ModulationParams.Params.LoRa.Bandwidth == LORA_BW_500 );
+    if( SX126xConfigChanged( SX126X_CONFIG_TX_MODULATION, &bw500, 1 ) == false )
+    {
+        // RegTxModulation already holds it
+    }
+    else if( bw500 != 0 )
     {
         // RegTxModulation = @address 0x0889
         SX126xWriteRegister( 0x0889, SX126xReadRegister( 0x0889 ) & ~( 1 << 2 ) );
@@ -957,7 +969,7 @@ void RadioSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
     // WORKAROUND END
 
     SX126xSetRfTxPower( power );
-    TxTimeout = timeout;
+    SX126x->TxTimeout = timeout;
 }
 
 bool RadioCheckRfFrequency( uint32_t frequency )
@@ -965,163 +977,239 @@ bool RadioCheckRfFrequency( uint32_t frequency )
     return true;
 }
 
-static uint32_t RadioGetLoRaBandwidthInHz( RadioLoRaBandwidths_t bw )
+uint32_t RadioTimeOnAir( RadioModems_t modem, uint32_t bandwidth,
+                              uint32_t datarate, uint8_t coderate,
+                              uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
+                              bool crcOn )
 {
-    uint32_t bandwidthInHz = 0;
+    LoRaRadioToa_t toa;
 
-    switch( bw )
+    switch( modem )
     {
-    case LORA_BW_007:
-        bandwidthInHz = 7812UL;
-        break;
-    case LORA_BW_010:
-        bandwidthInHz = 10417UL;
-        break;
-    case LORA_BW_015:
-        bandwidthInHz = 15625UL;
-        break;
-    case LORA_BW_020:
-        bandwidthInHz = 20833UL;
-        break;
-    case LORA_BW_031:
-        bandwidthInHz = 31250UL;
-        break;
-    case LORA_BW_041:
-        bandwidthInHz = 41667UL;
-        break;
-    case LORA_BW_062:
-        bandwidthInHz = 62500UL;
-        break;
-    case LORA_BW_125:
-        bandwidthInHz = 125000UL;
-        break;
-    case LORA_BW_250:
-        bandwidthInHz = 250000UL;
+    case MODEM_FSK:
+        if( lora_radio_toa_fsk( &toa, datarate, preambleLen, fixLen, crcOn ) == true )
+        {
+            return lora_radio_toa_ms( &toa, payloadLen );
+        }
         break;
-    case LORA_BW_500:
-        bandwidthInHz = 500000UL;
+    case MODEM_LORA:
+        if( lora_radio_toa_lora( &toa, LORA_RADIO_TOA_SX126X, bandwidth, datarate, coderate,
+                                 preambleLen, fixLen, crcOn ) == true )
+        {
+            return lora_radio_toa_ms( &toa, payloadLen );
+        }
         break;
     }
-
-    return bandwidthInHz;
+    return 0;
 }
 
-static uint32_t RadioGetGfskTimeOnAirNumerator( uint32_t datarate, uint8_t coderate,
-                              uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
-                              bool crcOn )
-{
-    const RadioAddressComp_t addrComp = RADIO_ADDRESSCOMP_FILT_OFF;
-    const uint8_t syncWordLength = 3;
-
-    return ( preambleLen << 3 ) +
-           ( ( fixLen == false ) ? 8 : 0 ) +
-             ( syncWordLength << 3 ) +
-             ( ( payloadLen +
-               ( addrComp == RADIO_ADDRESSCOMP_FILT_OFF ? 0 : 1 ) +
-               ( ( crcOn == true ) ? 2 : 0 ) 
-               ) << 3 
-             );
-}
-
-static uint32_t RadioGetLoRaTimeOnAirNumerator( uint32_t bandwidth,
-                              uint32_t datarate, uint8_t coderate,
-                              uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
-                              bool crcOn )
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+/*!
+ * \brief Time on air [us] of a \a size bytes frame with the modulation and
+ *        packet parameters in use, 0 if they are not a valid configuration
+ */
+static uint32_t RadioFrameTimeOnAirUs( uint8_t size )
 {
-    int32_t crDenom           = coderate + 4;
-    bool    lowDatareOptimize = false;
+    LoRaRadioToa_t toa;
+    uint8_t bandwidth = 0;
+    bool ready;
 
-    // Ensure that the preamble length is at least 12 symbols when using SF5 or
-    // SF6
-    if( ( datarate == 5 ) || ( datarate == 6 ) )
+    if( SX126x->PacketType == PACKET_TYPE_LORA )
     {
-        if( preambleLen < 12 )
+        while( ( bandwidth < ( sizeof( Bandwidths ) / sizeof( Bandwidths[0] ) ) ) &&
+               ( Bandwidths[bandwidth] != SX126x->ModulationParams.Params.LoRa.Bandwidth ) )
+        {
+            bandwidth++;
+        }
+        if( bandwidth == ( sizeof( Bandwidths ) / sizeof( Bandwidths[0] ) ) )
         {
-            preambleLen = 12;
+            // ERROR: Value not found, no air time rather than the one of 500 kHz
+            return 0;
         }
+        // false while the modem is not configured
+        ready = lora_radio_toa_lora( &toa, LORA_RADIO_TOA_SX126X, bandwidth, SX126x->ModulationParams.Params.LoRa.SpreadingFactor,
+                                     SX126x->ModulationParams.Params.LoRa.CodingRate,
+                                     SX126x->PacketParams.Params.LoRa.PreambleLength,
+                                     SX126x->PacketParams.Params.LoRa.HeaderType == LORA_PACKET_FIXED_LENGTH,
+                                     SX126x->PacketParams.Params.LoRa.CrcMode == LORA_CRC_ON );
+    }
+    else
+    {
+        ready = lora_radio_toa_fsk( &toa, SX126x->ModulationParams.Params.Gfsk.BitRate,
+                                    SX126x->PacketParams.Params.Gfsk.PreambleLength >> 3,
+                                    SX126x->PacketParams.Params.Gfsk.HeaderType == RADIO_PACKET_FIXED_LENGTH,
+                                    SX126x->PacketParams.Params.Gfsk.CrcLength != RADIO_CRC_OFF );
     }
+    return ( ready == true ) ? lora_radio_toa_us( &toa, size ) : 0;
+}
+
+// every SX126x IRQ comes on DIO1
+#define RadioTimestampCapture( tx, size )           lora_radio_timestamp_capture( tx, 1, RadioFrameTimeOnAirUs( size ) )
+#else
+#define RadioTimestampCapture( tx, size )
+#endif
+
+/*!
+ * CAD tuning per spreading factor, SF5..SF12, at 125 kHz after Semtech
+ * AN1200.48. SF5 / SF6 are not in the note and take the SF7 values. At
+ * 500 kHz the symbols are 4 times shorter, twice as many are used.
+ */
+static const struct
+{
+    RadioLoRaCadSymbols_t Symbols;
+    uint8_t DetPeak;
+}RadioCadTuning[] =
+{
+    { LORA_CAD_02_SYMBOL, 22 },                     // SF5
+    { LORA_CAD_02_SYMBOL, 22 },                     // SF6
+    { LORA_CAD_02_SYMBOL, 22 },                     // SF7
+    { LORA_CAD_02_SYMBOL, 22 },                     // SF8
+    { LORA_CAD_04_SYMBOL, 23 },                     // SF9
+    { LORA_CAD_04_SYMBOL, 24 },                     // SF10
+    { LORA_CAD_04_SYMBOL, 25 },                     // SF11
+    { LORA_CAD_04_SYMBOL, 28 },                     // SF12
+};
 
-    if( ( ( bandwidth == 0 ) && ( ( datarate == 11 ) || ( datarate == 12 ) ) ) ||
-        ( ( bandwidth == 1 ) && ( datarate == 12 ) ) )
+#define RADIO_CAD_DET_MIN                           10
+
+/*!
+ * \brief Sets the CAD parameters for the spreading factor and bandwidth in use
+ */
+static void RadioSetCadParams( RadioCadExitModes_t exitMode, uint32_t timeout )
+{
+    uint8_t sf = SX126x->ModulationParams.Params.LoRa.SpreadingFactor;
+    RadioLoRaCadSymbols_t symbols;
+
+    sf = ( sf < LORA_SF5 ) ? LORA_SF5 : ( sf > LORA_SF12 ) ? LORA_SF12 : sf;
+    symbols = RadioCadTuning[sf - LORA_SF5].Symbols;
+    if( ( SX126x->ModulationParams.Params.LoRa.Bandwidth == LORA_BW_500 ) && ( symbols < LORA_CAD_16_SYMBOL ) )
     {
-        lowDatareOptimize = true;
+        symbols = ( RadioLoRaCadSymbols_t )( symbols + 1 );
     }
+    SX126xSetCadParams( symbols, RadioCadTuning[sf - LORA_SF5].DetPeak, RADIO_CAD_DET_MIN, exitMode, timeout );
+}
 
-    int32_t ceilDenominator;
-    int32_t ceilNumerator = ( payloadLen << 3 ) +
-                            ( crcOn ? 16 : 0 ) -
-                            ( 4 * datarate ) +
-                            ( fixLen ? 0 : 20 );
+#ifdef LORA_RADIO_DRIVER_USING_SX126X_CAD_RX
+/*!
+ * \brief Another operation replaces the CAD_RX in progress, if any
+ */
+static void RadioCadRxCancel( void )
+{
+    SX126x->CadRx.Armed = false;
+    SX126x->CadRx.Receiving = false;
+}
+
+/*!
+ * \brief CadDone of a CAD_RX. On a detection the chip is in RX already, the
+ *        RX flags read with CadDone and the next ones belong to that window.
+ *
+ * \retval true when the chip entered RX, \a opMode is then MODE_RX
+ */
+static bool RadioIrqCadRx( uint16_t irqRegs, RadioOperatingModes_t *opMode )
+{
+    SX126xCadRx_t *cad = &SX126x->CadRx;
 
-    if( datarate <= 6 )
+    if( cad->Armed == false )
     {
-        ceilDenominator = 4 * datarate;
+        return false;
     }
-    else
+    cad->Armed = false;
+    if( ( irqRegs & IRQ_CAD_ACTIVITY_DETECTED ) != IRQ_CAD_ACTIVITY_DETECTED )
     {
-        ceilNumerator += 8;
+        return false;
+    }
+    cad->Stats.Detections++;
+    cad->Receiving = true;
+    cad->DetectedUs = LORA_RADIO_TIMESTAMP_US( );
 
-        if( lowDatareOptimize == true )
-        {
-            ceilDenominator = 4 * ( datarate - 2 );
-        }
-        else
-        {
-            ceilDenominator = 4 * datarate;
-        }
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+    if( SX126xGetOperatingMode( ) == *opMode )
+    {
+        SX126xSetOperatingMode( MODE_RX );
     }
+    LORA_RADIO_CRITICAL_SECTION_END( );
+    *opMode = MODE_RX;
 
-    if( ceilNumerator < 0 )
+    if( cad->RxTimeout != 0 )
     {
-        ceilNumerator = 0;
+        TimerSetValue( &SX126x->RxTimeoutTimer, cad->RxTimeout );
+        TimerStart( &SX126x->RxTimeoutTimer );
     }
+    return true;
+}
 
-    // Perform integral ceil()
-    int32_t intermediate =
-        ( ( ceilNumerator + ceilDenominator - 1 ) / ceilDenominator ) * crDenom + preambleLen + 12;
+/*!
+ * \brief End of the RX window opened by a detection, \a frame for RxDone
+ */
+static void RadioCadRxEnd( bool frame )
+{
+    SX126xCadRx_t *cad = &SX126x->CadRx;
+    uint32_t elapsed;
 
-    if( datarate <= 6 )
+    if( cad->Receiving == false )
     {
-        intermediate += 2;
+        return;
     }
-
-    return ( uint32_t )( ( 4 * intermediate + 1 ) * ( 1 << ( datarate - 2 ) ) );
+    cad->Receiving = false;
+    if( frame == false )
+    {
+        cad->Stats.Misses++;
+        return;
+    }
+    elapsed = LORA_RADIO_TIMESTAMP_US( ) - cad->DetectedUs;
+    cad->Stats.Frames++;
+    cad->Stats.LastUs = elapsed;
+    if( elapsed > cad->Stats.MaxUs )
+    {
+        cad->Stats.MaxUs = elapsed;
+    }
+    cad->Stats.TotalUs += elapsed;
 }
 
-uint32_t RadioTimeOnAir( RadioModems_t modem, uint32_t bandwidth,
-                              uint32_t datarate, uint8_t coderate,
-                              uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
-                              bool crcOn )
+void SX126xStartCadRx( uint32_t timeout )
 {
-    uint32_t numerator = 0;
-    uint32_t denominator = 1;
+    uint32_t rxTimeout;
 
-    switch( modem )
+    lora_radio_rx_policy_cancel( );
+    SX126xSetDioIrqParams( IRQ_RADIO_ALL, IRQ_RADIO_ALL, IRQ_RADIO_NONE, IRQ_RADIO_NONE );
+
+    // the window the chip opens on a detection is the one of RadioRx
+    if( LORA_RADIO_RX_CONTINUOUS( SX126x->RxContinuous ) == true )
     {
-    case MODEM_FSK:
-        {
-            numerator   = 1000U * RadioGetGfskTimeOnAirNumerator( datarate, coderate,
-                                                                  preambleLen, fixLen,
-                                                                  payloadLen, crcOn );
-            denominator = datarate;
-        }
-        break;
-    case MODEM_LORA:
-        {
-            numerator   = 1000U * RadioGetLoRaTimeOnAirNumerator( bandwidth, datarate,
-                                                                  coderate, preambleLen,
-                                                                  fixLen, payloadLen, crcOn );
-            denominator = RadioGetLoRaBandwidthInHz( Bandwidths[bandwidth] );
-        }
-        break;
+        rxTimeout = 0xFFFFFF;
     }
-    // Perform integral ceil()
-    return ( numerator + denominator - 1 ) / denominator;
+    else
+    {
+        rxTimeout = SX126x->RxTimeout << 6;
+    }
+    RadioSetCadParams( LORA_CAD_RX, rxTimeout );
+
+    SX126x->CadRx.Armed = true;
+    SX126x->CadRx.Receiving = false;
+    SX126x->CadRx.RxTimeout = timeout;
+    SX126x->CadRx.Stats.Cads++;
+    SX126xSetCad( );
 }
 
+void SX126xGetCadRxStats( SX126xCadRxStats_t *stats )
+{
+    *stats = SX126x->CadRx.Stats;
+}
+
+void SX126xResetCadRxStats( void )
+{
+    rt_memset( &SX126x->CadRx.Stats, 0, sizeof( SX126x->CadRx.Stats ) );
+}
+#else
+#define RadioCadRxCancel( )
+#define RadioIrqCadRx( irqRegs, opMode )            ( false )
+#define RadioCadRxEnd( frame )
+#endif
 
 void RadioSend( uint8_t *buffer, uint8_t size )
 {
+    RadioCadRxCancel( );
+    SX126xBatchBegin( &RadioBatch );
     SX126xSetDioIrqParams( IRQ_TX_DONE | IRQ_RX_TX_TIMEOUT,
                            IRQ_TX_DONE | IRQ_RX_TX_TIMEOUT,
                            IRQ_RADIO_NONE,
@@ -1129,24 +1217,27 @@ void RadioSend( uint8_t *buffer, uint8_t size )
 
     if( SX126xGetPacketType( ) == PACKET_TYPE_LORA )
     {
-        SX126x.PacketParams.Params.LoRa.PayloadLength = size;
+        SX126x->PacketParams.Params.LoRa.PayloadLength = size;
     }
     else
     {
-        SX126x.PacketParams.Params.Gfsk.PayloadLength = size;
+        SX126x->PacketParams.Params.Gfsk.PayloadLength = size;
     }
-    SX126xSetPacketParams( &SX126x.PacketParams );
+    SX126xSetPacketParams( &SX126x->PacketParams );
 
     SX126xSendPayload( buffer, size, 0 );
+    SX126xBatchEnd( &RadioBatch );
     
-    TimerSetValue( &TxTimeoutTimer, TxTimeout );
-    TimerStart( &TxTimeoutTimer );
+    TimerSetValue( &SX126x->TxTimeoutTimer, SX126x->TxTimeout );
+    TimerStart( &SX126x->TxTimeoutTimer );
 }
 
 void RadioSleep( void )
 {
     SleepParams_t params = { 0 };
 
+    RadioCadRxCancel( );
+
     params.Fields.WarmStart = 1;
     SX126xSetSleep( params );
 
@@ -1155,11 +1246,15 @@ void RadioSleep( void )
 
 void RadioStandby( void )
 {
+    RadioCadRxCancel( );
     SX126xSetStandby( STDBY_RC );
+    SX126xImageCalibrationIdle( );
 }
 
 void RadioRx( uint32_t timeout )
 {
+    RadioCadRxCancel( );
+    SX126xBatchBegin( &RadioBatch );
     SX126xSetDioIrqParams( IRQ_RADIO_ALL, //IRQ_RX_DONE | IRQ_RX_TX_TIMEOUT,
                            IRQ_RADIO_ALL, //IRQ_RX_DONE | IRQ_RX_TX_TIMEOUT,
                            IRQ_RADIO_NONE,
@@ -1167,22 +1262,25 @@ void RadioRx( uint32_t timeout )
 
     if( timeout != 0 )
     {
-        TimerSetValue( &RxTimeoutTimer, timeout );
-        TimerStart( &RxTimeoutTimer );
+        TimerSetValue( &SX126x->RxTimeoutTimer, timeout );
+        TimerStart( &SX126x->RxTimeoutTimer );
     }
 
-    if( RxContinuous == true )
+    if( LORA_RADIO_RX_CONTINUOUS( SX126x->RxContinuous ) == true )
     {
         SX126xSetRx( 0xFFFFFF ); // Rx Continuous
     }
     else
     {
-        SX126xSetRx( RxTimeout << 6 );
+        SX126xSetRx( SX126x->RxTimeout << 6 );
     }
+    SX126xBatchEnd( &RadioBatch );
 }
 
 void RadioRxBoosted( uint32_t timeout )
 {
+    RadioCadRxCancel( );
+    SX126xBatchBegin( &RadioBatch );
     SX126xSetDioIrqParams( IRQ_RADIO_ALL, //IRQ_RX_DONE | IRQ_RX_TX_TIMEOUT,
                            IRQ_RADIO_ALL, //IRQ_RX_DONE | IRQ_RX_TX_TIMEOUT,
                            IRQ_RADIO_NONE,
@@ -1190,28 +1288,32 @@ void RadioRxBoosted( uint32_t timeout )
 
     if( timeout != 0 )
     {
-        TimerSetValue( &RxTimeoutTimer, timeout );
-        TimerStart( &RxTimeoutTimer );
+        TimerSetValue( &SX126x->RxTimeoutTimer, timeout );
+        TimerStart( &SX126x->RxTimeoutTimer );
     }
 
-    if( RxContinuous == true )
+    if( LORA_RADIO_RX_CONTINUOUS( SX126x->RxContinuous ) == true )
     {
         SX126xSetRxBoosted( 0xFFFFFF ); // Rx Continuous
     }
     else
     {
-        SX126xSetRxBoosted( RxTimeout << 6 );
+        SX126xSetRxBoosted( SX126x->RxTimeout << 6 );
     }
+    SX126xBatchEnd( &RadioBatch );
 }
 
 void RadioSetRxDutyCycle( uint32_t rxTime, uint32_t sleepTime )
 {
+    RadioCadRxCancel( );
     SX126xSetRxDutyCycle( rxTime, sleepTime );
 }
 
 void RadioStartCad( void )
 {
+    RadioCadRxCancel( );
     SX126xSetDioIrqParams( IRQ_CAD_DONE | IRQ_CAD_ACTIVITY_DETECTED, IRQ_CAD_DONE | IRQ_CAD_ACTIVITY_DETECTED, IRQ_RADIO_NONE, IRQ_RADIO_NONE );
+    RadioSetCadParams( LORA_CAD_ONLY, 0 );
     SX126xSetCad( );
 }
 
@@ -1222,8 +1324,8 @@ void RadioSetTxContinuousWave( uint32_t freq, int8_t power, uint16_t time )
     SX126xSetRfTxPower( power );
     SX126xSetTxContinuousWave( );
 
-    TimerSetValue( &TxTimeoutTimer, timeout );
-    TimerStart( &TxTimeoutTimer );
+    TimerSetValue( &SX126x->TxTimeoutTimer, timeout );
+    TimerStart( &SX126x->TxTimeoutTimer );
 }
 
 int16_t RadioRssi( RadioModems_t modem )
@@ -1254,22 +1356,22 @@ void RadioSetMaxPayloadLength( RadioModems_t modem, uint8_t max )
 {
     if( modem == MODEM_LORA )
     {
-        SX126x.PacketParams.Params.LoRa.PayloadLength = MaxPayloadLength = max;
-        SX126xSetPacketParams( &SX126x.PacketParams );
+        SX126x->PacketParams.Params.LoRa.PayloadLength = SX126x->MaxPayloadLength = max;
+        SX126xSetPacketParams( &SX126x->PacketParams );
     }
     else
     {
-        if( SX126x.PacketParams.Params.Gfsk.HeaderType == RADIO_PACKET_VARIABLE_LENGTH )
+        if( SX126x->PacketParams.Params.Gfsk.HeaderType == RADIO_PACKET_VARIABLE_LENGTH )
         {
-            SX126x.PacketParams.Params.Gfsk.PayloadLength = MaxPayloadLength = max;
-            SX126xSetPacketParams( &SX126x.PacketParams );
+            SX126x->PacketParams.Params.Gfsk.PayloadLength = SX126x->MaxPayloadLength = max;
+            SX126xSetPacketParams( &SX126x->PacketParams );
         }
     }
 }
 
 void RadioSetPublicNetwork( bool enable )
 {
-    RadioPublicNetwork.Current = RadioPublicNetwork.Previous = enable;
+    SX126x->PublicNetwork.Current = SX126x->PublicNetwork.Previous = enable;
 
     RadioSetModem( MODEM_LORA );
     if( enable == true )
@@ -1291,59 +1393,138 @@ uint32_t RadioGetWakeupTime( void )
     return SX126xGetBoardTcxoWakeupTime( ) + RADIO_WAKEUP_TIME;
 }
 
-void RadioOnTxTimeoutIrq( void /** context*/ )
+void RadioOnTxTimeoutIrq( void* context )
 {
-    if( ( RadioEvents != NULL ) && ( RadioEvents->TxTimeout != NULL ) )
+    LoRaRadio_t *previous = lora_radio_lock( context );
+
+    if( ( lora_radio_tx_queue_complete( LORA_RADIO_TX_TIMEOUT ) == false ) &&
+        ( SX126x->RadioEvents != NULL ) && ( SX126x->RadioEvents->TxTimeout != NULL ) )
     {
-        RadioEvents->TxTimeout( );
+        SX126x->RadioEvents->TxTimeout( );
     }
     LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "PHY TX Timeout\r");
+    lora_radio_unlock( previous );
 }
 
-void RadioOnRxTimeoutIrq( void /** context*/ )
+void RadioOnRxTimeoutIrq( void* context )
 {
-    if( ( RadioEvents != NULL ) && ( RadioEvents->RxTimeout != NULL ) )
+    LoRaRadio_t *previous = lora_radio_lock( context );
+
+    RadioCadRxEnd( false );
+    if( LORA_RADIO_RX_CONTINUOUS( SX126x->RxContinuous ) == false )
+    {
+        ( void )lora_radio_rx_policy_end( );
+    }
+    if( ( SX126x->RadioEvents != NULL ) && ( SX126x->RadioEvents->RxTimeout != NULL ) )
     {
-        RadioEvents->RxTimeout( );
+        SX126x->RadioEvents->RxTimeout( );
     }
     LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "PHY RX Timeout\r");
+    lora_radio_unlock( previous );
 }
 
 void RadioOnDioIrq( void* context )
 {
     #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-        rt_event_send(&lora_radio_event, EV_LORA_RADIO_IRQ_FIRED);      
+        // context is the radio instance the DIO1 pin belongs to
+        lora_radio_notify( context, EV_LORA_RADIO_IRQ1_FIRED );
     #else
-        IrqFired = true;
+        SX126x->IrqFired = true;
     #endif
 }
 
-void RadioIrqProcess( void )
+/*!
+ * \brief Reads the driver state the IRQ handling depends on
+ */
+static void RadioIrqGetState( RadioOperatingModes_t *opMode, bool *rxContinuous )
 {
-#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
     LORA_RADIO_CRITICAL_SECTION_BEGIN( );
-#else
-    if( IrqFired == true )
+    *opMode = SX126xGetOperatingMode( );
+    *rxContinuous = LORA_RADIO_RX_CONTINUOUS( SX126x->RxContinuous );
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+/*!
+ * \brief Updates the operating mode to MODE_STDBY_RC once the chip left \a opMode
+ *        by itself, unless the application already moved the radio elsewhere
+ */
+static void RadioIrqSetStdbyRc( RadioOperatingModes_t opMode )
+{
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+    if( SX126xGetOperatingMode( ) == opMode )
+    {
+        //!< Update operating mode state to a value lower than \ref MODE_STDBY_XOSC
+        SX126xSetOperatingMode( MODE_STDBY_RC );
+    }
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+/*!
+ * \brief A single window ended, the RX policy may start the next one at once.
+ *        The other RX end flags of \a irqRegs then belong to the finished window.
+ */
+static void RadioIrqRxEnd( uint16_t *irqRegs )
+{
+    if( lora_radio_rx_policy_end( ) == true )
+    {
+        *irqRegs &= ~( IRQ_RX_TX_TIMEOUT | IRQ_HEADER_ERROR );
+    }
+}
+
+/*!
+ * Interrupts are only disabled while the driver state is read or updated,
+ * the SPI accesses and the user callbacks run with interrupts enabled. On
+ * RT-Thread the PHY thread calls it with the driver lock held, see
+ * lora_radio_lock(), which keeps the application calls off the SPI bus.
+ */
+void RadioIrqProcess( void )
+{
+#ifndef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+    if( SX126x->IrqFired == true )
 #endif    
     {
 #ifndef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
         LORA_RADIO_CRITICAL_SECTION_BEGIN( );
         // Clear IRQ flag
-        IrqFired = false;
+        SX126x->IrqFired = false;
         LORA_RADIO_CRITICAL_SECTION_END( );
 #endif
 
+        RadioOperatingModes_t opMode;
+        bool rxContinuous;
+        bool cadRx = false;
         uint16_t irqRegs = SX126xGetIrqStatus( );
         SX126xClearIrqStatus( IRQ_RADIO_ALL );
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+        if( ( irqRegs & ( IRQ_RX_DONE | IRQ_CRC_ERROR | IRQ_HEADER_ERROR | IRQ_RX_TX_TIMEOUT ) ) != 0 )
+        {
+            SX126x->RxInFlight = false;
+        }
+        else if( ( irqRegs & ( IRQ_PREAMBLE_DETECTED | IRQ_SYNCWORD_VALID | IRQ_HEADER_VALID ) ) != 0 )
+        {
+            // the RSSI is the one of the frame until it ends
+            SX126x->RxInFlight = true;
+        }
+#endif
+
+        RadioIrqGetState( &opMode, &rxContinuous );
+        if( ( irqRegs & IRQ_CAD_DONE ) == IRQ_CAD_DONE )
+        {
+            // before the RX flags, a CAD_RX frame may end in the same pass
+            cadRx = RadioIrqCadRx( irqRegs, &opMode );
+        }
 
         if( ( irqRegs & IRQ_TX_DONE ) == IRQ_TX_DONE )
         {
-            TimerStop( &TxTimeoutTimer );
-            //!< Update operating mode state to a value lower than \ref MODE_STDBY_XOSC
-            SX126xSetOperatingMode( MODE_STDBY_RC );
-            if( ( RadioEvents != NULL ) && ( RadioEvents->TxDone != NULL ) )
+            TimerStop( &SX126x->TxTimeoutTimer );
+            RadioIrqSetStdbyRc( opMode );
+            RadioTimestampCapture( true, ( SX126x->PacketType == PACKET_TYPE_LORA ) ? SX126x->PacketParams.Params.LoRa.PayloadLength :
+                                                                                     SX126x->PacketParams.Params.Gfsk.PayloadLength );
+            // a queued frame starts the next one right here
+            if( ( lora_radio_tx_queue_complete( LORA_RADIO_TX_DONE ) == false ) &&
+                ( SX126x->RadioEvents != NULL ) && ( SX126x->RadioEvents->TxDone != NULL ) )
             {
-                RadioEvents->TxDone( );
+                SX126x->RadioEvents->TxDone( );
             }
             LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "PHY TX Done\r");
         }
@@ -1352,28 +1533,33 @@ void RadioIrqProcess( void )
         {
             if( ( irqRegs & IRQ_CRC_ERROR ) == IRQ_CRC_ERROR )
             {    
-                if( RxContinuous == false )
+                RadioCadRxEnd( false );
+                if( rxContinuous == false )
                 {
-                    //!< Update operating mode state to a value lower than \ref MODE_STDBY_XOSC
-                    SX126xSetOperatingMode( MODE_STDBY_RC );
+                    RadioIrqSetStdbyRc( opMode );
+                    RadioIrqRxEnd( &irqRegs );
                 }
                 
-                if( ( RadioEvents != NULL ) && ( RadioEvents->RxError ) )
+                if( ( SX126x->RadioEvents != NULL ) && ( SX126x->RadioEvents->RxError ) )
                 {
-                        RadioEvents->RxError( );
+                        SX126x->RadioEvents->RxError( );
                 }
                 LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "PHY CRC Error\r");
             }
             else
             {
                 uint8_t size;
+                uint8_t *payload = SX126x->RadioRxPayload;
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+                LoRaRadioRxPacket_t *packet;
+#endif
 
-                TimerStop( &RxTimeoutTimer );
+                TimerStop( &SX126x->RxTimeoutTimer );
+                RadioCadRxEnd( true );
                     
-                if( RxContinuous == false )
+                if( rxContinuous == false )
                 {
-                     //!< Update operating mode state to a value lower than \ref MODE_STDBY_XOSC
-                     SX126xSetOperatingMode( MODE_STDBY_RC );
+                     RadioIrqSetStdbyRc( opMode );
 
                      // WORKAROUND - Implicit Header Mode Timeout Behavior, see DS_SX1261-2_V1.2 datasheet chapter 15.3
                      // RegRtcControl = @address 0x0902
@@ -1382,11 +1568,44 @@ void RadioIrqProcess( void )
                      SX126xWriteRegister( 0x0944, SX126xReadRegister( 0x0944 ) | ( 1 << 1 ) );
                      // WORKAROUND END
                  } 
-                SX126xGetPayload( RadioRxPayload, &size , 255 );
-                SX126xGetPacketStatus( &RadioPktStatus );
-                if( ( RadioEvents != NULL ) && ( RadioEvents->RxDone != NULL ) )
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+                // read straight into a pool slot, the static buffer only serves when the pool is exhausted
+                packet = lora_radio_rx_pool_alloc( );
+                if( packet != RT_NULL )
+                {
+                    payload = packet->Payload;
+                }
+#endif
+                SX126xGetPayload( payload, &size , 255 );
+                SX126xGetPacketStatus( &SX126x->RadioPktStatus );
+                RadioTimestampCapture( false, size );
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+                if( packet != RT_NULL )
                 {
-                    RadioEvents->RxDone( RadioRxPayload, size, RadioPktStatus.Params.LoRa.RssiPkt, RadioPktStatus.Params.LoRa.SnrPkt );
+                    packet->Size = size;
+                    packet->Rssi = SX126x->RadioPktStatus.Params.LoRa.RssiPkt;
+                    packet->Snr = SX126x->RadioPktStatus.Params.LoRa.SnrPkt;
+                    packet->Frequency = SX126x->Frequency;
+                    if( SX126x->PacketType == PACKET_TYPE_LORA )
+                    {
+                        packet->Modem = MODEM_LORA;
+                        packet->Datarate = SX126x->ModulationParams.Params.LoRa.SpreadingFactor;
+                    }
+                    else
+                    {
+                        packet->Modem = MODEM_FSK;
+                        packet->Datarate = SX126x->ModulationParams.Params.Gfsk.BitRate;
+                    }
+                    lora_radio_rx_pool_commit( packet );
+                }
+#endif
+                if( rxContinuous == false )
+                {
+                    RadioIrqRxEnd( &irqRegs );
+                }
+                if( ( SX126x->RadioEvents != NULL ) && ( SX126x->RadioEvents->RxDone != NULL ) )
+                {
+                    SX126x->RadioEvents->RxDone( payload, size, SX126x->RadioPktStatus.Params.LoRa.RssiPkt, SX126x->RadioPktStatus.Params.LoRa.SnrPkt );
                 }
                 LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "PHY RX Done\r");
             }
@@ -1394,36 +1613,40 @@ void RadioIrqProcess( void )
 
         if( ( irqRegs & IRQ_CAD_DONE ) == IRQ_CAD_DONE )
         {
-            //!< Update operating mode state to a value lower than \ref MODE_STDBY_XOSC
-            SX126xSetOperatingMode( MODE_STDBY_RC );
-            if( ( RadioEvents != NULL ) && ( RadioEvents->CadDone != NULL ) )
+            if( cadRx == false )
+            {
+                RadioIrqSetStdbyRc( opMode );
+            }
+            if( ( lora_radio_lbt_cad_done( ( irqRegs & IRQ_CAD_ACTIVITY_DETECTED ) == IRQ_CAD_ACTIVITY_DETECTED ) == false ) &&
+                ( SX126x->RadioEvents != NULL ) && ( SX126x->RadioEvents->CadDone != NULL ) )
             {
-                RadioEvents->CadDone( ( ( irqRegs & IRQ_CAD_ACTIVITY_DETECTED ) == IRQ_CAD_ACTIVITY_DETECTED ) );
+                SX126x->RadioEvents->CadDone( ( ( irqRegs & IRQ_CAD_ACTIVITY_DETECTED ) == IRQ_CAD_ACTIVITY_DETECTED ) );
             }
             LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "PHY CAD Done\r");
         }
 
         if( ( irqRegs & IRQ_RX_TX_TIMEOUT ) == IRQ_RX_TX_TIMEOUT )
         {
-            if( SX126xGetOperatingMode( ) == MODE_TX )
+            if( opMode == MODE_TX )
             {
-                TimerStop( &TxTimeoutTimer );
-                //!< Update operating mode state to a value lower than \ref MODE_STDBY_XOSC
-                SX126xSetOperatingMode( MODE_STDBY_RC );
-                if( ( RadioEvents != NULL ) && ( RadioEvents->TxTimeout != NULL ) )
+                TimerStop( &SX126x->TxTimeoutTimer );
+                RadioIrqSetStdbyRc( opMode );
+                if( ( lora_radio_tx_queue_complete( LORA_RADIO_TX_TIMEOUT ) == false ) &&
+                    ( SX126x->RadioEvents != NULL ) && ( SX126x->RadioEvents->TxTimeout != NULL ) )
                 {
-                    RadioEvents->TxTimeout( );
+                    SX126x->RadioEvents->TxTimeout( );
                 }
                 LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "PHY TX Timeout\r");
             }
-            else if( SX126xGetOperatingMode( ) == MODE_RX )
+            else if( opMode == MODE_RX )
             {
-                TimerStop( &RxTimeoutTimer );
-                //!< Update operating mode state to a value lower than \ref MODE_STDBY_XOSC
-                SX126xSetOperatingMode( MODE_STDBY_RC );
-                if( ( RadioEvents != NULL ) && ( RadioEvents->RxTimeout != NULL ) )
+                TimerStop( &SX126x->RxTimeoutTimer );
+                RadioCadRxEnd( false );
+                RadioIrqSetStdbyRc( opMode );
+                RadioIrqRxEnd( &irqRegs );
+                if( ( SX126x->RadioEvents != NULL ) && ( SX126x->RadioEvents->RxTimeout != NULL ) )
                 {
-                    RadioEvents->RxTimeout( );
+                    SX126x->RadioEvents->RxTimeout( );
                 }
                 LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "PHY RX Timeout\r");
             }
@@ -1446,22 +1669,22 @@ void RadioIrqProcess( void )
 
         if( ( irqRegs & IRQ_HEADER_ERROR ) == IRQ_HEADER_ERROR )
         {
-            TimerStop( &RxTimeoutTimer );
-            if( RxContinuous == false )
+            TimerStop( &SX126x->RxTimeoutTimer );
+            RadioCadRxEnd( false );
+            if( rxContinuous == false )
             {
-                //!< Update operating mode state to a value lower than \ref MODE_STDBY_XOSC
-                SX126xSetOperatingMode( MODE_STDBY_RC );
+                RadioIrqSetStdbyRc( opMode );
+                RadioIrqRxEnd( &irqRegs );
             }
-            if( ( RadioEvents != NULL ) && ( RadioEvents->RxTimeout != NULL ) )
+            if( ( SX126x->RadioEvents != NULL ) && ( SX126x->RadioEvents->RxTimeout != NULL ) )
             {
-                RadioEvents->RxTimeout( );
+                SX126x->RadioEvents->RxTimeout( );
             }
             LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "PHY HEADER Error\r");
         }
+
+        // the callbacks did not restart the radio, use the idle time
+        SX126xImageCalibrationIdle( );
     }
-    
-#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-    LORA_RADIO_CRITICAL_SECTION_END( );
-#endif
 }
 
@@ -17,13 +17,563 @@
 #define LOG_LEVEL  LOG_LVL_DBG 
 #include "lora-radio-debug.h"
 
+/*!
+ * BUSY polls SX126xWaitOnBusy makes before it blocks on the BUSY falling edge.
+ * The limit adapts between the two bounds: it grows when a blocked wait was
+ * shorter than SX126X_BUSY_BLOCK_COST_US (blocking did not pay off) and
+ * shrinks when it was longer.
+ */
+#ifndef SX126X_BUSY_SPIN_MIN
+#define SX126X_BUSY_SPIN_MIN                        8
+#endif
+#ifndef SX126X_BUSY_SPIN_MAX
+#define SX126X_BUSY_SPIN_MAX                        512
+#endif
+#ifndef SX126X_BUSY_BLOCK_COST_US
+#define SX126X_BUSY_BLOCK_COST_US                   20
+#endif
+
+/*!
+ * Longest BUSY high time [ms] before the chip is reported as hung, well above
+ * a full calibration (3.5 ms) plus the TCXO start-up
+ */
+#ifndef SX126X_BUSY_TIMEOUT
+#define SX126X_BUSY_TIMEOUT                         100
+#endif
+
+static uint32_t BusySpinLimit = SX126X_BUSY_SPIN_MIN;
+static SX126xBusyStats_t BusyStats;
+
+static void SX126xOnBusyIrq( void *args )
+{
+    rt_sem_release( ( rt_sem_t )args );
+}
+
+/*!
+ * \brief Blocks until the BUSY falling edge
+ *
+ * \retval done [true: BUSY low, false: still high after SX126X_BUSY_TIMEOUT]
+ */
+static bool SX126xBlockOnBusy( void )
+{
+    rt_err_t res = RT_EOK;
+
+    if( SX126x->BusyIrqAttached == false )
+    {
+        rt_sem_init( &SX126x->BusySem, "lr-busy", 0, RT_IPC_FLAG_FIFO );
+        rt_pin_attach_irq( LORA_RADIO_BUSY_PIN, PIN_IRQ_MODE_FALLING, SX126xOnBusyIrq, &SX126x->BusySem );
+        SX126x->BusyIrqAttached = true;
+    }
+
+    // drop the edges of earlier waits that completed while spinning
+    while( rt_sem_trytake( &SX126x->BusySem ) == RT_EOK );
+
+    rt_pin_irq_enable( LORA_RADIO_BUSY_PIN, PIN_IRQ_ENABLE );
+    // BUSY may have fallen before the interrupt was enabled
+    if( rt_pin_read( LORA_RADIO_BUSY_PIN ) == PIN_HIGH )
+    {
+        res = rt_sem_take( &SX126x->BusySem, rt_tick_from_millisecond( SX126X_BUSY_TIMEOUT ) );
+    }
+    rt_pin_irq_enable( LORA_RADIO_BUSY_PIN, PIN_IRQ_DISABLE );
+
+    return ( res == RT_EOK ) || ( rt_pin_read( LORA_RADIO_BUSY_PIN ) == PIN_LOW );
+}
+
+void SX126xWaitOnBusy( void )
+{
+    uint32_t start = LORA_RADIO_TIMESTAMP_US( );
+    uint32_t spins = 0;
+    uint32_t elapsed;
+    bool done = true;
+
+    while( ( rt_pin_read( LORA_RADIO_BUSY_PIN ) == PIN_HIGH ) && ( spins < BusySpinLimit ) )
+    {
+        spins++;
+    }
+
+    if( rt_pin_read( LORA_RADIO_BUSY_PIN ) == PIN_HIGH )
+    {
+        if( rt_interrupt_get_nest( ) != 0 )
+        {
+            // no blocking in interrupt context, keep polling up to the timeout
+            rt_tick_t deadline = rt_tick_get( ) + rt_tick_from_millisecond( SX126X_BUSY_TIMEOUT );
+
+            while( ( rt_pin_read( LORA_RADIO_BUSY_PIN ) == PIN_HIGH ) && ( ( rt_int32_t )( rt_tick_get( ) - deadline ) < 0 ) );
+            done = ( rt_pin_read( LORA_RADIO_BUSY_PIN ) == PIN_LOW );
+        }
+        else
+        {
+            BusyStats.Blocked++;
+            done = SX126xBlockOnBusy( );
+
+            if( ( LORA_RADIO_TIMESTAMP_US( ) - start ) < SX126X_BUSY_BLOCK_COST_US )
+            {
+                BusySpinLimit = ( BusySpinLimit * 2 > SX126X_BUSY_SPIN_MAX ) ? SX126X_BUSY_SPIN_MAX : BusySpinLimit * 2;
+            }
+            else
+            {
+                BusySpinLimit = ( BusySpinLimit / 2 < SX126X_BUSY_SPIN_MIN ) ? SX126X_BUSY_SPIN_MIN : BusySpinLimit / 2;
+            }
+        }
+    }
+
+    elapsed = LORA_RADIO_TIMESTAMP_US( ) - start;
+    BusyStats.Waits++;
+    BusyStats.TotalUs += elapsed;
+    if( elapsed > BusyStats.MaxUs )
+    {
+        BusyStats.MaxUs = elapsed;
+    }
+    if( done == false )
+    {
+        BusyStats.Timeouts++;
+        LORA_RADIO_DEBUG_LOG(LR_DBG_SPI, LOG_LVL_ERROR, "SX126x BUSY high for %d ms, chip hung\n", SX126X_BUSY_TIMEOUT);
+    }
+}
+
+void SX126xGetBusyStats( SX126xBusyStats_t *stats )
+{
+    *stats = BusyStats;
+}
+
+void SX126xResetBusyStats( void )
+{
+    rt_memset( &BusyStats, 0, sizeof( BusyStats ) );
+}
+
+#ifdef LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC
+
+#ifndef RT_USING_SPI
+#error "LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC needs the RT-Thread SPI device (RT_USING_SPI)"
+#endif
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+#error "LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC drives a single radio instance"
+#endif
+
+/*!
+ * The SPI thread runs above lora-phy (priority 20): it starts a transfer as
+ * soon as it is queued and sleeps while BUSY is high or while the transfer
+ * runs, which leaves the CPU to the submitter when the BSP drives the bus
+ * with DMA (BSP_SPIx_TX_USING_DMA / BSP_SPIx_RX_USING_DMA).
+ */
+#ifndef SX126X_SPI_THREAD_PRIORITY
+#define SX126X_SPI_THREAD_PRIORITY                  19
+#endif
+#ifndef SX126X_SPI_THREAD_STACK_SIZE
+#define SX126X_SPI_THREAD_STACK_SIZE                1024
+#endif
+
+static struct rt_thread SpiThread;
+static rt_uint8_t SpiThreadStack[SX126X_SPI_THREAD_STACK_SIZE];
+static struct rt_semaphore SpiQueueSem;
+static bool SpiQueueStarted = false;
+static SX126xSpiXfer_t *SpiQueueHead;
+static SX126xSpiXfer_t *SpiQueueTail;
+static SX126xSpiQueueStats_t SpiQueueStats;
+
+static void SX126xSpiPrepare( SX126xSpiXfer_t *xfer, uint8_t headerSize, const uint8_t *buffer, uint16_t size )
+{
+    xfer->HeaderSize = headerSize;
+    xfer->TxBuffer = RT_NULL;
+    xfer->RxBuffer = RT_NULL;
+    xfer->Size = 0;
+    xfer->Done = RT_NULL;
+    xfer->Arg = RT_NULL;
+    xfer->Next = RT_NULL;
+
+    if( ( buffer != RT_NULL ) && ( headerSize + size <= SX126X_SPI_XFER_INLINE_SIZE ) )
+    {
+        rt_memcpy( &xfer->Header[headerSize], buffer, size );
+        xfer->HeaderSize += size;
+    }
+    else
+    {
+        xfer->TxBuffer = buffer;
+        xfer->Size = size;
+    }
+}
+
+void SX126xSpiPrepareCommand( SX126xSpiXfer_t *xfer, RadioCommands_t opcode, const uint8_t *buffer, uint16_t size )
+{
+    xfer->Header[0] = ( uint8_t )opcode;
+    SX126xSpiPrepare( xfer, 1, buffer, size );
+}
+
+void SX126xSpiPrepareWriteRegisters( SX126xSpiXfer_t *xfer, uint16_t address, const uint8_t *buffer, uint16_t size )
+{
+    xfer->Header[0] = RADIO_WRITE_REGISTER;
+    xfer->Header[1] = ( address & 0xFF00 ) >> 8;
+    xfer->Header[2] = address & 0x00FF;
+    SX126xSpiPrepare( xfer, 3, buffer, size );
+}
+
+void SX126xSpiPrepareWriteBuffer( SX126xSpiXfer_t *xfer, uint8_t offset, const uint8_t *buffer, uint8_t size )
+{
+    xfer->Header[0] = RADIO_WRITE_BUFFER;
+    xfer->Header[1] = offset;
+    SX126xSpiPrepare( xfer, 2, buffer, size );
+}
+
+void SX126xSpiPrepareReadBuffer( SX126xSpiXfer_t *xfer, uint8_t offset, uint8_t *buffer, uint8_t size )
+{
+    xfer->Header[0] = RADIO_READ_BUFFER;
+    xfer->Header[1] = offset;
+    xfer->Header[2] = 0;
+    SX126xSpiPrepare( xfer, 3, RT_NULL, 0 );
+    xfer->RxBuffer = buffer;
+    xfer->Size = size;
+}
+
+static SX126xSpiXfer_t *SX126xSpiQueuePop( void )
+{
+    SX126xSpiXfer_t *xfer;
+
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+    xfer = SpiQueueHead;
+    if( xfer != RT_NULL )
+    {
+        SpiQueueHead = xfer->QueueNext;
+        if( SpiQueueHead == RT_NULL )
+        {
+            SpiQueueTail = RT_NULL;
+        }
+    }
+    LORA_RADIO_CRITICAL_SECTION_END( );
+
+    return xfer;
+}
+
+static void SX126xSpiQueueCompleted( void )
+{
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+    SpiQueueStats.Completed++;
+    SpiQueueStats.Depth--;
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+static uint32_t SX126xSpiQueueDepth( void )
+{
+    uint32_t depth;
+
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+    depth = SpiQueueStats.Depth;
+    LORA_RADIO_CRITICAL_SECTION_END( );
+
+    return depth;
+}
+
+/*!
+ * \brief Clocks one transaction out, the NSS framing matches
+ *        rt_spi_send_then_send / rt_spi_send_then_recv of the blocking path
+ */
+static void SX126xSpiRun( SX126xSpiXfer_t *xfer )
+{
+    struct rt_spi_message *msg = xfer->Msg;
+
+    // the previous command of the queue may still be executing
+    SX126xWaitOnBusy( );
+
+    msg[0].send_buf = xfer->Header;
+    msg[0].recv_buf = RT_NULL;
+    msg[0].length = xfer->HeaderSize;
+    msg[0].next = RT_NULL;
+    msg[0].cs_take = 1;
+    msg[0].cs_release = 1;
+
+    if( xfer->Size != 0 )
+    {
+        msg[0].next = &msg[1];
+        msg[0].cs_release = 0;
+
+        msg[1].send_buf = xfer->TxBuffer;
+        msg[1].recv_buf = xfer->RxBuffer;
+        msg[1].length = xfer->Size;
+        msg[1].next = RT_NULL;
+        msg[1].cs_take = 0;
+        msg[1].cs_release = 1;
+    }
+
+    rt_spi_transfer_message( SX126x->spi, msg );
+}
+
+static void SX126xSpiThreadEntry( void *parameter )
+{
+    SX126xSpiXfer_t *xfer;
+    bool counted;
+
+    while( 1 )
+    {
+        rt_sem_take( &SpiQueueSem, RT_WAITING_FOREVER );
+
+        while( ( xfer = SX126xSpiQueuePop( ) ) != RT_NULL )
+        {
+            // flush markers carry no SPI data and are not counted
+            counted = ( xfer->HeaderSize != 0 );
+            if( counted )
+            {
+                SX126xSpiRun( xfer );
+            }
+            // xfer may go out of scope as soon as Done returns
+            if( xfer->Done != RT_NULL )
+            {
+                xfer->Done( xfer, xfer->Arg );
+            }
+            if( counted )
+            {
+                SX126xSpiQueueCompleted( );
+            }
+        }
+    }
+}
+
+static void SX126xSpiQueueInit( void )
+{
+    if( SpiQueueStarted == true )
+    {
+        return;
+    }
+    rt_sem_init( &SpiQueueSem, "lr-spiq", 0, RT_IPC_FLAG_FIFO );
+    rt_thread_init( &SpiThread,
+                    "lora-spi",
+                    SX126xSpiThreadEntry,
+                    RT_NULL,
+                    &SpiThreadStack[0],
+                    sizeof( SpiThreadStack ),
+                    SX126X_SPI_THREAD_PRIORITY,
+                    20 );
+    rt_thread_startup( &SpiThread );
+    SpiQueueStarted = true;
+}
+
+static void SX126xSpiQueueAppend( SX126xSpiXfer_t *xfer )
+{
+    SX126xSpiXfer_t *tail = xfer;
+    uint32_t count = 0;
+
+    // link through QueueNext so the caller's chain stays intact for resubmission
+    while( 1 )
+    {
+        tail->QueueNext = tail->Next;
+        if( tail->HeaderSize != 0 )
+        {
+            count++;
+        }
+        if( tail->Next == RT_NULL )
+        {
+            break;
+        }
+        tail = tail->Next;
+    }
+
+    {
+        LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+        if( SpiQueueTail == RT_NULL )
+        {
+            SpiQueueHead = xfer;
+        }
+        else
+        {
+            SpiQueueTail->QueueNext = xfer;
+        }
+        SpiQueueTail = tail;
+
+        SpiQueueStats.Chains++;
+        SpiQueueStats.Submitted += count;
+        SpiQueueStats.Depth += count;
+        if( SpiQueueStats.Depth > SpiQueueStats.MaxDepth )
+        {
+            SpiQueueStats.MaxDepth = SpiQueueStats.Depth;
+        }
+        LORA_RADIO_CRITICAL_SECTION_END( );
+    }
+
+    rt_sem_release( &SpiQueueSem );
+}
+
+void SX126xSpiSubmit( SX126xSpiXfer_t *xfer )
+{
+    RT_ASSERT( xfer != RT_NULL );
+
+    SX126xSpiQueueInit( );
+
+    // the SPI thread only waits on BUSY, a sleeping chip is woken up here
+    if( ( SX126xGetOperatingMode( ) == MODE_SLEEP ) || ( SX126xGetOperatingMode( ) == MODE_RX_DC ) )
+    {
+        SX126xCheckDeviceReady( );
+    }
+    SX126xSpiQueueAppend( xfer );
+}
+
+static void SX126xSpiOnFlushed( SX126xSpiXfer_t *xfer, void *arg )
+{
+    rt_sem_release( ( rt_sem_t )arg );
+}
+
+void SX126xSpiFlush( void )
+{
+    SX126xSpiXfer_t marker;
+    struct rt_semaphore flushed;
+
+    // Done callbacks may use the blocking accessors, they run on the SPI thread
+    if( ( SpiQueueStarted == false ) || ( rt_thread_self( ) == &SpiThread ) )
+    {
+        return;
+    }
+    if( SX126xSpiQueueDepth( ) == 0 )
+    {
+        return;
+    }
+
+    rt_sem_init( &flushed, "lr-spif", 0, RT_IPC_FLAG_FIFO );
+    rt_memset( &marker, 0, sizeof( marker ) );
+    marker.Done = SX126xSpiOnFlushed;
+    marker.Arg = &flushed;
+
+    // every transaction ends within SX126X_BUSY_TIMEOUT, no timeout needed here
+    SX126xSpiQueueAppend( &marker );
+    rt_sem_take( &flushed, RT_WAITING_FOREVER );
+    rt_sem_detach( &flushed );
+}
+
+void SX126xGetSpiQueueStats( SX126xSpiQueueStats_t *stats )
+{
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+    *stats = SpiQueueStats;
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+void SX126xResetSpiQueueStats( void )
+{
+    LORA_RADIO_CRITICAL_SECTION_BEGIN( );
+    SpiQueueStats.Chains = 0;
+    SpiQueueStats.Submitted = 0;
+    SpiQueueStats.Completed = 0;
+    SpiQueueStats.MaxDepth = SpiQueueStats.Depth;
+    LORA_RADIO_CRITICAL_SECTION_END( );
+}
+
+#endif
+
+#ifdef RT_USING_SPI
+/*!
+ * Batch whose owner thread has its write accessors captured, see SX126xBatchBegin()
+ */
+static SX126xBatch_t *ActiveBatch = RT_NULL;
+
+/*!
+ * \brief Sends the captured commands, NSS framed one by one with a single
+ *        BUSY wait in between and none after the last one: the next access
+ *        waits in SX126xCheckDeviceReady anyway
+ */
+static void SX126xBatchRun( SX126xBatch_t *batch )
+{
+    uint16_t start = 0;
+    uint8_t i;
+
+    if( batch->Count == 0 )
+    {
+        return;
+    }
+#ifdef LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC
+    SX126xSpiFlush( );
+#endif
+
+    for( i = 0; i < batch->Count; i++ )
+    {
+        SX126xWaitOnBusy( );
+        rt_spi_transfer( SX126x->spi, &batch->Buffer[start], RT_NULL, batch->End[i] - start );
+        start = batch->End[i];
+    }
+    batch->Stats.Runs++;
+    batch->Stats.Commands += batch->Count;
+    batch->Count = 0;
+}
+
+/*!
+ * \brief Appends a write access to the batch of the calling thread
+ *
+ * \retval captured [true: queued in the batch, false: to be sent now]
+ */
+static bool SX126xBatchCapture( const uint8_t *header, uint8_t headerSize, const uint8_t *buffer, uint16_t size )
+{
+    SX126xBatch_t *batch = ActiveBatch;
+    uint16_t start;
+
+    if( ( batch == RT_NULL ) || ( batch->Owner != rt_thread_self( ) ) )
+    {
+        return false;
+    }
+    if( headerSize + size > SX126X_BATCH_BUFFER_SIZE )
+    {
+        // cannot fit even alone, sent directly after what is pending
+        SX126xBatchRun( batch );
+        return false;
+    }
+
+    start = ( batch->Count == 0 ) ? 0 : batch->End[batch->Count - 1];
+    if( ( batch->Count == SX126X_BATCH_MAX_COMMANDS ) || ( start + headerSize + size > SX126X_BATCH_BUFFER_SIZE ) )
+    {
+        SX126xBatchRun( batch );
+        start = 0;
+    }
+
+    rt_memcpy( &batch->Buffer[start], header, headerSize );
+    rt_memcpy( &batch->Buffer[start + headerSize], buffer, size );
+    batch->End[batch->Count++] = start + headerSize + size;
+
+    return true;
+}
+
+void SX126xBatchBegin( SX126xBatch_t *batch )
+{
+    RT_ASSERT( ActiveBatch == RT_NULL );
+
+    // the captured commands update the driver operating mode before they
+    // reach the chip, wake it up while that mode still tells it sleeps
+    if( ( SX126xGetOperatingMode( ) == MODE_SLEEP ) || ( SX126xGetOperatingMode( ) == MODE_RX_DC ) )
+    {
+        SX126xCheckDeviceReady( );
+    }
+
+    batch->Count = 0;
+    batch->Owner = rt_thread_self( );
+    ActiveBatch = batch;
+}
+
+void SX126xBatchEnd( SX126xBatch_t *batch )
+{
+    RT_ASSERT( ActiveBatch == batch );
+
+    SX126xBatchRun( batch );
+    ActiveBatch = RT_NULL;
+}
+#endif
+
+/*!
+ * \brief Orders a blocking access after the pending batch of the calling
+ *        thread and after the asynchronous queue
+ */
+static void SX126xSpiSync( void )
+{
+#ifdef RT_USING_SPI
+    if( ( ActiveBatch != RT_NULL ) && ( ActiveBatch->Owner == rt_thread_self( ) ) )
+    {
+        SX126xBatchRun( ActiveBatch );
+    }
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC
+    SX126xSpiFlush( );
+#endif
+}
+
 
 void SX126xWakeup( void )
 {
 #ifdef RT_USING_SPI
     uint8_t msg[2] = { RADIO_GET_STATUS, 0x00 };
     
-    rt_spi_transfer(SX126x.spi,msg,RT_NULL,2);
+    SX126xSpiSync( );
+    rt_spi_transfer(SX126x->spi,msg,RT_NULL,2);
     
     //rt_spi_send_then_send(SX126x.spi,&msg1,1,&msg2,1);
  
@@ -47,15 +597,27 @@ void SX126xWakeup( void )
     //////    GpioWrite( &SX126x.Spi.Nss, 1 );
     /////CRITICAL_SECTION_END( );
 #endif
+
+    // Update operating mode context variable, the next access must not wake
+    // the chip again while it is busy with the previous command
+    SX126xSetOperatingMode( MODE_STDBY_RC );
     
 }
 
 void SX126xWriteCommand( RadioCommands_t command, uint8_t *buffer, uint16_t size )
 {    
 #ifdef RT_USING_SPI
+    uint8_t opcode = ( uint8_t )command;
+
+    // nothing can follow SetSleep in a batch, the chip needs a wake-up first
+    if( ( command != RADIO_SET_SLEEP ) && ( SX126xBatchCapture( &opcode, 1, buffer, size ) == true ) )
+    {
+        return;
+    }
+    SX126xSpiSync( );
     SX126xCheckDeviceReady( );
 
-    rt_spi_send_then_send(SX126x.spi,&command,1,buffer,size);
+    rt_spi_send_then_send(SX126x->spi,&command,1,buffer,size);
     
     if( command != RADIO_SET_SLEEP )
     {
@@ -96,9 +658,10 @@ uint8_t SX126xReadCommand( RadioCommands_t command, uint8_t *buffer, uint16_t si
     uint8_t status = 0;
     uint8_t buffer_temp[16] = {0}; // command size is 2 size
     
+    SX126xSpiSync( );
     SX126xCheckDeviceReady( );
     
-    rt_spi_send_then_recv(SX126x.spi,&command,1,buffer_temp,size + 1);
+    rt_spi_send_then_recv(SX126x->spi,&command,1,buffer_temp,size + 1);
     
     status = buffer_temp[0];
     
@@ -144,9 +707,14 @@ void SX126xWriteRegisters( uint16_t address, uint8_t *buffer, uint16_t size )
     msg[1] = ( address & 0xFF00 ) >> 8;
     msg[2] = address & 0x00FF;
     
+    if( SX126xBatchCapture( msg, 3, buffer, size ) == true )
+    {
+        return;
+    }
+    SX126xSpiSync( );
     SX126xCheckDeviceReady( );
     
-    rt_spi_send_then_send(SX126x.spi,msg,3,buffer,size);
+    rt_spi_send_then_send(SX126x->spi,msg,3,buffer,size);
 
     SX126xWaitOnBusy( );
 #else
@@ -195,9 +763,10 @@ void SX126xReadRegisters( uint16_t address, uint8_t *buffer, uint16_t size )
     msg[2] = address & 0x00FF;
     msg[3] = 0;
     
+    SX126xSpiSync( );
     SX126xCheckDeviceReady( );
 
-    rt_spi_send_then_recv(SX126x.spi,msg,4,buffer,size);
+    rt_spi_send_then_recv(SX126x->spi,msg,4,buffer,size);
 
     SX126xWaitOnBusy( );
 #else
@@ -249,9 +818,14 @@ void SX126xWriteBuffer( uint8_t offset, uint8_t *buffer, uint8_t size )
     msg[0] = RADIO_WRITE_BUFFER;
     msg[1] = offset;
     
+    if( SX126xBatchCapture( msg, 2, buffer, size ) == true )
+    {
+        return;
+    }
+    SX126xSpiSync( );
     SX126xCheckDeviceReady( );
     
-    rt_spi_send_then_send(SX126x.spi,msg,2,buffer,size);
+    rt_spi_send_then_send(SX126x->spi,msg,2,buffer,size);
     
     SX126xWaitOnBusy( );  
 
@@ -296,9 +870,10 @@ void SX126xReadBuffer( uint8_t offset, uint8_t *buffer, uint8_t size )
     msg[1] = offset;
     msg[2] = 0;
     
+    SX126xSpiSync( );
     SX126xCheckDeviceReady( );
 
-    rt_spi_send_then_recv(SX126x.spi,msg,3,buffer,size);
+    rt_spi_send_then_recv(SX126x->spi,msg,3,buffer,size);
 
     SX126xWaitOnBusy( );
 #else    
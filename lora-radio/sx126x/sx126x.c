@@ -27,6 +27,7 @@
 #include "lora-radio.h"
 #include "sx126x.h"
 #include "sx126x-board.h"
+#include "lora-radio-noise-floor.h"
 
 /*!
  * \brief Radio registers definition
@@ -37,30 +38,30 @@ typedef struct
     uint8_t       Value;                            //!< The value of the register
 }RadioRegisters_t;
 
-/*!
- * \brief Holds the internal operating mode of the radio
- */
-static RadioOperatingModes_t OperatingMode;
-
-/*!
- * \brief Stores the current packet type set in the radio
- */
-static RadioPacketTypes_t PacketType;
-
-/*!
- * \brief Stores the current packet header type set in the radio
- */
-static volatile RadioLoRaPacketLengthsMode_t LoRaHeaderType;
-
 /*!
  * \brief Stores the last frequency error measured on LoRa received packet
  */
 volatile uint32_t FrequencyError = 0;
 
 /*!
- * \brief Hold the status of the Image calibration
+ * \brief Image calibration bands, by decreasing frequency. The last band also
+ *        covers every frequency below it.
  */
-static bool ImageCalibrated = false;
+static const struct
+{
+    uint32_t MinFreq;                               // band holds the frequencies above
+    uint8_t CalFreq[2];                             // CalibrateImage parameters
+}ImageCalibrationBands[] =
+{
+    { 900000000, { 0xE1, 0xE9 } },                  // 902 - 928 MHz
+    { 850000000, { 0xD7, 0xDB } },                  // 863 - 870 MHz
+    { 770000000, { 0xC1, 0xC5 } },                  // 779 - 787 MHz
+    { 460000000, { 0x75, 0x81 } },                  // 470 - 510 MHz
+    { 425000000, { 0x6B, 0x6F } },                  // 430 - 440 MHz
+};
+
+#define IMAGE_CALIBRATION_BAND_NONE                 -1
+#define IMAGE_CALIBRATION_BAND_COUNT                ( sizeof( ImageCalibrationBands ) / sizeof( ImageCalibrationBands[0] ) )
 
 /*
  * SX126x DIO IRQ callback functions prototype
@@ -89,6 +90,9 @@ void SX126xProcessIrqs( void );
 void SX126xInit( DioIrqHandler dioIrq )
 {   
     SX126xReset( );
+    SX126xConfigInvalidate( );
+    SX126x->ImageCalibratedBand = IMAGE_CALIBRATION_BAND_NONE;
+    SX126x->ImageCalibrationPending = IMAGE_CALIBRATION_BAND_NONE;
 
     SX126xIoIrqInit( dioIrq );
 
@@ -109,12 +113,12 @@ void SX126xInit( DioIrqHandler dioIrq )
 
 RadioOperatingModes_t SX126xGetOperatingMode( void )
 {
-    return OperatingMode;
+    return SX126x->OperatingMode;
 }
 
 void SX126xSetOperatingMode( RadioOperatingModes_t mode )
 {
-    OperatingMode = mode;
+    SX126x->OperatingMode = mode;
 
 #if defined( LORA_RADIO_RFSW2_PIN ) && defined( LORA_RADIO_RFSW1_PIN )      
     SX126xSetAntSw( mode );
@@ -177,7 +181,10 @@ void SX126xSendPayload( uint8_t *payload, uint8_t size, uint32_t timeout )
 
 uint8_t SX126xSetSyncWord( uint8_t *syncWord )
 {
-    SX126xWriteRegisters( REG_LR_SYNCWORDBASEADDRESS, syncWord, 8 );
+    if( SX126xConfigChanged( SX126X_CONFIG_SYNC_WORD, syncWord, 8 ) )
+    {
+        SX126xWriteRegisters( REG_LR_SYNCWORDBASEADDRESS, syncWord, 8 );
+    }
     return 0;
 }
 
@@ -191,7 +198,10 @@ void SX126xSetCrcSeed( uint16_t seed )
     switch( SX126xGetPacketType( ) )
     {
         case PACKET_TYPE_GFSK:
-            SX126xWriteRegisters( REG_LR_CRCSEEDBASEADDR, buf, 2 );
+            if( SX126xConfigChanged( SX126X_CONFIG_CRC_SEED, buf, 2 ) )
+            {
+                SX126xWriteRegisters( REG_LR_CRCSEEDBASEADDR, buf, 2 );
+            }
             break;
 
         default:
@@ -209,7 +219,10 @@ void SX126xSetCrcPolynomial( uint16_t polynomial )
     switch( SX126xGetPacketType( ) )
     {
         case PACKET_TYPE_GFSK:
-            SX126xWriteRegisters( REG_LR_CRCPOLYBASEADDR, buf, 2 );
+            if( SX126xConfigChanged( SX126X_CONFIG_CRC_POLYNOMIAL, buf, 2 ) )
+            {
+                SX126xWriteRegisters( REG_LR_CRCPOLYBASEADDR, buf, 2 );
+            }
             break;
 
         default:
@@ -220,10 +233,15 @@ void SX126xSetCrcPolynomial( uint16_t polynomial )
 void SX126xSetWhiteningSeed( uint16_t seed )
 {
     uint8_t regValue = 0;
+    uint8_t buf[2] = { ( uint8_t )( seed >> 8 ), ( uint8_t )seed };
     
     switch( SX126xGetPacketType( ) )
     {
         case PACKET_TYPE_GFSK:
+            if( SX126xConfigChanged( SX126X_CONFIG_WHITENING_SEED, buf, 2 ) == false )
+            {
+                break;
+            }
             regValue = SX126xReadRegister( REG_LR_WHITSEEDBASEADDR_MSB ) & 0xFE;
             regValue = ( ( seed >> 8 ) & 0x01 ) | regValue;
             SX126xWriteRegister( REG_LR_WHITSEEDBASEADDR_MSB, regValue ); // only 1 bit.
@@ -260,18 +278,49 @@ uint32_t SX126xGetRandom( void )
     return number;
 }
 
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+/*!
+ * \brief Reads the noise floor when the receiver is left
+ */
+static void SX126xNoiseFloorSample( void )
+{
+    if( SX126xGetOperatingMode( ) != MODE_RX )
+    {
+        return;
+    }
+    if( SX126x->RxInFlight == true )
+    {
+        lora_radio_noise_floor_skip( );
+    }
+    else
+    {
+        lora_radio_noise_floor_sample( SX126x->Frequency, SX126xGetRssiInst( ) );
+    }
+}
+#else
+#define SX126xNoiseFloorSample( )
+#endif
+
 void SX126xSetSleep( SleepParams_t sleepConfig )
 {
+    SX126xNoiseFloorSample( );
     SX126xAntSwOff( );
     uint8_t value = ( ( ( uint8_t )sleepConfig.Fields.WarmStart << 2 ) |
                       ( ( uint8_t )sleepConfig.Fields.Reset << 1 ) |
                       ( ( uint8_t )sleepConfig.Fields.WakeUpRTC ) );
     SX126xWriteCommand( RADIO_SET_SLEEP, &value, 1 ); 
     SX126xSetOperatingMode( MODE_SLEEP );
+    if( sleepConfig.Fields.WarmStart == 0 )
+    {
+        // cold start, the configuration is lost
+        SX126xConfigInvalidate( );
+        SX126x->ImageCalibratedBand = IMAGE_CALIBRATION_BAND_NONE;
+    }
 }
 
 void SX126xSetStandby( RadioStandbyModes_t standbyConfig )
 {
+    SX126xNoiseFloorSample( );
     SX126xWriteCommand( RADIO_SET_STANDBY, ( uint8_t* )&standbyConfig, 1 );
     if( standbyConfig == STDBY_RC )
     {
@@ -285,6 +334,7 @@ void SX126xSetStandby( RadioStandbyModes_t standbyConfig )
 
 void SX126xSetFs( void )
 {
+    SX126xNoiseFloorSample( );
     SX126xWriteCommand( RADIO_SET_FS, 0, 0 );
     SX126xSetOperatingMode( MODE_FS );
 }
@@ -293,6 +343,7 @@ void SX126xSetTx( uint32_t timeout )
 {
     uint8_t buf[3];
 
+    SX126xNoiseFloorSample( );
     SX126xSetOperatingMode( MODE_TX );
 
     buf[0] = ( uint8_t )( ( timeout >> 16 ) & 0xFF );
@@ -305,6 +356,9 @@ void SX126xSetRx( uint32_t timeout )
 {
     uint8_t buf[3];
 
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+    SX126x->RxInFlight = false;
+#endif
     SX126xSetOperatingMode( MODE_RX );
 
     buf[0] = ( uint8_t )( ( timeout >> 16 ) & 0xFF );
@@ -317,6 +371,9 @@ void SX126xSetRxBoosted( uint32_t timeout )
 {
     uint8_t buf[3];
 
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+    SX126x->RxInFlight = false;
+#endif
     SX126xSetOperatingMode( MODE_RX );
 
     SX126xWriteRegister( REG_RX_GAIN, 0x96 ); // max LNA gain, increase current by ~2mA for around ~3dB in sensivity
@@ -343,6 +400,7 @@ void SX126xSetRxDutyCycle( uint32_t rxTime, uint32_t sleepTime )
 
 void SX126xSetCad( void )
 {
+    SX126xNoiseFloorSample( );
     SX126xWriteCommand( RADIO_SET_CAD, 0, 0 );
     SX126xSetOperatingMode( MODE_CAD );
 }
@@ -360,11 +418,18 @@ void SX126xSetTxInfinitePreamble( void )
 
 void SX126xSetStopRxTimerOnPreambleDetect( bool enable )
 {
-    SX126xWriteCommand( RADIO_SET_STOPRXTIMERONPREAMBLE, ( uint8_t* )&enable, 1 );
+    if( SX126xConfigChanged( SX126X_CONFIG_STOP_RX_TIMER_ON_PREAMBLE, ( uint8_t* )&enable, 1 ) )
+    {
+        SX126xWriteCommand( RADIO_SET_STOPRXTIMERONPREAMBLE, ( uint8_t* )&enable, 1 );
+    }
 }
 
 void SX126xSetLoRaSymbNumTimeout( uint8_t symbNum )
 {
+    if( SX126xConfigChanged( SX126X_CONFIG_LORA_SYMB_TIMEOUT, &symbNum, 1 ) == false )
+    {
+        return;
+    }
     SX126xWriteCommand( RADIO_SET_LORASYMBTIMEOUT, &symbNum, 1 );
     
     if( symbNum >= 64 )
@@ -400,38 +465,96 @@ void SX126xCalibrate( CalibrationParams_t calibParam )
                       ( ( uint8_t )calibParam.Fields.RC64KEnable ) );
 
     SX126xWriteCommand( RADIO_CALIBRATE, &value, 1 );  
+    if( calibParam.Fields.ImgEnable != 0 )
+    {
+        // the chip calibrates its default band
+        SX126x->ImageCalibratedBand = IMAGE_CALIBRATION_BAND_NONE;
+    }
 }
 
-void SX126xCalibrateImage( uint32_t freq )
+/*!
+ * \brief Gets the image calibration band holding \a freq
+ *
+ * \retval band             Index in ImageCalibrationBands
+ */
+static uint8_t SX126xGetImageCalibrationBand( uint32_t freq )
 {
-    uint8_t calFreq[2];
+    uint8_t band;
 
-    if( freq > 900000000 )
+    for( band = 0; band < IMAGE_CALIBRATION_BAND_COUNT - 1; band++ )
     {
-        calFreq[0] = 0xE1;
-        calFreq[1] = 0xE9;
+        if( freq > ImageCalibrationBands[band].MinFreq )
+        {
+            break;
+        }
     }
-    else if( freq > 850000000 )
+    return band;
+}
+
+/*!
+ * \brief Calibrates the image rejection for \a band unless it is already done
+ */
+static void SX126xCalibrateImageBand( uint8_t band )
+{
+    if( SX126x->ImageCalibratedBand == ( int8_t )band )
     {
-        calFreq[0] = 0xD7;
-        calFreq[1] = 0xDB;
+        return;
     }
-    else if( freq > 770000000 )
+    SX126xWriteCommand( RADIO_CALIBRATEIMAGE, ( uint8_t* )ImageCalibrationBands[band].CalFreq, 2 );
+    SX126x->ImageCalibratedBand = band;
+}
+
+void SX126xCalibrateImage( uint32_t freq )
+{
+    uint8_t band = SX126xGetImageCalibrationBand( freq );
+
+    SX126xWriteCommand( RADIO_CALIBRATEIMAGE, ( uint8_t* )ImageCalibrationBands[band].CalFreq, 2 );
+    SX126x->ImageCalibratedBand = band;
+}
+
+/*!
+ * \brief Calibrates \a band now when the chip is in STDBY_RC, else on the next
+ *        SX126xImageCalibrationIdle call
+ */
+static void SX126xRequestImageCalibration( int8_t band )
+{
+    if( SX126x->ImageCalibratedBand == band )
     {
-        calFreq[0] = 0xC1;
-        calFreq[1] = 0xC5;
+        SX126x->ImageCalibrationPending = IMAGE_CALIBRATION_BAND_NONE;
+        return;
     }
-    else if( freq > 460000000 )
+    if( SX126xGetOperatingMode( ) != MODE_STDBY_RC )
     {
-        calFreq[0] = 0x75;
-        calFreq[1] = 0x81;
+        SX126x->ImageCalibrationPending = band;
+        return;
     }
-    else if( freq > 425000000 )
+    SX126x->ImageCalibrationPending = IMAGE_CALIBRATION_BAND_NONE;
+#ifdef LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC
     {
-        calFreq[0] = 0x6B;
-        calFreq[1] = 0x6F;
+        static SX126xSpiXfer_t xfer;
+
+        // the previous calibration may still sit in the queue
+        SX126xSpiFlush( );
+        SX126xSpiPrepareCommand( &xfer, RADIO_CALIBRATEIMAGE, ImageCalibrationBands[band].CalFreq, 2 );
+        SX126xSpiSubmit( &xfer );
+        SX126x->ImageCalibratedBand = band;
+    }
+#else
+    SX126xCalibrateImageBand( band );
+#endif
+}
+
+void SX126xPrepareImageCalibration( uint32_t freq )
+{
+    SX126xRequestImageCalibration( SX126xGetImageCalibrationBand( freq ) );
+}
+
+void SX126xImageCalibrationIdle( void )
+{
+    if( SX126x->ImageCalibrationPending != IMAGE_CALIBRATION_BAND_NONE )
+    {
+        SX126xRequestImageCalibration( SX126x->ImageCalibrationPending );
     }
-    SX126xWriteCommand( RADIO_CALIBRATEIMAGE, calFreq, 2 );
 }
 
 void SX126xSetPaConfig( uint8_t paDutyCycle, uint8_t hpMax, uint8_t deviceSel, uint8_t paLut )
@@ -490,41 +613,128 @@ void SX126xSetDio3AsTcxoCtrl( RadioTcxoCtrlVoltage_t tcxoVoltage, uint32_t timeo
     SX126xWriteCommand( RADIO_SET_TCXOMODE, buf, 4 );
 }
 
+/*!
+ * \brief Gets the SetRfFrequency parameters of \a frequency
+ */
+static void SX126xGetFrf( uint32_t frequency, uint8_t *buf )
+{
+    uint32_t freq = ( uint32_t )( ( double )frequency / ( double )FREQ_STEP );
+
+    buf[0] = ( uint8_t )( ( freq >> 24 ) & 0xFF );
+    buf[1] = ( uint8_t )( ( freq >> 16 ) & 0xFF );
+    buf[2] = ( uint8_t )( ( freq >> 8 ) & 0xFF );
+    buf[3] = ( uint8_t )( freq & 0xFF );
+}
+
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+/*!
+ * \brief Binary search of \a frequency in the channel plan
+ *
+ * \retval channel           The channel, RT_NULL when the plan does not hold it
+ */
+static const SX126xChannel_t *SX126xChannelPlanFind( uint32_t frequency )
+{
+    uint16_t low = 0, high = SX126x->ChannelPlanSize, mid;
+
+    while( low < high )
+    {
+        mid = ( low + high ) / 2;
+        if( SX126x->ChannelPlan[mid].Frequency < frequency )
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    if( ( low < SX126x->ChannelPlanSize ) && ( SX126x->ChannelPlan[low].Frequency == frequency ) )
+    {
+        return &SX126x->ChannelPlan[low];
+    }
+    return RT_NULL;
+}
+
+void SX126xSetChannelPlan( SX126xChannel_t *channels, uint16_t count )
+{
+    SX126xChannel_t channel;
+    uint16_t i, j;
+
+    SX126x->ChannelPlanSize = 0;
+    SX126x->ChannelPlan = channels;
+    if( channels == RT_NULL )
+    {
+        return;
+    }
+    for( i = 0; i < count; i++ )
+    {
+        channel = channels[i];
+        SX126xGetFrf( channel.Frequency, channel.Frf );
+        channel.ImageCalBand = SX126xGetImageCalibrationBand( channel.Frequency );
+
+        // insertion sort, the plan is registered once
+        for( j = i; ( j > 0 ) && ( channels[j - 1].Frequency > channel.Frequency ); j-- )
+        {
+            channels[j] = channels[j - 1];
+        }
+        channels[j] = channel;
+    }
+    SX126x->ChannelPlanSize = count;
+}
+#endif
+
 void SX126xSetRfFrequency( uint32_t frequency )
 {
     uint8_t buf[4];
-    uint32_t freq = 0;
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+    const SX126xChannel_t *channel;
+#endif
 
-    if( ImageCalibrated == false )
+    SX126x->Frequency = frequency;
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+    channel = SX126xChannelPlanFind( frequency );
+    if( channel != RT_NULL )
     {
-        SX126xCalibrateImage( frequency );
-        ImageCalibrated = true;
+        SX126xCalibrateImageBand( channel->ImageCalBand );
+        SX126xWriteCommand( RADIO_SET_RFFREQUENCY, ( uint8_t* )channel->Frf, 4 );
+        return;
     }
+#endif
 
-    freq = ( uint32_t )( ( double )frequency / ( double )FREQ_STEP );
-    buf[0] = ( uint8_t )( ( freq >> 24 ) & 0xFF );
-    buf[1] = ( uint8_t )( ( freq >> 16 ) & 0xFF );
-    buf[2] = ( uint8_t )( ( freq >> 8 ) & 0xFF );
-    buf[3] = ( uint8_t )( freq & 0xFF );
+    SX126xCalibrateImageBand( SX126xGetImageCalibrationBand( frequency ) );
+
+    SX126xGetFrf( frequency, buf );
     SX126xWriteCommand( RADIO_SET_RFFREQUENCY, buf, 4 );
 }
 
 void SX126xSetPacketType( RadioPacketTypes_t packetType )
 {
+    uint8_t value = ( uint8_t )packetType;
+
     // Save packet type internally to avoid questioning the radio
-    PacketType = packetType;
-    SX126xWriteCommand( RADIO_SET_PACKETTYPE, ( uint8_t* )&packetType, 1 );
+    SX126x->PacketType = packetType;
+    // The chip does not keep the parameters of the previous packet type
+    SX126xConfigInvalidate( );
+    ( void )SX126xConfigChanged( SX126X_CONFIG_PACKET_TYPE, &value, 1 );
+    SX126xWriteCommand( RADIO_SET_PACKETTYPE, &value, 1 );
 }
 
 RadioPacketTypes_t SX126xGetPacketType( void )
 {
-    return PacketType;
+    return SX126x->PacketType;
 }
 
 void SX126xSetTxParams( int8_t power, RadioRampTimes_t rampTime )
 {
     uint8_t buf[2];
 
+    buf[0] = power;
+    buf[1] = ( uint8_t )rampTime;
+    if( SX126xConfigChanged( SX126X_CONFIG_TX_PARAMS, buf, 2 ) == false )
+    {
+        return;
+    }
+
 ////    if( SX126xGetDeviceId( ) == SX1261 )
 ////    {
 ////        if( power == 15 )
@@ -576,7 +786,7 @@ void SX126xSetModulationParams( ModulationParams_t *modulationParams )
 
     // Check if required configuration corresponds to the stored packet type
     // If not, silently update radio packet type
-    if( PacketType != modulationParams->PacketType )
+    if( SX126x->PacketType != modulationParams->PacketType )
     {
         SX126xSetPacketType( modulationParams->PacketType );
     }
@@ -595,7 +805,6 @@ void SX126xSetModulationParams( ModulationParams_t *modulationParams )
         buf[5] = ( tempVal >> 16 ) & 0xFF;
         buf[6] = ( tempVal >> 8 ) & 0xFF;
         buf[7] = ( tempVal& 0xFF );
-        SX126xWriteCommand( RADIO_SET_MODULATIONPARAMS, buf, n );
         break;
     case PACKET_TYPE_LORA:
         n = 4;
@@ -603,14 +812,15 @@ void SX126xSetModulationParams( ModulationParams_t *modulationParams )
         buf[1] = modulationParams->Params.LoRa.Bandwidth;
         buf[2] = modulationParams->Params.LoRa.CodingRate;
         buf[3] = modulationParams->Params.LoRa.LowDatarateOptimize;
-
-        SX126xWriteCommand( RADIO_SET_MODULATIONPARAMS, buf, n );
-
         break;
     default:
     case PACKET_TYPE_NONE:
         return;
     }
+    if( SX126xConfigChanged( SX126X_CONFIG_MODULATION_PARAMS, buf, n ) )
+    {
+        SX126xWriteCommand( RADIO_SET_MODULATIONPARAMS, buf, n );
+    }
 }
 
 void SX126xSetPacketParams( PacketParams_t *packetParams )
@@ -621,7 +831,7 @@ void SX126xSetPacketParams( PacketParams_t *packetParams )
 
     // Check if required configuration corresponds to the stored packet type
     // If not, silently update radio packet type
-    if( PacketType != packetParams->PacketType )
+    if( SX126x->PacketType != packetParams->PacketType )
     {
         SX126xSetPacketType( packetParams->PacketType );
     }
@@ -660,7 +870,7 @@ void SX126xSetPacketParams( PacketParams_t *packetParams )
         n = 6;
         buf[0] = ( packetParams->Params.LoRa.PreambleLength >> 8 ) & 0xFF;
         buf[1] = packetParams->Params.LoRa.PreambleLength;
-        buf[2] = LoRaHeaderType = packetParams->Params.LoRa.HeaderType;
+        buf[2] = SX126x->LoRaHeaderType = packetParams->Params.LoRa.HeaderType;
         buf[3] = packetParams->Params.LoRa.PayloadLength;
         buf[4] = packetParams->Params.LoRa.CrcMode;
         buf[5] = packetParams->Params.LoRa.InvertIQ;
@@ -669,7 +879,10 @@ void SX126xSetPacketParams( PacketParams_t *packetParams )
     case PACKET_TYPE_NONE:
         return;
     }
-    SX126xWriteCommand( RADIO_SET_PACKETPARAMS, buf, n );
+    if( SX126xConfigChanged( SX126X_CONFIG_PACKET_PARAMS, buf, n ) )
+    {
+        SX126xWriteCommand( RADIO_SET_PACKETPARAMS, buf, n );
+    }
 }
 
 void SX126xSetCadParams( RadioLoRaCadSymbols_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, RadioCadExitModes_t cadExitMode, uint32_t cadTimeout )
@@ -683,8 +896,10 @@ void SX126xSetCadParams( RadioLoRaCadSymbols_t cadSymbolNum, uint8_t cadDetPeak,
     buf[4] = ( uint8_t )( ( cadTimeout >> 16 ) & 0xFF );
     buf[5] = ( uint8_t )( ( cadTimeout >> 8 ) & 0xFF );
     buf[6] = ( uint8_t )( cadTimeout & 0xFF );
-    SX126xWriteCommand( RADIO_SET_CADPARAMS, buf, 7 );
-    SX126xSetOperatingMode( MODE_CAD );
+    if( SX126xConfigChanged( SX126X_CONFIG_CAD_PARAMS, buf, 7 ) )
+    {
+        SX126xWriteCommand( RADIO_SET_CADPARAMS, buf, 7 );
+    }
 }
 
 void SX126xSetBufferBaseAddress( uint8_t txBaseAddress, uint8_t rxBaseAddress )
@@ -725,7 +940,7 @@ void SX126xGetRxBufferStatus( uint8_t *payloadLength, uint8_t *rxStartBufferPoin
 
     // In case of LORA fixed header, the payloadLength is obtained by reading
     // the register REG_LR_PAYLOADLENGTH
-    if( ( SX126xGetPacketType( ) == PACKET_TYPE_LORA ) && ( LoRaHeaderType == LORA_PACKET_FIXED_LENGTH ) )
+    if( ( SX126xGetPacketType( ) == PACKET_TYPE_LORA ) && ( SX126x->LoRaHeaderType == LORA_PACKET_FIXED_LENGTH ) )
     {
         *payloadLength = SX126xReadRegister( REG_LR_PAYLOADLENGTH );
     }
@@ -801,3 +1016,38 @@ void SX126xClearIrqStatus( uint16_t irq )
     buf[1] = ( uint8_t )( ( uint16_t )irq & 0x00FF );
     SX126xWriteCommand( RADIO_CLR_IRQSTATUS, buf, 2 );
 }
+
+#ifdef LORA_RADIO_DRIVER_USING_CONFIG_DIFF
+bool SX126xConfigChanged( SX126xConfigId_t id, const uint8_t *value, uint8_t size )
+{
+    RT_ASSERT( ( id < SX126X_CONFIG_COUNT ) && ( size <= SX126X_CONFIG_VALUE_SIZE ) );
+
+    if( ( ( SX126x->ConfigApplied.Valid & ( 1 << id ) ) != 0 ) && ( SX126x->ConfigApplied.Size[id] == size ) &&
+        ( rt_memcmp( SX126x->ConfigApplied.Value[id], value, size ) == 0 ) )
+    {
+        SX126x->ConfigApplied.Stats.Skipped++;
+        SX126x->ConfigApplied.Stats.BytesSkipped += size;
+        return false;
+    }
+    rt_memcpy( SX126x->ConfigApplied.Value[id], value, size );
+    SX126x->ConfigApplied.Size[id] = size;
+    SX126x->ConfigApplied.Valid |= ( 1 << id );
+    SX126x->ConfigApplied.Stats.Applied++;
+    return true;
+}
+
+void SX126xConfigInvalidate( void )
+{
+    SX126x->ConfigApplied.Valid = 0;
+}
+
+void SX126xGetConfigStats( SX126xConfigStats_t *stats )
+{
+    *stats = SX126x->ConfigApplied.Stats;
+}
+
+void SX126xResetConfigStats( void )
+{
+    rt_memset( &SX126x->ConfigApplied.Stats, 0, sizeof( SX126x->ConfigApplied.Stats ) );
+}
+#endif
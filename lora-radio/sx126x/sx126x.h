@@ -29,6 +29,7 @@
 //#include "gpio.h"
 //#include "spi.h"
 #include "lora-radio.h"
+#include "lora-radio-timer.h"
 
 #define SX1261                                      1
 #define SX1262                                      2
@@ -664,29 +665,6 @@ typedef union
     uint16_t Value;
 }RadioError_t;
 
-/*!
- * Radio hardware and global parameters
- */
-typedef struct SX126x_s
-{
-////    Gpio_t        Reset;
-////    Gpio_t        BUSY;
-////    Gpio_t        DIO1;
-////    Gpio_t        DIO2;
-////    Gpio_t        DIO3;
-////    Spi_t         Spi;
-    
- ////   #ifdef RT_USING_SPI
-    struct rt_spi_device *spi;
-////    #else
-////    //SPI_TypeDef *spi;
-////    #endif
-    
-    PacketParams_t PacketParams;
-    PacketStatus_t PacketStatus;
-    ModulationParams_t ModulationParams;
-}SX126x_t;
-
 /*!
  * Hardware IO IRQ callback function definition
  */
@@ -724,6 +702,168 @@ typedef struct
     void ( *cadDone )( bool cadFlag );              //!< Pointer to a function run on channel activity detected
 }SX126xCallbacks_t;
 
+#ifdef LORA_RADIO_DRIVER_USING_CONFIG_DIFF
+/*!
+ * \brief Configuration commands and registers whose last applied value is
+ *        kept, RadioSetRxConfig / RadioSetTxConfig only send the ones that
+ *        changed
+ */
+typedef enum
+{
+    SX126X_CONFIG_PACKET_TYPE,
+    SX126X_CONFIG_MODULATION_PARAMS,
+    SX126X_CONFIG_PACKET_PARAMS,
+    SX126X_CONFIG_TX_PARAMS,
+    SX126X_CONFIG_STOP_RX_TIMER_ON_PREAMBLE,
+    SX126X_CONFIG_LORA_SYMB_TIMEOUT,
+    SX126X_CONFIG_SYNC_WORD,
+    SX126X_CONFIG_CRC_SEED,
+    SX126X_CONFIG_CRC_POLYNOMIAL,
+    SX126X_CONFIG_WHITENING_SEED,
+    SX126X_CONFIG_IQ_POLARITY,
+    SX126X_CONFIG_TX_MODULATION,
+    SX126X_CONFIG_CAD_PARAMS,
+    SX126X_CONFIG_COUNT
+}SX126xConfigId_t;
+
+/*!
+ * Longest value kept for a configuration entry, SetPacketParams in GFSK
+ */
+#define SX126X_CONFIG_VALUE_SIZE                    9
+
+/*!
+ * \brief Configuration diffing counters
+ */
+typedef struct
+{
+    uint32_t Applied;                               //!< Configuration commands sent to the chip
+    uint32_t Skipped;                               //!< Configuration commands dropped, value already applied
+    uint32_t BytesSkipped;                          //!< Command parameter bytes not sent
+}SX126xConfigStats_t;
+
+/*!
+ * \brief Configuration values last applied to the chip, see SX126xConfigChanged
+ */
+typedef struct
+{
+    uint16_t Valid;                                 //!< one bit per SX126xConfigId_t
+    uint8_t Size[SX126X_CONFIG_COUNT];
+    uint8_t Value[SX126X_CONFIG_COUNT][SX126X_CONFIG_VALUE_SIZE];
+    SX126xConfigStats_t Stats;
+}SX126xConfigApplied_t;
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_SX126X_CAD_RX
+/*!
+ * \brief CAD_RX counters and detection to RxDone timing, see SX126xGetCadRxStats()
+ */
+typedef struct
+{
+    uint32_t Cads;                                  //!< SX126xStartCadRx calls
+    uint32_t Detections;                            //!< the chip entered RX by itself
+    uint32_t Frames;                                //!< RxDone after a detection
+    uint32_t Misses;                                //!< timeout, CRC or header error after a detection
+    uint32_t LastUs;                                //!< CadDone to RxDone of the last frame [us]
+    uint32_t MaxUs;
+    uint64_t TotalUs;                               //!< over Frames
+}SX126xCadRxStats_t;
+
+/*!
+ * \brief CAD_RX state of the radio driver
+ */
+typedef struct
+{
+    bool Armed;                                     //!< CAD started with the CAD_RX exit, CadDone not handled yet
+    bool Receiving;                                 //!< RX entered on the detection, not ended yet
+    uint32_t RxTimeout;                             //!< [ms] driver timer started on the detection, 0 for none
+    uint32_t DetectedUs;                            //!< LORA_RADIO_TIMESTAMP_US( ) of CadDone
+    SX126xCadRxStats_t Stats;
+}SX126xCadRx_t;
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+/*!
+ * \brief Channel of a channel plan, see SX126xSetChannelPlan
+ */
+typedef struct
+{
+    uint32_t Frequency;                             //!< RF frequency [Hz], set by the caller
+    uint8_t Frf[4];                                 //!< SetRfFrequency parameters
+    uint8_t ImageCalBand;                           //!< image calibration band of the frequency
+}SX126xChannel_t;
+#endif
+
+/*!
+ * Radio hardware and global parameters, one per radio instance
+ */
+typedef struct SX126x_s
+{
+////    Gpio_t        Reset;
+////    Gpio_t        BUSY;
+////    Gpio_t        DIO1;
+////    Gpio_t        DIO2;
+////    Gpio_t        DIO3;
+////    Spi_t         Spi;
+    
+ ////   #ifdef RT_USING_SPI
+    struct rt_spi_device *spi;
+////    #else
+////    //SPI_TypeDef *spi;
+////    #endif
+    
+    PacketParams_t PacketParams;
+    PacketStatus_t PacketStatus;
+    ModulationParams_t ModulationParams;
+
+    /*
+     * Chip state, sx126x.c
+     */
+    RadioOperatingModes_t OperatingMode;            //!< internal operating mode of the radio
+    RadioPacketTypes_t PacketType;                  //!< current packet type set in the radio
+    volatile RadioLoRaPacketLengthsMode_t LoRaHeaderType; //!< current packet header type set in the radio
+    uint32_t Frequency;                             //!< last RF frequency set [Hz]
+    int8_t ImageCalibratedBand;                     //!< band the image rejection is calibrated for
+    int8_t ImageCalibrationPending;                 //!< band requested by SX126xPrepareImageCalibration
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+    bool RxInFlight;                                //!< preamble / header detected, the frame has not ended yet
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+    SX126xChannel_t *ChannelPlan;                   //!< registered channel plan, sorted by frequency
+    uint16_t ChannelPlanSize;
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_CONFIG_DIFF
+    SX126xConfigApplied_t ConfigApplied;
+#endif
+
+    /*
+     * BUSY line, lora-spi-sx126x.c
+     */
+    struct rt_semaphore BusySem;
+    bool BusyIrqAttached;
+
+    /*
+     * Radio driver state, lora-radio-sx126x.c
+     */
+    RadioEvents_t *RadioEvents;                     //!< radio callbacks
+    TimerEvent_t TxTimeoutTimer;
+    TimerEvent_t RxTimeoutTimer;
+    uint32_t TxTimeout;
+    uint32_t RxTimeout;
+    bool RxContinuous;
+    bool IrqFired;
+    uint8_t MaxPayloadLength;
+    struct
+    {
+        bool Previous;
+        bool Current;
+    }PublicNetwork;                                 //!< current network type for the radio
+    PacketStatus_t RadioPktStatus;
+    uint8_t RadioRxPayload[255];
+#ifdef LORA_RADIO_DRIVER_USING_SX126X_CAD_RX
+    SX126xCadRx_t CadRx;
+#endif
+}SX126x_t;
+
 /*!
  * ============================================================================
  * Public functions prototypes
@@ -935,6 +1075,23 @@ void SX126xCalibrate( CalibrationParams_t calibParam );
  */
 void SX126xCalibrateImage( uint32_t freq );
 
+/*!
+ * \brief Calibrates the Image rejection for the band of \a freq ahead of the
+ *        channel switch, so that SX126xSetRfFrequency does not pay for it.
+ *
+ *        Nothing is sent when the band is already calibrated. Outside STDBY_RC
+ *        the calibration is postponed to the next SX126xImageCalibrationIdle.
+ *
+ * \param [in]  freq    The next operating frequency
+ */
+void SX126xPrepareImageCalibration( uint32_t freq );
+
+/*!
+ * \brief Runs the calibration postponed by SX126xPrepareImageCalibration once
+ *        the radio is back in STDBY_RC
+ */
+void SX126xImageCalibrationIdle( void );
+
 /*!
  * \brief Activate the extention of the timeout when long preamble is used
  *
@@ -1034,6 +1191,21 @@ void SX126xSetDio3AsTcxoCtrl( RadioTcxoCtrlVoltage_t tcxoVoltage, uint32_t timeo
  */
 void SX126xSetRfFrequency( uint32_t frequency );
 
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+/*!
+ * \brief Registers a channel plan. The FRF word and image calibration band of
+ *        every channel are computed here once, SX126xSetRfFrequency then
+ *        looks them up instead of dividing by FREQ_STEP. Frequencies outside
+ *        the plan still work through the computation.
+ *
+ * \param [in]  channels      Channels with Frequency filled in, sorted and
+ *                            completed by the call. Kept by the driver until
+ *                            the next call, RT_NULL removes the plan
+ * \param [in]  count         Number of channels
+ */
+void SX126xSetChannelPlan( SX126xChannel_t *channels, uint16_t count );
+#endif
+
 /*!
  * \brief Sets the radio for the given protocol
  *
@@ -1088,6 +1260,25 @@ void SX126xSetPacketParams( PacketParams_t *packetParams );
  */
 void SX126xSetCadParams( RadioLoRaCadSymbols_t cadSymbolNum, uint8_t cadDetPeak, uint8_t cadDetMin, RadioCadExitModes_t cadExitMode, uint32_t cadTimeout );
 
+#ifdef LORA_RADIO_DRIVER_USING_SX126X_CAD_RX
+/*!
+ * \brief Starts a CAD whose detection drops the chip into RX by itself, with
+ *        no PHY thread round trip between the two. CadDone is called as for
+ *        Radio.StartCad, then RxDone / RxTimeout / RxError of the window as
+ *        for Radio.Rx( timeout ) with the SetRxConfig settings. Without
+ *        activity the chip returns to standby.
+ *
+ * \param [IN] timeout [ms] RX timeout started on the detection, 0 for none
+ */
+void SX126xStartCadRx( uint32_t timeout );
+
+/*!
+ * \brief Gets / clears the CAD_RX counters of the selected radio instance
+ */
+void SX126xGetCadRxStats( SX126xCadRxStats_t *stats );
+void SX126xResetCadRxStats( void );
+#endif
+
 /*!
  * \brief Sets the data buffer base address for transmission and reception
  *
@@ -1144,9 +1335,46 @@ void SX126xClearDeviceErrors( void );
  */
 void SX126xClearIrqStatus( uint16_t irq );
 
+#ifdef LORA_RADIO_DRIVER_USING_CONFIG_DIFF
+/*!
+ * \brief Compares a configuration value with the one last applied to the chip
+ *        and records it
+ *
+ * \param [in]  id            Configuration entry
+ * \param [in]  value         Value about to be applied, usually the command parameters
+ * \param [in]  size          Value size, at most SX126X_CONFIG_VALUE_SIZE
+ *
+ * \retval changed            true when the value has to be sent to the chip
+ */
+bool SX126xConfigChanged( SX126xConfigId_t id, const uint8_t *value, uint8_t size );
+
+/*!
+ * \brief Forgets every applied configuration value, the next configuration
+ *        call sends all of them. Called on reset, cold sleep and packet type
+ *        changes
+ */
+void SX126xConfigInvalidate( void );
+
+/*!
+ * \brief Gets the configuration diffing counters
+ *
+ * \param [out] stats         Counters since the last reset
+ */
+void SX126xGetConfigStats( SX126xConfigStats_t *stats );
+
+/*!
+ * \brief Clears the configuration diffing counters
+ */
+void SX126xResetConfigStats( void );
+#else
+#define SX126xConfigChanged( id, value, size )      ( true )
+#define SX126xConfigInvalidate( )
+#endif
+
 /*!
- * Radio hardware and global parameters
+ * Radio hardware and global parameters of the selected radio instance,
+ * see lora_radio_lock()
  */
-extern SX126x_t SX126x;
+extern SX126x_t *SX126x;
 
 #endif // __SX126x_H__
@@ -36,23 +36,17 @@
 
 #define EV_LORA_RADIO_IRQ_MASK         0x0007 // DIO0 | DIO1 | DIO2 | DIO3 | DIO4 | DIO5 depend on board
 
-#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-static struct rt_event lora_radio_event;
-static struct rt_thread lora_radio_thread;
-static rt_uint8_t rt_lora_radio_thread_stack[4096];
-                            
 extern struct rt_spi_device *lora_radio_spi_init(const char *bus_name, const char *lora_device_name, rt_uint8_t param);
 
-#endif
-
 #endif // end of LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
 
 static bool SX127xRadioInit( RadioEvents_t *events );
 
 /*!
- * Radio driver structure initialization
+ * Radio driver structure initialization, called through the Radio shim
+ * and the lora_radio_xxx API with the radio instance selected
  */
-const struct Radio_s Radio =
+const struct Radio_s LoRaRadioOps =
 {
     SX127xRadioInit,
     SX127xGetStatus,
@@ -82,46 +76,121 @@ const struct Radio_s Radio =
     SX127xCheck,
     //SX126x Only
     NULL, // void ( *RxBoosted )( uint32_t timeout ) 
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE
+    SX127xSetRxDutyCycle,
+#else
     NULL, // void ( *SetRxDutyCycle )( uint32_t rxTime, uint32_t sleepTime ) 
+#endif
 };
 
 #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
 
-static uint8_t get_irq_index(uint32_t ev)
+/*!
+ * DIO events of one wakeup are handled class by class, lowest DIO first
+ * within a class. FSK: PreambleDetect (DIO4) and SyncAddress (DIO2) open the
+ * frame and latch its RSSI, FifoLevel (DIO1) drains the FIFO, then
+ * PayloadReady / PacketSent (DIO0) closes the frame. LoRa: RxDone / TxDone
+ * (DIO0) ahead of RxTimeout (DIO1), the plain DIO order.
+ */
+static const uint32_t SX127xFskDioClasses[] =
+{
+    EV_LORA_RADIO_IRQ2_FIRED | EV_LORA_RADIO_IRQ4_FIRED,
+    EV_LORA_RADIO_IRQ1_FIRED,
+    EV_LORA_RADIO_IRQ0_FIRED | EV_LORA_RADIO_IRQ3_FIRED | EV_LORA_RADIO_IRQ5_FIRED,
+};
+
+static const uint32_t SX127xLoRaDioClasses[] =
+{
+    EV_LORA_RADIO_IRQ0_FIRED | EV_LORA_RADIO_IRQ1_FIRED | EV_LORA_RADIO_IRQ2_FIRED |
+    EV_LORA_RADIO_IRQ3_FIRED | EV_LORA_RADIO_IRQ4_FIRED | EV_LORA_RADIO_IRQ5_FIRED,
+};
+
+/*!
+ * \brief Index of the lowest DIO event set in \a events, not 0
+ */
+static uint8_t SX127xDioIndex( uint32_t events )
 {
-    uint32_t i = 0;
-    for(i = 0; i < 32; i++)
+#if defined( __GNUC__ )
+    return ( uint8_t )__builtin_ctz( events );
+#else
+    static const uint8_t DeBruijn[32] =
     {
-        if(ev & 0x01)
-        {
-            break;
-        }
-        ev >>= 1;
-    }
-    return i;
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
+    return DeBruijn[( ( events & ( 0 - events ) ) * 0x077CB531UL ) >> 27];
+#endif
 }
 
-#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-/**
-  * @brief  lora_radio_thread_entry
-  * @param  None
-  * @retval None
-  */
-void lora_radio_thread_entry(void* parameter)
+/*!
+ * \brief Called by the PHY thread of the instance with the DIO events it
+ *        received. Handles every pending event, then those raised meanwhile,
+ *        before the driver lock is given back. With the event ring the
+ *        thread calls it once per edge, in order.
+ */
+void lora_radio_chip_irq_process( uint32_t events )
 {
-    rt_uint32_t ev;
-    
-    while(1)
+    const uint32_t *classes;
+    uint32_t count, pending, batch, i;
+    rt_uint32_t more;
+    uint8_t dio;
+
+    events &= EV_LORA_RADIO_IRQ_MASK;
+    while( events != 0 )
     {
-        if (rt_event_recv(&lora_radio_event, EV_LORA_RADIO_IRQ_MASK,
-                                RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR,
-                                RT_WAITING_FOREVER, &ev) == RT_EOK)
+        SX127x->DioStats.Wakeups++;
+        // more than one DIO: each of them was coalesced into this wakeup
+        if( ( events & ( events - 1 ) ) != 0 )
+        {
+            for( pending = events; pending != 0; pending &= pending - 1 )
+            {
+                SX127x->DioStats.Coalesced[SX127xDioIndex( pending )]++;
+            }
+        }
+
+        if( SX127x->Settings.Modem == MODEM_FSK )
+        {
+            classes = SX127xFskDioClasses;
+            count = sizeof( SX127xFskDioClasses ) / sizeof( SX127xFskDioClasses[0] );
+        }
+        else
+        {
+            classes = SX127xLoRaDioClasses;
+            count = sizeof( SX127xLoRaDioClasses ) / sizeof( SX127xLoRaDioClasses[0] );
+        }
+        for( i = 0; i < count; i++ )
+        {
+            for( batch = events & classes[i]; batch != 0; batch &= batch - 1 )
+            {
+                dio = SX127xDioIndex( batch );
+                SX127x->DioStats.Events[dio]++;
+                RadioIrqProcess( dio );
+            }
+        }
+
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+        // the PHY thread hands over the next edges in order from the ring
+        more = 0;
+#else
+        if( rt_event_recv( &lora_radio_current( )->Event, EV_LORA_RADIO_IRQ_MASK,
+                           RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, RT_WAITING_NO, &more ) != RT_EOK )
         {
-            RadioIrqProcess(get_irq_index(ev));
+            more = 0;
         }
+#endif
+        events = more & EV_LORA_RADIO_IRQ_MASK;
     }
 }
-#endif
+
+void SX127xGetDioStats( SX127xDioStats_t *stats )
+{
+    *stats = SX127x->DioStats;
+}
+
+void SX127xResetDioStats( void )
+{
+    rt_memset( &SX127x->DioStats, 0, sizeof( SX127x->DioStats ) );
+}
 
 bool SX127xRadioInit( RadioEvents_t *events )
 {
@@ -129,8 +198,8 @@ bool SX127xRadioInit( RadioEvents_t *events )
     
     #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
     // Initialize spi bus
-    SX127x.spi = lora_radio_spi_init(LORA_RADIO0_SPI_BUS_NAME, LORA_RADIO0_DEVICE_NAME, RT_NULL);
-    if (SX127x.spi == RT_NULL)
+    SX127x->spi = lora_radio_spi_init(LORA_RADIO_SPI_BUS_NAME, LORA_RADIO_DEVICE_NAME, RT_NULL);
+    if (SX127x->spi == RT_NULL)
     {
         LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "SX127x SPI Init Failed\n");
         return false;
@@ -139,57 +208,44 @@ bool SX127xRadioInit( RadioEvents_t *events )
     LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "SX127x SPI Init Succeed\n");
     
     SX127xInit(events);
-#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-    rt_event_init(&lora_radio_event, "ev_lora_phy", RT_IPC_FLAG_FIFO);
-
-    rt_thread_init(&lora_radio_thread,               	  
-                   "lora-phy",                     	  
-                   lora_radio_thread_entry,          	  
-                   RT_NULL,                    	  
-                   &rt_lora_radio_thread_stack[0],       
-                   sizeof(rt_lora_radio_thread_stack),  
-                   1,   // highest priority                       	  
-                   20);                           
-                               
-    rt_thread_startup(&lora_radio_thread);   
-#endif  
+
    return true;
 }
 
 void SX127xOnDio0IrqEvent( void *args )
 {
 #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-    rt_event_send(&lora_radio_event, EV_LORA_RADIO_IRQ0_FIRED);
+    lora_radio_notify( args, EV_LORA_RADIO_IRQ0_FIRED );
 #endif
     }
 void SX127xOnDio1IrqEvent( void *args )
 {
 #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-    rt_event_send(&lora_radio_event, EV_LORA_RADIO_IRQ1_FIRED);
+    lora_radio_notify( args, EV_LORA_RADIO_IRQ1_FIRED );
 #endif    
 }
 void SX127xOnDio2IrqEvent( void *args )
 {
 #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-    rt_event_send(&lora_radio_event, EV_LORA_RADIO_IRQ2_FIRED);
+    lora_radio_notify( args, EV_LORA_RADIO_IRQ2_FIRED );
 #endif  
 }
 void SX127xOnDio3IrqEvent( void *args )
 {
 #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-    rt_event_send(&lora_radio_event, EV_LORA_RADIO_IRQ3_FIRED);
+    lora_radio_notify( args, EV_LORA_RADIO_IRQ3_FIRED );
 #endif    
 }
 void SX127xOnDio4IrqEvent( void *args )
 {
 #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-    rt_event_send(&lora_radio_event, EV_LORA_RADIO_IRQ4_FIRED);
+    lora_radio_notify( args, EV_LORA_RADIO_IRQ4_FIRED );
 #endif
 }
 void SX127xOnDio5IrqEvent( void *args )
 {
 #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
-    rt_event_send(&lora_radio_event, EV_LORA_RADIO_IRQ5_FIRED);
+    lora_radio_notify( args, EV_LORA_RADIO_IRQ5_FIRED );
 #endif
 }
 
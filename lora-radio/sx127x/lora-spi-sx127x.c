@@ -29,7 +29,7 @@ void SX127xWriteBuffer( uint16_t addr, uint8_t *buffer, uint8_t size )
     msg2.cs_take    = 0;
     msg2.cs_release = 1;
     msg2.next       = RT_NULL;
-    rt_spi_transfer_message(SX127x.spi, &msg1);
+    rt_spi_transfer_message(SX127x->spi, &msg1);
 #else
 //    uint8_t i;
 
@@ -66,7 +66,7 @@ void SX127xReadBuffer( uint16_t addr, uint8_t *buffer, uint8_t size )
     msg2.cs_take    = 0;
     msg2.cs_release = 1;
     msg2.next       = RT_NULL;
-    rt_spi_transfer_message(SX127x.spi, &msg1);    
+    rt_spi_transfer_message(SX127x->spi, &msg1);    
 #else
 //    uint8_t i;
 
@@ -33,6 +33,11 @@
 #include "board.h" 
 #include "sx127x.h"
 #include "sx127x-board.h"
+#include "lora-radio-tx-queue.h"
+#include "lora-radio-rx-policy.h"
+#include "lora-radio-lbt.h"
+#include "lora-radio-noise-floor.h"
+#include "lora-radio-toa.h"
 
 #ifndef LORA_RADIO0_DEVICE_NAME
 #define LORA_RADIO0_DEVICE_NAME  "lora-radio0"
@@ -78,6 +83,85 @@ typedef struct
 static void RxChainCalibration( void );
 #endif
 
+/*!
+ * \brief Writes consecutive registers in one burst, through the shadow copy
+ *        when it is enabled
+ */
+static void SX127xWriteRegisters( uint16_t addr, uint8_t *buffer, uint8_t size );
+
+#ifdef LORA_RADIO_DRIVER_USING_CONFIG_DIFF
+/*!
+ * \brief Returns the modem selected by the last RegOpMode write
+ */
+static RadioModems_t SX127xShadowModem( void );
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+/*!
+ * \brief Takes a pool slot for the packet whose first byte is about to be
+ *        read, unless a slot is still held from an aborted reception
+ */
+static void SX127xRxPacketStart( void );
+
+/*!
+ * \brief Queues the received packet to the application
+ *
+ * \retval payload The payload to hand to RxDone
+ */
+static uint8_t *SX127xRxPacketDone( uint8_t size, int16_t rssi, int8_t snr );
+
+/*!
+ * Buffer the packet being received is read into, RxTxBuffer when the pool
+ * is exhausted
+ */
+#define SX127xRxBuffer( )                           ( ( SX127x->RxPacket != RT_NULL ) ? SX127x->RxPacket->Payload : SX127x->RxTxBuffer )
+#else
+#define SX127xRxPacketStart( )
+#define SX127xRxPacketDone( size, rssi, snr )       ( SX127x->RxTxBuffer )
+#define SX127xRxBuffer( )                           ( SX127x->RxTxBuffer )
+#endif
+
+/*!
+ * \brief Starts the receiver, SX127xSetRx without ending the sniff mode
+ */
+static void SX127xRxStart( uint32_t timeout );
+
+/*!
+ * \brief Starts a CAD, SX127xStartCad without ending the sniff mode
+ */
+static void SX127xCadStart( void );
+
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE
+/*!
+ * \brief End of the sleep between two CADs, \a context is the radio instance
+ */
+static void SX127xOnRxDutyCycleTimer( void *context );
+
+/*!
+ * \brief Sniff mode hook of CadDone
+ *
+ * \retval true when the CAD belongs to the sniff mode, CadDone is not called
+ */
+static bool SX127xRxDutyCycleCadDone( bool channelActivityDetected );
+
+/*!
+ * \brief Sniff mode hook of the end of a single RX, \a frame for RxDone and
+ *        CRC errors, false for the timeouts
+ *
+ * \retval true when sniffing resumed, RxTimeout is not called
+ */
+static bool SX127xRxDutyCycleRxEnd( bool frame );
+
+/*!
+ * \brief Ends the sniff mode, if running
+ */
+static void SX127xRxDutyCycleStop( void );
+#else
+#define SX127xRxDutyCycleCadDone( channelActivityDetected )     ( false )
+#define SX127xRxDutyCycleRxEnd( frame )                         ( false )
+#define SX127xRxDutyCycleStop( )
+#endif
+
 /*!
  * \brief Sets the SX127x in transmission mode for the given time
  * \param [IN] timeout Transmission timeout [ms] [0: continuous, others timeout]
@@ -144,7 +228,7 @@ void SX127xOnDio5Irq( void  );
 /*!
  * \brief Tx & Rx timeout timer callback
  */
-void SX127xOnTimeoutIrq( void );
+void SX127xOnTimeoutIrq( void* context );
 
 /*
  * Private global constants
@@ -205,23 +289,23 @@ const FskBandwidth_t FskBandwidths[] =
  */
 
 /*!
- * Radio callbacks variable
+ * Radio hardware and global parameters, one per radio instance
  */
-static RadioEvents_t *RadioEvents;
-
-/*!
- * Reception buffer
- */
-static uint8_t RxTxBuffer[RX_BUFFER_SIZE];
+static SX127x_t SX127xInstances[LORA_RADIO_DRIVER_INSTANCE_NUM];
 
 /*
  * Public global variables
  */
 
 /*!
- * Radio hardware and global parameters
+ * Radio hardware and global parameters of the selected instance
  */
-SX127x_t SX127x;
+SX127x_t *SX127x = &SX127xInstances[0];
+
+void lora_radio_chip_select( uint8_t index )
+{
+    SX127x = &SX127xInstances[index];
+}
 
 /*!
  * Hardware DIO IRQ callback initialization
@@ -229,13 +313,6 @@ SX127x_t SX127x;
 DioIrqHandler *SX127xDioIrq[] = { SX127xOnDio0Irq, SX127xOnDio1Irq,
                                   SX127xOnDio2Irq, SX127xOnDio3Irq,
                                   SX127xOnDio4Irq, NULL };
-
-/*!
- * Tx and Rx timers
- */
-TimerEvent_t TxTimeoutTimer;
-TimerEvent_t RxTimeoutTimer;
-TimerEvent_t RxTimeoutSyncWord;
                          
 /*
  * Radio spi check
@@ -245,7 +322,7 @@ uint8_t SX127xCheck(void)
 {
     uint8_t test = 0;
 
-    LORA_RADIO_DEBUG_LOG(LR_DBG_SPI, LOG_LEVEL, "LoRa Chip is SX127X, Packet Type is %s",( SX127x.Settings.Modem == MODEM_LORA )? "LoRa":"FSK");
+    LORA_RADIO_DEBUG_LOG(LR_DBG_SPI, LOG_LEVEL, "LoRa Chip is SX127X, Packet Type is %s",( SX127x->Settings.Modem == MODEM_LORA )? "LoRa":"FSK");
 
     {        
         /*spi check*/
@@ -268,18 +345,28 @@ void SX127xInit( RadioEvents_t *events )
 {
     uint8_t i; 
     
-    RadioEvents = events;
+    SX127x->RadioEvents = events;
 
     #ifdef PKG_USING_MULTI_RTIMER
     hw_rtc_init();
     #endif
     
     // Initialize driver timeout timers
-    TimerInit( &TxTimeoutTimer, SX127xOnTimeoutIrq );
-    TimerInit( &RxTimeoutTimer, SX127xOnTimeoutIrq );
-    TimerInit( &RxTimeoutSyncWord, SX127xOnTimeoutIrq );
+    TimerInit( &SX127x->TxTimeoutTimer, SX127xOnTimeoutIrq );
+    TimerSetContext( &SX127x->TxTimeoutTimer, lora_radio_current( ) );
+    TimerInit( &SX127x->RxTimeoutTimer, SX127xOnTimeoutIrq );
+    TimerSetContext( &SX127x->RxTimeoutTimer, lora_radio_current( ) );
+    TimerInit( &SX127x->RxTimeoutSyncWord, SX127xOnTimeoutIrq );
+    TimerSetContext( &SX127x->RxTimeoutSyncWord, lora_radio_current( ) );
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE
+    TimerInit( &SX127x->RxDutyCycle.Timer, SX127xOnRxDutyCycleTimer );
+    TimerSetContext( &SX127x->RxDutyCycle.Timer, lora_radio_current( ) );
+#endif
 
     SX127xReset( );
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+    SX127xShadowInvalidate( );
+#endif
     
 #if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1276 ) 
     RxChainCalibration( );
@@ -297,38 +384,146 @@ void SX127xInit( RadioEvents_t *events )
 
     SX127xSetModem( MODEM_FSK );
 
-    SX127x.Settings.State = RF_IDLE;
+    SX127x->Settings.State = RF_IDLE;
 }
 
 RadioState_t SX127xGetStatus( void )
 {
-    return SX127x.Settings.State;
+    return SX127x->Settings.State;
 }
 
-void SX127xSetChannel( uint32_t freq )
+/*!
+ * \brief Gets the RegFrfMsb..RegFrfLsb values of \a freq
+ */
+static void SX127xGetFrf( uint32_t freq, uint8_t *frf )
 {
-    SX127x.Settings.Channel = freq;
     freq = ( uint32_t )( ( double )freq / ( double )FREQ_STEP );
-    SX127xWrite( REG_FRFMSB, ( uint8_t )( ( freq >> 16 ) & 0xFF ) );
-    SX127xWrite( REG_FRFMID, ( uint8_t )( ( freq >> 8 ) & 0xFF ) );
-    SX127xWrite( REG_FRFLSB, ( uint8_t )( freq & 0xFF ) );
-    
-    LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"Set Freq:%d",SX127x.Settings.Channel);
+    frf[0] = ( uint8_t )( ( freq >> 16 ) & 0xFF );
+    frf[1] = ( uint8_t )( ( freq >> 8 ) & 0xFF );
+    frf[2] = ( uint8_t )( freq & 0xFF );
 }
 
-bool SX127xIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime )
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+/*!
+ * \brief Binary search of \a freq in the channel plan
+ *
+ * \retval channel The channel, RT_NULL when the plan does not hold it
+ */
+static const SX127xChannel_t *SX127xChannelPlanFind( uint32_t freq )
 {
-    bool status = true;
-    int16_t rssi = 0;
-    uint32_t carrierSenseTime = 0;
+    uint16_t low = 0, high = SX127x->ChannelPlanSize, mid;
+
+    while( low < high )
+    {
+        mid = ( low + high ) / 2;
+        if( SX127x->ChannelPlan[mid].Frequency < freq )
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    if( ( low < SX127x->ChannelPlanSize ) && ( SX127x->ChannelPlan[low].Frequency == freq ) )
+    {
+        return &SX127x->ChannelPlan[low];
+    }
+    return RT_NULL;
+}
+
+void SX127xSetChannelPlan( SX127xChannel_t *channels, uint16_t count )
+{
+    SX127xChannel_t channel;
+    uint16_t i, j;
+
+    SX127x->ChannelPlanSize = 0;
+    SX127x->ChannelPlan = channels;
+    if( channels == RT_NULL )
+    {
+        return;
+    }
+    for( i = 0; i < count; i++ )
+    {
+        channel = channels[i];
+        SX127xGetFrf( channel.Frequency, channel.Frf );
+
+        // insertion sort, the plan is registered once
+        for( j = i; ( j > 0 ) && ( channels[j - 1].Frequency > channel.Frequency ); j-- )
+        {
+            channels[j] = channels[j - 1];
+        }
+        channels[j] = channel;
+    }
+    SX127x->ChannelPlanSize = count;
+}
+#endif
+
+void SX127xSetChannel( uint32_t freq )
+{
+    uint8_t frf[3];
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+    const SX127xChannel_t *channel = SX127xChannelPlanFind( freq );
+
+    if( channel != RT_NULL )
+    {
+        rt_memcpy( frf, channel->Frf, sizeof( frf ) );
+    }
+    else
+#endif
+    {
+        SX127xGetFrf( freq, frf );
+    }
+    SX127x->Settings.Channel = freq;
 
+    // The new frequency is taken into account when RegFrfLsb is written,
+    // the three registers always go together
+    SX127xWriteRegisters( REG_FRFMSB, frf, 3 );
+    
+    LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"Set Freq:%d",SX127x->Settings.Channel);
+}
+
+void lora_radio_chip_rssi_start( RadioModems_t modem, uint32_t freq )
+{
     SX127xSetSleep( );
 
     SX127xSetModem( modem );
 
+    if( freq != 0 )
+    {
+        SX127xSetChannel( freq );
+    }
+
+    SX127xSetOpMode( RF_OPMODE_RECEIVER );
+}
+
+void lora_radio_chip_rssi_retune( uint32_t freq )
+{
+    SX127xSetOpMode( RF_OPMODE_STANDBY );
+
     SX127xSetChannel( freq );
 
     SX127xSetOpMode( RF_OPMODE_RECEIVER );
+}
+
+uint32_t lora_radio_chip_get_channel( void )
+{
+    return SX127x->Settings.Channel;
+}
+
+bool SX127xIsChannelFree( RadioModems_t modem, uint32_t freq, int16_t rssiThresh, uint32_t maxCarrierSenseTime )
+{
+    bool status = true;
+    int16_t rssi = 0;
+    uint32_t carrierSenseTime = 0;
+
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+    if( rssiThresh == LORA_RADIO_RSSI_THRESH_AUTO )
+    {
+        rssiThresh = lora_radio_noise_floor_threshold( lora_radio_current( ), freq );
+    }
+#endif
+    lora_radio_chip_rssi_start( modem, freq );
 
     DelayMs( 1 );
 
@@ -461,16 +656,16 @@ void SX127xSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
     {
     case MODEM_FSK:
         {
-            SX127x.Settings.Fsk.Bandwidth = bandwidth;
-            SX127x.Settings.Fsk.Datarate = datarate;
-            SX127x.Settings.Fsk.BandwidthAfc = bandwidthAfc;
-            SX127x.Settings.Fsk.FixLen = fixLen;
-            SX127x.Settings.Fsk.PayloadLen = payloadLen;
-            SX127x.Settings.Fsk.CrcOn = crcOn;
-            SX127x.Settings.Fsk.IqInverted = iqInverted;
-            SX127x.Settings.Fsk.RxContinuous = rxContinuous;
-            SX127x.Settings.Fsk.PreambleLen = preambleLen;
-            SX127x.Settings.Fsk.RxSingleTimeout = ( uint32_t )( symbTimeout * ( ( 1.0 / ( double )datarate ) * 8.0 ) * 1000 );
+            SX127x->Settings.Fsk.Bandwidth = bandwidth;
+            SX127x->Settings.Fsk.Datarate = datarate;
+            SX127x->Settings.Fsk.BandwidthAfc = bandwidthAfc;
+            SX127x->Settings.Fsk.FixLen = fixLen;
+            SX127x->Settings.Fsk.PayloadLen = payloadLen;
+            SX127x->Settings.Fsk.CrcOn = crcOn;
+            SX127x->Settings.Fsk.IqInverted = iqInverted;
+            SX127x->Settings.Fsk.RxContinuous = rxContinuous;
+            SX127x->Settings.Fsk.PreambleLen = preambleLen;
+            SX127x->Settings.Fsk.RxSingleTimeout = ( uint32_t )( symbTimeout * ( ( 1.0 / ( double )datarate ) * 8.0 ) * 1000 );
 
             datarate = ( uint16_t )( ( double )XTAL_FREQ / ( double )datarate );
             SX127xWrite( REG_BITRATEMSB, ( uint8_t )( datarate >> 8 ) );
@@ -511,17 +706,17 @@ void SX127xSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
 #if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1276 ) || defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1278 ) 			
             bandwidth += 7;
 #endif
-            SX127x.Settings.LoRa.Bandwidth = bandwidth;
-            SX127x.Settings.LoRa.Datarate = datarate;
-            SX127x.Settings.LoRa.Coderate = coderate;
-            SX127x.Settings.LoRa.PreambleLen = preambleLen;
-            SX127x.Settings.LoRa.FixLen = fixLen;
-            SX127x.Settings.LoRa.PayloadLen = payloadLen;
-            SX127x.Settings.LoRa.CrcOn = crcOn;
-            SX127x.Settings.LoRa.FreqHopOn = freqHopOn;
-            SX127x.Settings.LoRa.HopPeriod = hopPeriod;
-            SX127x.Settings.LoRa.IqInverted = iqInverted;
-            SX127x.Settings.LoRa.RxContinuous = rxContinuous;
+            SX127x->Settings.LoRa.Bandwidth = bandwidth;
+            SX127x->Settings.LoRa.Datarate = datarate;
+            SX127x->Settings.LoRa.Coderate = coderate;
+            SX127x->Settings.LoRa.PreambleLen = preambleLen;
+            SX127x->Settings.LoRa.FixLen = fixLen;
+            SX127x->Settings.LoRa.PayloadLen = payloadLen;
+            SX127x->Settings.LoRa.CrcOn = crcOn;
+            SX127x->Settings.LoRa.FreqHopOn = freqHopOn;
+            SX127x->Settings.LoRa.HopPeriod = hopPeriod;
+            SX127x->Settings.LoRa.IqInverted = iqInverted;
+            SX127x->Settings.LoRa.RxContinuous = rxContinuous;
 
             if( datarate > 12 )
             {
@@ -535,11 +730,11 @@ void SX127xSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
             if( ( ( bandwidth == 7 ) && ( ( datarate == 11 ) || ( datarate == 12 ) ) ) ||
                 ( ( bandwidth == 8 ) && ( datarate == 12 ) ) )
             {
-                SX127x.Settings.LoRa.LowDatarateOptimize = 0x01;
+                SX127x->Settings.LoRa.LowDatarateOptimize = 0x01;
             }
             else
             {
-                SX127x.Settings.LoRa.LowDatarateOptimize = 0x00;
+                SX127x->Settings.LoRa.LowDatarateOptimize = 0x00;
             }
 
             SX127xWrite( REG_LR_MODEMCONFIG1,
@@ -561,7 +756,7 @@ void SX127xSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
             SX127xWrite( REG_LR_MODEMCONFIG3,
                          ( SX127xRead( REG_LR_MODEMCONFIG3 ) &
                            RFLR_MODEMCONFIG3_LOWDATARATEOPTIMIZE_MASK ) |
-                           ( SX127x.Settings.LoRa.LowDatarateOptimize << 3 ) );
+                           ( SX127x->Settings.LoRa.LowDatarateOptimize << 3 ) );
 
 #elif defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1272 )
       		if( ( ( bandwidth == 0 ) && ( ( datarate == 11 ) || ( datarate == 12 ) ) ) ||
@@ -604,14 +799,14 @@ void SX127xSetRxConfig( RadioModems_t modem, uint32_t bandwidth,
                 SX127xWrite( REG_LR_PAYLOADLENGTH, payloadLen );
             }
 
-            if( SX127x.Settings.LoRa.FreqHopOn == true )
+            if( SX127x->Settings.LoRa.FreqHopOn == true )
             {
                 SX127xWrite( REG_LR_PLLHOP, ( SX127xRead( REG_LR_PLLHOP ) & RFLR_PLLHOP_FASTHOP_MASK ) | RFLR_PLLHOP_FASTHOP_ON );
-                SX127xWrite( REG_LR_HOPPERIOD, SX127x.Settings.LoRa.HopPeriod );
+                SX127xWrite( REG_LR_HOPPERIOD, SX127x->Settings.LoRa.HopPeriod );
             }
 			
 #if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1276 ) || defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1278 ) 
-            if( ( bandwidth == 9 ) && ( SX127x.Settings.Channel > RF_MID_BAND_THRESH ) )
+            if( ( bandwidth == 9 ) && ( SX127x->Settings.Channel > RF_MID_BAND_THRESH ) )
             {
                 // ERRATA 2.1 - Sensitivity Optimization with a 500 kHz Bandwidth
                 SX127xWrite( REG_LR_HIGHBWOPTIMIZE1, 0x02 );
@@ -736,15 +931,15 @@ void SX127xSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
     {
     case MODEM_FSK:
         {
-            SX127x.Settings.Fsk.Power = power;
-            SX127x.Settings.Fsk.Fdev = fdev;
-            SX127x.Settings.Fsk.Bandwidth = bandwidth;
-            SX127x.Settings.Fsk.Datarate = datarate;
-            SX127x.Settings.Fsk.PreambleLen = preambleLen;
-            SX127x.Settings.Fsk.FixLen = fixLen;
-            SX127x.Settings.Fsk.CrcOn = crcOn;
-            SX127x.Settings.Fsk.IqInverted = iqInverted;
-            SX127x.Settings.Fsk.TxTimeout = timeout;
+            SX127x->Settings.Fsk.Power = power;
+            SX127x->Settings.Fsk.Fdev = fdev;
+            SX127x->Settings.Fsk.Bandwidth = bandwidth;
+            SX127x->Settings.Fsk.Datarate = datarate;
+            SX127x->Settings.Fsk.PreambleLen = preambleLen;
+            SX127x->Settings.Fsk.FixLen = fixLen;
+            SX127x->Settings.Fsk.CrcOn = crcOn;
+            SX127x->Settings.Fsk.IqInverted = iqInverted;
+            SX127x->Settings.Fsk.TxTimeout = timeout;
 
             fdev = ( uint16_t )( ( double )fdev / ( double )FREQ_STEP );
             SX127xWrite( REG_FDEVMSB, ( uint8_t )( fdev >> 8 ) );
@@ -768,7 +963,7 @@ void SX127xSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
         break;
     case MODEM_LORA:
         {
-            SX127x.Settings.LoRa.Power = power;
+            SX127x->Settings.LoRa.Power = power;
             if( bandwidth > 2 )
             {
                 // Fatal error: When using LoRa modem only bandwidths 125, 250 and 500 kHz are supported
@@ -777,16 +972,16 @@ void SX127xSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
 #if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1276 ) || defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1278 ) 
             bandwidth += 7;
 #endif
-            SX127x.Settings.LoRa.Bandwidth = bandwidth;
-            SX127x.Settings.LoRa.Datarate = datarate;
-            SX127x.Settings.LoRa.Coderate = coderate;
-            SX127x.Settings.LoRa.PreambleLen = preambleLen;
-            SX127x.Settings.LoRa.FixLen = fixLen;
-            SX127x.Settings.LoRa.FreqHopOn = freqHopOn;
-            SX127x.Settings.LoRa.HopPeriod = hopPeriod;
-            SX127x.Settings.LoRa.CrcOn = crcOn;
-            SX127x.Settings.LoRa.IqInverted = iqInverted;
-            SX127x.Settings.LoRa.TxTimeout = timeout;
+            SX127x->Settings.LoRa.Bandwidth = bandwidth;
+            SX127x->Settings.LoRa.Datarate = datarate;
+            SX127x->Settings.LoRa.Coderate = coderate;
+            SX127x->Settings.LoRa.PreambleLen = preambleLen;
+            SX127x->Settings.LoRa.FixLen = fixLen;
+            SX127x->Settings.LoRa.FreqHopOn = freqHopOn;
+            SX127x->Settings.LoRa.HopPeriod = hopPeriod;
+            SX127x->Settings.LoRa.CrcOn = crcOn;
+            SX127x->Settings.LoRa.IqInverted = iqInverted;
+            SX127x->Settings.LoRa.TxTimeout = timeout;
 
             if( datarate > 12 )
             {
@@ -800,17 +995,17 @@ void SX127xSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
             if( ( ( bandwidth == 7 ) && ( ( datarate == 11 ) || ( datarate == 12 ) ) ) ||
                 ( ( bandwidth == 8 ) && ( datarate == 12 ) ) )
             {
-                SX127x.Settings.LoRa.LowDatarateOptimize = 0x01;
+                SX127x->Settings.LoRa.LowDatarateOptimize = 0x01;
             }
             else
             {
-                SX127x.Settings.LoRa.LowDatarateOptimize = 0x00;
+                SX127x->Settings.LoRa.LowDatarateOptimize = 0x00;
             }
 
-            if( SX127x.Settings.LoRa.FreqHopOn == true )
+            if( SX127x->Settings.LoRa.FreqHopOn == true )
             {
                 SX127xWrite( REG_LR_PLLHOP, ( SX127xRead( REG_LR_PLLHOP ) & RFLR_PLLHOP_FASTHOP_MASK ) | RFLR_PLLHOP_FASTHOP_ON );
-                SX127xWrite( REG_LR_HOPPERIOD, SX127x.Settings.LoRa.HopPeriod );
+                SX127xWrite( REG_LR_HOPPERIOD, SX127x->Settings.LoRa.HopPeriod );
             }
 
             SX127xWrite( REG_LR_MODEMCONFIG1,
@@ -830,7 +1025,7 @@ void SX127xSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
             SX127xWrite( REG_LR_MODEMCONFIG3,
                          ( SX127xRead( REG_LR_MODEMCONFIG3 ) &
                            RFLR_MODEMCONFIG3_LOWDATARATEOPTIMIZE_MASK ) |
-                           ( SX127x.Settings.LoRa.LowDatarateOptimize << 3 ) );
+                           ( SX127x->Settings.LoRa.LowDatarateOptimize << 3 ) );
 #elif defined ( LORA_CHIP_SX1272 )
             if( ( ( bandwidth == 0 ) && ( ( datarate == 11 ) || ( datarate == 12 ) ) ) ||
                 ( ( bandwidth == 1 ) && ( datarate == 12 ) ) )
@@ -890,150 +1085,81 @@ void SX127xSetTxConfig( RadioModems_t modem, int8_t power, uint32_t fdev,
     }
 }
 
-
-static uint32_t SX127xGetLoRaBandwidthInHz( uint32_t bw )
-{
-    uint32_t bandwidthInHz = 0;
-
-    switch( bw )
-    {
-    case 0: // 125 kHz
-        bandwidthInHz = 125000UL;
-        break;
-    case 1: // 250 kHz
-        bandwidthInHz = 250000UL;
-        break;
-    case 2: // 500 kHz
-        bandwidthInHz = 500000UL;
-        break;
-    }
-
-    return bandwidthInHz;
-}
-
-static uint32_t SX127xGetGfskTimeOnAirNumerator( uint32_t datarate, uint8_t coderate,
-                              uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
-                              bool crcOn )
-{
-    const uint8_t syncWordLength = 3;
-
-    return ( preambleLen << 3 ) +
-           ( ( fixLen == false ) ? 8 : 0 ) +
-             ( syncWordLength << 3 ) +
-             ( ( payloadLen +
-               ( 0 ) + // Address filter size
-               ( ( crcOn == true ) ? 2 : 0 ) 
-               ) << 3 
-             );
-}
-
-static uint32_t SX127xGetLoRaTimeOnAirNumerator( uint32_t bandwidth,
+uint32_t SX127xGetTimeOnAir( RadioModems_t modem, uint32_t bandwidth,
                               uint32_t datarate, uint8_t coderate,
                               uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
                               bool crcOn )
 {
-    int32_t crDenom           = coderate + 4;
-    bool    lowDatareOptimize = false;
-
-    // Ensure that the preamble length is at least 12 symbols when using SF5 or
-    // SF6
-    if( ( datarate == 5 ) || ( datarate == 6 ) )
-    {
-        if( preambleLen < 12 )
-        {
-            preambleLen = 12;
-        }
-    }
-
-    if( ( ( bandwidth == 0 ) && ( ( datarate == 11 ) || ( datarate == 12 ) ) ) ||
-        ( ( bandwidth == 1 ) && ( datarate == 12 ) ) )
-    {
-        lowDatareOptimize = true;
-    }
-
-    int32_t ceilDenominator;
-    int32_t ceilNumerator = ( payloadLen << 3 ) +
-                            ( crcOn ? 16 : 0 ) -
-                            ( 4 * datarate ) +
-                            ( fixLen ? 0 : 20 );
+    LoRaRadioToa_t toa;
 
-    if( datarate <= 6 )
-    {
-        ceilDenominator = 4 * datarate;
-    }
-    else
+    switch( modem )
     {
-        ceilNumerator += 8;
-
-        if( lowDatareOptimize == true )
+    case MODEM_FSK:
+        if( lora_radio_toa_fsk( &toa, datarate, preambleLen, fixLen, crcOn ) == true )
         {
-            ceilDenominator = 4 * ( datarate - 2 );
+            return lora_radio_toa_ms( &toa, payloadLen );
         }
-        else
+        break;
+    case MODEM_LORA:
+        if( lora_radio_toa_lora( &toa, LORA_RADIO_TOA_SX127X, bandwidth, datarate, coderate,
+                                 preambleLen, fixLen, crcOn ) == true )
         {
-            ceilDenominator = 4 * datarate;
+            return lora_radio_toa_ms( &toa, payloadLen );
         }
+        break;
     }
-
-    if( ceilNumerator < 0 )
-    {
-        ceilNumerator = 0;
-    }
-
-    // Perform integral ceil()
-    int32_t intermediate =
-        ( ( ceilNumerator + ceilDenominator - 1 ) / ceilDenominator ) * crDenom + preambleLen + 12;
-
-    if( datarate <= 6 )
-    {
-        intermediate += 2;
-    }
-
-    return ( uint32_t )( ( 4 * intermediate + 1 ) * ( 1 << ( datarate - 2 ) ) );
+    return 0;
 }
-uint32_t SX127xGetTimeOnAir( RadioModems_t modem, uint32_t bandwidth,
-                              uint32_t datarate, uint8_t coderate,
-                              uint16_t preambleLen, bool fixLen, uint8_t payloadLen,
-                              bool crcOn )
+
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+/*!
+ * \brief Time on air [us] of a \a size bytes frame with the settings in use
+ */
+static uint32_t SX127xFrameTimeOnAirUs( uint8_t size )
 {
-  uint32_t numerator = 0;
-    uint32_t denominator = 1;
+    LoRaRadioToa_t toa;
+    uint32_t bandwidth;
+    bool ready;
 
-    switch( modem )
+    if( SX127x->Settings.Modem == MODEM_LORA )
     {
-    case MODEM_FSK:
+        // SX1276 / SX1278 keep the register value, 7 + the API index
+        bandwidth = SX127x->Settings.LoRa.Bandwidth;
+        if( bandwidth >= 7 )
         {
-            numerator   = 1000U * SX127xGetGfskTimeOnAirNumerator( datarate, coderate,
-                                                                  preambleLen, fixLen,
-                                                                  payloadLen, crcOn );
-            denominator = datarate;
+            bandwidth -= 7;
         }
-        break;
-    case MODEM_LORA:
-        {
-            numerator   = 1000U * SX127xGetLoRaTimeOnAirNumerator( bandwidth, datarate,
-                                                                  coderate, preambleLen,
-                                                                  fixLen, payloadLen, crcOn );
-            denominator = SX127xGetLoRaBandwidthInHz( bandwidth );
-        }
-        break;
+        // false while the modem is not configured
+        ready = lora_radio_toa_lora( &toa, LORA_RADIO_TOA_SX127X, bandwidth, SX127x->Settings.LoRa.Datarate,
+                                     SX127x->Settings.LoRa.Coderate, SX127x->Settings.LoRa.PreambleLen,
+                                     SX127x->Settings.LoRa.FixLen, SX127x->Settings.LoRa.CrcOn );
     }
-   // Perform integral ceil()
-    return ( numerator + denominator - 1 ) / denominator;
+    else
+    {
+        ready = lora_radio_toa_fsk( &toa, SX127x->Settings.Fsk.Datarate, SX127x->Settings.Fsk.PreambleLen,
+                                    SX127x->Settings.Fsk.FixLen, SX127x->Settings.Fsk.CrcOn );
+    }
+    return ( ready == true ) ? lora_radio_toa_us( &toa, size ) : 0;
 }
 
+// TxDone, RxDone and PayloadReady all come on DIO0
+#define SX127xTimestampCapture( tx, size )          lora_radio_timestamp_capture( tx, 0, SX127xFrameTimeOnAirUs( size ) )
+#else
+#define SX127xTimestampCapture( tx, size )
+#endif
+
 void SX127xSend( uint8_t *buffer, uint8_t size )
 {
     uint32_t txTimeout = 0;
 
-    switch( SX127x.Settings.Modem )
+    switch( SX127x->Settings.Modem )
     {
     case MODEM_FSK:
         {
-            SX127x.Settings.FskPacketHandler.NbBytes = 0;
-            SX127x.Settings.FskPacketHandler.Size = size;
+            SX127x->Settings.FskPacketHandler.NbBytes = 0;
+            SX127x->Settings.FskPacketHandler.Size = size;
 
-            if( SX127x.Settings.Fsk.FixLen == false )
+            if( SX127x->Settings.Fsk.FixLen == false )
             {
                 SX127xWriteFifo( ( uint8_t* )&size, 1 );
             }
@@ -1044,24 +1170,24 @@ void SX127xSend( uint8_t *buffer, uint8_t size )
 
             if( ( size > 0 ) && ( size <= 64 ) )
             {
-                SX127x.Settings.FskPacketHandler.ChunkSize = size;
+                SX127x->Settings.FskPacketHandler.ChunkSize = size;
             }
             else
             {
-                memcpy( RxTxBuffer, buffer, size );
+                memcpy( SX127x->RxTxBuffer, buffer, size );
                 //rt_memcpy( RxTxBuffer, buffer, size );
-                SX127x.Settings.FskPacketHandler.ChunkSize = 32;
+                SX127x->Settings.FskPacketHandler.ChunkSize = 32;
             }
 
             // Write payload buffer
-            SX127xWriteFifo( buffer, SX127x.Settings.FskPacketHandler.ChunkSize );
-            SX127x.Settings.FskPacketHandler.NbBytes += SX127x.Settings.FskPacketHandler.ChunkSize;
-            txTimeout = SX127x.Settings.Fsk.TxTimeout;
+            SX127xWriteFifo( buffer, SX127x->Settings.FskPacketHandler.ChunkSize );
+            SX127x->Settings.FskPacketHandler.NbBytes += SX127x->Settings.FskPacketHandler.ChunkSize;
+            txTimeout = SX127x->Settings.Fsk.TxTimeout;
         }
         break;
     case MODEM_LORA:
         {
-            if( SX127x.Settings.LoRa.IqInverted == true )
+            if( SX127x->Settings.LoRa.IqInverted == true )
             {
                 SX127xWrite( REG_LR_INVERTIQ, ( ( SX127xRead( REG_LR_INVERTIQ ) & RFLR_INVERTIQ_TX_MASK & RFLR_INVERTIQ_RX_MASK ) | RFLR_INVERTIQ_RX_OFF | RFLR_INVERTIQ_TX_ON ) );
                 SX127xWrite( REG_LR_INVERTIQ2, RFLR_INVERTIQ2_ON );
@@ -1072,7 +1198,7 @@ void SX127xSend( uint8_t *buffer, uint8_t size )
                 SX127xWrite( REG_LR_INVERTIQ2, RFLR_INVERTIQ2_OFF );
             }
 
-            SX127x.Settings.LoRaPacketHandler.Size = size;
+            SX127x->Settings.LoRaPacketHandler.Size = size;
 
             // Initializes the payload size
             SX127xWrite( REG_LR_PAYLOADLENGTH, size );
@@ -1089,7 +1215,7 @@ void SX127xSend( uint8_t *buffer, uint8_t size )
             }
             // Write payload buffer
             SX127xWriteFifo( buffer, size );
-            txTimeout = SX127x.Settings.LoRa.TxTimeout;
+            txTimeout = SX127x->Settings.LoRa.TxTimeout;
         }
         break;
         default:
@@ -1101,9 +1227,10 @@ void SX127xSend( uint8_t *buffer, uint8_t size )
 
 void SX127xSetSleep( void )
 {
-    TimerStop( &RxTimeoutTimer );
-    TimerStop( &TxTimeoutTimer );
-    TimerStop( &RxTimeoutSyncWord );
+    SX127xRxDutyCycleStop( );
+    TimerStop( &SX127x->RxTimeoutTimer );
+    TimerStop( &SX127x->TxTimeoutTimer );
+    TimerStop( &SX127x->RxTimeoutSyncWord );
 
     SX127xSetOpMode( RF_OPMODE_SLEEP );
 
@@ -1112,29 +1239,36 @@ void SX127xSetSleep( void )
     SX127xSetBoardTcxo( false );
 #endif
 
-    SX127x.Settings.State = RF_IDLE;
+    SX127x->Settings.State = RF_IDLE;
 }
 
 void SX127xSetStby( void )
 {
-    TimerStop( &RxTimeoutTimer );
-    TimerStop( &TxTimeoutTimer );
-    TimerStop( &RxTimeoutSyncWord );
+    SX127xRxDutyCycleStop( );
+    TimerStop( &SX127x->RxTimeoutTimer );
+    TimerStop( &SX127x->TxTimeoutTimer );
+    TimerStop( &SX127x->RxTimeoutSyncWord );
 
     SX127xSetOpMode( RF_OPMODE_STANDBY );
-    SX127x.Settings.State = RF_IDLE;
+    SX127x->Settings.State = RF_IDLE;
 }
 
 void SX127xSetRx( uint32_t timeout )
+{
+    SX127xRxDutyCycleStop( );
+    SX127xRxStart( timeout );
+}
+
+static void SX127xRxStart( uint32_t timeout )
 {
     bool rxContinuous = false;
-    TimerStop( &TxTimeoutTimer );
+    TimerStop( &SX127x->TxTimeoutTimer );
 
-    switch( SX127x.Settings.Modem )
+    switch( SX127x->Settings.Modem )
     {
     case MODEM_FSK:
         {
-            rxContinuous = SX127x.Settings.Fsk.RxContinuous;
+            rxContinuous = LORA_RADIO_RX_CONTINUOUS( SX127x->Settings.Fsk.RxContinuous );
 
             // DIO0=PayloadReady
             // DIO1=FifoLevel
@@ -1154,19 +1288,19 @@ void SX127xSetRx( uint32_t timeout )
                                                                             RF_DIOMAPPING2_DIO4_11 |
                                                                             RF_DIOMAPPING2_MAP_PREAMBLEDETECT );
 
-            SX127x.Settings.FskPacketHandler.FifoThresh = SX127xRead( REG_FIFOTHRESH ) & 0x3F;
+            SX127x->Settings.FskPacketHandler.FifoThresh = SX127xRead( REG_FIFOTHRESH ) & 0x3F;
 
             SX127xWrite( REG_RXCONFIG, RF_RXCONFIG_AFCAUTO_ON | RF_RXCONFIG_AGCAUTO_ON | RF_RXCONFIG_RXTRIGER_PREAMBLEDETECT );
 
-            SX127x.Settings.FskPacketHandler.PreambleDetected = false;
-            SX127x.Settings.FskPacketHandler.SyncWordDetected = false;
-            SX127x.Settings.FskPacketHandler.NbBytes = 0;
-            SX127x.Settings.FskPacketHandler.Size = 0;
+            SX127x->Settings.FskPacketHandler.PreambleDetected = false;
+            SX127x->Settings.FskPacketHandler.SyncWordDetected = false;
+            SX127x->Settings.FskPacketHandler.NbBytes = 0;
+            SX127x->Settings.FskPacketHandler.Size = 0;
         }
         break;
     case MODEM_LORA:
         {
-            if( SX127x.Settings.LoRa.IqInverted == true )
+            if( SX127x->Settings.LoRa.IqInverted == true )
             {
                 SX127xWrite( REG_LR_INVERTIQ, ( ( SX127xRead( REG_LR_INVERTIQ ) & RFLR_INVERTIQ_TX_MASK & RFLR_INVERTIQ_RX_MASK ) | RFLR_INVERTIQ_RX_ON | RFLR_INVERTIQ_TX_OFF ) );
                 SX127xWrite( REG_LR_INVERTIQ2, RFLR_INVERTIQ2_ON );
@@ -1179,35 +1313,35 @@ void SX127xSetRx( uint32_t timeout )
 			
 #if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1276 ) || defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1278 ) 
             // ERRATA 2.3 - Receiver Spurious Reception of a LoRa Signal
-            if( SX127x.Settings.LoRa.Bandwidth < 9 )
+            if( SX127x->Settings.LoRa.Bandwidth < 9 )
             {
                 SX127xWrite( REG_LR_DETECTOPTIMIZE, SX127xRead( REG_LR_DETECTOPTIMIZE ) & 0x7F );
                 SX127xWrite( REG_LR_IFFREQ2, 0x00 );
-                switch( SX127x.Settings.LoRa.Bandwidth )
+                switch( SX127x->Settings.LoRa.Bandwidth )
                 {
                 case 0: // 7.8 kHz
                     SX127xWrite( REG_LR_IFFREQ1, 0x48 );
-                    SX127xSetChannel(SX127x.Settings.Channel + 7810 );
+                    SX127xSetChannel(SX127x->Settings.Channel + 7810 );
                     break;
                 case 1: // 10.4 kHz
                     SX127xWrite( REG_LR_IFFREQ1, 0x44 );
-                    SX127xSetChannel(SX127x.Settings.Channel + 10420 );
+                    SX127xSetChannel(SX127x->Settings.Channel + 10420 );
                     break;
                 case 2: // 15.6 kHz
                     SX127xWrite( REG_LR_IFFREQ1, 0x44 );
-                    SX127xSetChannel(SX127x.Settings.Channel + 15620 );
+                    SX127xSetChannel(SX127x->Settings.Channel + 15620 );
                     break;
                 case 3: // 20.8 kHz
                     SX127xWrite( REG_LR_IFFREQ1, 0x44 );
-                    SX127xSetChannel(SX127x.Settings.Channel + 20830 );
+                    SX127xSetChannel(SX127x->Settings.Channel + 20830 );
                     break;
                 case 4: // 31.2 kHz
                     SX127xWrite( REG_LR_IFFREQ1, 0x44 );
-                    SX127xSetChannel(SX127x.Settings.Channel + 31250 );
+                    SX127xSetChannel(SX127x->Settings.Channel + 31250 );
                     break;
                 case 5: // 41.4 kHz
                     SX127xWrite( REG_LR_IFFREQ1, 0x44 );
-                    SX127xSetChannel(SX127x.Settings.Channel + 41670 );
+                    SX127xSetChannel(SX127x->Settings.Channel + 41670 );
                     break;
                 case 6: // 62.5 kHz
                     SX127xWrite( REG_LR_IFFREQ1, 0x40 );
@@ -1226,9 +1360,9 @@ void SX127xSetRx( uint32_t timeout )
             }
 #endif
 
-            rxContinuous = SX127x.Settings.LoRa.RxContinuous;
+            rxContinuous = LORA_RADIO_RX_CONTINUOUS( SX127x->Settings.LoRa.RxContinuous );
 
-            if( SX127x.Settings.LoRa.FreqHopOn == true )
+            if( SX127x->Settings.LoRa.FreqHopOn == true )
             {
                 SX127xWrite( REG_LR_IRQFLAGSMASK, //RFLR_IRQFLAGS_RXTIMEOUT |
                                                   //RFLR_IRQFLAGS_RXDONE |
@@ -1262,21 +1396,24 @@ void SX127xSetRx( uint32_t timeout )
         break;
     }
 
-    memset( RxTxBuffer, 0, ( size_t )RX_BUFFER_SIZE );
+#ifndef LORA_RADIO_DRIVER_USING_RX_POLICY
+    // a window restarted by the driver comes before the callback of the previous one, its payload may be there
+    memset( SX127x->RxTxBuffer, 0, ( size_t )RX_BUFFER_SIZE );
+#endif
 
-    SX127x.Settings.State = RF_RX_RUNNING;
+    SX127x->Settings.State = RF_RX_RUNNING;
     if( timeout != 0 )
     {
-        TimerSetValue( &RxTimeoutTimer, timeout );
-        TimerStart( &RxTimeoutTimer );
+        TimerSetValue( &SX127x->RxTimeoutTimer, timeout );
+        TimerStart( &SX127x->RxTimeoutTimer );
     }
 
-    if( SX127x.Settings.Modem == MODEM_FSK )
+    if( SX127x->Settings.Modem == MODEM_FSK )
     {
         SX127xSetOpMode( RF_OPMODE_RECEIVER );
 
-        TimerSetValue( &RxTimeoutSyncWord, SX127x.Settings.Fsk.RxSingleTimeout );
-        TimerStart( &RxTimeoutSyncWord );
+        TimerSetValue( &SX127x->RxTimeoutSyncWord, SX127x->Settings.Fsk.RxSingleTimeout );
+        TimerStart( &SX127x->RxTimeoutSyncWord );
     }
     else
     {
@@ -1293,11 +1430,12 @@ void SX127xSetRx( uint32_t timeout )
 
 void SX127xSetTx( uint32_t timeout )
 {
-    TimerStop( &RxTimeoutTimer );
+    SX127xRxDutyCycleStop( );
+    TimerStop( &SX127x->RxTimeoutTimer );
 
-    TimerSetValue( &TxTimeoutTimer, timeout );
+    TimerSetValue( &SX127x->TxTimeoutTimer, timeout );
 
-    switch( SX127x.Settings.Modem )
+    switch( SX127x->Settings.Modem )
     {
     case MODEM_FSK:
         {
@@ -1314,12 +1452,12 @@ void SX127xSetTx( uint32_t timeout )
 
             SX127xWrite( REG_DIOMAPPING2, ( SX127xRead( REG_DIOMAPPING2 ) & RF_DIOMAPPING2_DIO4_MASK &
                                                                             RF_DIOMAPPING2_MAP_MASK ) );
-            SX127x.Settings.FskPacketHandler.FifoThresh = SX127xRead( REG_FIFOTHRESH ) & 0x3F;
+            SX127x->Settings.FskPacketHandler.FifoThresh = SX127xRead( REG_FIFOTHRESH ) & 0x3F;
         }
         break;
     case MODEM_LORA:
         {
-            if( SX127x.Settings.LoRa.FreqHopOn == true )
+            if( SX127x->Settings.LoRa.FreqHopOn == true )
             {
                 SX127xWrite( REG_LR_IRQFLAGSMASK, RFLR_IRQFLAGS_RXTIMEOUT |
                                                   RFLR_IRQFLAGS_RXDONE |
@@ -1353,14 +1491,20 @@ void SX127xSetTx( uint32_t timeout )
             break;
     }
 
-    SX127x.Settings.State = RF_TX_RUNNING;
-    TimerStart( &TxTimeoutTimer );
+    SX127x->Settings.State = RF_TX_RUNNING;
+    TimerStart( &SX127x->TxTimeoutTimer );
     SX127xSetOpMode( RF_OPMODE_TRANSMITTER );
 }
 
 void SX127xStartCad( void )
 {
-    switch( SX127x.Settings.Modem )
+    SX127xRxDutyCycleStop( );
+    SX127xCadStart( );
+}
+
+static void SX127xCadStart( void )
+{
+    switch( SX127x->Settings.Modem )
     {
     case MODEM_FSK:
         {
@@ -1379,10 +1523,11 @@ void SX127xStartCad( void )
                                         //RFLR_IRQFLAGS_CADDETECTED
                                         );
 
-            // DIO3=CADDone
-            SX127xWrite( REG_DIOMAPPING1, ( SX127xRead( REG_DIOMAPPING1 ) & RFLR_DIOMAPPING1_DIO3_MASK ) | RFLR_DIOMAPPING1_DIO3_00 );
+            // DIO0=CadDone, DIO3=CADDone: the boards wire DIO0 to DIO2 only
+            SX127xWrite( REG_DIOMAPPING1, ( SX127xRead( REG_DIOMAPPING1 ) & RFLR_DIOMAPPING1_DIO0_MASK & RFLR_DIOMAPPING1_DIO3_MASK ) |
+                                          RFLR_DIOMAPPING1_DIO0_10 | RFLR_DIOMAPPING1_DIO3_00 );
 
-            SX127x.Settings.State = RF_CAD;
+            SX127x->Settings.State = RF_CAD;
             SX127xSetOpMode( RFLR_OPMODE_CAD );
         }
         break;
@@ -1391,6 +1536,206 @@ void SX127xStartCad( void )
     }
 }
 
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE
+/*!
+ * \brief Adds the phase in progress to its time counter and enters \a phase
+ */
+static void SX127xRxDutyCycleEnter( RadioState_t phase )
+{
+    SX127xRxDutyCycle_t *dc = &SX127x->RxDutyCycle;
+    uint32_t now = LORA_RADIO_TIMESTAMP_US( );
+    uint32_t elapsed = now - dc->PhaseStartUs;
+
+    switch( dc->Phase )
+    {
+    case RF_CAD:
+        dc->Stats.CadUs += elapsed;
+        break;
+    case RF_RX_RUNNING:
+        dc->Stats.RxUs += elapsed;
+        break;
+    default:
+        dc->Stats.SleepUs += elapsed;
+        break;
+    }
+    dc->Phase = phase;
+    dc->PhaseStartUs = now;
+}
+
+static void SX127xRxDutyCycleCad( void )
+{
+    SX127xRxDutyCycleEnter( RF_CAD );
+    SX127x->RxDutyCycle.Stats.Cads++;
+    SX127xCadStart( );
+}
+
+static void SX127xRxDutyCycleSleep( void )
+{
+    SX127xRxDutyCycle_t *dc = &SX127x->RxDutyCycle;
+
+    SX127xRxDutyCycleEnter( RF_IDLE );
+    if( dc->Stats.SleepPeriod == 0 )
+    {
+        // preamble too short to sleep at all, CADs back to back
+        SX127xRxDutyCycleCad( );
+        return;
+    }
+    SX127xSetOpMode( RF_OPMODE_SLEEP );
+    SX127x->Settings.State = RF_IDLE;
+    TimerSetValue( &dc->Timer, dc->Stats.SleepPeriod );
+    TimerStart( &dc->Timer );
+}
+
+static void SX127xOnRxDutyCycleTimer( void *context )
+{
+    LoRaRadio_t *previous = lora_radio_lock( context );
+
+    // a CadDone may have ended the sleep meanwhile
+    if( ( SX127x->RxDutyCycle.Active == true ) && ( SX127x->RxDutyCycle.Phase == RF_IDLE ) )
+    {
+        SX127xRxDutyCycleCad( );
+    }
+    lora_radio_unlock( previous );
+}
+
+static bool SX127xRxDutyCycleCadDone( bool channelActivityDetected )
+{
+    SX127xRxDutyCycle_t *dc = &SX127x->RxDutyCycle;
+
+    if( ( dc->Active == false ) || ( dc->Phase != RF_CAD ) )
+    {
+        return false;
+    }
+    if( channelActivityDetected == true )
+    {
+        dc->Stats.Detections++;
+        SX127xRxDutyCycleEnter( RF_RX_RUNNING );
+        SX127xRxStart( dc->RxTime );
+    }
+    else
+    {
+        SX127xRxDutyCycleSleep( );
+    }
+    return true;
+}
+
+static bool SX127xRxDutyCycleRxEnd( bool frame )
+{
+    SX127xRxDutyCycle_t *dc = &SX127x->RxDutyCycle;
+
+    if( ( dc->Active == false ) || ( dc->Phase != RF_RX_RUNNING ) )
+    {
+        return false;
+    }
+    if( frame == true )
+    {
+        dc->Stats.Frames++;
+        SX127xRxDutyCycleStop( );
+        return false;
+    }
+    dc->Stats.FalseWakeups++;
+    TimerStop( &SX127x->RxTimeoutTimer );
+    SX127xRxDutyCycleSleep( );
+    return true;
+}
+
+static void SX127xRxDutyCycleStop( void )
+{
+    SX127xRxDutyCycle_t *dc = &SX127x->RxDutyCycle;
+
+    if( dc->Active == false )
+    {
+        return;
+    }
+    TimerStop( &dc->Timer );
+    SX127xRxDutyCycleEnter( RF_IDLE );
+    dc->Active = false;
+}
+
+/*!
+ * \brief Longest sleep [ms] between two CADs that still leaves a whole CAD
+ *        and the lock symbols inside the preamble
+ */
+static uint32_t SX127xRxDutyCycleSleepPeriod( void )
+{
+    uint32_t bandwidth = SX127x->Settings.LoRa.Bandwidth;
+    uint32_t symbolUs, symbols, sleepUs, wakeupUs;
+
+    // SX1276 / SX1278 keep the register value, 7 + the API index
+    if( bandwidth >= 7 )
+    {
+        bandwidth -= 7;
+    }
+    if( ( SX127x->Settings.LoRa.Datarate < 6 ) || ( bandwidth > 2 ) )
+    {
+        return 0; // modem not configured
+    }
+    symbolUs = lora_radio_toa_symbol_us( bandwidth, SX127x->Settings.LoRa.Datarate );
+    // a CAD starting just after the preamble did, the next CAD and the lock
+    symbols = 2 * SX127X_RX_DUTY_CYCLE_CAD_SYMBOLS + SX127X_RX_DUTY_CYCLE_LOCK_SYMBOLS;
+    if( SX127x->Settings.LoRa.PreambleLen <= symbols )
+    {
+        return 0;
+    }
+    sleepUs = ( SX127x->Settings.LoRa.PreambleLen - symbols ) * symbolUs;
+    wakeupUs = SX127xGetWakeupTime( ) * 1000;
+    return ( sleepUs > wakeupUs ) ? ( sleepUs - wakeupUs ) / 1000 : 0;
+}
+
+void SX127xSetRxDutyCycle( uint32_t rxTime, uint32_t sleepTime )
+{
+    SX127xRxDutyCycle_t *dc = &SX127x->RxDutyCycle;
+
+    SX127xRxDutyCycleStop( );
+    if( ( SX127x->Settings.Modem != MODEM_LORA ) ||
+        ( LORA_RADIO_RX_CONTINUOUS( SX127x->Settings.LoRa.RxContinuous ) == true ) )
+    {
+        SX127xRxStart( 0 );
+        return;
+    }
+
+    // 15.625 us steps as SX126xSetRxDutyCycle, rounded up to the timer ms
+    dc->RxTime = ( rxTime + 63 ) / 64;
+    dc->Stats.SleepPeriod = ( sleepTime != 0 ) ? ( sleepTime + 63 ) / 64 : SX127xRxDutyCycleSleepPeriod( );
+    dc->Phase = RF_IDLE;
+    dc->PhaseStartUs = LORA_RADIO_TIMESTAMP_US( );
+    dc->Active = true;
+    SX127xRxDutyCycleCad( );
+}
+
+void SX127xGetRxDutyCycleStats( SX127xRxDutyCycleStats_t *stats )
+{
+    uint64_t total, charge;
+
+    if( SX127x->RxDutyCycle.Active == true )
+    {
+        // count the phase in progress
+        SX127xRxDutyCycleEnter( SX127x->RxDutyCycle.Phase );
+    }
+    *stats = SX127x->RxDutyCycle.Stats;
+
+    total = stats->SleepUs + stats->CadUs + stats->RxUs;
+    charge = stats->SleepUs * SX127X_RX_DUTY_CYCLE_SLEEP_NA + stats->CadUs * SX127X_RX_DUTY_CYCLE_CAD_NA +
+             stats->RxUs * SX127X_RX_DUTY_CYCLE_RX_NA;
+    stats->AverageCurrent = ( total != 0 ) ? ( uint32_t )( charge / total ) : 0;
+}
+
+void SX127xResetRxDutyCycleStats( void )
+{
+    SX127xRxDutyCycleStats_t *stats = &SX127x->RxDutyCycle.Stats;
+
+    stats->Cads = 0;
+    stats->Detections = 0;
+    stats->FalseWakeups = 0;
+    stats->Frames = 0;
+    stats->SleepUs = 0;
+    stats->CadUs = 0;
+    stats->RxUs = 0;
+    stats->AverageCurrent = 0;
+    SX127x->RxDutyCycle.PhaseStartUs = LORA_RADIO_TIMESTAMP_US( );
+}
+#endif
+
 void SX127xSetTxContinuousWave( uint32_t freq, int8_t power, uint16_t time )
 {
     uint32_t timeout = ( uint32_t )( time * 1000 );
@@ -1404,13 +1749,13 @@ void SX127xSetTxContinuousWave( uint32_t freq, int8_t power, uint16_t time )
     SX127xWrite( REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_11 | RF_DIOMAPPING1_DIO1_11 );
     SX127xWrite( REG_DIOMAPPING2, RF_DIOMAPPING2_DIO4_10 | RF_DIOMAPPING2_DIO5_10 );
     
-    SX127x.Settings.State = RF_TX_RUNNING;
+    SX127x->Settings.State = RF_TX_RUNNING;
     SX127xSetOpMode( RF_OPMODE_TRANSMITTER );
     
     if(timeout)
     {
-        TimerSetValue( &TxTimeoutTimer, timeout );
-        TimerStart( &TxTimeoutTimer );
+        TimerSetValue( &SX127x->TxTimeoutTimer, timeout );
+        TimerStart( &SX127x->TxTimeoutTimer );
     }
 }
 
@@ -1425,7 +1770,7 @@ int16_t SX127xReadRssi( RadioModems_t modem )
         break;
     case MODEM_LORA:
 #if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1276 ) || defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1278 ) 
-        if( SX127x.Settings.Channel > RF_MID_BAND_THRESH )
+        if( SX127x->Settings.Channel > RF_MID_BAND_THRESH )
         {
             rssi = RSSI_OFFSET_HF + SX127xRead( REG_LR_RSSIVALUE );
         }
@@ -1444,8 +1789,47 @@ int16_t SX127xReadRssi( RadioModems_t modem )
     return rssi;
 }
 
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+/*!
+ * \brief Reads the noise floor when the receiver is left, \a regOpMode the
+ *        RegOpMode value before the change
+ */
+static void SX127xNoiseFloorSample( uint8_t regOpMode, uint8_t opMode )
+{
+    uint8_t current = regOpMode & ~RF_OPMODE_MASK;
+    bool receiving;
+
+    if( ( ( current != RF_OPMODE_RECEIVER ) && ( current != RFLR_OPMODE_RECEIVER_SINGLE ) ) || ( opMode == current ) )
+    {
+        return;
+    }
+    if( SX127x->Settings.Modem == MODEM_LORA )
+    {
+        receiving = ( SX127xRead( REG_LR_MODEMSTAT ) & ( RFLR_MODEMSTAT_SIGNAL_DETECTED | RFLR_MODEMSTAT_SIGNAL_SYNCHRONIZED |
+                                                         RFLR_MODEMSTAT_HEADER_INFO_VALID ) ) != 0;
+    }
+    else
+    {
+        receiving = ( SX127xRead( REG_IRQFLAGS1 ) & ( RF_IRQFLAGS1_PREAMBLEDETECT | RF_IRQFLAGS1_SYNCADDRESSMATCH ) ) != 0;
+    }
+    if( receiving == true )
+    {
+        lora_radio_noise_floor_skip( );
+    }
+    else
+    {
+        lora_radio_noise_floor_sample( SX127x->Settings.Channel, SX127xReadRssi( SX127x->Settings.Modem ) );
+    }
+}
+#endif
+
 void SX127xSetOpMode( uint8_t opMode )
 {
+    uint8_t regOpMode = SX127xRead( REG_OPMODE );
+
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+    SX127xNoiseFloorSample( regOpMode, opMode );
+#endif
 #if defined( USE_RADIO_DEBUG )
     switch( opMode )
     {
@@ -1477,27 +1861,32 @@ void SX127xSetOpMode( uint8_t opMode )
         SX127xSetAntSwLowPower( false );
         SX127xSetAntSw( opMode );
     }
-    SX127xWrite( REG_OPMODE, ( SX127xRead( REG_OPMODE ) & RF_OPMODE_MASK ) | opMode );
+    SX127xWrite( REG_OPMODE, ( regOpMode & RF_OPMODE_MASK ) | opMode );
 }
 
 void SX127xSetModem( RadioModems_t modem )
 {
+#ifdef LORA_RADIO_DRIVER_USING_CONFIG_DIFF
+    // LongRangeMode only changes on a RegOpMode write, no need to read it back
+    SX127x->Settings.Modem = SX127xShadowModem( );
+#else
     if( ( SX127xRead( REG_OPMODE ) & RFLR_OPMODE_LONGRANGEMODE_ON ) != 0 )
     {
-        SX127x.Settings.Modem = MODEM_LORA;
+        SX127x->Settings.Modem = MODEM_LORA;
     }
     else
     {
-        SX127x.Settings.Modem = MODEM_FSK;
+        SX127x->Settings.Modem = MODEM_FSK;
     }
+#endif
 
-    if( SX127x.Settings.Modem == modem )
+    if( SX127x->Settings.Modem == modem )
     {
         return;
     }
 
-    SX127x.Settings.Modem = modem;
-    switch( SX127x.Settings.Modem )
+    SX127x->Settings.Modem = modem;
+    switch( SX127x->Settings.Modem )
     {
     default:
     case MODEM_FSK:
@@ -1517,18 +1906,188 @@ void SX127xSetModem( RadioModems_t modem )
     }
 }
 
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+/*!
+ * Registers the chip updates by itself or whose write starts an action.
+ * They are never served from the shadow copy and are always written.
+ */
+static const uint8_t ShadowVolatileCommon[] =
+{
+    REG_FIFO, REG_OPMODE, REG_FORMERTEMP,
+};
+
+static const uint8_t ShadowVolatileFsk[] =
+{
+    REG_RXCONFIG, REG_RSSIVALUE, REG_AFCFEI, REG_AFCMSB, REG_AFCLSB, REG_FEIMSB, REG_FEILSB,
+    REG_OSC, REG_SEQCONFIG1, REG_IMAGECAL, REG_TEMP, REG_IRQFLAGS1, REG_IRQFLAGS2,
+};
+
+static const uint8_t ShadowVolatileLoRa[] =
+{
+    REG_LR_FIFOADDRPTR, REG_LR_FIFORXCURRENTADDR, REG_LR_IRQFLAGS, REG_LR_RXNBBYTES,
+    REG_LR_RXHEADERCNTVALUEMSB, REG_LR_RXHEADERCNTVALUELSB, REG_LR_RXPACKETCNTVALUEMSB,
+    REG_LR_RXPACKETCNTVALUELSB, REG_LR_MODEMSTAT, REG_LR_PKTSNRVALUE, REG_LR_PKTRSSIVALUE,
+    REG_LR_RSSIVALUE, REG_LR_HOPCHANNEL, REG_LR_FIFORXBYTEADDR, REG_LR_FEIMSB, REG_LR_FEIMID,
+    REG_LR_FEILSB, REG_LR_RSSIWIDEBAND,
+};
+
+#define SHADOW_PAGE_FSK                             0
+#define SHADOW_PAGE_LORA                            1
+
+/*!
+ * Registers never shadowed, common to every radio instance
+ */
+static bool ShadowVolatile[2][SHADOW_REG_NUM];
+static bool ShadowVolatileInit = false;
+
+static void SX127xShadowVolatileInit( void )
+{
+    uint8_t i;
+
+    for( i = 0; i < sizeof( ShadowVolatileCommon ); i++ )
+    {
+        ShadowVolatile[SHADOW_PAGE_FSK][ShadowVolatileCommon[i]] = true;
+    }
+    for( i = 0; i < sizeof( ShadowVolatileFsk ); i++ )
+    {
+        ShadowVolatile[SHADOW_PAGE_FSK][ShadowVolatileFsk[i]] = true;
+    }
+    for( i = 0; i < sizeof( ShadowVolatileLoRa ); i++ )
+    {
+        ShadowVolatile[SHADOW_PAGE_LORA][ShadowVolatileLoRa[i]] = true;
+    }
+    ShadowVolatileInit = true;
+}
+
+/*!
+ * \brief Returns the shadow page of \a addr, -1 if it must not be shadowed
+ */
+static int8_t SX127xShadowPage( uint16_t addr )
+{
+    int8_t page = SHADOW_PAGE_FSK;
+
+    if( addr >= SHADOW_REG_NUM )
+    {
+        return -1;
+    }
+    if( ShadowVolatileInit == false )
+    {
+        SX127xShadowVolatileInit( );
+    }
+    if( ( addr >= 0x0D ) && ( addr <= 0x3F ) )
+    {
+        page = SX127x->Shadow.Page;
+    }
+    return ( ShadowVolatile[page][addr] == true ) ? -1 : page;
+}
+
+void SX127xShadowInvalidate( void )
+{
+    rt_memset( SX127x->Shadow.Valid, 0, sizeof( SX127x->Shadow.Valid ) );
+    // FSK/OOK mode after reset
+    SX127x->Shadow.Page = SHADOW_PAGE_FSK;
+    SX127x->Shadow.LongRangeMode = false;
+}
+
+#ifdef LORA_RADIO_DRIVER_USING_CONFIG_DIFF
+static RadioModems_t SX127xShadowModem( void )
+{
+    return ( SX127x->Shadow.LongRangeMode == true ) ? MODEM_LORA : MODEM_FSK;
+}
+#endif
+
+void SX127xGetShadowStats( SX127xShadowStats_t *stats )
+{
+    *stats = SX127x->Shadow.Stats;
+}
+
+void SX127xResetShadowStats( void )
+{
+    rt_memset( &SX127x->Shadow.Stats, 0, sizeof( SX127x->Shadow.Stats ) );
+}
+#endif
+
 void SX127xWrite( uint16_t addr, uint8_t data )
 {
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+    int8_t page = SX127xShadowPage( addr );
+
+    SX127x->Shadow.Stats.Writes++;
+    if( page >= 0 )
+    {
+        if( ( SX127x->Shadow.Valid[page][addr] == true ) && ( SX127x->Shadow.Value[page][addr] == data ) )
+        {
+            SX127x->Shadow.Stats.WritesSaved++;
+            return;
+        }
+        SX127x->Shadow.Value[page][addr] = data;
+        SX127x->Shadow.Valid[page][addr] = true;
+    }
+    else if( addr == REG_OPMODE )
+    {
+        // LongRangeMode only changes on a write, AccessSharedReg maps the FSK page back in
+        SX127x->Shadow.LongRangeMode = ( data & RFLR_OPMODE_LONGRANGEMODE_ON ) != 0;
+        SX127x->Shadow.Page = ( ( ( data & RFLR_OPMODE_LONGRANGEMODE_ON ) != 0 ) &&
+                        ( ( data & RFLR_OPMODE_ACCESSSHAREDREG_ENABLE ) == 0 ) ) ? SHADOW_PAGE_LORA : SHADOW_PAGE_FSK;
+    }
+#endif
     SX127xWriteBuffer( addr, &data, 1 );
 }
 
 uint8_t SX127xRead( uint16_t addr )
 {
     uint8_t data;
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+    int8_t page = SX127xShadowPage( addr );
+
+    SX127x->Shadow.Stats.Reads++;
+    if( ( page >= 0 ) && ( SX127x->Shadow.Valid[page][addr] == true ) )
+    {
+        SX127x->Shadow.Stats.ReadsSaved++;
+        return SX127x->Shadow.Value[page][addr];
+    }
+#endif
     SX127xReadBuffer( addr, &data, 1 );
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+    if( page >= 0 )
+    {
+        SX127x->Shadow.Value[page][addr] = data;
+        SX127x->Shadow.Valid[page][addr] = true;
+    }
+#endif
     return data;
 }
 
+static void SX127xWriteRegisters( uint16_t addr, uint8_t *buffer, uint8_t size )
+{
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+    bool changed = false;
+    int8_t page;
+    uint8_t i;
+
+    for( i = 0; i < size; i++ )
+    {
+        page = SX127xShadowPage( addr + i );
+        SX127x->Shadow.Stats.Writes++;
+        if( ( page < 0 ) || ( SX127x->Shadow.Valid[page][addr + i] == false ) || ( SX127x->Shadow.Value[page][addr + i] != buffer[i] ) )
+        {
+            changed = true;
+        }
+        if( page >= 0 )
+        {
+            SX127x->Shadow.Value[page][addr + i] = buffer[i];
+            SX127x->Shadow.Valid[page][addr + i] = true;
+        }
+    }
+    if( changed == false )
+    {
+        SX127x->Shadow.Stats.WritesSaved += size;
+        return;
+    }
+#endif
+    SX127xWriteBuffer( addr, buffer, size );
+}
+
 void SX127xWriteFifo( uint8_t *buffer, uint8_t size )
 {
     SX127xWriteBuffer( 0, buffer, size );
@@ -1546,7 +2105,7 @@ void SX127xSetMaxPayloadLength( RadioModems_t modem, uint8_t max )
     switch( modem )
     {
     case MODEM_FSK:
-        if( SX127x.Settings.Fsk.FixLen == false )
+        if( SX127x->Settings.Fsk.FixLen == false )
         {
             SX127xWrite( REG_PAYLOADLENGTH, max );
         }
@@ -1560,7 +2119,7 @@ void SX127xSetMaxPayloadLength( RadioModems_t modem, uint8_t max )
 void SX127xSetPublicNetwork( bool enable )
 {
     SX127xSetModem( MODEM_LORA );
-    SX127x.Settings.LoRa.PublicNetwork = enable;
+    SX127x->Settings.LoRa.PublicNetwork = enable;
     if( enable == true )
     {
         // Change LoRa modem SyncWord
@@ -1579,17 +2138,23 @@ uint32_t SX127xGetWakeupTime( void )
 }
 
 
-void SX127xOnTimeoutIrq( void )
+void SX127xOnTimeoutIrq( void* context )
 {
-    switch( SX127x.Settings.State )
+    LoRaRadio_t *previous = lora_radio_lock( context );
+
+    switch( SX127x->Settings.State )
     {
     case RF_RX_RUNNING:
-        if( SX127x.Settings.Modem == MODEM_FSK )
+        if( SX127xRxDutyCycleRxEnd( false ) == true )
         {
-            SX127x.Settings.FskPacketHandler.PreambleDetected = false;
-            SX127x.Settings.FskPacketHandler.SyncWordDetected = false;
-            SX127x.Settings.FskPacketHandler.NbBytes = 0;
-            SX127x.Settings.FskPacketHandler.Size = 0;
+            break;
+        }
+        if( SX127x->Settings.Modem == MODEM_FSK )
+        {
+            SX127x->Settings.FskPacketHandler.PreambleDetected = false;
+            SX127x->Settings.FskPacketHandler.SyncWordDetected = false;
+            SX127x->Settings.FskPacketHandler.NbBytes = 0;
+            SX127x->Settings.FskPacketHandler.Size = 0;
 
             // Clear Irqs
             SX127xWrite( REG_IRQFLAGS1, RF_IRQFLAGS1_RSSI |
@@ -1597,21 +2162,27 @@ void SX127xOnTimeoutIrq( void )
                                         RF_IRQFLAGS1_SYNCADDRESSMATCH );
             SX127xWrite( REG_IRQFLAGS2, RF_IRQFLAGS2_FIFOOVERRUN );
 
-            if( SX127x.Settings.Fsk.RxContinuous == true )
+            if( LORA_RADIO_RX_CONTINUOUS( SX127x->Settings.Fsk.RxContinuous ) == true )
             {
                 // Continuous mode restart Rx chain
                 SX127xWrite( REG_RXCONFIG, SX127xRead( REG_RXCONFIG ) | RF_RXCONFIG_RESTARTRXWITHOUTPLLLOCK );
-                TimerStart( &RxTimeoutSyncWord );
+                TimerStart( &SX127x->RxTimeoutSyncWord );
             }
             else
             {
-                SX127x.Settings.State = RF_IDLE;
-                TimerStop( &RxTimeoutSyncWord );
+                SX127x->Settings.State = RF_IDLE;
+                TimerStop( &SX127x->RxTimeoutSyncWord );
+                ( void )lora_radio_rx_policy_end( );
             }
         }
-        if( ( RadioEvents != NULL ) && ( RadioEvents->RxTimeout != NULL ) )
+        else if( LORA_RADIO_RX_CONTINUOUS( SX127x->Settings.LoRa.RxContinuous ) == false )
+        {
+            // the window given to Rx is over, the single receiver only waits for its symbol timeout
+            ( void )lora_radio_rx_policy_end( );
+        }
+        if( ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->RxTimeout != NULL ) )
         {
-            RadioEvents->RxTimeout( );
+            SX127x->RadioEvents->RxTimeout( );
         }
         LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"PHY RxTimeout\r");
         break;
@@ -1629,6 +2200,9 @@ void SX127xOnTimeoutIrq( void )
 
         // Reset the radio
         SX127xReset( );
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+        SX127xShadowInvalidate( );
+#endif
     
 #if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1276 ) 
         // Calibrate Rx chain
@@ -1646,34 +2220,68 @@ void SX127xOnTimeoutIrq( void )
         SX127xSetModem( MODEM_FSK );
 
         // Restore previous network type setting.
-        SX127xSetPublicNetwork( SX127x.Settings.LoRa.PublicNetwork );
+        SX127xSetPublicNetwork( SX127x->Settings.LoRa.PublicNetwork );
         // END WORKAROUND
 
-        SX127x.Settings.State = RF_IDLE;
-        if( ( RadioEvents != NULL ) && ( RadioEvents->TxTimeout != NULL ) )
+        SX127x->Settings.State = RF_IDLE;
+        if( ( lora_radio_tx_queue_complete( LORA_RADIO_TX_TIMEOUT ) == false ) &&
+            ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->TxTimeout != NULL ) )
         {
-            RadioEvents->TxTimeout( );
+            SX127x->RadioEvents->TxTimeout( );
         }
         LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"PHY TxTimeout\r");
         break;
     default:
         break;
     }
+    lora_radio_unlock( previous );
 }
 
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+static void SX127xRxPacketStart( void )
+{
+    if( SX127x->RxPacket == RT_NULL )
+    {
+        SX127x->RxPacket = lora_radio_rx_pool_alloc( );
+    }
+}
+
+static uint8_t *SX127xRxPacketDone( uint8_t size, int16_t rssi, int8_t snr )
+{
+    LoRaRadioRxPacket_t *packet = SX127x->RxPacket;
+
+    if( packet == RT_NULL )
+    {
+        return SX127x->RxTxBuffer;
+    }
+    SX127x->RxPacket = RT_NULL;
+
+    packet->Size = size;
+    packet->Rssi = rssi;
+    packet->Snr = snr;
+    packet->Modem = SX127x->Settings.Modem;
+    packet->Frequency = SX127x->Settings.Channel;
+    packet->Datarate = ( SX127x->Settings.Modem == MODEM_LORA ) ? SX127x->Settings.LoRa.Datarate : SX127x->Settings.Fsk.Datarate;
+    lora_radio_rx_pool_commit( packet );
+    return packet->Payload;
+}
+#endif
+
 void SX127xOnDio0Irq( void )
 {
     volatile uint8_t irqFlags = 0;
+    uint8_t *payload;
+    uint8_t size;
 
-    switch( SX127x.Settings.State )
+    switch( SX127x->Settings.State )
     {
         case RF_RX_RUNNING:
-            //TimerStop( &RxTimeoutTimer );
+            //TimerStop( &SX127x.RxTimeoutTimer );
             // RxDone interrupt
-            switch( SX127x.Settings.Modem )
+            switch( SX127x->Settings.Modem )
             {
             case MODEM_FSK:
-                if( SX127x.Settings.Fsk.CrcOn == true )
+                if( SX127x->Settings.Fsk.CrcOn == true )
                 {
                     irqFlags = SX127xRead( REG_IRQFLAGS2 );
                     if( ( irqFlags & RF_IRQFLAGS2_CRCOK ) != RF_IRQFLAGS2_CRCOK )
@@ -1684,77 +2292,87 @@ void SX127xOnDio0Irq( void )
                                                     RF_IRQFLAGS1_SYNCADDRESSMATCH );
                         SX127xWrite( REG_IRQFLAGS2, RF_IRQFLAGS2_FIFOOVERRUN );
 
-                        TimerStop( &RxTimeoutTimer );
+                        TimerStop( &SX127x->RxTimeoutTimer );
 
-                        if( SX127x.Settings.Fsk.RxContinuous == false )
+                        if( LORA_RADIO_RX_CONTINUOUS( SX127x->Settings.Fsk.RxContinuous ) == false )
                         {
-                            TimerStop( &RxTimeoutSyncWord );
-                            SX127x.Settings.State = RF_IDLE;
+                            TimerStop( &SX127x->RxTimeoutSyncWord );
+                            SX127x->Settings.State = RF_IDLE;
+                            ( void )lora_radio_rx_policy_end( );
                         }
                         else
                         {
                             // Continuous mode restart Rx chain
                             SX127xWrite( REG_RXCONFIG, SX127xRead( REG_RXCONFIG ) | RF_RXCONFIG_RESTARTRXWITHOUTPLLLOCK );
-                            TimerStart( &RxTimeoutSyncWord );
+                            TimerStart( &SX127x->RxTimeoutSyncWord );
                         }
 
-                        if( ( RadioEvents != NULL ) && ( RadioEvents->RxError != NULL ) )
+                        if( ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->RxError != NULL ) )
                         {
-                            RadioEvents->RxError( );
+                            SX127x->RadioEvents->RxError( );
                         }
                         LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"PHY RX Error\r");
                         
-                        SX127x.Settings.FskPacketHandler.PreambleDetected = false;
-                        SX127x.Settings.FskPacketHandler.SyncWordDetected = false;
-                        SX127x.Settings.FskPacketHandler.NbBytes = 0;
-                        SX127x.Settings.FskPacketHandler.Size = 0;
+                        SX127x->Settings.FskPacketHandler.PreambleDetected = false;
+                        SX127x->Settings.FskPacketHandler.SyncWordDetected = false;
+                        SX127x->Settings.FskPacketHandler.NbBytes = 0;
+                        SX127x->Settings.FskPacketHandler.Size = 0;
                         break;
                     }
                 }
 
                 // Read received packet size
-                if( ( SX127x.Settings.FskPacketHandler.Size == 0 ) && ( SX127x.Settings.FskPacketHandler.NbBytes == 0 ) )
+                if( ( SX127x->Settings.FskPacketHandler.Size == 0 ) && ( SX127x->Settings.FskPacketHandler.NbBytes == 0 ) )
                 {
-                    if( SX127x.Settings.Fsk.FixLen == false )
+                    SX127xRxPacketStart( );
+                    if( SX127x->Settings.Fsk.FixLen == false )
                     {
-                        SX127xReadFifo( ( uint8_t* )&SX127x.Settings.FskPacketHandler.Size, 1 );
+                        SX127xReadFifo( ( uint8_t* )&SX127x->Settings.FskPacketHandler.Size, 1 );
                     }
                     else
                     {
-                        SX127x.Settings.FskPacketHandler.Size = SX127xRead( REG_PAYLOADLENGTH );
+                        SX127x->Settings.FskPacketHandler.Size = SX127xRead( REG_PAYLOADLENGTH );
                     }
-                    SX127xReadFifo( RxTxBuffer + SX127x.Settings.FskPacketHandler.NbBytes, SX127x.Settings.FskPacketHandler.Size - SX127x.Settings.FskPacketHandler.NbBytes );
-                    SX127x.Settings.FskPacketHandler.NbBytes += ( SX127x.Settings.FskPacketHandler.Size - SX127x.Settings.FskPacketHandler.NbBytes );
+                    SX127xReadFifo( SX127xRxBuffer( ) + SX127x->Settings.FskPacketHandler.NbBytes, SX127x->Settings.FskPacketHandler.Size - SX127x->Settings.FskPacketHandler.NbBytes );
+                    SX127x->Settings.FskPacketHandler.NbBytes += ( SX127x->Settings.FskPacketHandler.Size - SX127x->Settings.FskPacketHandler.NbBytes );
                 }
                 else
                 {
-                    SX127xReadFifo( RxTxBuffer + SX127x.Settings.FskPacketHandler.NbBytes, SX127x.Settings.FskPacketHandler.Size - SX127x.Settings.FskPacketHandler.NbBytes );
-                    SX127x.Settings.FskPacketHandler.NbBytes += ( SX127x.Settings.FskPacketHandler.Size - SX127x.Settings.FskPacketHandler.NbBytes );
+                    SX127xReadFifo( SX127xRxBuffer( ) + SX127x->Settings.FskPacketHandler.NbBytes, SX127x->Settings.FskPacketHandler.Size - SX127x->Settings.FskPacketHandler.NbBytes );
+                    SX127x->Settings.FskPacketHandler.NbBytes += ( SX127x->Settings.FskPacketHandler.Size - SX127x->Settings.FskPacketHandler.NbBytes );
                 }
 
-                TimerStop( &RxTimeoutTimer );
+                TimerStop( &SX127x->RxTimeoutTimer );
 
-                if( SX127x.Settings.Fsk.RxContinuous == false )
+                if( LORA_RADIO_RX_CONTINUOUS( SX127x->Settings.Fsk.RxContinuous ) == false )
                 {
-                    SX127x.Settings.State = RF_IDLE;
-                    TimerStop( &RxTimeoutSyncWord );
+                    SX127x->Settings.State = RF_IDLE;
+                    TimerStop( &SX127x->RxTimeoutSyncWord );
                 }
                 else
                 {
                     // Continuous mode restart Rx chain
                     SX127xWrite( REG_RXCONFIG, SX127xRead( REG_RXCONFIG ) | RF_RXCONFIG_RESTARTRXWITHOUTPLLLOCK );
-                    TimerStart( &RxTimeoutSyncWord );
+                    TimerStart( &SX127x->RxTimeoutSyncWord );
                 }
 
-                if( ( RadioEvents != NULL ) && ( RadioEvents->RxDone != NULL ) )
+                size = SX127x->Settings.FskPacketHandler.Size;
+                SX127xTimestampCapture( false, size );
+                payload = SX127xRxPacketDone( size, SX127x->Settings.FskPacketHandler.RssiValue, 0 );
+                // a window restarted by the RX policy resets the packet handler
+                if( SX127x->Settings.State == RF_IDLE )
                 {
-                    RadioEvents->RxDone( RxTxBuffer, SX127x.Settings.FskPacketHandler.Size, SX127x.Settings.FskPacketHandler.RssiValue, 0 );
+                    ( void )lora_radio_rx_policy_end( );
+                }
+                if( ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->RxDone != NULL ) )
+                {
+                    SX127x->RadioEvents->RxDone( payload, size, SX127x->Settings.FskPacketHandler.RssiValue, 0 );
                 }
                 LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"PHY RX Done\r");
-                SX127x.Settings.FskPacketHandler.PreambleDetected = false;
-                SX127x.Settings.FskPacketHandler.SyncWordDetected = false;
-                SX127x.Settings.FskPacketHandler.NbBytes = 0;
-                SX127x.Settings.FskPacketHandler.Size = 0;
+                SX127x->Settings.FskPacketHandler.PreambleDetected = false;
+                SX127x->Settings.FskPacketHandler.SyncWordDetected = false;
+                SX127x->Settings.FskPacketHandler.NbBytes = 0;
+                SX127x->Settings.FskPacketHandler.Size = 0;
                 break;
             case MODEM_LORA:
                 {
@@ -1767,56 +2385,64 @@ void SX127xOnDio0Irq( void )
                         // Clear Irq
                         SX127xWrite( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_PAYLOADCRCERROR );
 
-                        if( SX127x.Settings.LoRa.RxContinuous == false )
+                        TimerStop( &SX127x->RxTimeoutTimer );
+                        ( void )SX127xRxDutyCycleRxEnd( true );
+                        if( LORA_RADIO_RX_CONTINUOUS( SX127x->Settings.LoRa.RxContinuous ) == false )
                         {
-                            SX127x.Settings.State = RF_IDLE;
+                            SX127x->Settings.State = RF_IDLE;
+                            ( void )lora_radio_rx_policy_end( );
                         }
-                        TimerStop( &RxTimeoutTimer );
 
-                        if( ( RadioEvents != NULL ) && ( RadioEvents->RxError != NULL ) )
+                        if( ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->RxError != NULL ) )
                         {
-                            RadioEvents->RxError( );
+                            SX127x->RadioEvents->RxError( );
                         }
                         LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"PHY RX Error\r");
                         break;
                     }
 
                     // Returns SNR value [dB] rounded to the nearest integer value
-                    SX127x.Settings.LoRaPacketHandler.SnrValue = ( ( ( int8_t )SX127xRead( REG_LR_PKTSNRVALUE ) ) + 2 ) >> 2;
+                    SX127x->Settings.LoRaPacketHandler.SnrValue = ( ( ( int8_t )SX127xRead( REG_LR_PKTSNRVALUE ) ) + 2 ) >> 2;
 
                     int16_t rssi = SX127xRead( REG_LR_PKTRSSIVALUE );
 					
 					int16_t rssi_offset = RSSI_OFFSET_HF;
 					
 #if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1276 ) || defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX1278 ) 
-					if( SX127x.Settings.Channel <= RF_MID_BAND_THRESH )
+					if( SX127x->Settings.Channel <= RF_MID_BAND_THRESH )
 					{
 						rssi_offset = RSSI_OFFSET_LF;
 					}
 #endif					
-                    if( SX127x.Settings.LoRaPacketHandler.SnrValue < 0 )
+                    if( SX127x->Settings.LoRaPacketHandler.SnrValue < 0 )
                     {
-                        SX127x.Settings.LoRaPacketHandler.RssiValue = rssi_offset + rssi + ( rssi >> 4 ) +
-                                                                      SX127x.Settings.LoRaPacketHandler.SnrValue;
+                        SX127x->Settings.LoRaPacketHandler.RssiValue = rssi_offset + rssi + ( rssi >> 4 ) +
+                                                                      SX127x->Settings.LoRaPacketHandler.SnrValue;
                     }
                     else
                     {
-                        SX127x.Settings.LoRaPacketHandler.RssiValue = rssi_offset + rssi + ( rssi >> 4 );
+                        SX127x->Settings.LoRaPacketHandler.RssiValue = rssi_offset + rssi + ( rssi >> 4 );
                     }
 
-                    SX127x.Settings.LoRaPacketHandler.Size = SX127xRead( REG_LR_RXNBBYTES );
+                    SX127x->Settings.LoRaPacketHandler.Size = SX127xRead( REG_LR_RXNBBYTES );
                     SX127xWrite( REG_LR_FIFOADDRPTR, SX127xRead( REG_LR_FIFORXCURRENTADDR ) );
-                    SX127xReadFifo( RxTxBuffer, SX127x.Settings.LoRaPacketHandler.Size );
-
-                    if( SX127x.Settings.LoRa.RxContinuous == false )
+                    SX127xRxPacketStart( );
+                    SX127xReadFifo( SX127xRxBuffer( ), SX127x->Settings.LoRaPacketHandler.Size );
+                    SX127xTimestampCapture( false, SX127x->Settings.LoRaPacketHandler.Size );
+                    payload = SX127xRxPacketDone( SX127x->Settings.LoRaPacketHandler.Size, SX127x->Settings.LoRaPacketHandler.RssiValue,
+                                                  SX127x->Settings.LoRaPacketHandler.SnrValue );
+
+                    TimerStop( &SX127x->RxTimeoutTimer );
+                    ( void )SX127xRxDutyCycleRxEnd( true );
+                    if( LORA_RADIO_RX_CONTINUOUS( SX127x->Settings.LoRa.RxContinuous ) == false )
                     {
-                        SX127x.Settings.State = RF_IDLE;
+                        SX127x->Settings.State = RF_IDLE;
+                        ( void )lora_radio_rx_policy_end( );
                     }
-                    TimerStop( &RxTimeoutTimer );
 
-                    if( ( RadioEvents != NULL ) && ( RadioEvents->RxDone != NULL ) )
+                    if( ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->RxDone != NULL ) )
                     {
-                        RadioEvents->RxDone( RxTxBuffer, SX127x.Settings.LoRaPacketHandler.Size, SX127x.Settings.LoRaPacketHandler.RssiValue, SX127x.Settings.LoRaPacketHandler.SnrValue );
+                        SX127x->RadioEvents->RxDone( payload, SX127x->Settings.LoRaPacketHandler.Size, SX127x->Settings.LoRaPacketHandler.RssiValue, SX127x->Settings.LoRaPacketHandler.SnrValue );
                     }
                     LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"PHY RX Done\r");
                 }
@@ -1826,9 +2452,9 @@ void SX127xOnDio0Irq( void )
             }
             break;
         case RF_TX_RUNNING:
-            TimerStop( &TxTimeoutTimer );
+            TimerStop( &SX127x->TxTimeoutTimer );
             // TxDone interrupt
-            switch( SX127x.Settings.Modem )
+            switch( SX127x->Settings.Modem )
             {
             case MODEM_LORA:
                 // Clear Irq
@@ -1836,15 +2462,23 @@ void SX127xOnDio0Irq( void )
                 // Intentional fall through
             case MODEM_FSK:
             default:
-                SX127x.Settings.State = RF_IDLE;
-                if( ( RadioEvents != NULL ) && ( RadioEvents->TxDone != NULL ) )
+                SX127x->Settings.State = RF_IDLE;
+                SX127xTimestampCapture( true, ( SX127x->Settings.Modem == MODEM_LORA ) ? SX127x->Settings.LoRaPacketHandler.Size :
+                                                                                         SX127x->Settings.FskPacketHandler.Size );
+                // a queued frame starts the next one right here
+                if( ( lora_radio_tx_queue_complete( LORA_RADIO_TX_DONE ) == false ) &&
+                    ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->TxDone != NULL ) )
                 {
-                    RadioEvents->TxDone( );
+                    SX127x->RadioEvents->TxDone( );
                 }
                 LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"PHY TX Done\r");
                 break;
             }
             break;
+        case RF_CAD:
+            // CadDone interrupt
+            SX127xOnDio3Irq( );
+            break;
         default:
             break;
     }
@@ -1852,26 +2486,33 @@ void SX127xOnDio0Irq( void )
 
 void SX127xOnDio1Irq( void )
 {
-    switch( SX127x.Settings.State )
+    switch( SX127x->Settings.State )
     {
         case RF_RX_RUNNING:
-            switch( SX127x.Settings.Modem )
+            switch( SX127x->Settings.Modem )
             {
             case MODEM_FSK:
+                // The event may have been latched before the PHY thread got the
+                // driver lock, act only if FifoLevel is still set
+                if( SX127xGetDio1PinState( ) == 0 )
+                {
+                    break;
+                }
                 // Stop timer
-                TimerStop( &RxTimeoutSyncWord );
+                TimerStop( &SX127x->RxTimeoutSyncWord );
 
                 // FifoLevel interrupt
                 // Read received packet size
-                if( ( SX127x.Settings.FskPacketHandler.Size == 0 ) && ( SX127x.Settings.FskPacketHandler.NbBytes == 0 ) )
+                if( ( SX127x->Settings.FskPacketHandler.Size == 0 ) && ( SX127x->Settings.FskPacketHandler.NbBytes == 0 ) )
                 {
-                    if( SX127x.Settings.Fsk.FixLen == false )
+                    SX127xRxPacketStart( );
+                    if( SX127x->Settings.Fsk.FixLen == false )
                     {
-                        SX127xReadFifo( ( uint8_t* )&SX127x.Settings.FskPacketHandler.Size, 1 );
+                        SX127xReadFifo( ( uint8_t* )&SX127x->Settings.FskPacketHandler.Size, 1 );
                     }
                     else
                     {
-                        SX127x.Settings.FskPacketHandler.Size = SX127xRead( REG_PAYLOADLENGTH );
+                        SX127x->Settings.FskPacketHandler.Size = SX127xRead( REG_PAYLOADLENGTH );
                     }
                 }
 
@@ -1882,27 +2523,41 @@ void SX127xOnDio1Irq( void )
                 //              PayloadReady  and FifoLevel interrupts, and
                 //              read only (FifoThreshold-1) bytes off the FIFO
                 //              when FifoLevel fires
-                if( ( SX127x.Settings.FskPacketHandler.Size - SX127x.Settings.FskPacketHandler.NbBytes ) >= SX127x.Settings.FskPacketHandler.FifoThresh )
-                {
-                    SX127xReadFifo( ( RxTxBuffer + SX127x.Settings.FskPacketHandler.NbBytes ), SX127x.Settings.FskPacketHandler.FifoThresh - 1 );
-                    SX127x.Settings.FskPacketHandler.NbBytes += SX127x.Settings.FskPacketHandler.FifoThresh - 1;
-                }
-                else
+                //
+                // FifoLevel is a level, not a pulse: if the thread got here
+                // late and the FIFO still holds more than FifoThreshold bytes
+                // after one chunk, DIO1 never falls and no new edge arrives,
+                // so keep offloading chunks until it drops
+                do
                 {
-                    SX127xReadFifo( ( RxTxBuffer + SX127x.Settings.FskPacketHandler.NbBytes ), SX127x.Settings.FskPacketHandler.Size - SX127x.Settings.FskPacketHandler.NbBytes );
-                    SX127x.Settings.FskPacketHandler.NbBytes += ( SX127x.Settings.FskPacketHandler.Size - SX127x.Settings.FskPacketHandler.NbBytes );
-                }
+                    if( ( SX127x->Settings.FskPacketHandler.Size - SX127x->Settings.FskPacketHandler.NbBytes ) >= SX127x->Settings.FskPacketHandler.FifoThresh )
+                    {
+                        SX127xReadFifo( ( SX127xRxBuffer( ) + SX127x->Settings.FskPacketHandler.NbBytes ), SX127x->Settings.FskPacketHandler.FifoThresh - 1 );
+                        SX127x->Settings.FskPacketHandler.NbBytes += SX127x->Settings.FskPacketHandler.FifoThresh - 1;
+                    }
+                    else
+                    {
+                        SX127xReadFifo( ( SX127xRxBuffer( ) + SX127x->Settings.FskPacketHandler.NbBytes ), SX127x->Settings.FskPacketHandler.Size - SX127x->Settings.FskPacketHandler.NbBytes );
+                        SX127x->Settings.FskPacketHandler.NbBytes += ( SX127x->Settings.FskPacketHandler.Size - SX127x->Settings.FskPacketHandler.NbBytes );
+                    }
+                } while( ( SX127x->Settings.FskPacketHandler.NbBytes < SX127x->Settings.FskPacketHandler.Size ) &&
+                         ( SX127xGetDio1PinState( ) != 0 ) );
                 break;
             case MODEM_LORA:
                 // Sync time out
-                TimerStop( &RxTimeoutTimer );
+                TimerStop( &SX127x->RxTimeoutTimer );
                 // Clear Irq
                 SX127xWrite( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_RXTIMEOUT );
 
-                SX127x.Settings.State = RF_IDLE;
-                if( ( RadioEvents != NULL ) && ( RadioEvents->RxTimeout != NULL ) )
+                if( SX127xRxDutyCycleRxEnd( false ) == true )
+                {
+                    break;
+                }
+                SX127x->Settings.State = RF_IDLE;
+                ( void )lora_radio_rx_policy_end( );
+                if( ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->RxTimeout != NULL ) )
                 {
-                    RadioEvents->RxTimeout( );
+                    SX127x->RadioEvents->RxTimeout( );
                 }
                 LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"PHY Single Rxtimeout\r");
                 break;
@@ -1911,20 +2566,25 @@ void SX127xOnDio1Irq( void )
             }
             break;
         case RF_TX_RUNNING:
-            switch( SX127x.Settings.Modem )
+            switch( SX127x->Settings.Modem )
             {
             case MODEM_FSK:
+                // An edge latched while Send was filling the FIFO is stale
+                if( SX127xGetDio1PinState( ) == 0 )
+                {
+                    break;
+                }
                 // FifoEmpty interrupt
-                if( ( SX127x.Settings.FskPacketHandler.Size - SX127x.Settings.FskPacketHandler.NbBytes ) > SX127x.Settings.FskPacketHandler.ChunkSize )
+                if( ( SX127x->Settings.FskPacketHandler.Size - SX127x->Settings.FskPacketHandler.NbBytes ) > SX127x->Settings.FskPacketHandler.ChunkSize )
                 {
-                    SX127xWriteFifo( ( RxTxBuffer + SX127x.Settings.FskPacketHandler.NbBytes ), SX127x.Settings.FskPacketHandler.ChunkSize );
-                    SX127x.Settings.FskPacketHandler.NbBytes += SX127x.Settings.FskPacketHandler.ChunkSize;
+                    SX127xWriteFifo( ( SX127x->RxTxBuffer + SX127x->Settings.FskPacketHandler.NbBytes ), SX127x->Settings.FskPacketHandler.ChunkSize );
+                    SX127x->Settings.FskPacketHandler.NbBytes += SX127x->Settings.FskPacketHandler.ChunkSize;
                 }
                 else
                 {
                     // Write the last chunk of data
-                    SX127xWriteFifo( RxTxBuffer + SX127x.Settings.FskPacketHandler.NbBytes, SX127x.Settings.FskPacketHandler.Size - SX127x.Settings.FskPacketHandler.NbBytes );
-                    SX127x.Settings.FskPacketHandler.NbBytes += SX127x.Settings.FskPacketHandler.Size - SX127x.Settings.FskPacketHandler.NbBytes;
+                    SX127xWriteFifo( SX127x->RxTxBuffer + SX127x->Settings.FskPacketHandler.NbBytes, SX127x->Settings.FskPacketHandler.Size - SX127x->Settings.FskPacketHandler.NbBytes );
+                    SX127x->Settings.FskPacketHandler.NbBytes += SX127x->Settings.FskPacketHandler.Size - SX127x->Settings.FskPacketHandler.NbBytes;
                 }
                 break;
             case MODEM_LORA:
@@ -1940,41 +2600,41 @@ void SX127xOnDio1Irq( void )
 
 void SX127xOnDio2Irq( void )
 {
-    switch( SX127x.Settings.State )
+    switch( SX127x->Settings.State )
     {
         case RF_RX_RUNNING:
-            switch( SX127x.Settings.Modem )
+            switch( SX127x->Settings.Modem )
             {
             case MODEM_FSK:
                 // Checks if DIO4 is connected. If it is not PreambleDetected is set to true.
                 ////if( SX127x.DIO4.port == NULL )
                 {
-                    SX127x.Settings.FskPacketHandler.PreambleDetected = true;
+                    SX127x->Settings.FskPacketHandler.PreambleDetected = true;
                 }
 
-                if( ( SX127x.Settings.FskPacketHandler.PreambleDetected == true ) && ( SX127x.Settings.FskPacketHandler.SyncWordDetected == false ) )
+                if( ( SX127x->Settings.FskPacketHandler.PreambleDetected == true ) && ( SX127x->Settings.FskPacketHandler.SyncWordDetected == false ) )
                 {
-                    TimerStop( &RxTimeoutSyncWord );
+                    TimerStop( &SX127x->RxTimeoutSyncWord );
 
-                    SX127x.Settings.FskPacketHandler.SyncWordDetected = true;
+                    SX127x->Settings.FskPacketHandler.SyncWordDetected = true;
 
-                    SX127x.Settings.FskPacketHandler.RssiValue = -( SX127xRead( REG_RSSIVALUE ) >> 1 );
+                    SX127x->Settings.FskPacketHandler.RssiValue = -( SX127xRead( REG_RSSIVALUE ) >> 1 );
 
-                    SX127x.Settings.FskPacketHandler.AfcValue = ( int32_t )( double )( ( ( uint16_t )SX127xRead( REG_AFCMSB ) << 8 ) |
+                    SX127x->Settings.FskPacketHandler.AfcValue = ( int32_t )( double )( ( ( uint16_t )SX127xRead( REG_AFCMSB ) << 8 ) |
                                                                            ( uint16_t )SX127xRead( REG_AFCLSB ) ) *
                                                                            ( double )FREQ_STEP;
-                    SX127x.Settings.FskPacketHandler.RxGain = ( SX127xRead( REG_LNA ) >> 5 ) & 0x07;
+                    SX127x->Settings.FskPacketHandler.RxGain = ( SX127xRead( REG_LNA ) >> 5 ) & 0x07;
                 }
                 break;
             case MODEM_LORA:
-                if( SX127x.Settings.LoRa.FreqHopOn == true )
+                if( SX127x->Settings.LoRa.FreqHopOn == true )
                 {
                     // Clear Irq
                     SX127xWrite( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_FHSSCHANGEDCHANNEL );
 
-                    if( ( RadioEvents != NULL ) && ( RadioEvents->FhssChangeChannel != NULL ) )
+                    if( ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->FhssChangeChannel != NULL ) )
                     {
-                        RadioEvents->FhssChangeChannel( ( SX127xRead( REG_LR_HOPCHANNEL ) & RFLR_HOPCHANNEL_CHANNEL_MASK ) );
+                        SX127x->RadioEvents->FhssChangeChannel( ( SX127xRead( REG_LR_HOPCHANNEL ) & RFLR_HOPCHANNEL_CHANNEL_MASK ) );
                     }
                 }
                 break;
@@ -1983,19 +2643,19 @@ void SX127xOnDio2Irq( void )
             }
             break;
         case RF_TX_RUNNING:
-            switch( SX127x.Settings.Modem )
+            switch( SX127x->Settings.Modem )
             {
             case MODEM_FSK:
                 break;
             case MODEM_LORA:
-                if( SX127x.Settings.LoRa.FreqHopOn == true )
+                if( SX127x->Settings.LoRa.FreqHopOn == true )
                 {
                     // Clear Irq
                     SX127xWrite( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_FHSSCHANGEDCHANNEL );
 
-                    if( ( RadioEvents != NULL ) && ( RadioEvents->FhssChangeChannel != NULL ) )
+                    if( ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->FhssChangeChannel != NULL ) )
                     {
-                        RadioEvents->FhssChangeChannel( ( SX127xRead( REG_LR_HOPCHANNEL ) & RFLR_HOPCHANNEL_CHANNEL_MASK ) );
+                        SX127x->RadioEvents->FhssChangeChannel( ( SX127xRead( REG_LR_HOPCHANNEL ) & RFLR_HOPCHANNEL_CHANNEL_MASK ) );
                     }
                 }
                 break;
@@ -2010,18 +2670,26 @@ void SX127xOnDio2Irq( void )
 
 void SX127xOnDio3Irq( void  )
 {
-    switch( SX127x.Settings.Modem )
+    switch( SX127x->Settings.Modem )
     {
     case MODEM_FSK:
         break;
     case MODEM_LORA:
+        // CadDone comes on DIO0 and DIO3, the first one handles it
+        if( SX127x->Settings.State != RF_CAD )
+        {
+            break;
+        }
+        SX127x->Settings.State = RF_IDLE;
         if( ( SX127xRead( REG_LR_IRQFLAGS ) & RFLR_IRQFLAGS_CADDETECTED ) == RFLR_IRQFLAGS_CADDETECTED )
         {
             // Clear Irq
             SX127xWrite( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_CADDETECTED | RFLR_IRQFLAGS_CADDONE );
-            if( ( RadioEvents != NULL ) && ( RadioEvents->CadDone != NULL ) )
+            if( ( SX127xRxDutyCycleCadDone( true ) == false ) &&
+                ( lora_radio_lbt_cad_done( true ) == false ) &&
+                ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->CadDone != NULL ) )
             {
-                RadioEvents->CadDone( true );
+                SX127x->RadioEvents->CadDone( true );
             }
             LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"PHY CAD Done,Detected\r");
         }
@@ -2029,9 +2697,11 @@ void SX127xOnDio3Irq( void  )
         {
             // Clear Irq
             SX127xWrite( REG_LR_IRQFLAGS, RFLR_IRQFLAGS_CADDONE );
-            if( ( RadioEvents != NULL ) && ( RadioEvents->CadDone != NULL ) )
+            if( ( SX127xRxDutyCycleCadDone( false ) == false ) &&
+                ( lora_radio_lbt_cad_done( false ) == false ) &&
+                ( SX127x->RadioEvents != NULL ) && ( SX127x->RadioEvents->CadDone != NULL ) )
             {
-                RadioEvents->CadDone( false );
+                SX127x->RadioEvents->CadDone( false );
             }
             LORA_RADIO_DEBUG_LOG(LR_DBG_CHIP, LOG_LEVEL,"PHY CAD Done,Not Detected\r");
         }
@@ -2044,13 +2714,13 @@ void SX127xOnDio3Irq( void  )
 
 void SX127xOnDio4Irq( void  )
 {
-    switch( SX127x.Settings.Modem )
+    switch( SX127x->Settings.Modem )
     {
     case MODEM_FSK:
         {
-            if( SX127x.Settings.FskPacketHandler.PreambleDetected == false )
+            if( SX127x->Settings.FskPacketHandler.PreambleDetected == false )
             {
-                SX127x.Settings.FskPacketHandler.PreambleDetected = true;
+                SX127x->Settings.FskPacketHandler.PreambleDetected = true;
             }
         }
         break;
@@ -2063,7 +2733,7 @@ void SX127xOnDio4Irq( void  )
 
 void SX127xOnDio5Irq( void )
 {
-    switch( SX127x.Settings.Modem )
+    switch( SX127x->Settings.Modem )
     {
     case MODEM_FSK:
         break;
@@ -30,6 +30,8 @@
 //#include "gpio.h"
 //#include "spi.h"
 #include "lora-radio.h"
+#include "lora-radio-timer.h"
+#include "lora-radio-rx-pool.h"
 #include "sx127xRegs-Fsk.h"
 #include "sx127xRegs-LoRa.h"
 
@@ -130,6 +132,128 @@ typedef struct
     RadioLoRaPacketHandler_t LoRaPacketHandler;
 }RadioSettings_t;
 
+/*!
+ * SX127x definitions
+ */
+#define XTAL_FREQ                                   32000000
+#define FREQ_STEP                                   61.03515625
+
+#define RX_BUFFER_SIZE                              256
+
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+/*!
+ * \brief Channel of a channel plan, see SX127xSetChannelPlan
+ */
+typedef struct
+{
+    uint32_t Frequency;                             //!< RF frequency [Hz], set by the caller
+    uint8_t Frf[3];                                 //!< RegFrfMsb, RegFrfMid, RegFrfLsb
+}SX127xChannel_t;
+#endif
+
+#if defined( LORA_RADIO_DRIVER_USING_CONFIG_DIFF ) && !defined( LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS )
+/*!
+ * Configuration diffing on SX127x is the shadow copy: a register write of
+ * the value the chip already holds is dropped, so SX127xSetRxConfig /
+ * SX127xSetTxConfig only reach the registers whose fields changed
+ */
+#define LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+/*!
+ * \brief Register accesses of SX127xRead / SX127xWrite served by the shadow
+ *        copy instead of the SPI bus, see SX127xGetShadowStats()
+ */
+typedef struct
+{
+    uint32_t Reads;             //!< SX127xRead calls
+    uint32_t ReadsSaved;        //!< reads served from the shadow copy
+    uint32_t Writes;            //!< SX127xWrite calls
+    uint32_t WritesSaved;       //!< writes skipped, the register already held the value
+}SX127xShadowStats_t;
+
+#define SHADOW_REG_NUM                              0x80
+
+/*!
+ * Shadow copy of the registers. 0x0D..0x3F are banked on LongRangeMode and
+ * use page SHADOW_PAGE_LORA in LoRa mode, every other register lives in
+ * page SHADOW_PAGE_FSK.
+ */
+typedef struct
+{
+    uint8_t Value[2][SHADOW_REG_NUM];
+    bool Valid[2][SHADOW_REG_NUM];
+    uint8_t Page;                                   //!< page of 0x0D..0x3F, from the last RegOpMode write
+    bool LongRangeMode;                             //!< LongRangeMode of the last RegOpMode write
+    SX127xShadowStats_t Stats;
+}SX127xShadow_t;
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+/*!
+ * \brief DIO events handled by the PHY thread, see SX127xGetDioStats()
+ */
+typedef struct
+{
+    uint32_t Wakeups;           //!< lora_radio_chip_irq_process calls with a DIO event
+    uint32_t Events[6];         //!< events handled per DIO
+    uint32_t Coalesced[6];      //!< events handled in the same wakeup as an event of another DIO
+}SX127xDioStats_t;
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE
+/*!
+ * Supply current of each sniff phase [nA], for the average current estimate
+ * of SX127xGetRxDutyCycleStats(). Defaults: SX1276 datasheet, LoRa 125 kHz,
+ * LnaBoost off; CAD runs the receiver.
+ */
+#ifndef SX127X_RX_DUTY_CYCLE_SLEEP_NA
+#define SX127X_RX_DUTY_CYCLE_SLEEP_NA               200
+#endif
+#ifndef SX127X_RX_DUTY_CYCLE_CAD_NA
+#define SX127X_RX_DUTY_CYCLE_CAD_NA                 10800000
+#endif
+#ifndef SX127X_RX_DUTY_CYCLE_RX_NA
+#define SX127X_RX_DUTY_CYCLE_RX_NA                  10800000
+#endif
+
+/*!
+ * Symbols of one CAD, wake up included, and preamble symbols the receiver
+ * still needs after CadDetected to lock on the frame. The sleep derived from
+ * the preamble length lets a CAD just miss the start of the preamble and the
+ * next one find it with enough symbols left.
+ */
+#define SX127X_RX_DUTY_CYCLE_CAD_SYMBOLS            2
+#define SX127X_RX_DUTY_CYCLE_LOCK_SYMBOLS           4
+
+/*!
+ * \brief Sniff mode counters and time per phase, see SX127xGetRxDutyCycleStats()
+ */
+typedef struct
+{
+    uint32_t Cads;              //!< CAD performed
+    uint32_t Detections;        //!< CadDetected, a single RX was started
+    uint32_t FalseWakeups;      //!< RX ended with no frame, sniffing resumed
+    uint32_t Frames;            //!< RxDone / CRC error, sniffing ended
+    uint64_t SleepUs;           //!< time asleep between two CADs
+    uint64_t CadUs;
+    uint64_t RxUs;
+    uint32_t SleepPeriod;       //!< [ms] sleep between two CADs in use
+    uint32_t AverageCurrent;    //!< [nA] estimate over the time counted
+}SX127xRxDutyCycleStats_t;
+
+typedef struct
+{
+    bool Active;
+    RadioState_t Phase;                             //!< RF_IDLE (asleep), RF_CAD or RF_RX_RUNNING
+    uint32_t PhaseStartUs;
+    uint32_t RxTime;                                //!< [ms] RX timeout after CadDetected, 0: symbol timeout only
+    TimerEvent_t Timer;                             //!< end of the sleep
+    SX127xRxDutyCycleStats_t Stats;
+}SX127xRxDutyCycle_t;
+#endif
+
 /*!
  * Radio hardware and global parameters
  */
@@ -150,20 +274,42 @@ typedef struct SX127x_s
     struct rt_spi_device *spi;
     
     RadioSettings_t Settings;
+
+    RadioEvents_t *RadioEvents;
+    uint8_t RxTxBuffer[RX_BUFFER_SIZE];
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+    LoRaRadioRxPacket_t *RxPacket;                  //!< pool slot of the packet being received
+#endif
+
+    TimerEvent_t TxTimeoutTimer;
+    TimerEvent_t RxTimeoutTimer;
+    TimerEvent_t RxTimeoutSyncWord;
+
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+    SX127xChannel_t *ChannelPlan;                   //!< registered channel plan, sorted by frequency
+    uint16_t ChannelPlanSize;
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+    SX127xShadow_t Shadow;
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+    SX127xDioStats_t DioStats;
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE
+    SX127xRxDutyCycle_t RxDutyCycle;
+#endif
 }SX127x_t;
 
 /*!
- * Hardware IO IRQ callback function definition
+ * Radio hardware and global parameters of the selected radio instance,
+ * see lora_radio_lock()
  */
-typedef void ( DioIrqHandler )( void );
+extern SX127x_t *SX127x;
 
 /*!
- * SX127x definitions
+ * Hardware IO IRQ callback function definition
  */
-#define XTAL_FREQ                                   32000000
-#define FREQ_STEP                                   61.03515625
-
-#define RX_BUFFER_SIZE                              256
+typedef void ( DioIrqHandler )( void );
 
 /*!
  * ============================================================================
@@ -199,6 +345,21 @@ void SX127xSetModem( RadioModems_t modem );
  */
 void SX127xSetChannel( uint32_t freq );
 
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+/*!
+ * \brief Registers a channel plan. The FRF word of every channel is computed
+ *        here once, SX127xSetChannel then looks it up instead of dividing by
+ *        FREQ_STEP. Frequencies outside the plan still work through the
+ *        computation.
+ *
+ * \param [IN] channels     Channels with Frequency filled in, sorted and
+ *                          completed by the call. Kept by the driver until
+ *                          the next call, RT_NULL removes the plan
+ * \param [IN] count        Number of channels
+ */
+void SX127xSetChannelPlan( SX127xChannel_t *channels, uint16_t count );
+#endif
+
 /*!
  * \brief Sets the radio output power.
  *
@@ -415,6 +576,19 @@ void SX127xWrite( uint16_t addr, uint8_t data );
  */
 uint8_t SX127xRead( uint16_t addr );
 
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+/*!
+ * \brief Forgets every shadowed register, to be called when the chip is reset
+ */
+void SX127xShadowInvalidate( void );
+
+/*!
+ * \brief Gets / clears the shadow register counters
+ */
+void SX127xGetShadowStats( SX127xShadowStats_t *stats );
+void SX127xResetShadowStats( void );
+#endif
+
 /*!
  * \brief Writes multiple radio registers starting at address
  *
@@ -469,4 +643,38 @@ uint8_t SX127xCheck( void );
  */
 void RadioIrqProcess( uint8_t irq_index );
 
+#ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
+/*!
+ * \brief Gets / clears the DIO event counters of the selected radio instance
+ */
+void SX127xGetDioStats( SX127xDioStats_t *stats );
+void SX127xResetDioStats( void );
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE
+/*!
+ * \brief Sniff mode (wake-on-radio) of the LoRa modem: CAD and sleep
+ *        alternate on the driver timer. On CadDetected the receiver enters
+ *        single RX with the SetRxConfig settings. RxDone or a CRC error ends
+ *        the mode, as on SX126x; an RX ending with no frame is a false wake
+ *        up and sniffing resumes without RxTimeout. Sleep, Standby, Send, Rx
+ *        and StartCad end the mode as well.
+ *
+ *        FSK has no CAD and with a continuous RX configuration there is
+ *        nothing to sniff for, the receiver is simply started.
+ *
+ * \param [IN] rxTime    [15.625 us] RX timeout after CadDetected, 0 to rely
+ *                       on the symbol timeout of SetRxConfig
+ * \param [IN] sleepTime [15.625 us] sleep between two CADs, 0 to derive it
+ *                       from the preamble length of SetRxConfig
+ */
+void SX127xSetRxDutyCycle( uint32_t rxTime, uint32_t sleepTime );
+
+/*!
+ * \brief Gets / clears the sniff mode counters of the selected radio instance
+ */
+void SX127xGetRxDutyCycleStats( SX127xRxDutyCycleStats_t *stats );
+void SX127xResetRxDutyCycleStats( void );
+#endif
+
 #endif // __SX127x_H__
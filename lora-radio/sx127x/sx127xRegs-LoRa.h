@@ -302,6 +302,12 @@
 #define RFLR_MODEMSTAT_RX_CR_MASK                   0x1F
 #define RFLR_MODEMSTAT_MODEM_STATUS_MASK            0xE0
 
+#define RFLR_MODEMSTAT_SIGNAL_DETECTED              0x01
+#define RFLR_MODEMSTAT_SIGNAL_SYNCHRONIZED          0x02
+#define RFLR_MODEMSTAT_RX_ONGOING                   0x04
+#define RFLR_MODEMSTAT_HEADER_INFO_VALID            0x08
+#define RFLR_MODEMSTAT_MODEM_CLEAR                  0x10
+
 /*!
  * RegPktSnrValue (Read Only)
  */
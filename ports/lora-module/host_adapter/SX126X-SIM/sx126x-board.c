@@ -0,0 +1,151 @@
+/*!
+ * \file      sx126x-board.c
+ *
+ * \brief     host simulator board for SX126x, wires the driver pins to the
+ *            software model in sx126x-sim.c
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *                ______                              _
+ *               / _____)             _              | |
+ *              ( (____  _____ ____ _| |_ _____  ____| |__
+ *               \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ *               _____) ) ____| | | || |_| ____( (___| | | |
+ *              (______/|_____)_|_|_| \__)_____)\____)_| |_|
+ *              (C)2013-2017 Semtech
+ *
+ * \endcode
+ *
+ * \author    Miguel Luis ( Semtech )
+ *
+ * \author    Gregory Cristian ( Semtech )
+ *
+ * \author    Forest-Rain
+ */
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "sx126x-board.h"
+#include "sx126x-sim.h"
+
+#define LOG_TAG "LoRa.Board.HOST-SIM(SX126X)"
+#define LOG_LEVEL  LOG_LVL_DBG 
+#include "lora-radio-debug.h"
+
+extern void RadioOnDioIrq( void* context );
+
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 2
+    #error "the host board wires two radios"
+#elif LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+/*!
+ * Radio 0 keeps the single radio wiring, radio 1 sits on the same bus
+ */
+const LoRaRadioHw_t lora_radio_hw[LORA_RADIO_DRIVER_INSTANCE_NUM] =
+{
+    {
+        .SpiBusName = LORA_RADIO0_SPI_BUS_NAME, .SpiDeviceName = LORA_RADIO0_DEVICE_NAME,
+        .NssPin = GET_PIN(A,15), .ResetPin = GET_PIN(A,7), .BusyPin = GET_PIN(B,2),
+        .DioPins = { PIN_IRQ_PIN_NONE, GET_PIN(B,1), PIN_IRQ_PIN_NONE, PIN_IRQ_PIN_NONE, PIN_IRQ_PIN_NONE, PIN_IRQ_PIN_NONE },
+        .RfSw1Pin = GET_PIN(B,0), .RfSw2Pin = GET_PIN(C,5),
+    },
+    {
+        .SpiBusName = "spi3", .SpiDeviceName = "spi31",
+        .NssPin = GET_PIN(D,0), .ResetPin = GET_PIN(D,1), .BusyPin = GET_PIN(D,2),
+        .DioPins = { PIN_IRQ_PIN_NONE, GET_PIN(D,3), PIN_IRQ_PIN_NONE, PIN_IRQ_PIN_NONE, PIN_IRQ_PIN_NONE, PIN_IRQ_PIN_NONE },
+        .RfSw1Pin = GET_PIN(D,4), .RfSw2Pin = GET_PIN(D,5),
+    },
+};
+#endif
+
+/*!
+ * \brief called by lora_radio_spi_init() in place of rt_hw_spi_device_attach()
+ */
+rt_err_t lora_radio_sim_device_attach( const char *bus_name, const char *lora_device_name )
+{
+    return sx126x_sim_attach( &sx126x_sim[lora_radio_current( )->Index], lora_device_name, LORA_RADIO_BUSY_PIN, LORA_RADIO_DIO1_PIN, LORA_RADIO_RESET_PIN );
+}
+
+void SX126xIoInit( void )
+{
+    rt_pin_mode(LORA_RADIO_NSS_PIN, PIN_MODE_OUTPUT);
+    rt_pin_mode(LORA_RADIO_BUSY_PIN, PIN_MODE_INPUT);
+    rt_pin_mode(LORA_RADIO_DIO1_PIN, PIN_MODE_INPUT_PULLDOWN);
+#if defined( LORA_RADIO_RFSW1_PIN ) && defined ( LORA_RADIO_RFSW2_PIN )   
+    rt_pin_mode(LORA_RADIO_RFSW1_PIN, PIN_MODE_OUTPUT);
+    rt_pin_mode(LORA_RADIO_RFSW2_PIN, PIN_MODE_OUTPUT);
+#endif
+}
+
+void SX126xIoIrqInit( DioIrqHandler dioIrq )
+{ 
+    rt_pin_mode(LORA_RADIO_DIO1_PIN, PIN_MODE_INPUT_PULLDOWN);
+    rt_pin_attach_irq(LORA_RADIO_DIO1_PIN, PIN_IRQ_MODE_RISING, RadioOnDioIrq, lora_radio_current( ));
+    rt_pin_irq_enable(LORA_RADIO_DIO1_PIN, PIN_IRQ_ENABLE);  
+}
+
+void SX126xIoDeInit( void )
+{
+}
+
+void SX126xIoDbgInit( void )
+{
+}
+
+void SX126xIoTcxoInit( void )
+{
+    CalibrationParams_t calibParam;
+
+    SX126xClearDeviceErrors();
+
+    SX126xSetDio3AsTcxoCtrl( TCXO_CTRL_2_7V, SX126xGetBoardTcxoWakeupTime( ) << 6 );
+
+    calibParam.Value = 0x7F;
+    SX126xCalibrate( calibParam );
+}
+
+uint32_t SX126xGetBoardTcxoWakeupTime( void )
+{
+    return BOARD_TCXO_WAKEUP_TIME;
+}
+
+void SX126xReset( void )
+{   
+    DelayMs( 10 );
+    rt_pin_mode(LORA_RADIO_RESET_PIN, PIN_MODE_OUTPUT); 
+    rt_pin_write(LORA_RADIO_RESET_PIN, PIN_LOW);
+    DelayMs( 20 );
+    // internal pull-up
+    rt_pin_mode(LORA_RADIO_RESET_PIN, PIN_MODE_INPUT); 
+    DelayMs( 10 ); 
+}
+
+void SX126xAntSwOn( void )
+{
+}
+
+void SX126xAntSwOff( void )
+{
+#if defined( LORA_RADIO_RFSW1_PIN ) && defined ( LORA_RADIO_RFSW2_PIN )   
+    rt_pin_write(LORA_RADIO_RFSW1_PIN, PIN_LOW);
+    rt_pin_write(LORA_RADIO_RFSW2_PIN, PIN_LOW);
+#endif
+}
+
+void SX126xSetAntSw( RadioOperatingModes_t mode )
+{
+    if( mode == MODE_TX )
+    {
+        rt_pin_write(LORA_RADIO_RFSW1_PIN, PIN_HIGH);
+        rt_pin_write(LORA_RADIO_RFSW2_PIN, PIN_LOW);
+    }
+    else 
+    {
+        rt_pin_write(LORA_RADIO_RFSW1_PIN, PIN_LOW);
+        rt_pin_write(LORA_RADIO_RFSW2_PIN, PIN_HIGH);
+    }
+}
+
+bool SX126xCheckRfFrequency( uint32_t frequency )
+{
+    return true;
+}
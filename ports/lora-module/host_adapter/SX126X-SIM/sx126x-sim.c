@@ -0,0 +1,741 @@
+/*!
+ * \file      sx126x-sim.c
+ *
+ * \brief     software model of an SX126x transceiver for the host build.
+ *
+ *            Lock order is "interrupt lock -> model lock": the driver may hold
+ *            the interrupt lock around SPI transfers, and every edge the model
+ *            produces on DIO1 / BUSY(falling) is delivered from the "hw"
+ *            scheduler thread, never from inside the model lock.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#include <stdlib.h>
+#include <math.h>
+
+#include "lora-radio-rtos-config.h"
+#include "sx126x/sx126x.h"
+#include "sx126x-sim.h"
+
+sx126x_sim_t sx126x_sim[LORA_RADIO_DRIVER_INSTANCE_NUM];
+
+enum
+{
+    SIM_OP_NONE = 0,
+    SIM_OP_TX_DONE,
+    SIM_OP_TX_TIMEOUT,
+    SIM_OP_RX_TIMEOUT,
+    SIM_OP_CAD_DONE,
+};
+
+/* one step of the SX126x RTC based timers */
+#define SIM_RTC_STEP_NS                             15625
+
+static uint64_t sim_scaled( sx126x_sim_t *sim, uint64_t us )
+{
+    return us * sim->air_time_scale / 100;
+}
+
+static uint32_t sim_lora_bw_hz( uint8_t bw )
+{
+    switch( bw )
+    {
+    case LORA_BW_007: return 7812;
+    case LORA_BW_010: return 10417;
+    case LORA_BW_015: return 15625;
+    case LORA_BW_020: return 20833;
+    case LORA_BW_031: return 31250;
+    case LORA_BW_041: return 41667;
+    case LORA_BW_062: return 62500;
+    case LORA_BW_250: return 250000;
+    case LORA_BW_500: return 500000;
+    case LORA_BW_125:
+    default:          return 125000;
+    }
+}
+
+static double sim_lora_symbol_us( sx126x_sim_t *sim )
+{
+    uint8_t sf = sim->mod_params[0];
+
+    return ( double )( 1UL << sf ) * 1e6 / ( double )sim_lora_bw_hz( sim->mod_params[1] );
+}
+
+/*
+ * Reference air time formulas, SX1261/2 datasheet chapter 6.1.4 (LoRa) and
+ * 6.2.3 (GFSK), evaluated in floating point on purpose.
+ */
+static uint32_t sim_time_on_air_us( sx126x_sim_t *sim, uint8_t size )
+{
+    if( sim->packet_type == PACKET_TYPE_LORA )
+    {
+        int sf = sim->mod_params[0];
+        int cr = sim->mod_params[2];
+        int ldro = sim->mod_params[3] ? 1 : 0;
+        int preamble = ( sim->pkt_params[0] << 8 ) | sim->pkt_params[1];
+        int implicit = sim->pkt_params[2] ? 1 : 0;
+        int crc = sim->pkt_params[4] ? 1 : 0;
+        double tsym = sim_lora_symbol_us( sim );
+        double num, den, npayload, npreamble;
+
+        if( sf < 7 )
+        {
+            npreamble = preamble + 6.25;
+            num = 8.0 * size + 16.0 * crc - 4.0 * sf + ( implicit ? 0.0 : 20.0 );
+            den = 4.0 * sf;
+        }
+        else
+        {
+            npreamble = preamble + 4.25;
+            num = 8.0 * size + 16.0 * crc - 4.0 * sf + 8.0 + ( implicit ? 0.0 : 20.0 );
+            den = 4.0 * ( sf - 2 * ldro );
+        }
+        npayload = 8.0 + ( ( num > 0.0 ) ? ceil( num / den ) * ( cr + 4 ) : 0.0 );
+        return ( uint32_t )ceil( ( npreamble + npayload ) * tsym );
+    }
+    else
+    {
+        uint32_t br_reg = ( sim->mod_params[0] << 16 ) | ( sim->mod_params[1] << 8 ) | sim->mod_params[2];
+        double bitrate = br_reg ? ( 32.0 * 32e6 / br_reg ) : 50000.0;
+        uint32_t bits;
+        uint8_t crc = sim->pkt_params[7];
+
+        bits = ( ( sim->pkt_params[0] << 8 ) | sim->pkt_params[1] ) + sim->pkt_params[3];
+        bits += ( sim->pkt_params[5] ? 8 : 0 );
+        bits += ( sim->pkt_params[4] ? 8 : 0 );
+        bits += size * 8;
+        bits += ( crc == RADIO_CRC_OFF ) ? 0 : ( ( crc & 0x02 ) ? 16 : 8 );
+        return ( uint32_t )ceil( bits * 1e6 / bitrate );
+    }
+}
+
+uint32_t sx126x_sim_time_on_air_us( sx126x_sim_t *sim, uint8_t size )
+{
+    uint32_t toa;
+
+    pthread_mutex_lock( &sim->lock );
+    toa = sim_time_on_air_us( sim, size );
+    pthread_mutex_unlock( &sim->lock );
+    return toa;
+}
+
+static uint8_t sim_status_byte( sx126x_sim_t *sim )
+{
+    uint8_t chip_mode;
+
+    switch( sim->mode )
+    {
+    case MODE_STDBY_RC:   chip_mode = 0x2; break;
+    case MODE_STDBY_XOSC: chip_mode = 0x3; break;
+    case MODE_FS:         chip_mode = 0x4; break;
+    case MODE_RX:
+    case MODE_RX_DC:
+    case MODE_CAD:        chip_mode = 0x5; break;
+    case MODE_TX:         chip_mode = 0x6; break;
+    default:              chip_mode = 0x0; break;
+    }
+    return ( uint8_t )( ( chip_mode << 4 ) | ( ( sim->irq_status ? 0x2 : 0x1 ) << 1 ) );
+}
+
+/* RSSI seen on the frequency the chip is tuned to, called with the model lock held */
+static int8_t sim_channel_rssi( sx126x_sim_t *sim )
+{
+    uint32_t freq = sim->rf_freq;
+    uint8_t i;
+
+    for( i = 0; i < SX126X_SIM_RSSI_MAP_SIZE; i++ )
+    {
+        if( ( sim->rssi_map_freq[i] != 0 ) &&
+            ( ( ( freq > sim->rssi_map_freq[i] ) ? freq - sim->rssi_map_freq[i] : sim->rssi_map_freq[i] - freq ) < 1000 ) )
+        {
+            return sim->rssi_map_rssi[i];
+        }
+    }
+    return sim->channel_rssi;
+}
+
+/* called with the model lock held */
+static void sim_busy_extend( sx126x_sim_t *sim, uint32_t us )
+{
+    uint64_t now = sim_get_time_us( );
+    uint64_t start = ( sim->busy_until_us > now ) ? sim->busy_until_us : now;
+
+    sim->busy_until_us = start + us;
+    sim->stats.busy_time_us += us;
+
+    /* BUSY rising edges never raise interrupts, only the falling edge does */
+    sim_pin_set_input( sim->busy_pin, PIN_HIGH );
+    sim_hw_event_schedule( &sim->busy_event, sim->busy_until_us );
+}
+
+/* called with the model lock held */
+static void sim_update_dio1( sx126x_sim_t *sim )
+{
+    uint8_t level = ( sim->irq_status & sim->dio1_mask ) ? PIN_HIGH : PIN_LOW;
+
+    if( level != sim->dio1_level )
+    {
+        /* a clear followed by a new IRQ before the event ran is still an edge */
+        sim->dio1_fell |= ( level == PIN_LOW );
+        sim->dio1_level = level;
+        sim_hw_event_schedule( &sim->dio1_event, sim_get_time_us( ) );
+    }
+}
+
+static void sim_raise_irq( sx126x_sim_t *sim, uint16_t irq )
+{
+    sim->irq_status |= ( irq & sim->irq_mask );
+    sim_update_dio1( sim );
+}
+
+static void sim_schedule_op( sx126x_sim_t *sim, uint8_t kind, uint64_t delay_us )
+{
+    sim->op_kind = kind;
+    sim_hw_event_schedule( &sim->op_event, sim_get_time_us( ) + delay_us );
+}
+
+static void sim_cancel_op( sx126x_sim_t *sim )
+{
+    sim->op_kind = SIM_OP_NONE;
+    sim_hw_event_cancel( &sim->op_event );
+}
+
+static void sim_start_tx( sx126x_sim_t *sim, uint32_t timeout )
+{
+    uint64_t toa = sim_scaled( sim, sim_time_on_air_us( sim, sim->pkt_params[ ( sim->packet_type == PACKET_TYPE_LORA ) ? 3 : 6 ] ) );
+    uint64_t limit = sim_scaled( sim, ( uint64_t )timeout * SIM_RTC_STEP_NS / 1000 );
+
+    sim->mode = MODE_TX;
+    sim->stats.last_tx_start_us = sim_get_time_us( );
+    if( ( timeout != 0 ) && ( limit < toa ) )
+    {
+        sim_schedule_op( sim, SIM_OP_TX_TIMEOUT, limit );
+    }
+    else
+    {
+        sim_schedule_op( sim, SIM_OP_TX_DONE, toa );
+    }
+}
+
+static void sim_start_rx( sx126x_sim_t *sim, uint32_t timeout )
+{
+    sim->mode = MODE_RX;
+    sim->rx_continuous = ( timeout == 0xFFFFFF );
+    sim->stats.last_rx_start_us = sim_get_time_us( );
+    if( ( timeout != 0 ) && ( timeout != 0xFFFFFF ) )
+    {
+        sim_schedule_op( sim, SIM_OP_RX_TIMEOUT, sim_scaled( sim, ( uint64_t )timeout * SIM_RTC_STEP_NS / 1000 ) );
+    }
+    else
+    {
+        sim_cancel_op( sim );
+    }
+}
+
+static void sim_reset_state( sx126x_sim_t *sim )
+{
+    sim_cancel_op( sim );
+    memset( sim->regs, 0, sizeof( sim->regs ) );
+    memset( sim->mod_params, 0, sizeof( sim->mod_params ) );
+    memset( sim->pkt_params, 0, sizeof( sim->pkt_params ) );
+    memset( sim->cad_params, 0, sizeof( sim->cad_params ) );
+    sim->regs[REG_LR_SYNCWORD] = ( LORA_MAC_PRIVATE_SYNCWORD >> 8 ) & 0xFF;
+    sim->regs[REG_LR_SYNCWORD + 1] = LORA_MAC_PRIVATE_SYNCWORD & 0xFF;
+    sim->regs[REG_OCP] = 0x18;
+    sim->mode = MODE_STDBY_RC;
+    sim->packet_type = PACKET_TYPE_GFSK;
+    sim->irq_status = 0;
+    sim->irq_mask = 0;
+    sim->dio1_mask = 0;
+    sim->tx_base = 0;
+    sim->rx_base = 0;
+    sim->rx_continuous = false;
+    sim_update_dio1( sim );
+}
+
+static uint32_t sim_get_u24( const uint8_t *p )
+{
+    return ( ( uint32_t )p[0] << 16 ) | ( ( uint32_t )p[1] << 8 ) | p[2];
+}
+
+/* executes the decoded write type command, model lock held */
+static void sim_execute( sx126x_sim_t *sim )
+{
+    uint8_t opcode = sim->cmd[0];
+    const uint8_t *arg = &sim->cmd[1];
+    uint16_t argc = sim->cmd_len - 1;
+    uint32_t busy_us = SX126X_SIM_BUSY_DEFAULT_US;
+    uint16_t i, addr;
+
+    switch( opcode )
+    {
+    case RADIO_WRITE_REGISTER:
+        addr = ( arg[0] << 8 ) | arg[1];
+        for( i = 2; i < argc; i++, addr++ )
+        {
+            sim->regs[addr % SX126X_SIM_REG_SIZE] = arg[i];
+        }
+        break;
+    case RADIO_WRITE_BUFFER:
+        for( i = 1; i < argc; i++ )
+        {
+            sim->buffer[( uint8_t )( arg[0] + i - 1 )] = arg[i];
+        }
+        break;
+    case RADIO_SET_SLEEP:
+        sim_cancel_op( sim );
+        sim->mode = MODE_SLEEP;
+        sim_pin_set_input( sim->busy_pin, PIN_HIGH );
+        return;
+    case RADIO_SET_STANDBY:
+        sim_cancel_op( sim );
+        sim->mode = ( arg[0] == STDBY_XOSC ) ? MODE_STDBY_XOSC : MODE_STDBY_RC;
+        busy_us = SX126X_SIM_BUSY_SET_STANDBY_US;
+        break;
+    case RADIO_SET_FS:
+        sim_cancel_op( sim );
+        sim->mode = MODE_FS;
+        busy_us = SX126X_SIM_BUSY_SET_FS_US;
+        break;
+    case RADIO_SET_TX:
+        sim_start_tx( sim, sim_get_u24( arg ) );
+        busy_us = SX126X_SIM_BUSY_SET_TX_US;
+        break;
+    case RADIO_SET_RX:
+        sim_start_rx( sim, sim_get_u24( arg ) );
+        busy_us = SX126X_SIM_BUSY_SET_RX_US;
+        break;
+    case RADIO_SET_RXDUTYCYCLE:
+        sim_cancel_op( sim );
+        sim->mode = MODE_RX_DC;
+        sim->rx_continuous = false;
+        busy_us = SX126X_SIM_BUSY_SET_RX_US;
+        break;
+    case RADIO_SET_CAD:
+        {
+            uint32_t nsym = 1UL << ( sim->cad_params[0] & 0x07 );
+
+            sim->mode = MODE_CAD;
+            sim_schedule_op( sim, SIM_OP_CAD_DONE, sim_scaled( sim, ( uint64_t )( ( nsym + 0.5 ) * sim_lora_symbol_us( sim ) ) ) );
+            busy_us = SX126X_SIM_BUSY_SET_CAD_US;
+        }
+        break;
+    case RADIO_SET_TXCONTINUOUSWAVE:
+    case RADIO_SET_TXCONTINUOUSPREAMBLE:
+        sim_cancel_op( sim );
+        sim->mode = MODE_TX;
+        busy_us = SX126X_SIM_BUSY_SET_TX_US;
+        break;
+    case RADIO_SET_PACKETTYPE:
+        sim->packet_type = arg[0];
+        break;
+    case RADIO_SET_RFFREQUENCY:
+        {
+            uint32_t frf = ( ( uint32_t )arg[0] << 24 ) | ( ( uint32_t )arg[1] << 16 ) | ( ( uint32_t )arg[2] << 8 ) | arg[3];
+            sim->rf_freq = ( uint32_t )( ( ( uint64_t )frf * 32000000ULL ) >> 25 );
+        }
+        break;
+    case RADIO_SET_CADPARAMS:
+        memcpy( sim->cad_params, arg, ( argc < 7 ) ? argc : 7 );
+        break;
+    case RADIO_SET_BUFFERBASEADDRESS:
+        sim->tx_base = arg[0];
+        sim->rx_base = arg[1];
+        break;
+    case RADIO_SET_MODULATIONPARAMS:
+        memcpy( sim->mod_params, arg, ( argc < 8 ) ? argc : 8 );
+        break;
+    case RADIO_SET_PACKETPARAMS:
+        memcpy( sim->pkt_params, arg, ( argc < 9 ) ? argc : 9 );
+        break;
+    case RADIO_CFG_DIOIRQ:
+        sim->irq_mask = ( arg[0] << 8 ) | arg[1];
+        sim->dio1_mask = ( arg[2] << 8 ) | arg[3];
+        sim_update_dio1( sim );
+        break;
+    case RADIO_CLR_IRQSTATUS:
+        sim->irq_status &= ~( ( arg[0] << 8 ) | arg[1] );
+        sim_update_dio1( sim );
+        break;
+    case RADIO_CALIBRATE:
+        sim->stats.calibrations++;
+        busy_us = SX126X_SIM_BUSY_CALIBRATE_US;
+        break;
+    case RADIO_CALIBRATEIMAGE:
+        sim->stats.image_calibrations++;
+        busy_us = SX126X_SIM_BUSY_CALIBRATE_IMAGE_US;
+        break;
+    default:
+        /* read commands and settings without a modelled side effect */
+        break;
+    }
+    sim_busy_extend( sim, busy_us );
+}
+
+/* response to the byte clocked at position idx of the current command */
+static uint8_t sim_response( sx126x_sim_t *sim, uint16_t idx )
+{
+    uint8_t opcode = sim->cmd[0];
+    uint16_t addr;
+
+    if( idx == 0 )
+    {
+        return sim_status_byte( sim );
+    }
+
+    switch( opcode )
+    {
+    case RADIO_READ_REGISTER:
+        if( idx < 4 )
+        {
+            return sim_status_byte( sim );
+        }
+        addr = ( ( sim->cmd[1] << 8 ) | sim->cmd[2] ) + ( idx - 4 );
+        if( ( addr >= RANDOM_NUMBER_GENERATORBASEADDR ) && ( addr < RANDOM_NUMBER_GENERATORBASEADDR + 4 ) )
+        {
+            return ( uint8_t )rand( );
+        }
+        return sim->regs[addr % SX126X_SIM_REG_SIZE];
+    case RADIO_READ_BUFFER:
+        if( idx < 3 )
+        {
+            return sim_status_byte( sim );
+        }
+        return sim->buffer[( uint8_t )( sim->cmd[1] + idx - 3 )];
+    case RADIO_GET_IRQSTATUS:
+        return ( idx == 2 ) ? ( uint8_t )( sim->irq_status >> 8 ) :
+               ( idx == 3 ) ? ( uint8_t )( sim->irq_status & 0xFF ) : sim_status_byte( sim );
+    case RADIO_GET_RXBUFFERSTATUS:
+        return ( idx == 2 ) ? sim->rx_len : ( idx == 3 ) ? sim->rx_ptr : sim_status_byte( sim );
+    case RADIO_GET_PACKETSTATUS:
+        return ( ( idx >= 2 ) && ( idx <= 4 ) ) ? sim->pkt_status[idx - 2] : sim_status_byte( sim );
+    case RADIO_GET_RSSIINST:
+        return ( idx == 2 ) ? ( uint8_t )( -sim_channel_rssi( sim ) * 2 ) : sim_status_byte( sim );
+    case RADIO_GET_PACKETTYPE:
+        return ( idx == 2 ) ? sim->packet_type : sim_status_byte( sim );
+    case RADIO_GET_ERROR:
+    case RADIO_GET_STATS:
+        return ( idx == 1 ) ? sim_status_byte( sim ) : 0x00;
+    default:
+        return sim_status_byte( sim );
+    }
+}
+
+static void sim_spi_cs( struct rt_spi_device *device, rt_bool_t active )
+{
+    sx126x_sim_t *sim = device->user_data;
+
+    pthread_mutex_lock( &sim->lock );
+    if( active )
+    {
+        sim->cmd_len = 0;
+        sim->cmd_ignored = false;
+        if( sim->mode == MODE_SLEEP )
+        {
+            /* NSS falling edge wakes the chip, this transaction is lost */
+            sim->mode = MODE_STDBY_RC;
+            sim->cmd_ignored = true;
+            sim_busy_extend( sim, SX126X_SIM_BUSY_WAKEUP_US );
+        }
+        else if( sim_get_time_us( ) < sim->busy_until_us )
+        {
+            sim->stats.busy_violations++;
+            sim->cmd_ignored = true;
+        }
+    }
+    else if( ( sim->cmd_ignored == false ) && ( sim->cmd_len > 0 ) )
+    {
+        sim->stats.commands++;
+        sim_execute( sim );
+    }
+    pthread_mutex_unlock( &sim->lock );
+}
+
+static rt_uint8_t sim_spi_xfer( struct rt_spi_device *device, rt_uint8_t out )
+{
+    sx126x_sim_t *sim = device->user_data;
+    uint16_t idx;
+    uint8_t in;
+
+    pthread_mutex_lock( &sim->lock );
+    idx = sim->cmd_len;
+    if( idx < SX126X_SIM_CMD_SIZE )
+    {
+        sim->cmd[idx] = out;
+        sim->cmd_len++;
+    }
+    in = sim->cmd_ignored ? 0x00 : sim_response( sim, idx );
+    pthread_mutex_unlock( &sim->lock );
+    return in;
+}
+
+static const struct sim_spi_ops sx126x_sim_spi_ops =
+{
+    sim_spi_cs,
+    sim_spi_xfer,
+};
+
+static int sim_busy_read( void *ctx )
+{
+    sx126x_sim_t *sim = ctx;
+
+    return ( ( sim->mode == MODE_SLEEP ) || ( sim_get_time_us( ) < sim->busy_until_us ) ) ? PIN_HIGH : PIN_LOW;
+}
+
+static void sim_reset_write( void *ctx, rt_base_t value )
+{
+    sx126x_sim_t *sim = ctx;
+
+    pthread_mutex_lock( &sim->lock );
+    if( value == PIN_LOW )
+    {
+        sim_reset_state( sim );
+        sim->mode = MODE_SLEEP;
+        sim_pin_set_input( sim->busy_pin, PIN_HIGH );
+    }
+    else if( sim->mode == MODE_SLEEP )
+    {
+        sim->mode = MODE_STDBY_RC;
+        sim_busy_extend( sim, SX126X_SIM_BUSY_RESET_US );
+    }
+    pthread_mutex_unlock( &sim->lock );
+}
+
+static void sim_busy_event( void *parameter )
+{
+    sx126x_sim_t *sim = parameter;
+    bool release;
+
+    pthread_mutex_lock( &sim->lock );
+    release = ( sim->mode != MODE_SLEEP ) && ( sim_get_time_us( ) >= sim->busy_until_us );
+    pthread_mutex_unlock( &sim->lock );
+
+    if( release )
+    {
+        sim_pin_set_input( sim->busy_pin, PIN_LOW );
+    }
+}
+
+static void sim_dio1_event( void *parameter )
+{
+    sx126x_sim_t *sim = parameter;
+    uint8_t level;
+    bool pulse;
+
+    pthread_mutex_lock( &sim->lock );
+    level = sim->dio1_level;
+    pulse = sim->dio1_fell && ( level == PIN_HIGH ) && ( sim->dio1_driven == PIN_HIGH );
+    if( ( level == PIN_HIGH ) && ( ( sim->dio1_driven == PIN_LOW ) || pulse ) )
+    {
+        sim->stats.dio1_edges++;
+        sim->stats.last_dio1_rise_us = sim_get_time_us( );
+    }
+    sim->dio1_fell = false;
+    sim->dio1_driven = level;
+    pthread_mutex_unlock( &sim->lock );
+
+    if( pulse )
+    {
+        sim_pin_set_input( sim->dio1_pin, PIN_LOW );
+    }
+    sim_pin_set_input( sim->dio1_pin, level );
+}
+
+static void sim_op_event( void *parameter )
+{
+    sx126x_sim_t *sim = parameter;
+
+    pthread_mutex_lock( &sim->lock );
+    switch( sim->op_kind )
+    {
+    case SIM_OP_TX_DONE:
+        sim->mode = MODE_STDBY_RC;
+        sim->stats.tx_done++;
+        sim_raise_irq( sim, IRQ_TX_DONE );
+        break;
+    case SIM_OP_TX_TIMEOUT:
+    case SIM_OP_RX_TIMEOUT:
+        sim->mode = MODE_STDBY_RC;
+        sim->stats.timeouts++;
+        sim_raise_irq( sim, IRQ_RX_TX_TIMEOUT );
+        break;
+    case SIM_OP_CAD_DONE:
+        sim->stats.cad_done++;
+        sim_raise_irq( sim, IRQ_CAD_DONE | ( sim->channel_activity ? IRQ_CAD_ACTIVITY_DETECTED : 0 ) );
+        if( ( sim->cad_params[3] == LORA_CAD_RX ) && sim->channel_activity )
+        {
+            sim_start_rx( sim, sim_get_u24( &sim->cad_params[4] ) );
+        }
+        else if( ( sim->cad_params[3] == LORA_CAD_LBT ) && !sim->channel_activity )
+        {
+            sim_start_tx( sim, sim_get_u24( &sim->cad_params[4] ) );
+        }
+        else
+        {
+            sim->mode = MODE_STDBY_RC;
+        }
+        break;
+    default:
+        break;
+    }
+    if( sim->op_event.pending == 0 )
+    {
+        sim->op_kind = SIM_OP_NONE;
+    }
+    pthread_mutex_unlock( &sim->lock );
+}
+
+static void sim_rx_event( void *parameter )
+{
+    sx126x_sim_t *sim = parameter;
+    uint16_t irq;
+    uint8_t i;
+
+    pthread_mutex_lock( &sim->lock );
+    sim->pending_rx_busy = false;
+    if( ( sim->mode != MODE_RX ) && ( sim->mode != MODE_RX_DC ) )
+    {
+        sim->stats.rx_missed++;
+        pthread_mutex_unlock( &sim->lock );
+        return;
+    }
+
+    for( i = 0; i < sim->pending_rx_len; i++ )
+    {
+        sim->buffer[( uint8_t )( sim->rx_base + i )] = sim->pending_rx[i];
+    }
+    sim->rx_len = sim->pending_rx_len;
+    sim->rx_ptr = sim->rx_base;
+    sim->regs[REG_LR_PAYLOADLENGTH] = sim->pending_rx_len;
+    sim->pkt_status[0] = ( uint8_t )( -sim->pending_rx_rssi * 2 );
+    sim->pkt_status[1] = ( uint8_t )( sim->pending_rx_snr * 4 );
+    sim->pkt_status[2] = ( uint8_t )( -sim->pending_rx_rssi * 2 );
+
+    irq = IRQ_PREAMBLE_DETECTED | IRQ_RX_DONE;
+    irq |= ( sim->packet_type == PACKET_TYPE_LORA ) ? IRQ_HEADER_VALID : IRQ_SYNCWORD_VALID;
+    if( sim->pending_rx_crc_error )
+    {
+        irq |= IRQ_CRC_ERROR;
+    }
+    if( !sim->rx_continuous )
+    {
+        sim_cancel_op( sim );
+        sim->mode = MODE_STDBY_RC;
+    }
+    sim->stats.rx_done++;
+    sim_raise_irq( sim, irq );
+    pthread_mutex_unlock( &sim->lock );
+}
+
+rt_err_t sx126x_sim_attach( sx126x_sim_t *sim, const char *device_name,
+                            rt_base_t busy_pin, rt_base_t dio1_pin, rt_base_t reset_pin )
+{
+    memset( sim, 0, sizeof( *sim ) );
+    pthread_mutex_init( &sim->lock, RT_NULL );
+    sim->busy_pin = busy_pin;
+    sim->dio1_pin = dio1_pin;
+    sim->reset_pin = reset_pin;
+    sim->channel_rssi = -120;
+    sim->air_time_scale = 100;
+
+    sim_hw_event_init( &sim->op_event, sim_op_event, sim, SIM_HW_EVENT_CHIP );
+    sim_hw_event_init( &sim->rx_event, sim_rx_event, sim, SIM_HW_EVENT_CHIP );
+    sim_hw_event_init( &sim->dio1_event, sim_dio1_event, sim, SIM_HW_EVENT_ISR );
+    sim_hw_event_init( &sim->busy_event, sim_busy_event, sim, SIM_HW_EVENT_ISR );
+
+    sim_reset_state( sim );
+
+    sim_pin_set_reader( busy_pin, sim_busy_read, sim );
+    sim_pin_set_writer( reset_pin, sim_reset_write, sim );
+
+    return sim_spi_device_register( &sim->spi, device_name, &sx126x_sim_spi_ops, sim );
+}
+
+void sx126x_sim_set_air_time_scale( sx126x_sim_t *sim, uint32_t percent )
+{
+    sim->air_time_scale = percent;
+}
+
+rt_err_t sx126x_sim_inject_rx( sx126x_sim_t *sim, const uint8_t *payload, uint8_t size,
+                               int8_t rssi, int8_t snr, bool crc_error )
+{
+    pthread_mutex_lock( &sim->lock );
+    if( sim->pending_rx_busy ||
+        ( ( sim->mode != MODE_RX ) && ( sim->mode != MODE_RX_DC ) && ( sim->mode != MODE_CAD ) ) )
+    {
+        sim->stats.rx_missed++;
+        pthread_mutex_unlock( &sim->lock );
+        return -RT_ERROR;
+    }
+
+    memcpy( sim->pending_rx, payload, size );
+    sim->pending_rx_len = size;
+    sim->pending_rx_rssi = rssi;
+    sim->pending_rx_snr = snr;
+    sim->pending_rx_crc_error = crc_error;
+    sim->pending_rx_busy = true;
+
+    /* preamble detected, the symbol timeout no longer applies */
+    if( sim->op_kind == SIM_OP_RX_TIMEOUT )
+    {
+        sim_cancel_op( sim );
+    }
+    sim_hw_event_schedule( &sim->rx_event, sim_get_time_us( ) + sim_scaled( sim, sim_time_on_air_us( sim, size ) ) );
+    pthread_mutex_unlock( &sim->lock );
+    return RT_EOK;
+}
+
+void sx126x_sim_set_channel_rssi_at( sx126x_sim_t *sim, uint32_t freq, int8_t rssi )
+{
+    uint8_t i;
+
+    pthread_mutex_lock( &sim->lock );
+    for( i = 0; i < SX126X_SIM_RSSI_MAP_SIZE; i++ )
+    {
+        if( freq == 0 )
+        {
+            sim->rssi_map_freq[i] = 0;
+        }
+        else if( ( sim->rssi_map_freq[i] == freq ) || ( sim->rssi_map_freq[i] == 0 ) )
+        {
+            sim->rssi_map_freq[i] = freq;
+            sim->rssi_map_rssi[i] = rssi;
+            break;
+        }
+    }
+    pthread_mutex_unlock( &sim->lock );
+}
+
+void sx126x_sim_set_channel( sx126x_sim_t *sim, bool activity, int8_t rssi )
+{
+    pthread_mutex_lock( &sim->lock );
+    sim->channel_activity = activity;
+    sim->channel_rssi = rssi;
+    pthread_mutex_unlock( &sim->lock );
+}
+
+uint8_t sx126x_sim_get_mode( sx126x_sim_t *sim )
+{
+    return sim->mode;
+}
+
+uint32_t sx126x_sim_get_rf_frequency( sx126x_sim_t *sim )
+{
+    return sim->rf_freq;
+}
+
+void sx126x_sim_get_stats( sx126x_sim_t *sim, struct sx126x_sim_stats *stats )
+{
+    pthread_mutex_lock( &sim->lock );
+    *stats = sim->stats;
+    pthread_mutex_unlock( &sim->lock );
+}
+
+void sx126x_sim_reset_stats( sx126x_sim_t *sim )
+{
+    pthread_mutex_lock( &sim->lock );
+    memset( &sim->stats, 0, sizeof( sim->stats ) );
+    pthread_mutex_unlock( &sim->lock );
+}
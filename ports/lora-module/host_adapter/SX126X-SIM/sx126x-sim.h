@@ -0,0 +1,186 @@
+/*!
+ * \file      sx126x-sim.h
+ *
+ * \brief     software model of an SX126x transceiver for the host build.
+ *
+ *            The model sits behind an rt_spi_device and decodes the SX126x
+ *            command set byte by byte: 256-byte data buffer, register space,
+ *            IRQ status and masks, BUSY line timing and DIO1 edges. Air time
+ *            is derived from the modulation and packet parameters that the
+ *            driver programs, so TX done / RX timeout / CAD done arrive when
+ *            a real chip would raise them.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#ifndef __SX126X_SIM_H__
+#define __SX126X_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "lora-radio.h"
+
+/*!
+ * BUSY high time after a command, in us, typical values from the datasheet
+ * switching time tables. Commands not listed use SX126X_SIM_BUSY_DEFAULT_US.
+ */
+#define SX126X_SIM_BUSY_DEFAULT_US                  2
+#define SX126X_SIM_BUSY_SET_STANDBY_US              10
+#define SX126X_SIM_BUSY_SET_FS_US                   50
+#define SX126X_SIM_BUSY_SET_TX_US                   120
+#define SX126X_SIM_BUSY_SET_RX_US                   80
+#define SX126X_SIM_BUSY_SET_CAD_US                  80
+#define SX126X_SIM_BUSY_CALIBRATE_US                3500
+#define SX126X_SIM_BUSY_CALIBRATE_IMAGE_US          1000
+#define SX126X_SIM_BUSY_WAKEUP_US                   350
+#define SX126X_SIM_BUSY_RESET_US                    3500
+
+#define SX126X_SIM_REG_SIZE                         0x1000
+#define SX126X_SIM_CMD_SIZE                         ( 3 + 256 )
+#define SX126X_SIM_RSSI_MAP_SIZE                    16      // channels with their own RSSI
+
+/*!
+ * \brief statistics gathered by the model, see sx126x_sim_get_stats()
+ */
+struct sx126x_sim_stats
+{
+    uint32_t commands;              //!< SPI transactions decoded
+    uint32_t busy_violations;       //!< transactions started while BUSY was high
+    uint32_t dio1_edges;            //!< DIO1 rising edges
+    uint32_t tx_done;
+    uint32_t rx_done;
+    uint32_t rx_missed;             //!< injected frames the receiver was not listening for
+    uint32_t cad_done;
+    uint32_t timeouts;
+    uint32_t calibrations;          //!< Calibrate commands
+    uint32_t image_calibrations;    //!< CalibrateImage commands
+    uint64_t busy_time_us;          //!< cumulated BUSY high time caused by commands
+    uint64_t last_dio1_rise_us;     //!< time stamp of the latest DIO1 rising edge
+    uint64_t last_tx_start_us;      //!< time stamp of the latest SetTx execution
+    uint64_t last_rx_start_us;      //!< time stamp of the latest SetRx execution
+};
+
+/*!
+ * \brief SX126x model instance
+ */
+typedef struct sx126x_sim
+{
+    struct rt_spi_device spi;
+    pthread_mutex_t lock;
+
+    rt_base_t busy_pin;
+    rt_base_t dio1_pin;
+    rt_base_t reset_pin;
+
+    /* SPI transaction being decoded */
+    uint8_t cmd[SX126X_SIM_CMD_SIZE];
+    uint16_t cmd_len;
+    bool cmd_ignored;
+
+    /* chip state */
+    uint8_t mode;
+    uint8_t packet_type;
+    uint8_t buffer[256];
+    uint8_t regs[SX126X_SIM_REG_SIZE];
+    uint8_t tx_base;
+    uint8_t rx_base;
+    uint8_t mod_params[8];
+    uint8_t pkt_params[9];
+    uint8_t cad_params[7];
+    uint32_t rf_freq;
+    uint16_t irq_status;
+    uint16_t irq_mask;
+    uint16_t dio1_mask;
+    uint8_t dio1_level;             /* IRQ line of the model */
+    uint8_t dio1_driven;            /* level the ISR event last drove on the pin */
+    bool dio1_fell;                 /* the line went low since the ISR event ran */
+    bool rx_continuous;
+    uint8_t rx_len;
+    uint8_t rx_ptr;
+    uint8_t pkt_status[3];
+    uint64_t busy_until_us;
+    uint8_t op_kind;
+
+    /* air side */
+    int8_t channel_rssi;
+    bool channel_activity;
+    uint32_t rssi_map_freq[SX126X_SIM_RSSI_MAP_SIZE];   //!< 0: free entry
+    int8_t rssi_map_rssi[SX126X_SIM_RSSI_MAP_SIZE];
+    uint32_t air_time_scale;
+    uint8_t pending_rx[256];
+    uint8_t pending_rx_len;
+    int8_t pending_rx_rssi;
+    int8_t pending_rx_snr;
+    bool pending_rx_crc_error;
+    bool pending_rx_busy;
+
+    struct sim_hw_event op_event;       //!< TX done, RX / CAD completion, RX timeout
+    struct sim_hw_event rx_event;       //!< end of an injected frame
+    struct sim_hw_event dio1_event;     //!< deferred DIO1 level update
+    struct sim_hw_event busy_event;     //!< BUSY falling edge
+
+    struct sx126x_sim_stats stats;
+}sx126x_sim_t;
+
+/*!
+ * \brief Creates the model and registers it as SPI device \a device_name
+ *
+ * \param [IN] sim          model instance
+ * \param [IN] device_name  name the driver will rt_device_find()
+ * \param [IN] busy_pin     MCU pin wired to BUSY
+ * \param [IN] dio1_pin     MCU pin wired to DIO1
+ * \param [IN] reset_pin    MCU pin wired to NRESET
+ */
+rt_err_t sx126x_sim_attach( sx126x_sim_t *sim, const char *device_name,
+                            rt_base_t busy_pin, rt_base_t dio1_pin, rt_base_t reset_pin );
+
+/*!
+ * \brief Scales every air time (TX, RX, CAD, timeouts) by percent/100.
+ *        100 is real time, smaller values speed up benchmarks.
+ */
+void sx126x_sim_set_air_time_scale( sx126x_sim_t *sim, uint32_t percent );
+
+/*!
+ * \brief Starts a frame on air now, it is received if the chip is listening
+ *        when it starts and is still in RX when it ends.
+ *
+ * \retval RT_EOK if the receiver was listening, -RT_ERROR otherwise
+ */
+rt_err_t sx126x_sim_inject_rx( sx126x_sim_t *sim, const uint8_t *payload, uint8_t size,
+                               int8_t rssi, int8_t snr, bool crc_error );
+
+/*!
+ * \brief Sets the channel state seen by GetRssiInst and CAD
+ */
+void sx126x_sim_set_channel( sx126x_sim_t *sim, bool activity, int8_t rssi );
+
+/*!
+ * \brief Gives \a freq its own RSSI reading, used instead of the channel
+ *        RSSI while the chip is tuned within 1 kHz of it. \a freq 0 clears
+ *        every entry.
+ */
+void sx126x_sim_set_channel_rssi_at( sx126x_sim_t *sim, uint32_t freq, int8_t rssi );
+
+/*!
+ * \brief Returns the air time of a frame of \a size bytes with the current
+ *        modulation and packet parameters, in us, unscaled
+ */
+uint32_t sx126x_sim_time_on_air_us( sx126x_sim_t *sim, uint8_t size );
+
+uint8_t sx126x_sim_get_mode( sx126x_sim_t *sim );
+uint32_t sx126x_sim_get_rf_frequency( sx126x_sim_t *sim );
+void sx126x_sim_get_stats( sx126x_sim_t *sim, struct sx126x_sim_stats *stats );
+void sx126x_sim_reset_stats( sx126x_sim_t *sim );
+
+/*!
+ * \brief The model instances, one per radio instance. sx126x_sim0 is the one
+ *        behind LORA_RADIO0_DEVICE_NAME
+ */
+extern sx126x_sim_t sx126x_sim[LORA_RADIO_DRIVER_INSTANCE_NUM];
+#define sx126x_sim0                      ( sx126x_sim[0] )
+
+#endif /* __SX126X_SIM_H__ */
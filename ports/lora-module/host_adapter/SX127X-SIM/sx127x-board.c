@@ -0,0 +1,187 @@
+/*!
+ * \file      sx127x-board.c
+ *
+ * \brief     host simulator board for SX127x, wires the driver pins to the
+ *            software model in sx127x-sim.c
+ *
+ * \copyright Revised BSD License, see section \ref LICENSE.
+ *
+ * \code
+ *                ______                              _
+ *               / _____)             _              | |
+ *              ( (____  _____ ____ _| |_ _____  ____| |__
+ *               \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ *               _____) ) ____| | | || |_| ____( (___| | | |
+ *              (______/|_____)_|_|_| \__)_____)\____)_| |_|
+ *              (C)2013-2017 Semtech
+ *
+ * \endcode
+ *
+ * \author    Miguel Luis ( Semtech )
+ *
+ * \author    Gregory Cristian ( Semtech )
+ *
+ * \author    Forest-Rain
+ */
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "sx127x-board.h"
+#include "sx127x-sim.h"
+
+#define LOG_TAG "LoRa.Board.HOST-SIM(SX127X)"
+#define LOG_LEVEL  LOG_LVL_DBG
+#include "lora-radio-debug.h"
+
+// the driver handles DIO0..DIO2, same wiring as the LSD4RF-2F717N20 board
+#ifndef LORA_RADIO_DIO1_PIN
+#define LORA_RADIO_DIO1_PIN   GET_PIN(B,10)
+#endif
+#ifndef LORA_RADIO_DIO2_PIN
+#define LORA_RADIO_DIO2_PIN   GET_PIN(B,11)
+#endif
+
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 2
+    #error "the host board wires two radios"
+#elif LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+/*!
+ * Radio 0 keeps the single radio wiring, radio 1 sits on the same bus
+ */
+const LoRaRadioHw_t lora_radio_hw[LORA_RADIO_DRIVER_INSTANCE_NUM] =
+{
+    {
+        .SpiBusName = LORA_RADIO0_SPI_BUS_NAME, .SpiDeviceName = LORA_RADIO0_DEVICE_NAME,
+        .NssPin = GET_PIN(A,15), .ResetPin = GET_PIN(A,7), .BusyPin = PIN_IRQ_PIN_NONE,
+        .DioPins = { GET_PIN(B,1), GET_PIN(B,10), GET_PIN(B,11), PIN_IRQ_PIN_NONE, PIN_IRQ_PIN_NONE, PIN_IRQ_PIN_NONE },
+        .RfSw1Pin = PIN_IRQ_PIN_NONE, .RfSw2Pin = PIN_IRQ_PIN_NONE,
+    },
+    {
+        .SpiBusName = "spi3", .SpiDeviceName = "spi31",
+        .NssPin = GET_PIN(D,0), .ResetPin = GET_PIN(D,1), .BusyPin = PIN_IRQ_PIN_NONE,
+        .DioPins = { GET_PIN(D,3), GET_PIN(D,6), GET_PIN(D,7), PIN_IRQ_PIN_NONE, PIN_IRQ_PIN_NONE, PIN_IRQ_PIN_NONE },
+        .RfSw1Pin = PIN_IRQ_PIN_NONE, .RfSw2Pin = PIN_IRQ_PIN_NONE,
+    },
+};
+#endif
+
+/*!
+ * \brief DIO 0 IRQ callback
+ */
+void SX127xOnDio0IrqEvent( void *args );
+
+/*!
+ * \brief DIO 1 IRQ callback
+ */
+void SX127xOnDio1IrqEvent( void *args );
+
+/*!
+ * \brief DIO 2 IRQ callback
+ */
+void SX127xOnDio2IrqEvent( void *args );
+
+/*!
+ * \brief called by lora_radio_spi_init() in place of rt_hw_spi_device_attach()
+ */
+rt_err_t lora_radio_sim_device_attach( const char *bus_name, const char *lora_device_name )
+{
+    const rt_base_t dio_pins[SX127X_SIM_DIO_NUM] =
+    {
+        LORA_RADIO_DIO0_PIN,
+        LORA_RADIO_DIO1_PIN,
+        LORA_RADIO_DIO2_PIN,
+#ifdef LORA_RADIO_DIO3_PIN
+        LORA_RADIO_DIO3_PIN,
+#else
+        PIN_IRQ_PIN_NONE,
+#endif
+#ifdef LORA_RADIO_DIO4_PIN
+        LORA_RADIO_DIO4_PIN,
+#else
+        PIN_IRQ_PIN_NONE,
+#endif
+#ifdef LORA_RADIO_DIO5_PIN
+        LORA_RADIO_DIO5_PIN,
+#else
+        PIN_IRQ_PIN_NONE,
+#endif
+    };
+
+    return sx127x_sim_attach( &sx127x_sim[lora_radio_current( )->Index], lora_device_name, dio_pins, LORA_RADIO_RESET_PIN );
+}
+
+void SX127xIoInit( void )
+{
+    rt_pin_mode(LORA_RADIO_NSS_PIN, PIN_MODE_OUTPUT);
+
+    rt_pin_mode(LORA_RADIO_DIO0_PIN, PIN_MODE_INPUT_PULLDOWN);
+    rt_pin_mode(LORA_RADIO_DIO1_PIN, PIN_MODE_INPUT_PULLDOWN);
+    rt_pin_mode(LORA_RADIO_DIO2_PIN, PIN_MODE_INPUT_PULLDOWN);
+}
+
+void SX127xIoIrqInit( DioIrqHandler **irqHandlers )
+{
+    rt_pin_attach_irq(LORA_RADIO_DIO0_PIN, PIN_IRQ_MODE_RISING,SX127xOnDio0IrqEvent, lora_radio_current( ));
+    rt_pin_irq_enable(LORA_RADIO_DIO0_PIN, PIN_IRQ_ENABLE);
+    rt_pin_attach_irq(LORA_RADIO_DIO1_PIN, PIN_IRQ_MODE_RISING,SX127xOnDio1IrqEvent, lora_radio_current( ));
+    rt_pin_irq_enable(LORA_RADIO_DIO1_PIN, PIN_IRQ_ENABLE);
+    rt_pin_attach_irq(LORA_RADIO_DIO2_PIN, PIN_IRQ_MODE_RISING,SX127xOnDio2IrqEvent, lora_radio_current( ));
+    rt_pin_irq_enable(LORA_RADIO_DIO2_PIN, PIN_IRQ_ENABLE);
+}
+
+void SX127xIoDeInit( void )
+{
+}
+
+void SX127xIoDbgInit( void )
+{
+}
+
+void SX127xIoTcxoInit( void )
+{
+}
+
+void SX127xReset( void )
+{
+    // Set RESET pin to 0
+    rt_pin_mode(LORA_RADIO_RESET_PIN, PIN_MODE_OUTPUT);
+    rt_pin_write(LORA_RADIO_RESET_PIN, PIN_LOW);
+
+    // Wait 1 ms
+    DelayMs( 1 );
+
+    // Configure RESET as input
+    rt_pin_mode(LORA_RADIO_RESET_PIN, PIN_MODE_INPUT);
+
+    // Wait 6 ms
+    DelayMs( 6 );
+}
+
+void SX127xSetAntSwLowPower( bool status )
+{
+}
+
+void SX127xAntSwInit( void )
+{
+}
+
+void SX127xAntSwDeInit( void )
+{
+}
+
+void SX127xSetAntSw( uint8_t opMode )
+{
+}
+
+uint8_t SX127xGetPaSelect( int8_t power )
+{
+    return RF_PACONFIG_PASELECT_PABOOST;
+}
+
+bool SX127xCheckRfFrequency( uint32_t frequency )
+{
+    return true;
+}
+
+uint32_t SX127xGetDio1PinState( void )
+{
+    return rt_pin_read( LORA_RADIO_DIO1_PIN );
+}
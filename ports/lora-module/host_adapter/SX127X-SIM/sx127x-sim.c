@@ -0,0 +1,1171 @@
+/*!
+ * \file      sx127x-sim.c
+ *
+ * \brief     software model of an SX127x transceiver for the host build.
+ *
+ *            Lock order is "interrupt lock -> model lock": the driver holds
+ *            the interrupt lock around its DIO handlers, so edges on DIO0..5
+ *            are delivered from the "hw" scheduler thread, never from inside
+ *            the model lock. Air time and the FSK byte clock run on the "chip"
+ *            scheduler and keep going while the MCU has interrupts disabled.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#include <stdlib.h>
+#include <math.h>
+
+#include "lora-radio-rtos-config.h"
+#include "sx127x/sx127x.h"
+#include "sx127x-sim.h"
+
+sx127x_sim_t sx127x_sim[LORA_RADIO_DRIVER_INSTANCE_NUM];
+
+enum
+{
+    SIM_OP_NONE = 0,
+    SIM_OP_TX_DONE,
+    SIM_OP_RX_DONE,
+    SIM_OP_RX_TIMEOUT,
+    SIM_OP_CAD_DONE,
+    SIM_OP_FSK_TX_DATA,
+    SIM_OP_FSK_TX_END,
+    SIM_OP_FSK_RX_PREAMBLE,
+    SIM_OP_FSK_RX_SYNC,
+    SIM_OP_FSK_RX_END,
+};
+
+#define SIM_VERSION                                 0x12
+#define SIM_RSSI_OFFSET_LF                          164
+#define SIM_RSSI_OFFSET_HF                          157
+#define SIM_FSK_MIN_BYTE_US                         27      // 8 bits at 300 kbps
+#define SIM_FSK_LATE_BYTES                          8       // byte clock lag caught up without pushing the packet back
+
+static const uint32_t sim_lora_bw_hz[] =
+{
+    7810, 10420, 15630, 20830, 31250, 41670, 62500, 125000, 250000, 500000
+};
+
+static uint64_t sim_scaled( sx127x_sim_t *sim, uint64_t us )
+{
+    return us * sim->air_time_scale / 100;
+}
+
+static bool sim_is_lora( sx127x_sim_t *sim )
+{
+    return ( sim->regs[REG_OPMODE] & RFLR_OPMODE_LONGRANGEMODE_ON ) != 0;
+}
+
+static uint8_t sim_mode( sx127x_sim_t *sim )
+{
+    return sim->regs[REG_OPMODE] & ~RF_OPMODE_MASK;
+}
+
+static void sim_set_mode_bits( sx127x_sim_t *sim, uint8_t mode )
+{
+    sim->regs[REG_OPMODE] = ( sim->regs[REG_OPMODE] & RF_OPMODE_MASK ) | mode;
+}
+
+/* register page selected by LongRangeMode / AccessSharedReg */
+static uint8_t *sim_reg( sx127x_sim_t *sim, uint8_t addr )
+{
+    if( ( addr >= REG_LR_FIFOADDRPTR ) && ( addr < REG_LR_DIOMAPPING1 ) && sim_is_lora( sim ) &&
+        ( ( sim->regs[REG_OPMODE] & RFLR_OPMODE_ACCESSSHAREDREG_ENABLE ) == 0 ) )
+    {
+        return &sim->lora_regs[addr];
+    }
+    return &sim->regs[addr];
+}
+
+static double sim_lora_symbol_us( sx127x_sim_t *sim )
+{
+    uint8_t bw = sim->lora_regs[REG_LR_MODEMCONFIG1] >> 4;
+    uint8_t sf = sim->lora_regs[REG_LR_MODEMCONFIG2] >> 4;
+
+    if( bw > 9 )
+    {
+        bw = 9;
+    }
+    return ( double )( 1UL << sf ) * 1e6 / ( double )sim_lora_bw_hz[bw];
+}
+
+static double sim_fsk_byte_us( sx127x_sim_t *sim )
+{
+    uint32_t br_reg = ( sim->regs[REG_BITRATEMSB] << 8 ) | sim->regs[REG_BITRATELSB];
+
+    return br_reg ? ( 8.0 * br_reg / 32.0 ) : 8.0 * 0x1A0B / 32.0;
+}
+
+/*
+ * period of the FIFO byte clock. The air time scale speeds it up like every
+ * other air time, but never past the 300 kbps the FSK modem supports: the
+ * driver has to keep up with the FIFO of a real chip, not of a faster one
+ */
+static uint64_t sim_fsk_byte_clock_us( sx127x_sim_t *sim )
+{
+    uint64_t us = sim_scaled( sim, ( uint64_t )sim_fsk_byte_us( sim ) );
+
+    return ( us < SIM_FSK_MIN_BYTE_US ) ? SIM_FSK_MIN_BYTE_US : us;
+}
+
+static uint32_t sim_fsk_preamble_bytes( sx127x_sim_t *sim )
+{
+    return ( sim->regs[REG_PREAMBLEMSB] << 8 ) | sim->regs[REG_PREAMBLELSB];
+}
+
+static uint32_t sim_fsk_sync_bytes( sx127x_sim_t *sim )
+{
+    uint8_t cfg = sim->regs[REG_SYNCCONFIG];
+
+    return ( cfg & RF_SYNCCONFIG_SYNC_ON ) ? ( ( cfg & ~RF_SYNCCONFIG_SYNCSIZE_MASK ) + 1 ) : 0;
+}
+
+static bool sim_fsk_variable_length( sx127x_sim_t *sim )
+{
+    return ( sim->regs[REG_PACKETCONFIG1] & RF_PACKETCONFIG1_PACKETFORMAT_VARIABLE ) != 0;
+}
+
+static uint32_t sim_fsk_crc_bytes( sx127x_sim_t *sim )
+{
+    return ( sim->regs[REG_PACKETCONFIG1] & RF_PACKETCONFIG1_CRC_ON ) ? 2 : 0;
+}
+
+/*
+ * Reference air time formulas, SX1276/77/78/79 datasheet chapter 4.1.1.7
+ * (LoRa) and 4.2.13 packet format (FSK), evaluated in floating point on purpose.
+ */
+static uint32_t sim_time_on_air_us( sx127x_sim_t *sim, uint8_t size )
+{
+    if( sim_is_lora( sim ) )
+    {
+        int sf = sim->lora_regs[REG_LR_MODEMCONFIG2] >> 4;
+        int cr = ( sim->lora_regs[REG_LR_MODEMCONFIG1] >> 1 ) & 0x07;
+        int implicit = sim->lora_regs[REG_LR_MODEMCONFIG1] & 0x01;
+        int crc = ( sim->lora_regs[REG_LR_MODEMCONFIG2] >> 2 ) & 0x01;
+        int ldro = ( sim->lora_regs[REG_LR_MODEMCONFIG3] >> 3 ) & 0x01;
+        int preamble = ( sim->lora_regs[REG_LR_PREAMBLEMSB] << 8 ) | sim->lora_regs[REG_LR_PREAMBLELSB];
+        double tsym = sim_lora_symbol_us( sim );
+        double num = 8.0 * size - 4.0 * sf + 28.0 + 16.0 * crc - 20.0 * implicit;
+        double npayload = 8.0 + ( ( num > 0.0 ) ? ceil( num / ( 4.0 * ( sf - 2 * ldro ) ) ) * ( cr + 4 ) : 0.0 );
+
+        return ( uint32_t )ceil( ( preamble + 4.25 + npayload ) * tsym );
+    }
+    else
+    {
+        uint32_t bytes = sim_fsk_preamble_bytes( sim ) + sim_fsk_sync_bytes( sim ) +
+                         ( sim_fsk_variable_length( sim ) ? 1 : 0 ) + size + sim_fsk_crc_bytes( sim );
+
+        return ( uint32_t )ceil( bytes * sim_fsk_byte_us( sim ) );
+    }
+}
+
+uint32_t sx127x_sim_time_on_air_us( sx127x_sim_t *sim, uint8_t size )
+{
+    uint32_t toa;
+
+    pthread_mutex_lock( &sim->lock );
+    toa = sim_time_on_air_us( sim, size );
+    pthread_mutex_unlock( &sim->lock );
+    return toa;
+}
+
+static uint8_t sim_fsk_flags1( sx127x_sim_t *sim )
+{
+    uint8_t mode = sim_mode( sim );
+    uint8_t flags = sim->fsk_flags1 | RF_IRQFLAGS1_MODEREADY;
+
+    if( mode == RF_OPMODE_RECEIVER )
+    {
+        flags |= RF_IRQFLAGS1_RXREADY | RF_IRQFLAGS1_PLLLOCK;
+    }
+    else if( mode == RF_OPMODE_TRANSMITTER )
+    {
+        flags |= RF_IRQFLAGS1_TXREADY | RF_IRQFLAGS1_PLLLOCK;
+    }
+    else if( ( mode == RF_OPMODE_SYNTHESIZER_TX ) || ( mode == RF_OPMODE_SYNTHESIZER_RX ) )
+    {
+        flags |= RF_IRQFLAGS1_PLLLOCK;
+    }
+    return flags;
+}
+
+static uint8_t sim_fsk_flags2( sx127x_sim_t *sim )
+{
+    uint8_t flags = sim->fsk_flags2;
+
+    if( sim->fsk_count >= SX127X_SIM_FSK_FIFO_SIZE )
+    {
+        flags |= RF_IRQFLAGS2_FIFOFULL;
+    }
+    if( sim->fsk_count == 0 )
+    {
+        flags |= RF_IRQFLAGS2_FIFOEMPTY;
+    }
+    if( sim->fsk_count > ( sim->regs[REG_FIFOTHRESH] & ~RF_FIFOTHRESH_FIFOTHRESHOLD_MASK ) )
+    {
+        flags |= RF_IRQFLAGS2_FIFOLEVEL;
+    }
+    return flags;
+}
+
+/* RSSI seen on the frequency the chip is tuned to, called with the model lock held */
+static int8_t sim_channel_rssi( sx127x_sim_t *sim )
+{
+    uint32_t freq = sx127x_sim_get_rf_frequency( sim );
+    uint8_t i;
+
+    for( i = 0; i < SX127X_SIM_RSSI_MAP_SIZE; i++ )
+    {
+        if( ( sim->rssi_map_freq[i] != 0 ) &&
+            ( ( ( freq > sim->rssi_map_freq[i] ) ? freq - sim->rssi_map_freq[i] : sim->rssi_map_freq[i] - freq ) < 1000 ) )
+        {
+            return sim->rssi_map_rssi[i];
+        }
+    }
+    return sim->channel_rssi;
+}
+
+/* DIO levels as selected by REG_DIOMAPPING1/2, datasheet tables 18 and 29 */
+static uint8_t sim_dio_levels( sx127x_sim_t *sim )
+{
+    uint8_t map1 = sim->regs[REG_DIOMAPPING1];
+    uint8_t map2 = sim->regs[REG_DIOMAPPING2];
+    uint8_t m[SX127X_SIM_DIO_NUM];
+    uint8_t levels = 0;
+    bool d[SX127X_SIM_DIO_NUM];
+    uint8_t i;
+
+    m[0] = ( map1 >> 6 ) & 0x03;
+    m[1] = ( map1 >> 4 ) & 0x03;
+    m[2] = ( map1 >> 2 ) & 0x03;
+    m[3] = map1 & 0x03;
+    m[4] = ( map2 >> 6 ) & 0x03;
+    m[5] = ( map2 >> 4 ) & 0x03;
+
+    if( sim_is_lora( sim ) )
+    {
+        uint8_t f = sim->lora_regs[REG_LR_IRQFLAGS];
+
+        d[0] = ( m[0] == 0 ) ? ( f & RFLR_IRQFLAGS_RXDONE ) :
+               ( m[0] == 1 ) ? ( f & RFLR_IRQFLAGS_TXDONE ) :
+               ( m[0] == 2 ) ? ( f & RFLR_IRQFLAGS_CADDONE ) : 0;
+        d[1] = ( m[1] == 0 ) ? ( f & RFLR_IRQFLAGS_RXTIMEOUT ) :
+               ( m[1] == 1 ) ? ( f & RFLR_IRQFLAGS_FHSSCHANGEDCHANNEL ) :
+               ( m[1] == 2 ) ? ( f & RFLR_IRQFLAGS_CADDETECTED ) : 0;
+        d[2] = ( m[2] != 3 ) ? ( f & RFLR_IRQFLAGS_FHSSCHANGEDCHANNEL ) : 0;
+        d[3] = ( m[3] == 0 ) ? ( f & RFLR_IRQFLAGS_CADDONE ) :
+               ( m[3] == 1 ) ? ( f & RFLR_IRQFLAGS_VALIDHEADER ) :
+               ( m[3] == 2 ) ? ( f & RFLR_IRQFLAGS_PAYLOADCRCERROR ) : 0;
+        d[4] = ( m[4] == 0 ) ? ( f & RFLR_IRQFLAGS_CADDETECTED ) : 0;
+        d[5] = ( m[5] == 0 ) ? ( sim_mode( sim ) != RFLR_OPMODE_SLEEP ) : 0;
+    }
+    else
+    {
+        uint8_t f1 = sim_fsk_flags1( sim );
+        uint8_t f2 = sim_fsk_flags2( sim );
+        bool rx = ( sim_mode( sim ) == RF_OPMODE_RECEIVER );
+        bool tx = ( sim_mode( sim ) == RF_OPMODE_TRANSMITTER );
+
+        d[0] = ( m[0] == 0 ) ? ( rx ? ( f2 & RF_IRQFLAGS2_PAYLOADREADY ) : ( tx ? ( f2 & RF_IRQFLAGS2_PACKETSENT ) : 0 ) ) :
+               ( m[0] == 1 ) ? ( rx ? ( f2 & RF_IRQFLAGS2_CRCOK ) : 0 ) : 0;
+        d[1] = ( m[1] == 0 ) ? ( f2 & RF_IRQFLAGS2_FIFOLEVEL ) :
+               ( m[1] == 1 ) ? ( f2 & RF_IRQFLAGS2_FIFOEMPTY ) :
+               ( m[1] == 2 ) ? ( f2 & RF_IRQFLAGS2_FIFOFULL ) : 0;
+        d[2] = ( !rx || ( m[2] == 0 ) ) ? ( f2 & RF_IRQFLAGS2_FIFOFULL ) :
+               ( m[2] == 1 ) ? ( f1 & RF_IRQFLAGS1_RXREADY ) :
+               ( m[2] == 2 ) ? ( f1 & RF_IRQFLAGS1_TIMEOUT ) : ( f1 & RF_IRQFLAGS1_SYNCADDRESSMATCH );
+        d[3] = ( m[3] == 1 ) ? ( tx ? ( f1 & RF_IRQFLAGS1_TXREADY ) : 0 ) : ( f2 & RF_IRQFLAGS2_FIFOEMPTY );
+        d[4] = ( m[4] == 1 ) ? ( f1 & RF_IRQFLAGS1_PLLLOCK ) :
+               ( m[4] == 2 ) ? ( rx ? ( f1 & RF_IRQFLAGS1_TIMEOUT ) : 0 ) :
+               ( m[4] == 3 ) ? ( rx ? ( f1 & ( ( map2 & RF_DIOMAPPING2_MAP_PREAMBLEDETECT ) ?
+                                               RF_IRQFLAGS1_PREAMBLEDETECT : RF_IRQFLAGS1_RSSI ) ) : 0 ) : 0;
+        d[5] = ( m[5] == 1 ) ? ( f1 & RF_IRQFLAGS1_PLLLOCK ) :
+               ( ( m[5] == 2 ) && !rx ) ? ( f1 & RF_IRQFLAGS1_MODEREADY ) :
+               ( m[5] == 3 ) ? ( f1 & RF_IRQFLAGS1_MODEREADY ) : 0;
+    }
+
+    for( i = 0; i < SX127X_SIM_DIO_NUM; i++ )
+    {
+        if( d[i] )
+        {
+            levels |= ( 1 << i );
+        }
+    }
+    return levels;
+}
+
+/*
+ * called with the model lock held. A DIO that falls and rises again before
+ * dio_event runs (the MCU had interrupts disabled) keeps its rising edge,
+ * as the pending bit of an edge triggered interrupt would
+ */
+static void sim_update_dio( sx127x_sim_t *sim )
+{
+    uint8_t levels = sim_dio_levels( sim );
+
+    sim->dio_rise |= levels & ~sim->dio_sampled;
+    sim->dio_sampled = levels;
+    if( ( levels != sim->dio_level ) || ( sim->dio_rise & sim->dio_level ) )
+    {
+        sim_hw_event_schedule( &sim->dio_event, sim_get_time_us( ) );
+    }
+}
+
+static void sim_lora_raise_irq( sx127x_sim_t *sim, uint8_t irq )
+{
+    sim->lora_regs[REG_LR_IRQFLAGS] |= ( irq & ~sim->lora_regs[REG_LR_IRQFLAGSMASK] );
+}
+
+static void sim_schedule_op( sx127x_sim_t *sim, uint8_t kind, uint64_t delay_us )
+{
+    sim->op_kind = kind;
+    sim_hw_event_schedule( &sim->op_event, sim_get_time_us( ) + delay_us );
+}
+
+static void sim_cancel_op( sx127x_sim_t *sim )
+{
+    sim->op_kind = SIM_OP_NONE;
+    sim_hw_event_cancel( &sim->op_event );
+    sim_hw_event_cancel( &sim->byte_event );
+    sim->fsk_byte_clock_on = false;
+    sim->fsk_tx_active = false;
+    sim->fsk_rx_active = false;
+    if( sim->pending_rx_busy )
+    {
+        sim->pending_rx_busy = false;
+        sim->stats.rx_missed++;
+    }
+}
+
+static void sim_fsk_clear_fifo( sx127x_sim_t *sim )
+{
+    sim->fsk_head = 0;
+    sim->fsk_count = 0;
+}
+
+static void sim_fsk_push( sx127x_sim_t *sim, uint8_t data )
+{
+    if( sim->fsk_count >= SX127X_SIM_FSK_FIFO_SIZE )
+    {
+        sim->stats.fifo_overruns++;
+        sim->fsk_flags2 |= RF_IRQFLAGS2_FIFOOVERRUN;
+        return;
+    }
+    sim->fifo[( sim->fsk_head + sim->fsk_count ) % SX127X_SIM_FSK_FIFO_SIZE] = data;
+    sim->fsk_count++;
+}
+
+static uint8_t sim_fsk_pop( sx127x_sim_t *sim )
+{
+    uint8_t data;
+
+    if( sim->fsk_count == 0 )
+    {
+        return 0;
+    }
+    data = sim->fifo[sim->fsk_head];
+    sim->fsk_head = ( sim->fsk_head + 1 ) % SX127X_SIM_FSK_FIFO_SIZE;
+    sim->fsk_count--;
+    if( sim->fsk_count == 0 )
+    {
+        /* PayloadReady and CrcOk are cleared once the FIFO is read empty */
+        sim->fsk_flags2 &= ~( RF_IRQFLAGS2_PAYLOADREADY | RF_IRQFLAGS2_CRCOK );
+    }
+    return data;
+}
+
+static void sim_fsk_try_start_tx( sx127x_sim_t *sim )
+{
+    uint8_t thresh = sim->regs[REG_FIFOTHRESH];
+    bool start;
+
+    if( sim_is_lora( sim ) || ( sim_mode( sim ) != RF_OPMODE_TRANSMITTER ) || sim->fsk_tx_active )
+    {
+        return;
+    }
+    if( thresh & RF_FIFOTHRESH_TXSTARTCONDITION_FIFONOTEMPTY )
+    {
+        start = ( sim->fsk_count > 0 );
+    }
+    else
+    {
+        start = ( sim->fsk_count > ( thresh & ~RF_FIFOTHRESH_FIFOTHRESHOLD_MASK ) );
+    }
+    if( !start )
+    {
+        return;
+    }
+
+    sim->fsk_pkt_len = sim_fsk_variable_length( sim ) ? ( 1 + sim->fifo[sim->fsk_head] ) : sim->regs[REG_PAYLOADLENGTH];
+    sim->fsk_pkt_pos = 0;
+    sim->fsk_tx_active = true;
+    sim->fsk_flags2 &= ~RF_IRQFLAGS2_PACKETSENT;
+    sim->stats.last_tx_start_us = sim_get_time_us( );
+    sim_schedule_op( sim, SIM_OP_FSK_TX_DATA,
+                     sim_scaled( sim, ( uint64_t )( ( sim_fsk_preamble_bytes( sim ) + sim_fsk_sync_bytes( sim ) ) * sim_fsk_byte_us( sim ) ) ) );
+}
+
+/* OpMode transition, model lock held */
+static void sim_enter_mode( sx127x_sim_t *sim, uint8_t mode )
+{
+    uint64_t now = sim_get_time_us( );
+
+    sim_cancel_op( sim );
+    sim->fsk_flags2 &= ~RF_IRQFLAGS2_PACKETSENT;
+
+    if( sim_is_lora( sim ) )
+    {
+        switch( mode )
+        {
+        case RFLR_OPMODE_TRANSMITTER:
+            sim->stats.last_tx_start_us = now;
+            sim_schedule_op( sim, SIM_OP_TX_DONE,
+                             sim_scaled( sim, sim_time_on_air_us( sim, sim->lora_regs[REG_LR_PAYLOADLENGTH] ) ) );
+            break;
+        case RFLR_OPMODE_RECEIVER:
+            sim->stats.last_rx_start_us = now;
+            break;
+        case RFLR_OPMODE_RECEIVER_SINGLE:
+            {
+                uint32_t symbols = ( ( sim->lora_regs[REG_LR_MODEMCONFIG2] & 0x03 ) << 8 ) | sim->lora_regs[REG_LR_SYMBTIMEOUTLSB];
+
+                sim->stats.last_rx_start_us = now;
+                sim_schedule_op( sim, SIM_OP_RX_TIMEOUT, sim_scaled( sim, ( uint64_t )( symbols * sim_lora_symbol_us( sim ) ) ) );
+            }
+            break;
+        case RFLR_OPMODE_CAD:
+            {
+                uint8_t sf = sim->lora_regs[REG_LR_MODEMCONFIG2] >> 4;
+
+                sim_schedule_op( sim, SIM_OP_CAD_DONE,
+                                 sim_scaled( sim, ( uint64_t )( sim_lora_symbol_us( sim ) * ( 1.0 + 32.0 / ( 1UL << sf ) ) ) ) );
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    else
+    {
+        switch( mode )
+        {
+        case RF_OPMODE_SLEEP:
+            sim_fsk_clear_fifo( sim );
+            sim->fsk_flags1 = 0;
+            sim->fsk_flags2 = 0;
+            break;
+        case RF_OPMODE_TRANSMITTER:
+            sim_fsk_try_start_tx( sim );
+            break;
+        case RF_OPMODE_RECEIVER:
+            sim->stats.last_rx_start_us = now;
+            sim->fsk_flags1 &= ~( RF_IRQFLAGS1_PREAMBLEDETECT | RF_IRQFLAGS1_SYNCADDRESSMATCH );
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void sim_write_opmode( sx127x_sim_t *sim, uint8_t value )
+{
+    uint8_t old = sim->regs[REG_OPMODE];
+
+    /* LongRangeMode can be modified only in Sleep mode */
+    if( ( ( old ^ value ) & RFLR_OPMODE_LONGRANGEMODE_ON ) && ( ( old & ~RF_OPMODE_MASK ) != RF_OPMODE_SLEEP ) )
+    {
+        sim->stats.mode_violations++;
+        value = ( value & RFLR_OPMODE_LONGRANGEMODE_MASK ) | ( old & RFLR_OPMODE_LONGRANGEMODE_ON );
+    }
+    sim->regs[REG_OPMODE] = value;
+    if( ( ( old ^ value ) & ( RFLR_OPMODE_LONGRANGEMODE_ON | ~RF_OPMODE_MASK ) ) != 0 )
+    {
+        sim_enter_mode( sim, value & ~RF_OPMODE_MASK );
+    }
+}
+
+static void sim_reset_state( sx127x_sim_t *sim )
+{
+    sim_cancel_op( sim );
+    memset( sim->regs, 0, sizeof( sim->regs ) );
+    memset( sim->lora_regs, 0, sizeof( sim->lora_regs ) );
+
+    /* datasheet reset values of the registers the driver relies on */
+    sim->regs[REG_OPMODE] = RFLR_OPMODE_FREQMODE_ACCESS_LF | RF_OPMODE_STANDBY;
+    sim->regs[REG_BITRATEMSB] = 0x1A;
+    sim->regs[REG_BITRATELSB] = 0x0B;
+    sim->regs[REG_FDEVLSB] = 0x52;
+    sim->regs[REG_FRFMSB] = 0x6C;
+    sim->regs[REG_FRFMID] = 0x80;
+    sim->regs[REG_PACONFIG] = 0x4F;
+    sim->regs[REG_PARAMP] = 0x09;
+    sim->regs[REG_OCP] = 0x2B;
+    sim->regs[REG_LNA] = 0x20;
+    sim->regs[REG_RXCONFIG] = 0x0E;
+    sim->regs[REG_RSSICONFIG] = 0x02;
+    sim->regs[REG_RXBW] = 0x15;
+    sim->regs[REG_AFCBW] = 0x0B;
+    sim->regs[REG_PREAMBLEDETECT] = 0xAA;
+    sim->regs[REG_PREAMBLELSB] = 0x03;
+    sim->regs[REG_SYNCCONFIG] = 0x93;
+    sim->regs[REG_PACKETCONFIG1] = 0x90;
+    sim->regs[REG_PACKETCONFIG2] = 0x40;
+    sim->regs[REG_PAYLOADLENGTH] = 0x40;
+    sim->regs[REG_FIFOTHRESH] = 0x0F;
+    sim->regs[REG_IMAGECAL] = 0x82;
+    sim->regs[REG_VERSION] = SIM_VERSION;
+    sim->regs[REG_PADAC] = 0x84;
+
+    sim->lora_regs[REG_LR_FIFOTXBASEADDR] = 0x80;
+    sim->lora_regs[REG_LR_MODEMCONFIG1] = 0x72;
+    sim->lora_regs[REG_LR_MODEMCONFIG2] = 0x70;
+    sim->lora_regs[REG_LR_SYMBTIMEOUTLSB] = 0x64;
+    sim->lora_regs[REG_LR_PREAMBLELSB] = 0x08;
+    sim->lora_regs[REG_LR_PAYLOADLENGTH] = 0x01;
+    sim->lora_regs[REG_LR_PAYLOADMAXLENGTH] = 0xFF;
+    sim->lora_regs[REG_LR_HOPPERIOD] = 0xFF;
+    sim->lora_regs[REG_LR_MODEMCONFIG3] = 0x04;
+    sim->lora_regs[REG_LR_DETECTOPTIMIZE] = 0xC3;
+    sim->lora_regs[REG_LR_INVERTIQ] = 0x27;
+    sim->lora_regs[REG_LR_DETECTIONTHRESHOLD] = 0x0A;
+    sim->lora_regs[REG_LR_SYNCWORD] = LORA_MAC_PRIVATE_SYNCWORD;
+    sim->lora_regs[REG_LR_INVERTIQ2] = 0x1D;
+
+    sim_fsk_clear_fifo( sim );
+    sim->fsk_flags1 = 0;
+    sim->fsk_flags2 = 0;
+    sim_update_dio( sim );
+}
+
+static uint8_t sim_rssi_reg( sx127x_sim_t *sim, int16_t rssi )
+{
+    int16_t offset = ( sim->regs[REG_OPMODE] & RFLR_OPMODE_FREQMODE_ACCESS_LF ) ? SIM_RSSI_OFFSET_LF : SIM_RSSI_OFFSET_HF;
+    int16_t value = ( rssi + offset ) * 16 / 17;
+
+    return ( uint8_t )( ( value < 0 ) ? 0 : ( value > 255 ) ? 255 : value );
+}
+
+static uint8_t sim_reg_read( sx127x_sim_t *sim, uint8_t addr )
+{
+    uint8_t *reg;
+    uint8_t data;
+
+    if( addr == REG_FIFO )
+    {
+        sim->stats.fifo_reads++;
+        if( sim_is_lora( sim ) )
+        {
+            if( sim_mode( sim ) == RFLR_OPMODE_SLEEP )
+            {
+                sim->stats.mode_violations++;
+                return 0;
+            }
+            return sim->fifo[sim->lora_regs[REG_LR_FIFOADDRPTR]++];
+        }
+        data = sim_fsk_pop( sim );
+        /* FifoLevel / FifoEmpty / PayloadReady follow the FIFO as it is read */
+        sim_update_dio( sim );
+        return data;
+    }
+
+    sim->stats.reg_reads++;
+    reg = sim_reg( sim, addr );
+    if( reg == &sim->lora_regs[REG_LR_RSSIVALUE] )
+    {
+        return sim_rssi_reg( sim, sim_channel_rssi( sim ) );
+    }
+    if( reg == &sim->lora_regs[REG_LR_MODEMSTAT] )
+    {
+        // signal detected and synchronized, header valid while a frame is received
+        return sim->pending_rx_busy ? ( RFLR_MODEMSTAT_SIGNAL_DETECTED | RFLR_MODEMSTAT_SIGNAL_SYNCHRONIZED |
+                                        RFLR_MODEMSTAT_RX_ONGOING | RFLR_MODEMSTAT_HEADER_INFO_VALID ) : RFLR_MODEMSTAT_MODEM_CLEAR;
+    }
+    if( reg == &sim->lora_regs[REG_LR_RSSIWIDEBAND] )
+    {
+        return ( uint8_t )rand( );
+    }
+    if( reg == &sim->regs[REG_RSSIVALUE] )
+    {
+        return ( uint8_t )( -2 * ( sim->fsk_rx_active ? sim->pending_rx_rssi : sim_channel_rssi( sim ) ) );
+    }
+    if( reg == &sim->regs[REG_IRQFLAGS1] )
+    {
+        return sim_fsk_flags1( sim );
+    }
+    if( reg == &sim->regs[REG_IRQFLAGS2] )
+    {
+        return sim_fsk_flags2( sim );
+    }
+    return *reg;
+}
+
+static void sim_reg_write( sx127x_sim_t *sim, uint8_t addr, uint8_t data )
+{
+    uint8_t *reg;
+
+    if( addr == REG_FIFO )
+    {
+        sim->stats.fifo_writes++;
+        if( sim_is_lora( sim ) )
+        {
+            if( sim_mode( sim ) == RFLR_OPMODE_SLEEP )
+            {
+                sim->stats.mode_violations++;
+                return;
+            }
+            sim->fifo[sim->lora_regs[REG_LR_FIFOADDRPTR]++] = data;
+            return;
+        }
+        sim_fsk_push( sim, data );
+        sim_fsk_try_start_tx( sim );
+        sim_update_dio( sim );
+        return;
+    }
+
+    sim->stats.reg_writes++;
+    if( addr == REG_OPMODE )
+    {
+        sim_write_opmode( sim, data );
+        sim_update_dio( sim );
+        return;
+    }
+    if( addr == REG_VERSION )
+    {
+        return;
+    }
+
+    reg = sim_reg( sim, addr );
+    if( reg == &sim->lora_regs[REG_LR_IRQFLAGS] )
+    {
+        *reg &= ~data;
+    }
+    else if( reg == &sim->regs[REG_IRQFLAGS1] )
+    {
+        sim->fsk_flags1 &= ~( data & ( RF_IRQFLAGS1_RSSI | RF_IRQFLAGS1_PREAMBLEDETECT | RF_IRQFLAGS1_SYNCADDRESSMATCH ) );
+    }
+    else if( reg == &sim->regs[REG_IRQFLAGS2] )
+    {
+        if( data & RF_IRQFLAGS2_FIFOOVERRUN )
+        {
+            sim->fsk_flags2 &= ~RF_IRQFLAGS2_FIFOOVERRUN;
+            sim_fsk_clear_fifo( sim );
+        }
+    }
+    else if( reg == &sim->regs[REG_RXCONFIG] )
+    {
+        *reg = data & ~( RF_RXCONFIG_RESTARTRXWITHOUTPLLLOCK | RF_RXCONFIG_RESTARTRXWITHPLLLOCK );
+        if( ( data & ( RF_RXCONFIG_RESTARTRXWITHOUTPLLLOCK | RF_RXCONFIG_RESTARTRXWITHPLLLOCK ) ) &&
+            ( sim_mode( sim ) == RF_OPMODE_RECEIVER ) )
+        {
+            sim_cancel_op( sim );
+            sim_fsk_clear_fifo( sim );
+            sim->fsk_flags1 &= ~( RF_IRQFLAGS1_PREAMBLEDETECT | RF_IRQFLAGS1_SYNCADDRESSMATCH );
+            sim->fsk_flags2 = 0;
+        }
+    }
+    else if( reg == &sim->regs[REG_IMAGECAL] )
+    {
+        /* calibration completes instantly, ImageCalRunning never reads back set */
+        *reg = data & ~( RF_IMAGECAL_IMAGECAL_START | RF_IMAGECAL_IMAGECAL_RUNNING );
+    }
+    else
+    {
+        *reg = data;
+    }
+    sim_update_dio( sim );
+}
+
+static void sim_fsk_rx_byte( sx127x_sim_t *sim )
+{
+    uint16_t pos = sim->fsk_pkt_pos;
+
+    if( sim_fsk_variable_length( sim ) )
+    {
+        sim_fsk_push( sim, ( pos == 0 ) ? sim->pending_rx_len : sim->pending_rx[pos - 1] );
+    }
+    else
+    {
+        sim_fsk_push( sim, sim->pending_rx[pos] );
+    }
+    sim->fsk_pkt_pos++;
+}
+
+/*
+ * Bytes the clock can move before one of them changes a FIFO flag: the
+ * FifoLevel threshold, FIFO full / empty, or the end of the packet. Only
+ * that byte needs the byte clock event; the MCU reading or writing the FIFO
+ * in between only pushes the next flag change further away.
+ */
+static uint32_t sim_fsk_quiet_bytes( sx127x_sim_t *sim )
+{
+    uint32_t thresh = sim->regs[REG_FIFOTHRESH] & ~RF_FIFOTHRESH_FIFOTHRESHOLD_MASK;
+    uint32_t count = sim->fsk_count;
+    uint32_t left = sim->fsk_pkt_len - sim->fsk_pkt_pos;
+    uint32_t n;
+
+    if( sim->fsk_tx_active )
+    {
+        n = ( count > thresh ) ? ( count - thresh ) : ( ( count > 0 ) ? count : 1 );
+    }
+    else
+    {
+        n = ( count <= thresh ) ? ( thresh + 1 - count ) :
+            ( ( count < SX127X_SIM_FSK_FIFO_SIZE ) ? ( SX127X_SIM_FSK_FIFO_SIZE - count ) : 1 );
+    }
+    return ( ( left > 0 ) && ( left < n ) ) ? left : n;
+}
+
+/*
+ * Moves the FSK bytes due by now through the FIFO, model lock held. The byte
+ * clock event calls it on time, SPI accesses and DIO reads call it too so
+ * the MCU never sees a FIFO behind the air. If the host ran the model so
+ * late that a byte changing a FIFO flag is more than SIM_FSK_LATE_BYTES
+ * behind, the rest of the packet is pushed back rather than landing in the
+ * FIFO before its DIO could rise, so only a late MCU overruns the FIFO.
+ */
+static void sim_fsk_byte_clock( sx127x_sim_t *sim, bool from_event )
+{
+    uint64_t now, due, end_us;
+    uint32_t quiet;
+    bool moved = false;
+
+    if( !sim->fsk_byte_clock_on )
+    {
+        return;
+    }
+    now = sim_get_time_us( );
+    quiet = sim_fsk_quiet_bytes( sim );
+    while( sim->fsk_byte_clock_on && ( sim->fsk_next_byte_us <= now ) )
+    {
+        due = sim->fsk_next_byte_us;
+        moved = true;
+        if( sim->fsk_tx_active )
+        {
+            if( sim->fsk_count == 0 )
+            {
+                sim->stats.fifo_underruns++;
+            }
+            else
+            {
+                sim_fsk_pop( sim );
+                sim->fsk_pkt_pos++;
+            }
+        }
+        else if( sim->fsk_rx_active )
+        {
+            sim_fsk_rx_byte( sim );
+        }
+        else
+        {
+            sim->fsk_byte_clock_on = false;
+            break;
+        }
+        if( sim->fsk_pkt_pos >= sim->fsk_pkt_len )
+        {
+            sim->fsk_byte_clock_on = false;
+            end_us = due + sim_scaled( sim, ( uint64_t )( sim_fsk_crc_bytes( sim ) * sim_fsk_byte_us( sim ) ) );
+            sim->op_kind = sim->fsk_tx_active ? SIM_OP_FSK_TX_END : SIM_OP_FSK_RX_END;
+            sim_hw_event_schedule( &sim->op_event, end_us );
+            break;
+        }
+        sim->fsk_next_byte_us = due + sim_fsk_byte_clock_us( sim );
+        if( --quiet == 0 )
+        {
+            if( ( now - due ) > SIM_FSK_LATE_BYTES * sim_fsk_byte_clock_us( sim ) )
+            {
+                sim->fsk_next_byte_us = now + sim_fsk_byte_clock_us( sim );
+                break;
+            }
+            quiet = sim_fsk_quiet_bytes( sim );
+        }
+    }
+    if( moved )
+    {
+        sim_update_dio( sim );
+    }
+    if( sim->fsk_byte_clock_on && ( moved || from_event ) )
+    {
+        sim_hw_event_schedule( &sim->byte_event, sim->fsk_next_byte_us +
+                               ( sim_fsk_quiet_bytes( sim ) - 1 ) * sim_fsk_byte_clock_us( sim ) );
+    }
+}
+
+static void sim_fsk_byte_clock_start( sx127x_sim_t *sim )
+{
+    sim->fsk_next_byte_us = sim_get_time_us( ) + sim_fsk_byte_clock_us( sim );
+    sim->fsk_byte_clock_on = true;
+    sim_hw_event_schedule( &sim->byte_event, sim->fsk_next_byte_us +
+                           ( sim_fsk_quiet_bytes( sim ) - 1 ) * sim_fsk_byte_clock_us( sim ) );
+}
+
+static void sim_spi_cs( struct rt_spi_device *device, rt_bool_t active )
+{
+    sx127x_sim_t *sim = device->user_data;
+
+    pthread_mutex_lock( &sim->lock );
+    if( active )
+    {
+        sim_fsk_byte_clock( sim, false );
+        sim->xfer_len = 0;
+        sim->xfer_ignored = false;
+        if( sim_get_time_us( ) < sim->ready_at_us )
+        {
+            sim->stats.not_ready++;
+            sim->xfer_ignored = true;
+        }
+    }
+    pthread_mutex_unlock( &sim->lock );
+}
+
+static rt_uint8_t sim_spi_xfer( struct rt_spi_device *device, rt_uint8_t out )
+{
+    sx127x_sim_t *sim = device->user_data;
+    uint8_t in = 0;
+    uint8_t addr;
+
+    pthread_mutex_lock( &sim->lock );
+    if( sim->xfer_ignored )
+    {
+        /* nothing */
+    }
+    else if( sim->xfer_len == 0 )
+    {
+        sim->addr = out & 0x7F;
+        sim->write = ( out & 0x80 ) != 0;
+    }
+    else
+    {
+        /* burst access, the address auto-increments except on the FIFO */
+        addr = sim->addr;
+        if( addr != REG_FIFO )
+        {
+            sim->addr = ( sim->addr + 1 ) & 0x7F;
+        }
+        if( sim->write )
+        {
+            sim_reg_write( sim, addr, out );
+        }
+        else
+        {
+            in = sim_reg_read( sim, addr );
+        }
+    }
+    sim->xfer_len++;
+    pthread_mutex_unlock( &sim->lock );
+    return in;
+}
+
+static const struct sim_spi_ops sx127x_sim_spi_ops =
+{
+    sim_spi_cs,
+    sim_spi_xfer,
+};
+
+static void sim_reset_write( void *ctx, rt_base_t value )
+{
+    sx127x_sim_t *sim = ctx;
+
+    pthread_mutex_lock( &sim->lock );
+    if( value == PIN_LOW )
+    {
+        sim_reset_state( sim );
+        sim->ready_at_us = UINT64_MAX;
+    }
+    else if( sim->ready_at_us == UINT64_MAX )
+    {
+        sim->ready_at_us = sim_get_time_us( ) + SX127X_SIM_RESET_READY_US;
+    }
+    pthread_mutex_unlock( &sim->lock );
+}
+
+/* the MCU samples the DIO as the chip drives it, edges still go through dio_event */
+static int sim_dio_read( void *ctx )
+{
+    struct sx127x_sim_dio_reader *reader = ctx;
+    sx127x_sim_t *sim = reader->sim;
+    int level;
+
+    pthread_mutex_lock( &sim->lock );
+    sim_fsk_byte_clock( sim, false );
+    level = ( ( sim_dio_levels( sim ) >> reader->index ) & 0x01 ) ? PIN_HIGH : PIN_LOW;
+    pthread_mutex_unlock( &sim->lock );
+    return level;
+}
+
+static void sim_dio_event( void *parameter )
+{
+    sx127x_sim_t *sim = parameter;
+    uint8_t levels, changed, pulsed, i;
+    uint64_t now = sim_get_time_us( );
+
+    pthread_mutex_lock( &sim->lock );
+    levels = sim_dio_levels( sim );
+    sim->dio_rise |= levels & ~sim->dio_sampled;
+    sim->dio_sampled = levels;
+    // high on the pin and high now, but went low in between: drive the low first
+    pulsed = sim->dio_rise & sim->dio_level & levels;
+    changed = ( levels ^ sim->dio_level ) | pulsed;
+    for( i = 0; i < SX127X_SIM_DIO_NUM; i++ )
+    {
+        if( ( changed & levels ) & ( 1 << i ) )
+        {
+            sim->stats.dio_edges[i]++;
+            sim->stats.last_dio_rise_us[i] = now;
+        }
+    }
+    sim->dio_level = levels;
+    sim->dio_rise = 0;
+    pthread_mutex_unlock( &sim->lock );
+
+    for( i = 0; i < SX127X_SIM_DIO_NUM; i++ )
+    {
+        if( ( changed & ( 1 << i ) ) && ( sim->dio_pins[i] != PIN_IRQ_PIN_NONE ) )
+        {
+            if( pulsed & ( 1 << i ) )
+            {
+                sim_pin_set_input( sim->dio_pins[i], PIN_LOW );
+            }
+            sim_pin_set_input( sim->dio_pins[i], ( levels >> i ) & 0x01 );
+        }
+    }
+}
+
+static void sim_byte_event( void *parameter )
+{
+    sx127x_sim_t *sim = parameter;
+
+    pthread_mutex_lock( &sim->lock );
+    sim_fsk_byte_clock( sim, true );
+    pthread_mutex_unlock( &sim->lock );
+}
+
+static void sim_lora_rx_done( sx127x_sim_t *sim )
+{
+    uint8_t base = sim->lora_regs[REG_LR_FIFORXBASEADDR];
+    uint8_t irq = RFLR_IRQFLAGS_VALIDHEADER | RFLR_IRQFLAGS_RXDONE;
+    uint8_t i;
+
+    sim->pending_rx_busy = false;
+    for( i = 0; i < sim->pending_rx_len; i++ )
+    {
+        sim->fifo[( uint8_t )( base + i )] = sim->pending_rx[i];
+    }
+    sim->lora_regs[REG_LR_FIFORXCURRENTADDR] = base;
+    sim->lora_regs[REG_LR_RXNBBYTES] = sim->pending_rx_len;
+    sim->lora_regs[REG_LR_PKTSNRVALUE] = ( uint8_t )( sim->pending_rx_snr * 4 );
+    sim->lora_regs[REG_LR_PKTRSSIVALUE] = sim_rssi_reg( sim, sim->pending_rx_rssi );
+    if( sim->pending_rx_crc_error )
+    {
+        irq |= RFLR_IRQFLAGS_PAYLOADCRCERROR;
+    }
+    if( sim_mode( sim ) == RFLR_OPMODE_RECEIVER_SINGLE )
+    {
+        sim_set_mode_bits( sim, RFLR_OPMODE_STANDBY );
+    }
+    sim->stats.rx_done++;
+    sim_lora_raise_irq( sim, irq );
+}
+
+static void sim_op_event( void *parameter )
+{
+    sx127x_sim_t *sim = parameter;
+    uint8_t kind;
+
+    pthread_mutex_lock( &sim->lock );
+    kind = sim->op_kind;
+    sim->op_kind = SIM_OP_NONE;
+    switch( kind )
+    {
+    case SIM_OP_TX_DONE:
+        sim_set_mode_bits( sim, RFLR_OPMODE_STANDBY );
+        sim->stats.tx_done++;
+        sim_lora_raise_irq( sim, RFLR_IRQFLAGS_TXDONE );
+        break;
+    case SIM_OP_RX_DONE:
+        sim_lora_rx_done( sim );
+        break;
+    case SIM_OP_RX_TIMEOUT:
+        sim_set_mode_bits( sim, RFLR_OPMODE_STANDBY );
+        sim->stats.timeouts++;
+        sim_lora_raise_irq( sim, RFLR_IRQFLAGS_RXTIMEOUT );
+        break;
+    case SIM_OP_CAD_DONE:
+        sim_set_mode_bits( sim, RFLR_OPMODE_STANDBY );
+        sim->stats.cad_done++;
+        sim_lora_raise_irq( sim, RFLR_IRQFLAGS_CADDONE | ( sim->channel_activity ? RFLR_IRQFLAGS_CADDETECTED : 0 ) );
+        break;
+    case SIM_OP_FSK_TX_DATA:
+        sim_fsk_byte_clock_start( sim );
+        break;
+    case SIM_OP_FSK_TX_END:
+        sim->fsk_tx_active = false;
+        sim->fsk_flags2 |= RF_IRQFLAGS2_PACKETSENT;
+        sim->stats.tx_done++;
+        break;
+    case SIM_OP_FSK_RX_PREAMBLE:
+        sim->fsk_flags1 |= RF_IRQFLAGS1_PREAMBLEDETECT | RF_IRQFLAGS1_RSSI;
+        sim_schedule_op( sim, SIM_OP_FSK_RX_SYNC, sim_scaled( sim, ( uint64_t )( sim_fsk_sync_bytes( sim ) * sim_fsk_byte_us( sim ) ) ) );
+        break;
+    case SIM_OP_FSK_RX_SYNC:
+        sim->fsk_flags1 |= RF_IRQFLAGS1_SYNCADDRESSMATCH;
+        sim->fsk_rx_active = true;
+        sim_fsk_byte_clock_start( sim );
+        break;
+    case SIM_OP_FSK_RX_END:
+        sim->fsk_rx_active = false;
+        sim->pending_rx_busy = false;
+        sim->stats.rx_done++;
+        if( sim->pending_rx_crc_error && sim_fsk_crc_bytes( sim ) &&
+            ( ( sim->regs[REG_PACKETCONFIG1] & RF_PACKETCONFIG1_CRCAUTOCLEAR_OFF ) == 0 ) )
+        {
+            /* CrcAutoClear: the packet is dropped and the receiver restarted */
+            sim_fsk_clear_fifo( sim );
+            sim->fsk_flags1 &= ~( RF_IRQFLAGS1_PREAMBLEDETECT | RF_IRQFLAGS1_SYNCADDRESSMATCH );
+        }
+        else
+        {
+            sim->fsk_flags2 |= RF_IRQFLAGS2_PAYLOADREADY;
+            if( sim_fsk_crc_bytes( sim ) && !sim->pending_rx_crc_error )
+            {
+                sim->fsk_flags2 |= RF_IRQFLAGS2_CRCOK;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    sim_update_dio( sim );
+    pthread_mutex_unlock( &sim->lock );
+}
+
+rt_err_t sx127x_sim_attach( sx127x_sim_t *sim, const char *device_name,
+                            const rt_base_t dio_pins[SX127X_SIM_DIO_NUM], rt_base_t reset_pin )
+{
+    uint8_t i;
+
+    memset( sim, 0, sizeof( *sim ) );
+    pthread_mutex_init( &sim->lock, RT_NULL );
+    for( i = 0; i < SX127X_SIM_DIO_NUM; i++ )
+    {
+        sim->dio_pins[i] = dio_pins[i];
+        sim->dio_readers[i].sim = sim;
+        sim->dio_readers[i].index = i;
+        if( dio_pins[i] != PIN_IRQ_PIN_NONE )
+        {
+            sim_pin_set_reader( dio_pins[i], sim_dio_read, &sim->dio_readers[i] );
+        }
+    }
+    sim->reset_pin = reset_pin;
+    sim->channel_rssi = -120;
+    sim->air_time_scale = 100;
+
+    sim_hw_event_init( &sim->op_event, sim_op_event, sim, SIM_HW_EVENT_CHIP );
+    sim_hw_event_init( &sim->byte_event, sim_byte_event, sim, SIM_HW_EVENT_CHIP );
+    sim_hw_event_init( &sim->dio_event, sim_dio_event, sim, SIM_HW_EVENT_ISR );
+
+    sim_reset_state( sim );
+
+    sim_pin_set_writer( reset_pin, sim_reset_write, sim );
+
+    return sim_spi_device_register( &sim->spi, device_name, &sx127x_sim_spi_ops, sim );
+}
+
+void sx127x_sim_set_air_time_scale( sx127x_sim_t *sim, uint32_t percent )
+{
+    sim->air_time_scale = percent;
+}
+
+rt_err_t sx127x_sim_inject_rx( sx127x_sim_t *sim, const uint8_t *payload, uint8_t size,
+                               int8_t rssi, int8_t snr, bool crc_error )
+{
+    uint8_t mode;
+
+    pthread_mutex_lock( &sim->lock );
+    mode = sim_mode( sim );
+    if( sim->pending_rx_busy ||
+        ( sim_is_lora( sim ) && ( mode != RFLR_OPMODE_RECEIVER ) && ( mode != RFLR_OPMODE_RECEIVER_SINGLE ) ) ||
+        ( !sim_is_lora( sim ) && ( mode != RF_OPMODE_RECEIVER ) ) )
+    {
+        sim->stats.rx_missed++;
+        pthread_mutex_unlock( &sim->lock );
+        return -RT_ERROR;
+    }
+
+    memcpy( sim->pending_rx, payload, size );
+    sim->pending_rx_len = size;
+    sim->pending_rx_rssi = rssi;
+    sim->pending_rx_snr = snr;
+    sim->pending_rx_crc_error = crc_error;
+    sim->pending_rx_busy = true;
+
+    if( sim_is_lora( sim ) )
+    {
+        /* preamble detected, the symbol timeout no longer applies */
+        sim_schedule_op( sim, SIM_OP_RX_DONE, sim_scaled( sim, sim_time_on_air_us( sim, size ) ) );
+    }
+    else
+    {
+        sim->fsk_pkt_len = ( sim_fsk_variable_length( sim ) ? 1 : 0 ) + size;
+        sim->fsk_pkt_pos = 0;
+        sim_schedule_op( sim, SIM_OP_FSK_RX_PREAMBLE,
+                         sim_scaled( sim, ( uint64_t )( sim_fsk_preamble_bytes( sim ) * sim_fsk_byte_us( sim ) ) ) );
+    }
+    pthread_mutex_unlock( &sim->lock );
+    return RT_EOK;
+}
+
+void sx127x_sim_set_channel_rssi_at( sx127x_sim_t *sim, uint32_t freq, int8_t rssi )
+{
+    uint8_t i;
+
+    pthread_mutex_lock( &sim->lock );
+    for( i = 0; i < SX127X_SIM_RSSI_MAP_SIZE; i++ )
+    {
+        if( freq == 0 )
+        {
+            sim->rssi_map_freq[i] = 0;
+        }
+        else if( ( sim->rssi_map_freq[i] == freq ) || ( sim->rssi_map_freq[i] == 0 ) )
+        {
+            sim->rssi_map_freq[i] = freq;
+            sim->rssi_map_rssi[i] = rssi;
+            break;
+        }
+    }
+    pthread_mutex_unlock( &sim->lock );
+}
+
+void sx127x_sim_set_channel( sx127x_sim_t *sim, bool activity, int8_t rssi )
+{
+    pthread_mutex_lock( &sim->lock );
+    sim->channel_activity = activity;
+    sim->channel_rssi = rssi;
+    pthread_mutex_unlock( &sim->lock );
+}
+
+uint8_t sx127x_sim_get_opmode( sx127x_sim_t *sim )
+{
+    return sim->regs[REG_OPMODE];
+}
+
+uint32_t sx127x_sim_get_rf_frequency( sx127x_sim_t *sim )
+{
+    uint32_t frf = ( ( uint32_t )sim->regs[REG_FRFMSB] << 16 ) | ( ( uint32_t )sim->regs[REG_FRFMID] << 8 ) | sim->regs[REG_FRFLSB];
+
+    return ( uint32_t )( ( ( uint64_t )frf * XTAL_FREQ ) >> 19 );
+}
+
+void sx127x_sim_get_stats( sx127x_sim_t *sim, struct sx127x_sim_stats *stats )
+{
+    pthread_mutex_lock( &sim->lock );
+    *stats = sim->stats;
+    pthread_mutex_unlock( &sim->lock );
+}
+
+void sx127x_sim_reset_stats( sx127x_sim_t *sim )
+{
+    pthread_mutex_lock( &sim->lock );
+    memset( &sim->stats, 0, sizeof( sim->stats ) );
+    pthread_mutex_unlock( &sim->lock );
+}
@@ -0,0 +1,189 @@
+/*!
+ * \file      sx127x-sim.h
+ *
+ * \brief     software model of an SX127x transceiver for the host build.
+ *
+ *            The model sits behind an rt_spi_device and implements the
+ *            register file of sx127xRegs-Fsk.h / sx127xRegs-LoRa.h (0x0D..0x3F
+ *            banked on LongRangeMode), the 256-byte LoRa data buffer and the
+ *            64-byte FSK FIFO behind register 0x00, the OpMode state machine
+ *            and the DIO0..DIO5 lines as selected by REG_DIOMAPPING1/2.
+ *            Air time is derived from the programmed modulation, FSK bytes
+ *            are clocked in and out of the FIFO at the programmed bit rate.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#ifndef __SX127X_SIM_H__
+#define __SX127X_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "lora-radio.h"
+
+#define SX127X_SIM_DIO_NUM                          6
+#define SX127X_SIM_RSSI_MAP_SIZE                    16      // channels with their own RSSI
+#define SX127X_SIM_REG_SIZE                         0x80
+#define SX127X_SIM_FSK_FIFO_SIZE                    64
+
+/*!
+ * Time from NRESET release to the first SPI access, datasheet 7.2.2
+ */
+#define SX127X_SIM_RESET_READY_US                   5000
+
+/*!
+ * \brief statistics gathered by the model, see sx127x_sim_get_stats()
+ */
+struct sx127x_sim_stats
+{
+    uint32_t reg_reads;             //!< register bytes read, FIFO excluded
+    uint32_t reg_writes;            //!< register bytes written, FIFO excluded
+    uint32_t fifo_reads;            //!< bytes read from the FIFO
+    uint32_t fifo_writes;           //!< bytes written to the FIFO
+    uint32_t not_ready;             //!< SPI transactions during reset / POR, ignored
+    uint32_t mode_violations;       //!< LongRangeMode change outside Sleep, LoRa FIFO access in Sleep
+    uint32_t fifo_overruns;         //!< FSK bytes received into a full FIFO
+    uint32_t fifo_underruns;        //!< FSK byte slots the FIFO was empty during a packet
+    uint32_t dio_edges[SX127X_SIM_DIO_NUM];
+    uint32_t tx_done;
+    uint32_t rx_done;
+    uint32_t rx_missed;             //!< injected frames the receiver was not listening for
+    uint32_t cad_done;
+    uint32_t timeouts;
+    uint64_t last_dio_rise_us[SX127X_SIM_DIO_NUM];
+    uint64_t last_tx_start_us;      //!< time stamp of the latest entry in Tx
+    uint64_t last_rx_start_us;      //!< time stamp of the latest entry in Rx
+};
+
+struct sx127x_sim;
+
+/*!
+ * \brief context of the reader behind one DIO pin
+ */
+struct sx127x_sim_dio_reader
+{
+    struct sx127x_sim *sim;
+    uint8_t index;
+};
+
+/*!
+ * \brief SX127x model instance
+ */
+typedef struct sx127x_sim
+{
+    struct rt_spi_device spi;
+    pthread_mutex_t lock;
+
+    rt_base_t dio_pins[SX127X_SIM_DIO_NUM];
+    struct sx127x_sim_dio_reader dio_readers[SX127X_SIM_DIO_NUM];
+    rt_base_t reset_pin;
+
+    /* SPI transaction being decoded */
+    uint8_t addr;
+    bool write;
+    uint16_t xfer_len;
+    bool xfer_ignored;
+
+    /* chip state, regs[] holds the common and FSK/OOK page, lora_regs[] the LoRa page */
+    uint8_t regs[SX127X_SIM_REG_SIZE];
+    uint8_t lora_regs[SX127X_SIM_REG_SIZE];
+    uint8_t fifo[256];
+    uint8_t fsk_head;
+    uint8_t fsk_count;
+    uint8_t fsk_flags1;             //!< latched bits of REG_IRQFLAGS1
+    uint8_t fsk_flags2;             //!< latched bits of REG_IRQFLAGS2
+    uint8_t dio_level;              //!< levels last driven on the MCU pins
+    uint8_t dio_sampled;            //!< levels at the last model update
+    uint8_t dio_rise;               //!< rising edges not yet driven on the pins
+    uint64_t ready_at_us;
+    uint8_t op_kind;
+
+    /* FSK packet engine */
+    uint16_t fsk_pkt_len;           //!< bytes moved through the FIFO for the packet on air
+    uint16_t fsk_pkt_pos;
+    uint64_t fsk_next_byte_us;      //!< when the byte clock moves the next byte
+    bool fsk_byte_clock_on;
+    bool fsk_tx_active;
+    bool fsk_rx_active;
+
+    /* air side */
+    int8_t channel_rssi;
+    bool channel_activity;
+    uint32_t rssi_map_freq[SX127X_SIM_RSSI_MAP_SIZE];   //!< 0: free entry
+    int8_t rssi_map_rssi[SX127X_SIM_RSSI_MAP_SIZE];
+    uint32_t air_time_scale;
+    uint8_t pending_rx[256];
+    uint8_t pending_rx_len;
+    int8_t pending_rx_rssi;
+    int8_t pending_rx_snr;
+    bool pending_rx_crc_error;
+    bool pending_rx_busy;
+
+    struct sim_hw_event op_event;       //!< LoRa TX / RX / CAD completion and timeouts, FSK packet phases
+    struct sim_hw_event byte_event;     //!< FSK FIFO byte clock
+    struct sim_hw_event dio_event;      //!< deferred DIO level update
+
+    struct sx127x_sim_stats stats;
+}sx127x_sim_t;
+
+/*!
+ * \brief Creates the model and registers it as SPI device \a device_name
+ *
+ * \param [IN] sim          model instance
+ * \param [IN] device_name  name the driver will rt_device_find()
+ * \param [IN] dio_pins     MCU pins wired to DIO0..DIO5, PIN_IRQ_PIN_NONE if not connected
+ * \param [IN] reset_pin    MCU pin wired to NRESET
+ */
+rt_err_t sx127x_sim_attach( sx127x_sim_t *sim, const char *device_name,
+                            const rt_base_t dio_pins[SX127X_SIM_DIO_NUM], rt_base_t reset_pin );
+
+/*!
+ * \brief Scales every air time (TX, RX, CAD, FSK bit rate) by percent/100.
+ *        100 is real time, smaller values speed up benchmarks.
+ */
+void sx127x_sim_set_air_time_scale( sx127x_sim_t *sim, uint32_t percent );
+
+/*!
+ * \brief Starts a frame on air now, it is received if the chip is listening
+ *        when it starts and is still in RX when it ends.
+ *
+ * \retval RT_EOK if the receiver was listening, -RT_ERROR otherwise
+ */
+rt_err_t sx127x_sim_inject_rx( sx127x_sim_t *sim, const uint8_t *payload, uint8_t size,
+                               int8_t rssi, int8_t snr, bool crc_error );
+
+/*!
+ * \brief Sets the channel state seen by RSSI reads and CAD
+ */
+void sx127x_sim_set_channel( sx127x_sim_t *sim, bool activity, int8_t rssi );
+
+/*!
+ * \brief Gives \a freq its own RSSI reading, used instead of the channel
+ *        RSSI while the chip is tuned within 1 kHz of it. \a freq 0 clears
+ *        every entry.
+ */
+void sx127x_sim_set_channel_rssi_at( sx127x_sim_t *sim, uint32_t freq, int8_t rssi );
+
+/*!
+ * \brief Returns the air time of a frame of \a size bytes with the current
+ *        modem settings, in us, unscaled
+ */
+uint32_t sx127x_sim_time_on_air_us( sx127x_sim_t *sim, uint8_t size );
+
+uint8_t sx127x_sim_get_opmode( sx127x_sim_t *sim );
+uint32_t sx127x_sim_get_rf_frequency( sx127x_sim_t *sim );
+void sx127x_sim_get_stats( sx127x_sim_t *sim, struct sx127x_sim_stats *stats );
+void sx127x_sim_reset_stats( sx127x_sim_t *sim );
+
+/*!
+ * \brief The model instances, one per radio instance. sx127x_sim0 is the one
+ *        behind LORA_RADIO0_DEVICE_NAME
+ */
+extern sx127x_sim_t sx127x_sim[LORA_RADIO_DRIVER_INSTANCE_NUM];
+#define sx127x_sim0                      ( sx127x_sim[0] )
+
+#endif /* __SX127X_SIM_H__ */
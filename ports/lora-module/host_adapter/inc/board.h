@@ -0,0 +1,16 @@
+/*!
+ * \file      board.h
+ *
+ * \brief     host build replacement for the BSP board.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#ifndef __BOARD_H__
+#define __BOARD_H__
+
+#include <rtthread.h>
+
+#endif /* __BOARD_H__ */
@@ -0,0 +1,19 @@
+/*!
+ * \file      drv_gpio.h
+ *
+ * \brief     host build replacement for the BSP drv_gpio.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#ifndef __DRV_GPIO_H__
+#define __DRV_GPIO_H__
+
+#include <rtdevice.h>
+
+/* same numbering as the stm32 drv_gpio.c: 16 pins per port, GPIOA first */
+#define GET_PIN(PORTx, PIN)  (rt_base_t)( 16 * ( #PORTx[0] - 'A' ) + ( PIN ) )
+
+#endif /* __DRV_GPIO_H__ */
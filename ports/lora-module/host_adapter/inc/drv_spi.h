@@ -0,0 +1,16 @@
+/*!
+ * \file      drv_spi.h
+ *
+ * \brief     host build replacement for the BSP drv_spi.h
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#ifndef __DRV_SPI_H__
+#define __DRV_SPI_H__
+
+#include <rtdevice.h>
+
+#endif /* __DRV_SPI_H__ */
@@ -0,0 +1,56 @@
+/*!
+ * \file      rtconfig.h
+ *
+ * \brief     host build configuration, stands in for the BSP rtconfig.h that
+ *            menuconfig generates. The chip family is selected on the make
+ *            command line, see host_adapter/Makefile.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#ifndef __RT_CONFIG_H__
+#define __RT_CONFIG_H__
+
+#define RT_NAME_MAX 8
+#define RT_TICK_PER_SECOND 1000
+#define RT_USING_PIN
+#define RT_USING_SPI
+#define BSP_USING_SPI3
+#define BSP_SPI3_TX_USING_DMA
+#define BSP_SPI3_RX_USING_DMA
+
+#define PKG_USING_LORA_RADIO_DRIVER
+#define LORA_RADIO_DRIVER_USING_HOST_SIMULATOR
+#define LORA_RADIO_DRIVER_USING_CRITICAL_SECTION_STATS
+#if !defined( LORA_RADIO_DRIVER_INSTANCE_NUM ) || ( LORA_RADIO_DRIVER_INSTANCE_NUM == 1 )
+#define LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC
+#endif
+#define LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS
+#define LORA_RADIO_DRIVER_USING_CONFIG_DIFF
+#define LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+#define LORA_RADIO_DRIVER_USING_RX_POOL
+#define LORA_RADIO_DRIVER_USING_TX_QUEUE
+#define LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+#define LORA_RADIO_DRIVER_USING_EVENT_RING
+#define LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+#define LORA_RADIO_DRIVER_USING_RX_POLICY
+#define LORA_RADIO_DRIVER_USING_LBT
+#define LORA_RADIO_DRIVER_USING_SCAN
+#define LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+#define LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE
+#define LORA_RADIO_DRIVER_USING_SX126X_CAD_RX
+#ifndef LORA_RADIO_HOST_USING_RTICK_TIMER
+#define LORA_RADIO_DRIVER_USING_HRTIMER
+#endif
+#define LORA_RADIO_TIMESTAMP_US( ) ( ( uint32_t )sim_get_time_us( ) )
+
+#ifndef LORA_RADIO0_SPI_BUS_NAME
+#define LORA_RADIO0_SPI_BUS_NAME "spi3"
+#endif
+#ifndef LORA_RADIO0_DEVICE_NAME
+#define LORA_RADIO0_DEVICE_NAME "spi30"
+#endif
+
+#endif /* __RT_CONFIG_H__ */
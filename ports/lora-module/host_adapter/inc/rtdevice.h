@@ -0,0 +1,171 @@
+/*!
+ * \file      rtdevice.h
+ *
+ * \brief     minimal RT-Thread device API (PIN and SPI) for the host build.
+ *
+ *            SPI devices are backed by a byte-level model registered through
+ *            sim_spi_device_register(); every transfer is clocked one byte at a
+ *            time into the model with NSS asserted and released exactly as the
+ *            rt_spi_message chain requests, and the time on the wire is
+ *            accounted at the configured max_hz.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#ifndef __RT_DEVICE_HOST_H__
+#define __RT_DEVICE_HOST_H__
+
+#include "rtthread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* PIN */
+#define PIN_LOW                         0x00
+#define PIN_HIGH                        0x01
+
+#define PIN_MODE_OUTPUT                 0x00
+#define PIN_MODE_INPUT                  0x01
+#define PIN_MODE_INPUT_PULLUP           0x02
+#define PIN_MODE_INPUT_PULLDOWN         0x03
+#define PIN_MODE_OUTPUT_OD              0x04
+
+#define PIN_IRQ_MODE_RISING             0x00
+#define PIN_IRQ_MODE_FALLING            0x01
+#define PIN_IRQ_MODE_RISING_FALLING     0x02
+#define PIN_IRQ_MODE_HIGH_LEVEL         0x03
+#define PIN_IRQ_MODE_LOW_LEVEL          0x04
+
+#define PIN_IRQ_DISABLE                 0x00
+#define PIN_IRQ_ENABLE                  0x01
+
+#define PIN_IRQ_PIN_NONE                -1
+
+#define SIM_PIN_MAX                     256
+
+void rt_pin_mode(rt_base_t pin, rt_base_t mode);
+void rt_pin_write(rt_base_t pin, rt_base_t value);
+int  rt_pin_read(rt_base_t pin);
+rt_err_t rt_pin_attach_irq(rt_int32_t pin, rt_uint32_t mode,
+                           void (*hdr)(void *args), void *args);
+rt_err_t rt_pin_detach_irq(rt_int32_t pin);
+rt_err_t rt_pin_irq_enable(rt_base_t pin, rt_uint32_t enabled);
+
+/*!
+ * \brief hooks used by the chip models to drive the MCU side of a pin.
+ *
+ * sim_pin_set_input() changes the level seen by rt_pin_read() and fires the
+ * attached IRQ handler on a matching edge, with the interrupt lock held.
+ * sim_pin_set_reader() overrides rt_pin_read() for time driven lines such
+ * as BUSY. sim_pin_set_writer() observes MCU writes (NSS, RESET, ...).
+ */
+void sim_pin_set_input(rt_base_t pin, rt_base_t value);
+void sim_pin_set_reader(rt_base_t pin, int (*reader)(void *ctx), void *ctx);
+void sim_pin_set_writer(rt_base_t pin, void (*writer)(void *ctx, rt_base_t value), void *ctx);
+
+/* SPI */
+#define RT_SPI_CPHA                     (1<<0)
+#define RT_SPI_CPOL                     (1<<1)
+#define RT_SPI_LSB                      (0<<2)
+#define RT_SPI_MSB                      (1<<2)
+#define RT_SPI_MASTER                   (0<<3)
+#define RT_SPI_SLAVE                    (1<<3)
+#define RT_SPI_MODE_0                   (0 | 0)
+#define RT_SPI_MODE_1                   (0 | RT_SPI_CPHA)
+#define RT_SPI_MODE_2                   (RT_SPI_CPOL | 0)
+#define RT_SPI_MODE_3                   (RT_SPI_CPOL | RT_SPI_CPHA)
+
+struct rt_spi_message
+{
+    const void *send_buf;
+    void *recv_buf;
+    rt_size_t length;
+    struct rt_spi_message *next;
+
+    unsigned cs_take    : 1;
+    unsigned cs_release : 1;
+};
+
+struct rt_spi_configuration
+{
+    rt_uint8_t mode;
+    rt_uint8_t data_width;
+    rt_uint16_t reserved;
+    rt_uint32_t max_hz;
+};
+
+/* shorter messages are sent by polling, as drv_spi does */
+#define SIM_SPI_DMA_MIN_LEN             10
+
+struct rt_spi_device;
+
+/*!
+ * \brief byte level SPI slave model
+ */
+struct sim_spi_ops
+{
+    void (*cs)(struct rt_spi_device *device, rt_bool_t active);
+    rt_uint8_t (*xfer)(struct rt_spi_device *device, rt_uint8_t out);
+};
+
+/*!
+ * \brief bus statistics, one transaction per NSS assert/release pair
+ */
+struct sim_spi_stats
+{
+    rt_uint32_t transactions;
+    rt_uint32_t bytes;
+    rt_uint32_t dma_transfers;      //!< messages moved by the simulated DMA
+    uint64_t wire_time_us;
+};
+
+struct rt_spi_device
+{
+    struct rt_object parent;
+    struct rt_spi_configuration config;
+    const struct sim_spi_ops *ops;
+    void *user_data;
+    pthread_mutex_t bus_lock;
+    rt_bool_t cs_active;
+    rt_bool_t dma;
+    struct sim_spi_stats stats;
+};
+
+rt_err_t rt_spi_configure(struct rt_spi_device *device, struct rt_spi_configuration *cfg);
+rt_err_t rt_spi_take_bus(struct rt_spi_device *device);
+rt_err_t rt_spi_release_bus(struct rt_spi_device *device);
+rt_err_t rt_spi_take(struct rt_spi_device *device);
+rt_err_t rt_spi_release(struct rt_spi_device *device);
+struct rt_spi_message *rt_spi_transfer_message(struct rt_spi_device *device,
+                                               struct rt_spi_message *message);
+rt_size_t rt_spi_transfer(struct rt_spi_device *device, const void *send_buf,
+                          void *recv_buf, rt_size_t length);
+rt_err_t rt_spi_send_then_send(struct rt_spi_device *device,
+                               const void *send_buf1, rt_size_t send_length1,
+                               const void *send_buf2, rt_size_t send_length2);
+rt_err_t rt_spi_send_then_recv(struct rt_spi_device *device,
+                               const void *send_buf, rt_size_t send_length,
+                               void *recv_buf, rt_size_t recv_length);
+
+void *rt_device_find(const char *name);
+
+rt_err_t sim_spi_device_register(struct rt_spi_device *device, const char *name,
+                                 const struct sim_spi_ops *ops, void *user_data);
+void sim_spi_reset_stats(struct rt_spi_device *device);
+
+/*!
+ * \brief models BSP_SPIx_TX/RX_USING_DMA: messages of SIM_SPI_DMA_MIN_LEN bytes
+ *        or more sleep for their wire time instead of spinning, the calling
+ *        thread gives the CPU away as it would while waiting for the DMA
+ *        completion interrupt
+ */
+void sim_spi_set_dma(struct rt_spi_device *device, rt_bool_t enable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RT_DEVICE_HOST_H__ */
@@ -0,0 +1,235 @@
+/*!
+ * \file      rtthread.h
+ *
+ * \brief     minimal RT-Thread kernel API for building lora-radio-driver on a
+ *            POSIX host, implemented in rt-thread-host.c on top of pthreads.
+ *
+ *            Only the subset used by the driver and the test shell is provided.
+ *            "Interrupts" are modelled by a global recursive lock: simulated
+ *            ISRs (pin IRQ handlers) run with it held, so code running under
+ *            rt_hw_interrupt_disable() is never preempted by an ISR.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+
+#ifndef __RT_THREAD_HOST_H__
+#define __RT_THREAD_HOST_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "rtconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int8_t                          rt_int8_t;
+typedef int16_t                         rt_int16_t;
+typedef int32_t                         rt_int32_t;
+typedef uint8_t                         rt_uint8_t;
+typedef uint16_t                        rt_uint16_t;
+typedef uint32_t                        rt_uint32_t;
+typedef int                             rt_bool_t;
+typedef long                            rt_base_t;
+typedef unsigned long                   rt_ubase_t;
+typedef rt_base_t                       rt_err_t;
+typedef rt_uint32_t                     rt_tick_t;
+typedef rt_ubase_t                      rt_size_t;
+typedef rt_base_t                       rt_off_t;
+
+#define RT_TRUE                         1
+#define RT_FALSE                        0
+#define RT_NULL                         0
+
+#define RT_EOK                          0
+#define RT_ERROR                        1
+#define RT_ETIMEOUT                     2
+#define RT_EFULL                        3
+#define RT_EEMPTY                       4
+#define RT_ENOMEM                       5
+#define RT_EBUSY                        7
+#define RT_EINVAL                       10
+
+#define RT_WAITING_FOREVER              -1
+#define RT_WAITING_NO                   0
+
+#define RT_IPC_FLAG_FIFO                0x00
+#define RT_IPC_FLAG_PRIO                0x01
+
+#define RT_EVENT_FLAG_AND               0x01
+#define RT_EVENT_FLAG_OR                0x02
+#define RT_EVENT_FLAG_CLEAR             0x04
+
+#define RT_TIMER_FLAG_DEACTIVATED       0x0
+#define RT_TIMER_FLAG_ACTIVATED         0x1
+#define RT_TIMER_FLAG_ONE_SHOT          0x0
+#define RT_TIMER_FLAG_PERIODIC          0x2
+#define RT_TIMER_FLAG_HARD_TIMER        0x0
+#define RT_TIMER_FLAG_SOFT_TIMER        0x4
+
+#define RT_TIMER_CTRL_SET_TIME          0x0
+#define RT_TIMER_CTRL_GET_TIME          0x1
+#define RT_TIMER_CTRL_SET_ONESHOT       0x2
+#define RT_TIMER_CTRL_SET_PERIODIC      0x3
+
+#define RT_ASSERT(EX)                   assert(EX)
+
+#define rt_memcpy                       memcpy
+#define rt_memset                       memset
+#define rt_memcmp                       memcmp
+#define rt_strcmp                       strcmp
+#define rt_strncmp                      strncmp
+#define rt_strlen                       strlen
+#define rt_snprintf                     snprintf
+#define rt_kprintf                      printf
+
+/*!
+ * \brief host scheduler entry, shared by soft timers and simulated hardware.
+ *        SIM_HW_EVENT_ISR handlers run with the global interrupt lock held,
+ *        SIM_HW_EVENT_CHIP handlers model clocks internal to a chip and run
+ *        on their own thread, unaffected by the interrupt lock.
+ */
+#define SIM_HW_EVENT_SOFT               0
+#define SIM_HW_EVENT_ISR                1
+#define SIM_HW_EVENT_CHIP               2
+
+struct sim_hw_event
+{
+    struct sim_hw_event *next;
+    uint64_t expire_us;
+    void (*handler)(void *parameter);
+    void *parameter;
+    rt_uint8_t isr;
+    rt_uint8_t pending;
+};
+
+struct rt_object
+{
+    char name[RT_NAME_MAX];
+};
+
+struct rt_event
+{
+    struct rt_object parent;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    rt_uint32_t set;
+};
+typedef struct rt_event *rt_event_t;
+
+struct rt_semaphore
+{
+    struct rt_object parent;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    rt_uint32_t value;
+};
+typedef struct rt_semaphore *rt_sem_t;
+
+struct rt_mutex
+{
+    struct rt_object parent;
+    pthread_mutex_t lock;
+};
+typedef struct rt_mutex *rt_mutex_t;
+
+struct rt_messagequeue
+{
+    struct rt_object parent;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    rt_uint8_t *msg_pool;
+    rt_size_t msg_size;
+    rt_size_t max_msgs;
+    rt_size_t head;
+    rt_size_t entry;
+};
+typedef struct rt_messagequeue *rt_mq_t;
+
+struct rt_timer
+{
+    struct rt_object parent;
+    struct sim_hw_event hw;
+    void (*timeout_func)(void *parameter);
+    void *parameter;
+    rt_tick_t init_tick;
+    rt_uint8_t flag;
+};
+typedef struct rt_timer *rt_timer_t;
+
+struct rt_thread
+{
+    struct rt_object parent;
+    pthread_t tid;
+    void (*entry)(void *parameter);
+    void *parameter;
+    rt_uint8_t current_priority;
+};
+typedef struct rt_thread *rt_thread_t;
+
+/* kernel */
+rt_base_t rt_hw_interrupt_disable(void);
+void rt_hw_interrupt_enable(rt_base_t level);
+rt_uint8_t rt_interrupt_get_nest(void);
+void rt_enter_critical(void);
+void rt_exit_critical(void);
+
+rt_tick_t rt_tick_get(void);
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms);
+
+rt_err_t rt_thread_init(struct rt_thread *thread, const char *name,
+                        void (*entry)(void *parameter), void *parameter,
+                        void *stack_start, rt_uint32_t stack_size,
+                        rt_uint8_t priority, rt_uint32_t tick);
+rt_thread_t rt_thread_create(const char *name, void (*entry)(void *parameter), void *parameter,
+                             rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick);
+rt_err_t rt_thread_startup(rt_thread_t thread);
+rt_err_t rt_thread_mdelay(rt_int32_t ms);
+rt_err_t rt_thread_delay(rt_tick_t tick);
+rt_thread_t rt_thread_self(void);
+
+rt_err_t rt_event_init(rt_event_t event, const char *name, rt_uint8_t flag);
+rt_err_t rt_event_send(rt_event_t event, rt_uint32_t set);
+rt_err_t rt_event_recv(rt_event_t event, rt_uint32_t set, rt_uint8_t opt,
+                       rt_int32_t timeout, rt_uint32_t *recved);
+
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag);
+rt_err_t rt_sem_detach(rt_sem_t sem);
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time);
+rt_err_t rt_sem_trytake(rt_sem_t sem);
+rt_err_t rt_sem_release(rt_sem_t sem);
+
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag);
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time);
+rt_err_t rt_mutex_release(rt_mutex_t mutex);
+
+rt_err_t rt_mq_init(rt_mq_t mq, const char *name, void *msgpool, rt_size_t msg_size,
+                    rt_size_t pool_size, rt_uint8_t flag);
+rt_err_t rt_mq_send(rt_mq_t mq, const void *buffer, rt_size_t size);
+rt_err_t rt_mq_recv(rt_mq_t mq, void *buffer, rt_size_t size, rt_int32_t timeout);
+
+void rt_timer_init(rt_timer_t timer, const char *name, void (*timeout)(void *parameter),
+                   void *parameter, rt_tick_t time, rt_uint8_t flag);
+rt_err_t rt_timer_start(rt_timer_t timer);
+rt_err_t rt_timer_stop(rt_timer_t timer);
+rt_err_t rt_timer_control(rt_timer_t timer, int cmd, void *arg);
+
+/* host simulation services */
+uint64_t sim_get_time_us(void);
+void sim_hw_event_init(struct sim_hw_event *ev, void (*handler)(void *parameter),
+                       void *parameter, rt_uint8_t isr);
+void sim_hw_event_schedule(struct sim_hw_event *ev, uint64_t expire_us);
+void sim_hw_event_cancel(struct sim_hw_event *ev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RT_THREAD_HOST_H__ */
@@ -0,0 +1,47 @@
+/*!
+ * \file      lora-hrtimer-board.c
+ *
+ * \brief     compare interrupt of the high resolution driver timers for the
+ *            host build, on a simulated hardware event of the host clock
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-timer.h"
+
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+
+static struct sim_hw_event lora_hrtimer_compare;
+static bool lora_hrtimer_compare_init = false;
+
+static void lora_hrtimer_compare_isr( void *parameter )
+{
+    lora_radio_hrtimer_isr( );
+}
+
+void lora_radio_hrtimer_port_set_compare( uint32_t deadlineUs )
+{
+    uint64_t now = sim_get_time_us( );
+    int32_t delta = ( int32_t )( deadlineUs - ( uint32_t )now );
+
+    if( lora_hrtimer_compare_init == false )
+    {
+        sim_hw_event_init( &lora_hrtimer_compare, lora_hrtimer_compare_isr, RT_NULL, SIM_HW_EVENT_ISR );
+        lora_hrtimer_compare_init = true;
+    }
+    // the counter is the low 32 bits of the host clock
+    sim_hw_event_schedule( &lora_hrtimer_compare, ( delta > 0 ) ? now + delta : now );
+}
+
+void lora_radio_hrtimer_port_cancel( void )
+{
+    if( lora_hrtimer_compare_init == true )
+    {
+        sim_hw_event_cancel( &lora_hrtimer_compare );
+    }
+}
+
+#endif
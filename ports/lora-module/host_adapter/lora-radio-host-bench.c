@@ -0,0 +1,2686 @@
+/*!
+ * \file      lora-radio-host-bench.c
+ *
+ * \brief     latency and throughput benchmark of the lora-radio driver running
+ *            on the host against the simulated chip.
+ *
+ *            usage: lora-radio-host-bench [-n frames] [-l payload] [-s air time scale %] [-f]
+ *
+ *            -f runs the FSK modem (SX127x only) instead of LoRa.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-timer.h"
+#include "lora-radio-rx-pool.h"
+#include "lora-radio-tx-queue.h"
+#include "lora-radio-executor.h"
+#include "lora-radio-rx-policy.h"
+#include "lora-radio-lbt.h"
+#include "lora-radio-scan.h"
+#include "lora-radio-noise-floor.h"
+#include "lora-radio-toa.h"
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X )
+#include "sx126x-board.h"
+#include "sx126x-sim.h"
+#define BENCH_CHIP_NAME                 "SX126x"
+#define BENCH_TOA_RULES                 LORA_RADIO_TOA_SX126X
+#define bench_sim_spi( )                ( &sx126x_sim0.spi )
+#define bench_sim_set_scale( pct )      sx126x_sim_set_air_time_scale( &sx126x_sim0, pct )
+#define bench_sim_inject( buf, len )    sx126x_sim_inject_rx( &sx126x_sim0, buf, len, -60, 8, false )
+#define bench_sim_last_irq_us( )        ( sx126x_sim0.stats.last_dio1_rise_us )
+#define bench_sim_last_tx_start_us( )   ( sx126x_sim0.stats.last_tx_start_us )
+#define bench_sim_violations( )         ( sx126x_sim0.stats.busy_violations )
+#define bench_sim_set_channel( busy )   sx126x_sim_set_channel( &sx126x_sim0, busy, ( busy ) ? -60 : -120 )
+#define bench_sim_set_rssi_at( f, rssi )    sx126x_sim_set_channel_rssi_at( &sx126x_sim0, f, rssi )
+#define bench_sim_n_set_scale( n, pct )     sx126x_sim_set_air_time_scale( &sx126x_sim[n], pct )
+#define bench_sim_n_inject( n, buf, len )   sx126x_sim_inject_rx( &sx126x_sim[n], buf, len, -60, 8, false )
+#define bench_sim_n_last_irq_us( n )        ( sx126x_sim[n].stats.last_dio1_rise_us )
+#define bench_sim_n_violations( n )         ( sx126x_sim[n].stats.busy_violations )
+#define BENCH_SIM_VIOLATIONS_NAME       "BUSY violations"
+#elif defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX127X )
+#include "sx127x.h"
+#include "sx127x-sim.h"
+#define BENCH_CHIP_NAME                 "SX127x"
+#define BENCH_TOA_RULES                 LORA_RADIO_TOA_SX127X
+#define BENCH_CHIP_HAS_FSK
+#define BENCH_SIM_HAS_SIGNAL_DETECT     // RegModemStat reports the frame being received
+#define bench_sim_spi( )                ( &sx127x_sim0.spi )
+#define bench_sim_set_scale( pct )      sx127x_sim_set_air_time_scale( &sx127x_sim0, pct )
+#define bench_sim_inject( buf, len )    sx127x_sim_inject_rx( &sx127x_sim0, buf, len, -60, 8, false )
+#define bench_sim_last_irq_us( )        ( sx127x_sim0.stats.last_dio_rise_us[0] )
+#define bench_sim_last_tx_start_us( )   ( sx127x_sim0.stats.last_tx_start_us )
+#define bench_sim_violations( )         ( sx127x_sim0.stats.not_ready + sx127x_sim0.stats.mode_violations + \
+                                          sx127x_sim0.stats.fifo_overruns + sx127x_sim0.stats.fifo_underruns )
+#define bench_sim_set_channel( busy )   sx127x_sim_set_channel( &sx127x_sim0, busy, ( busy ) ? -60 : -120 )
+#define bench_sim_set_rssi_at( f, rssi )    sx127x_sim_set_channel_rssi_at( &sx127x_sim0, f, rssi )
+#define bench_sim_n_set_scale( n, pct )     sx127x_sim_set_air_time_scale( &sx127x_sim[n], pct )
+#define bench_sim_n_inject( n, buf, len )   sx127x_sim_inject_rx( &sx127x_sim[n], buf, len, -60, 8, false )
+#define bench_sim_n_last_irq_us( n )        ( sx127x_sim[n].stats.last_dio_rise_us[0] )
+#define bench_sim_n_violations( n )         ( sx127x_sim[n].stats.not_ready + sx127x_sim[n].stats.mode_violations + \
+                                              sx127x_sim[n].stats.fifo_overruns + sx127x_sim[n].stats.fifo_underruns )
+#define BENCH_SIM_VIOLATIONS_NAME       "SPI / mode / FIFO violations"
+#endif
+
+#define BENCH_FREQUENCY                 470300000
+#define BENCH_TX_POWER                  14
+#define BENCH_BANDWIDTH                 0       // 125 kHz
+#define BENCH_SPREADING_FACTOR          7
+#define BENCH_CODINGRATE                1       // 4/5
+#define BENCH_PREAMBLE_LENGTH           8
+#define BENCH_TX_TIMEOUT                3000    // ms
+#define BENCH_WAIT_TIMEOUT              5000    // ticks
+#define BENCH_FSK_DATARATE              50000   // bps
+#define BENCH_FSK_FDEV                  25000   // Hz
+#define BENCH_FSK_BANDWIDTH             50000   // Hz
+#define BENCH_FSK_BANDWIDTH_AFC         83333   // Hz
+#define BENCH_FSK_PREAMBLE_LENGTH       5
+#define BENCH_FSK_SYNC_TIMEOUT          6250    // bytes, 1 s at 50 kbps, restarts the receiver when no sync word
+
+typedef struct
+{
+    const char *name;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint32_t count;
+}bench_stat_t;
+
+static struct rt_semaphore tx_done_sem;
+static struct rt_semaphore rx_done_sem;
+static volatile uint64_t tx_done_us;
+static volatile uint64_t rx_done_us;
+static volatile uint32_t rx_errors;
+static volatile uint32_t timeouts;
+static uint8_t bench_payload[255];
+static uint8_t rx_size;
+static RadioEvents_t bench_events;
+static RadioModems_t bench_modem = MODEM_LORA;
+
+static void bench_stat_add( bench_stat_t *stat, uint64_t value )
+{
+    if( stat->count == 0 || value < stat->min )
+    {
+        stat->min = value;
+    }
+    if( value > stat->max )
+    {
+        stat->max = value;
+    }
+    stat->sum += value;
+    stat->count++;
+}
+
+static void bench_stat_print( const bench_stat_t *stat )
+{
+    if( stat->count == 0 )
+    {
+        rt_kprintf( "  %-34s %10s\n", stat->name, "n/a" );
+        return;
+    }
+    rt_kprintf( "  %-34s min %7llu  avg %7llu  max %7llu us\n", stat->name,
+                ( unsigned long long )stat->min,
+                ( unsigned long long )( stat->sum / stat->count ),
+                ( unsigned long long )stat->max );
+}
+
+static void OnTxDone( void )
+{
+    tx_done_us = sim_get_time_us( );
+    rt_sem_release( &tx_done_sem );
+}
+
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+/*!
+ * Set while bench_rx_pool plays an application that is busy: the packets
+ * stay queued until the main thread takes them. Otherwise the callbacks give
+ * every slot back at once.
+ */
+static volatile bool bench_pool_hold = false;
+
+static void bench_rx_pool_drain( void )
+{
+    LoRaRadioRxPacket_t *packet;
+
+    if( bench_pool_hold == true )
+    {
+        return;
+    }
+    while( ( packet = lora_radio_rx_pool_take( ) ) != RT_NULL )
+    {
+        lora_radio_rx_pool_release( packet );
+    }
+}
+#else
+#define bench_rx_pool_drain( )
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+/*!
+ * Set while bench_executor plays an application with slow RxDone callbacks
+ */
+static volatile uint32_t bench_slow_callback_ms = 0;
+#endif
+
+static void OnRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
+{
+#ifdef LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+    if( bench_slow_callback_ms != 0 )
+    {
+        rt_thread_mdelay( bench_slow_callback_ms );
+    }
+#endif
+    rx_done_us = sim_get_time_us( );
+    rx_size = size;
+    if( memcmp( payload, bench_payload, size ) != 0 )
+    {
+        rx_errors++;
+    }
+    bench_rx_pool_drain( );
+    rt_sem_release( &rx_done_sem );
+}
+
+static void OnTxTimeout( void )
+{
+    timeouts++;
+    rt_sem_release( &tx_done_sem );
+}
+
+/*!
+ * Set while bench_timer waits for the RX timeouts it asks for
+ */
+static volatile bool bench_rx_timeout_expected = false;
+static volatile uint64_t rx_timeout_us;
+
+static void OnRxTimeout( void )
+{
+    if( bench_rx_timeout_expected == true )
+    {
+        rx_timeout_us = sim_get_time_us( );
+        rt_sem_release( &rx_done_sem );
+        return;
+    }
+    timeouts++;
+}
+
+static void OnRxError( void )
+{
+    rx_errors++;
+    rt_sem_release( &rx_done_sem );
+}
+
+static void bench_set_tx_config( uint16_t preambleLen )
+{
+    if( bench_modem == MODEM_FSK )
+    {
+        Radio.SetTxConfig( MODEM_FSK, BENCH_TX_POWER, BENCH_FSK_FDEV, 0, BENCH_FSK_DATARATE, 0,
+                           preambleLen, false, true, 0, 0, false, BENCH_TX_TIMEOUT );
+    }
+    else
+    {
+        Radio.SetTxConfig( MODEM_LORA, BENCH_TX_POWER, 0, BENCH_BANDWIDTH, BENCH_SPREADING_FACTOR,
+                           BENCH_CODINGRATE, preambleLen, false, true, 0, 0, false, BENCH_TX_TIMEOUT );
+    }
+}
+
+static void bench_set_rx_config( uint16_t preambleLen )
+{
+    if( bench_modem == MODEM_FSK )
+    {
+        Radio.SetRxConfig( MODEM_FSK, BENCH_FSK_BANDWIDTH, BENCH_FSK_DATARATE, 0, BENCH_FSK_BANDWIDTH_AFC,
+                           preambleLen, BENCH_FSK_SYNC_TIMEOUT, false, 0, true, 0, 0, false, true );
+    }
+    else
+    {
+        Radio.SetRxConfig( MODEM_LORA, BENCH_BANDWIDTH, BENCH_SPREADING_FACTOR, BENCH_CODINGRATE, 0,
+                           preambleLen, 0, false, 0, true, 0, 0, false, true );
+    }
+}
+
+static void bench_tx( uint32_t frames, uint8_t len )
+{
+    bench_stat_t send_call = { "Radio.Send() call" };
+    bench_stat_t tx_start = { "Radio.Send() -> chip in TX" };
+    bench_stat_t irq_to_cb = { "DIO IRQ -> TxDone callback" };
+    bench_stat_t cycle = { "Radio.Send() -> TxDone callback" };
+    struct rt_spi_device *spi = bench_sim_spi( );
+    uint64_t t0, t1, start;
+    uint32_t i, spi_transactions = 0, spi_bytes = 0;
+
+    start = sim_get_time_us( );
+    for( i = 0; i < frames; i++ )
+    {
+        bench_payload[0] = ( uint8_t )i;
+        sim_spi_reset_stats( spi );
+
+        t0 = sim_get_time_us( );
+        Radio.Send( bench_payload, len );
+        t1 = sim_get_time_us( );
+        spi_transactions += spi->stats.transactions;
+        spi_bytes += spi->stats.bytes;
+
+        if( rt_sem_take( &tx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+        {
+            rt_kprintf( "  TxDone lost at frame %u\n", i );
+            break;
+        }
+        bench_stat_add( &send_call, t1 - t0 );
+        bench_stat_add( &tx_start, bench_sim_last_tx_start_us( ) - t0 );
+        bench_stat_add( &irq_to_cb, tx_done_us - bench_sim_last_irq_us( ) );
+        bench_stat_add( &cycle, tx_done_us - t0 );
+    }
+
+    if( bench_modem == MODEM_FSK )
+    {
+        rt_kprintf( "TX, %u frames of %u bytes, ToA %u ms\n", i, len,
+                    Radio.TimeOnAir( MODEM_FSK, BENCH_FSK_BANDWIDTH, BENCH_FSK_DATARATE, 0,
+                                     BENCH_FSK_PREAMBLE_LENGTH, false, len, true ) );
+    }
+    else
+    {
+        rt_kprintf( "TX, %u frames of %u bytes, ToA %u ms\n", i, len,
+                    Radio.TimeOnAir( MODEM_LORA, BENCH_BANDWIDTH, BENCH_SPREADING_FACTOR, BENCH_CODINGRATE,
+                                     BENCH_PREAMBLE_LENGTH, false, len, true ) );
+    }
+    bench_stat_print( &send_call );
+    bench_stat_print( &tx_start );
+    bench_stat_print( &irq_to_cb );
+    bench_stat_print( &cycle );
+    if( i > 0 )
+    {
+        rt_kprintf( "  SPI per Radio.Send()                transactions %u, bytes %u\n",
+                    spi_transactions / i, spi_bytes / i );
+        rt_kprintf( "  throughput                          %.1f frames/s\n",
+                    i * 1e6 / ( double )( sim_get_time_us( ) - start ) );
+    }
+}
+
+static void bench_rx( uint32_t frames, uint8_t len )
+{
+    bench_stat_t irq_to_cb = { "DIO IRQ -> RxDone callback" };
+    struct rt_spi_device *spi = bench_sim_spi( );
+    uint32_t i, spi_transactions = 0, spi_bytes = 0;
+
+    Radio.Rx( 0 );
+    for( i = 0; i < frames; i++ )
+    {
+        bench_payload[0] = ( uint8_t )i;
+        /* let the chip settle in RX before the next frame starts on air */
+        rt_thread_mdelay( 1 );
+        if( bench_sim_inject( bench_payload, len ) != RT_EOK )
+        {
+            rt_kprintf( "  receiver not listening at frame %u\n", i );
+            break;
+        }
+        sim_spi_reset_stats( spi );
+        if( rt_sem_take( &rx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+        {
+            rt_kprintf( "  RxDone lost at frame %u\n", i );
+            break;
+        }
+        spi_transactions += spi->stats.transactions;
+        spi_bytes += spi->stats.bytes;
+        bench_stat_add( &irq_to_cb, rx_done_us - bench_sim_last_irq_us( ) );
+    }
+
+    rt_kprintf( "RX (continuous), %u frames of %u bytes, %u payload errors\n", i, len, rx_errors );
+    bench_stat_print( &irq_to_cb );
+    if( i > 0 )
+    {
+        rt_kprintf( "  SPI per RxDone                      transactions %u, bytes %u\n",
+                    spi_transactions / i, spi_bytes / i );
+    }
+    Radio.Standby( );
+}
+
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+#define BENCH_TIMESTAMP_FRAMES          10
+
+static uint64_t bench_abs_diff( uint32_t a, uint32_t b )
+{
+    return ( int32_t )( a - b ) < 0 ? ( uint32_t )( b - a ) : ( uint32_t )( a - b );
+}
+
+/*!
+ * \brief Frame timestamps against the simulator, at real air time so the
+ *        time on air correction applies: the DIO edge latched by the ISR, the
+ *        start of the frame derived from it, and the tick based time the
+ *        application reads in its callback.
+ */
+static void bench_timestamp( uint32_t frames, uint8_t len, uint32_t scale )
+{
+    bench_stat_t tx_irq = { "TX DIO edge latch error" };
+    bench_stat_t tx_start = { "TX frame start error" };
+    bench_stat_t rx_irq = { "RX DIO edge latch error" };
+    bench_stat_t rx_start = { "RX frame start error" };
+    bench_stat_t rx_cb = { "RX start error, cb tick - ToA" };
+    bench_stat_t latency = { "RX DIO edge -> driver" };
+    LoRaRadioTimestamp_t ts;
+    uint32_t i, tick_us, injected_us;
+
+    if( frames > BENCH_TIMESTAMP_FRAMES )
+    {
+        frames = BENCH_TIMESTAMP_FRAMES;
+    }
+    bench_sim_set_scale( 100 );
+    for( i = 0; i < frames; i++ )
+    {
+        Radio.Send( bench_payload, len );
+        if( ( rt_sem_take( &tx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK ) ||
+            ( lora_radio_get_tx_timestamp( RT_NULL, &ts ) == false ) )
+        {
+            rt_kprintf( "  TxDone lost at frame %u\n", i );
+            timeouts++;
+            break;
+        }
+        bench_stat_add( &tx_irq, bench_abs_diff( ts.IrqUs, ( uint32_t )bench_sim_last_irq_us( ) ) );
+        bench_stat_add( &tx_start, bench_abs_diff( ts.StartUs, ( uint32_t )bench_sim_last_tx_start_us( ) ) );
+    }
+
+    Radio.Rx( 0 );
+    for( i = 0; i < frames; i++ )
+    {
+        bench_payload[0] = ( uint8_t )i;
+        rt_thread_mdelay( 1 );
+        // the frame starts on air when it is injected
+        injected_us = LORA_RADIO_TIMESTAMP_US( );
+        if( ( bench_sim_inject( bench_payload, len ) != RT_EOK ) ||
+            ( rt_sem_take( &rx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK ) ||
+            ( lora_radio_get_rx_timestamp( RT_NULL, &ts ) == false ) )
+        {
+            rt_kprintf( "  RxDone lost at frame %u\n", i );
+            timeouts++;
+            break;
+        }
+        tick_us = ( uint32_t )( rx_done_us / ( 1000000UL / RT_TICK_PER_SECOND ) ) * ( 1000000UL / RT_TICK_PER_SECOND );
+        bench_stat_add( &rx_irq, bench_abs_diff( ts.IrqUs, ( uint32_t )bench_sim_last_irq_us( ) ) );
+        bench_stat_add( &rx_start, bench_abs_diff( ts.StartUs, injected_us ) );
+        bench_stat_add( &rx_cb, bench_abs_diff( tick_us - ts.TimeOnAirUs, injected_us ) );
+        bench_stat_add( &latency, ts.LatencyUs );
+    }
+    Radio.Standby( );
+    bench_sim_set_scale( scale );
+
+    rt_kprintf( "DIO timestamps, %u frames of %u bytes at real air time, ToA %u us\n", i, len, ts.TimeOnAirUs );
+    bench_stat_print( &tx_irq );
+    bench_stat_print( &tx_start );
+    bench_stat_print( &rx_irq );
+    bench_stat_print( &rx_start );
+    bench_stat_print( &rx_cb );
+    bench_stat_print( &latency );
+}
+#endif
+
+#define BENCH_TIMER_ROUNDS              1000
+#define BENCH_TIMER_FIRINGS             20
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+#define BENCH_TIMER_NAME                "high resolution"
+#else
+#define BENCH_TIMER_NAME                "rt_timer tick"
+#endif
+
+static struct rt_semaphore bench_timer_sem;
+static volatile uint64_t bench_timer_fired_us;
+
+static void bench_timer_fired( void *context )
+{
+    bench_timer_fired_us = sim_get_time_us( );
+    rt_sem_release( &bench_timer_sem );
+}
+
+static void bench_timer_idle( void *context )
+{
+}
+
+/*!
+ * \brief Waits for a point \a phase us into an OS tick, the timeouts then
+ *        start at every phase of the tick
+ */
+static void bench_timer_phase( uint32_t phase )
+{
+    const uint32_t tick_us = 1000000UL / RT_TICK_PER_SECOND;
+
+    while( ( sim_get_time_us( ) % tick_us ) > ( tick_us / 20 ) );
+    while( ( sim_get_time_us( ) % tick_us ) < phase );
+}
+
+/*!
+ * \brief Driver timer backend: start / stop cost with the radio timeouts
+ *        armed beside, the error of a timer callback against its deadline,
+ *        and the same for the RX timeout of the driver. Timeouts are given
+ *        in ms, the tick backend counts them from the current tick.
+ */
+static void bench_timer( void )
+{
+    const uint32_t tick_us = 1000000UL / RT_TICK_PER_SECOND;
+    bench_stat_t start = { "TimerStart() call" };
+    bench_stat_t stop = { "TimerStop() call" };
+    bench_stat_t early = { "timer fired early by" };
+    bench_stat_t late = { "timer fired late by" };
+    bench_stat_t rx_early = { "RxTimeout early by" };
+    bench_stat_t rx_late = { "RxTimeout late by" };
+    TimerEvent_t timer, others[3];
+    uint64_t t0, t1, t2, deadline, fired;
+    uint32_t i, value;
+
+    rt_sem_init( &bench_timer_sem, "bench_tm", 0, RT_IPC_FLAG_FIFO );
+    for( i = 0; i < 3; i++ )
+    {
+        TimerInit( &others[i], bench_timer_idle );
+        TimerSetContext( &others[i], lora_radio_get( 0 ) );
+        TimerSetValue( &others[i], 60000 + i * 1000 );
+        TimerStart( &others[i] );
+    }
+    TimerInit( &timer, bench_timer_fired );
+    TimerSetContext( &timer, lora_radio_get( 0 ) );
+    TimerSetValue( &timer, 30000 + 500 );
+    for( i = 0; i < BENCH_TIMER_ROUNDS; i++ )
+    {
+        t0 = sim_get_time_us( );
+        TimerStart( &timer );
+        t1 = sim_get_time_us( );
+        TimerStop( &timer );
+        t2 = sim_get_time_us( );
+        bench_stat_add( &start, t1 - t0 );
+        bench_stat_add( &stop, t2 - t1 );
+    }
+    for( i = 0; i < 3; i++ )
+    {
+        TimerStop( &others[i] );
+    }
+
+    for( i = 0; i < BENCH_TIMER_FIRINGS; i++ )
+    {
+        value = 1 + i % 5;
+        TimerSetValue( &timer, value );
+        bench_timer_phase( ( i * 397 ) % ( tick_us - tick_us / 10 ) + tick_us / 10 );
+        deadline = sim_get_time_us( ) + value * 1000;
+        TimerStart( &timer );
+        if( rt_sem_take( &bench_timer_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+        {
+            rt_kprintf( "  timer lost at %u\n", i );
+            timeouts++;
+            break;
+        }
+        fired = bench_timer_fired_us;
+        bench_stat_add( ( fired < deadline ) ? &early : &late, ( fired < deadline ) ? deadline - fired : fired - deadline );
+    }
+
+    bench_rx_timeout_expected = true;
+    for( i = 0; i < BENCH_TIMER_FIRINGS / 2; i++ )
+    {
+        value = 2 + i % 3;
+        bench_timer_phase( ( i * 397 ) % ( tick_us - tick_us / 10 ) + tick_us / 10 );
+        deadline = sim_get_time_us( ) + value * 1000;
+        Radio.Rx( value );
+        if( rt_sem_take( &rx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+        {
+            rt_kprintf( "  RxTimeout lost at %u\n", i );
+            timeouts++;
+            break;
+        }
+        fired = rx_timeout_us;
+        bench_stat_add( ( fired < deadline ) ? &rx_early : &rx_late, ( fired < deadline ) ? deadline - fired : fired - deadline );
+        Radio.Standby( );
+    }
+    bench_rx_timeout_expected = false;
+    rt_sem_detach( &bench_timer_sem );
+
+    rt_kprintf( "driver timers, %s backend, %u start / stop with 3 armed, %u timeouts of 1-5 ms\n",
+                BENCH_TIMER_NAME, BENCH_TIMER_ROUNDS, BENCH_TIMER_FIRINGS );
+    bench_stat_print( &start );
+    bench_stat_print( &stop );
+    bench_stat_print( &early );
+    bench_stat_print( &late );
+    bench_stat_print( &rx_early );
+    bench_stat_print( &rx_late );
+}
+
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+#define BENCH_RING_POSTS                ( LORA_RADIO_EVENT_RING_SIZE / 2 )
+
+static uint64_t bench_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( uint64_t )ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*!
+ * \brief Waits until the PHY thread of instance 0 handled every posted event
+ */
+static void bench_event_ring_drain( void )
+{
+    LoRaRadioEventRingStats_t stats;
+    uint32_t waited;
+
+    for( waited = 0; waited < 100; waited++ )
+    {
+        lora_radio_event_ring_stats_get( RT_NULL, &stats );
+        if( stats.Handled == stats.Posted )
+        {
+            return;
+        }
+        rt_thread_mdelay( 1 );
+    }
+}
+
+static struct rt_semaphore bench_ring_held;
+static struct rt_semaphore bench_ring_release;
+
+static void bench_ring_hold_fired( void *context )
+{
+    rt_sem_release( &bench_ring_held );
+    rt_sem_take( &bench_ring_release, RT_WAITING_FOREVER );
+}
+
+/*!
+ * \brief Keeps the PHY thread of instance 0 in a driver timer callback, the
+ *        events posted meanwhile stay in its ring. The radio callbacks of the
+ *        SX127x run with interrupts masked and cannot be used for this.
+ */
+static bool bench_event_ring_hold( TimerEvent_t *timer )
+{
+    TimerStart( timer );
+    if( rt_sem_take( &bench_ring_held, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+    {
+        TimerStop( timer );
+        rt_kprintf( "  driver timer lost\n" );
+        return false;
+    }
+    return true;
+}
+#endif
+
+/*!
+ * \brief ISR to PHY thread event ring: the latency of the DIO events of the
+ *        previous runs, then with the PHY thread held the cost of a post
+ *        against rt_event_send, a burst handled event by event and a full
+ *        ring. The synthetic events are on DIO5, which the chip drivers
+ *        ignore when the radio is idle.
+ */
+static void bench_event_ring( void )
+{
+    LoRaRadioEventRingStats_t after;
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+    LoRaRadioEventRingStats_t before;
+    struct rt_event flags;
+    uint64_t t0, ring_ns, event_ns;
+    TimerEvent_t timer;
+    uint32_t i;
+#endif
+
+    lora_radio_event_ring_stats_get( RT_NULL, &after );
+    rt_kprintf( "event ring, %u slots: %u DIO / timer events, %u wakeups, %u overflowed, high water %u\n",
+                LORA_RADIO_EVENT_RING_SIZE, after.Posted, after.Wakeups, after.Overflowed, after.HighWater );
+    rt_kprintf( "  ISR -> PHY thread dequeue         avg %7llu  max %7u us\n",
+                ( unsigned long long )( after.Handled ? after.LatencyTotalUs / after.Handled : 0 ), after.LatencyMaxUs );
+
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+    rt_sem_init( &bench_ring_held, "bench_rh", 0, RT_IPC_FLAG_PRIO );
+    rt_sem_init( &bench_ring_release, "bench_rr", 0, RT_IPC_FLAG_PRIO );
+    rt_event_init( &flags, "bench_ev", RT_IPC_FLAG_PRIO );
+    TimerInit( &timer, bench_ring_hold_fired );
+    TimerSetContext( &timer, lora_radio_get( 0 ) );
+    TimerSetValue( &timer, 1 );
+
+    /*
+     * The stats are read with the driver lock, which the held PHY thread owns
+     * on multi-instance builds: they are compared before and after. The timer
+     * event holding the thread keeps its slot until its callback returns.
+     */
+    lora_radio_event_ring_stats_get( RT_NULL, &before );
+    if( bench_event_ring_hold( &timer ) == false )
+    {
+        timeouts++;
+        return;
+    }
+    t0 = bench_ns( );
+    for( i = 0; i < BENCH_RING_POSTS; i++ )
+    {
+        lora_radio_notify( RT_NULL, EV_LORA_RADIO_IRQ5_FIRED );
+    }
+    ring_ns = bench_ns( ) - t0;
+    t0 = bench_ns( );
+    for( i = 0; i < BENCH_RING_POSTS; i++ )
+    {
+        rt_event_send( &flags, EV_LORA_RADIO_IRQ5_FIRED );
+    }
+    event_ns = bench_ns( ) - t0;
+    rt_sem_release( &bench_ring_release );
+    bench_event_ring_drain( );
+    lora_radio_event_ring_stats_get( RT_NULL, &after );
+
+    rt_kprintf( "  burst of %u DIO5 edges            handled %u, %u wakeup(s); the flags keep 1 of them\n",
+                BENCH_RING_POSTS, after.Handled - before.Handled - 1, after.Wakeups - before.Wakeups - 1 );
+    rt_kprintf( "  lora_radio_notify() post          %llu ns, rt_event_send() %llu ns\n",
+                ( unsigned long long )( ring_ns / BENCH_RING_POSTS ), ( unsigned long long )( event_ns / BENCH_RING_POSTS ) );
+    if( ( after.Handled - before.Handled ) != ( BENCH_RING_POSTS + 1 ) )
+    {
+        timeouts++;
+    }
+
+    // twice the ring: what does not fit merges into one event handled last
+    before = after;
+    if( bench_event_ring_hold( &timer ) == false )
+    {
+        timeouts++;
+        return;
+    }
+    for( i = 0; i < 2 * LORA_RADIO_EVENT_RING_SIZE; i++ )
+    {
+        lora_radio_notify( RT_NULL, EV_LORA_RADIO_IRQ5_FIRED );
+    }
+    rt_sem_release( &bench_ring_release );
+    bench_event_ring_drain( );
+    lora_radio_event_ring_stats_get( RT_NULL, &after );
+    rt_kprintf( "  %u edges while the thread is busy handled %u, %u of them merged after the ring\n",
+                2 * LORA_RADIO_EVENT_RING_SIZE, after.Handled - before.Handled - 1, after.Overflowed - before.Overflowed );
+    if( ( ( after.Handled - before.Handled ) != ( LORA_RADIO_EVENT_RING_SIZE + 1 ) ) ||
+        ( ( after.Overflowed - before.Overflowed ) != ( LORA_RADIO_EVENT_RING_SIZE + 1 ) ) )
+    {
+        timeouts++;
+    }
+
+    rt_sem_detach( &bench_ring_held );
+    rt_sem_detach( &bench_ring_release );
+#endif
+}
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+#define BENCH_EXECUTOR_FRAMES           ( LORA_RADIO_EXECUTOR_QUEUE_SIZE / 2 )
+
+static void bench_executor_print( const LoRaRadioExecutorStats_t *stats )
+{
+    uint32_t bin;
+
+    rt_kprintf( "  driver -> callback                avg %7llu  max %7u us, longest callback %u us\n",
+                ( unsigned long long )( stats->Dispatched ? stats->LatencyTotalUs / stats->Dispatched : 0 ),
+                stats->LatencyMaxUs, stats->CallbackMaxUs );
+    rt_kprintf( "  histogram, us                    " );
+    for( bin = 0; bin < LORA_RADIO_EXECUTOR_HISTOGRAM_BINS; bin++ )
+    {
+        if( stats->Histogram[bin] == 0 )
+        {
+            continue;
+        }
+        if( bin == ( LORA_RADIO_EXECUTOR_HISTOGRAM_BINS - 1 ) )
+        {
+            rt_kprintf( " >=%u: %u", 1U << ( bin + 3 ), stats->Histogram[bin] );
+        }
+        else
+        {
+            rt_kprintf( " <%u: %u", 1U << ( bin + 4 ), stats->Histogram[bin] );
+        }
+    }
+    rt_kprintf( "\n" );
+}
+
+/*!
+ * \brief Deferred callbacks: the dispatch latency of the previous runs, then
+ *        continuous RX of frames closer than the RxDone callback takes. The
+ *        PHY thread must take every frame at once, the callbacks catch up.
+ */
+static void bench_executor( uint8_t len, uint32_t scale )
+{
+    LoRaRadioExecutorStats_t stats;
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+    LoRaRadioEventRingStats_t ring;
+#endif
+    uint32_t spacing, i, received = 0;
+
+    lora_radio_executor_stats_get( &stats );
+    rt_kprintf( "callback executor, %u slots: %u posted, %u dispatched, %u coalesced, %u RxDone dropped\n",
+                LORA_RADIO_EXECUTOR_QUEUE_SIZE, stats.Posted, stats.Dispatched, stats.Coalesced, stats.Dropped );
+    bench_executor_print( &stats );
+
+    // the payload stays the same, the callbacks check it after the next frame was sent
+    spacing = Radio.TimeOnAir( MODEM_LORA, BENCH_BANDWIDTH, BENCH_SPREADING_FACTOR, BENCH_CODINGRATE,
+                               BENCH_PREAMBLE_LENGTH, false, len, true ) * scale / 100 + 2;
+    bench_slow_callback_ms = 2 * spacing;
+    lora_radio_executor_stats_reset( );
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+    lora_radio_event_ring_stats_reset( RT_NULL );
+#endif
+    Radio.Rx( 0 );
+    for( i = 0; i < BENCH_EXECUTOR_FRAMES; i++ )
+    {
+        rt_thread_mdelay( spacing );
+        if( bench_sim_inject( bench_payload, len ) != RT_EOK )
+        {
+            rt_kprintf( "  receiver not listening at frame %u\n", i );
+            break;
+        }
+    }
+    for( i = 0; i < BENCH_EXECUTOR_FRAMES; i++ )
+    {
+        if( rt_sem_take( &rx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+        {
+            break;
+        }
+        received++;
+    }
+    bench_slow_callback_ms = 0;
+    Radio.Standby( );
+
+    lora_radio_executor_stats_get( &stats );
+    rt_kprintf( "  %u frames %u ms apart, RxDone callbacks of %u ms: received %u, dropped %u\n",
+                BENCH_EXECUTOR_FRAMES, spacing, 2 * spacing, received, stats.Dropped );
+    bench_executor_print( &stats );
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+    lora_radio_event_ring_stats_get( RT_NULL, &ring );
+    rt_kprintf( "  DIO IRQ -> PHY thread dequeue     max %7u us\n", ring.LatencyMaxUs );
+#endif
+    if( ( received != BENCH_EXECUTOR_FRAMES ) || ( stats.Dropped != 0 ) )
+    {
+        rx_errors++;
+    }
+}
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_RX_POLICY
+#define BENCH_RX_POLICY_FRAMES          10
+#define BENCH_RX_POLICY_PROCESS_MS      5       // application processing and logging after each RxDone
+#define BENCH_RX_POLICY_SYMB_TIMEOUT    1023
+
+/*!
+ * \brief Single RX windows, each frame followed at once by another one while
+ *        the application still processes the first
+ *
+ * \retval frames lost, most because the receiver was off
+ */
+static uint32_t bench_rx_policy_run( LoRaRadioRxPolicy_t policy, uint8_t len )
+{
+    LoRaRadioRxPolicyStats_t stats;
+    uint32_t i, burst, received = 0, missed = 0;
+
+    lora_radio_set_rx_policy( RT_NULL, policy, 0 );
+    lora_radio_rx_policy_stats_reset( RT_NULL );
+    Radio.Rx( 0 );
+    for( i = 0; i < BENCH_RX_POLICY_FRAMES; i++ )
+    {
+        for( burst = 0; burst < 2; burst++ )
+        {
+            if( bench_sim_inject( bench_payload, len ) != RT_EOK )
+            {
+                missed++;
+            }
+            else if( rt_sem_take( &rx_done_sem, BENCH_WAIT_TIMEOUT ) == RT_EOK )
+            {
+                received++;
+            }
+        }
+        rt_thread_mdelay( BENCH_RX_POLICY_PROCESS_MS );
+        if( policy != LORA_RADIO_RX_AUTO_REARM )
+        {
+            Radio.Rx( 0 );
+        }
+    }
+    Radio.Standby( );
+
+    lora_radio_rx_policy_stats_get( RT_NULL, &stats );
+    rt_kprintf( "  %-34s received %u, missed %u; windows %u, %u restarted by the driver\n",
+                ( policy == LORA_RADIO_RX_AUTO_REARM ) ? "driver re-arms the window" : "application calls Radio.Rx()",
+                received, missed, stats.Windows, stats.Rearms );
+    rt_kprintf( "  %-34s avg %7llu  max %7u us, %u us per hour\n", "blind time",
+                ( unsigned long long )( stats.Gaps ? stats.BlindTotalUs / stats.Gaps : 0 ),
+                stats.BlindMaxUs, stats.BlindUsPerHour );
+    return 2 * BENCH_RX_POLICY_FRAMES - received;
+}
+
+/*!
+ * \brief Receiver blind time of single RX windows restarted by the
+ *        application, then by the driver before the RxDone callback
+ */
+static void bench_rx_policy( uint8_t len )
+{
+    Radio.SetRxConfig( MODEM_LORA, BENCH_BANDWIDTH, BENCH_SPREADING_FACTOR, BENCH_CODINGRATE, 0,
+                       BENCH_PREAMBLE_LENGTH, BENCH_RX_POLICY_SYMB_TIMEOUT, false, 0, true, 0, 0, false, false );
+    rt_kprintf( "RX policy, %u x 2 frames back to back, %u ms of processing after each RxDone\n",
+                BENCH_RX_POLICY_FRAMES, BENCH_RX_POLICY_PROCESS_MS );
+    ( void )bench_rx_policy_run( LORA_RADIO_RX_DEFAULT, len );
+    if( bench_rx_policy_run( LORA_RADIO_RX_AUTO_REARM, len ) != 0 )
+    {
+        rx_errors++;
+    }
+    lora_radio_set_rx_policy( RT_NULL, LORA_RADIO_RX_DEFAULT, 0 );
+    bench_set_rx_config( BENCH_PREAMBLE_LENGTH );
+}
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_LBT
+#define BENCH_LBT_RSSI_THRESH           -90     // dBm
+#define BENCH_LBT_SENSE_MS              5
+#define BENCH_LBT_BUSY_MS               40      // the channel is released that long after the request
+#define BENCH_LBT_ALWAYS_BUSY           0xFFFFFFFFU
+
+static struct rt_semaphore lbt_sem;
+static volatile LoRaRadioLbtResult_t lbt_result;
+static volatile uint64_t lbt_done_us;
+
+static void OnLbtDone( void *context, LoRaRadioLbtResult_t result )
+{
+    lbt_result = result;
+    lbt_done_us = sim_get_time_us( );
+    rt_sem_release( &lbt_sem );
+}
+
+static void bench_lbt_params( LoRaRadioLbtParams_t *params, LoRaRadioLbtMode_t mode, uint8_t attempts )
+{
+    rt_memset( params, 0, sizeof( *params ) );
+    params->Mode = mode;
+    params->Modem = MODEM_LORA;
+    params->Frequency = BENCH_FREQUENCY;
+    params->RssiThresh = BENCH_LBT_RSSI_THRESH;
+    params->SenseTime = BENCH_LBT_SENSE_MS;
+    params->SamplePeriod = 1;
+    params->MaxAttempts = attempts;
+    params->BackoffMin = 2;
+    params->BackoffMax = 32;
+    params->Callback = OnLbtDone;
+}
+
+/*!
+ * \brief One request while the channel stays busy for \a busyMs, 0: clear,
+ *        BENCH_LBT_ALWAYS_BUSY: never released
+ *
+ * \retval false when the outcome is not the expected one
+ */
+static bool bench_lbt_run( const char *name, LoRaRadioLbtMode_t mode, uint8_t attempts, uint32_t busyMs, bool send, uint8_t len )
+{
+    LoRaRadioLbtParams_t params;
+    LoRaRadioLbtStats_t stats;
+    LoRaRadioLbtResult_t expected = ( busyMs == BENCH_LBT_ALWAYS_BUSY ) ? LORA_RADIO_LBT_BUSY : LORA_RADIO_LBT_CLEAR;
+    uint64_t t0, t1;
+    rt_err_t err;
+    bool ok = true;
+
+    bench_lbt_params( &params, mode, attempts );
+    lora_radio_lbt_stats_reset( RT_NULL );
+    bench_sim_set_channel( busyMs != 0 );
+
+    t0 = sim_get_time_us( );
+    if( send == true )
+    {
+        err = lora_radio_lbt_send( RT_NULL, &params, bench_payload, len );
+    }
+    else
+    {
+        err = lora_radio_lbt_start( RT_NULL, &params );
+    }
+    t1 = sim_get_time_us( );
+    if( ( busyMs != 0 ) && ( busyMs != BENCH_LBT_ALWAYS_BUSY ) )
+    {
+        rt_thread_mdelay( busyMs );
+        bench_sim_set_channel( false );
+    }
+    if( ( err != RT_EOK ) || ( rt_sem_take( &lbt_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK ) )
+    {
+        rt_kprintf( "  %-34s no outcome\n", name );
+        lora_radio_lbt_abort( RT_NULL );
+        bench_sim_set_channel( false );
+        return false;
+    }
+    if( ( send == true ) && ( lbt_result == LORA_RADIO_LBT_CLEAR ) &&
+        ( rt_sem_take( &tx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK ) )
+    {
+        ok = false;
+    }
+    bench_sim_set_channel( false );
+
+    lora_radio_lbt_stats_get( RT_NULL, &stats );
+    rt_kprintf( "  %-34s %s after %6llu us (call %4llu us); assessments %u, busy %u, samples %u, back-off %llu ms\n",
+                name, ( lbt_result == LORA_RADIO_LBT_CLEAR ) ? "clear" : ( lbt_result == LORA_RADIO_LBT_BUSY ) ? "busy " : "abort",
+                ( unsigned long long )( lbt_done_us - t0 ), ( unsigned long long )( t1 - t0 ),
+                stats.Assessments, stats.Busy, stats.Samples, ( unsigned long long )stats.BackoffTotalMs );
+    if( ( send == true ) && ( lbt_result == LORA_RADIO_LBT_CLEAR ) )
+    {
+        rt_kprintf( "  %-34s %6llu us after the request\n", "  chip in TX",
+                    ( unsigned long long )( bench_sim_last_tx_start_us( ) - t0 ) );
+    }
+    return ok && ( lbt_result == expected ) && ( ( send == false ) || ( stats.Sent == ( expected == LORA_RADIO_LBT_CLEAR ) ) );
+}
+
+/*!
+ * \brief Blocking Radio.IsChannelFree against the LBT engine: time the
+ *        caller is held, a busy channel released later with a send request,
+ *        and a channel that stays busy
+ */
+static void bench_lbt( uint8_t len )
+{
+    struct rt_spi_device *spi = bench_sim_spi( );
+    uint64_t t0, t1;
+    bool free, ok = true;
+
+    rt_sem_init( &lbt_sem, "lbt", 0, RT_IPC_FLAG_FIFO );
+    rt_kprintf( "listen before talk, RSSI below %d dBm for %u ms or CAD, channel released %u ms after the request\n",
+                BENCH_LBT_RSSI_THRESH, BENCH_LBT_SENSE_MS, BENCH_LBT_BUSY_MS );
+
+    sim_spi_reset_stats( spi );
+    t0 = sim_get_time_us( );
+    free = Radio.IsChannelFree( MODEM_LORA, BENCH_FREQUENCY, BENCH_LBT_RSSI_THRESH, BENCH_LBT_SENSE_MS );
+    t1 = sim_get_time_us( );
+    rt_kprintf( "  %-34s %s after %6llu us, caller held throughout, SPI transactions %u\n", "Radio.IsChannelFree()",
+                free ? "clear" : "busy ", ( unsigned long long )( t1 - t0 ), spi->stats.transactions );
+
+    sim_spi_reset_stats( spi );
+    ok &= bench_lbt_run( "RSSI, clear channel", LORA_RADIO_LBT_RSSI, 1, 0, false, len );
+    rt_kprintf( "  %-34s SPI transactions %u\n", "", spi->stats.transactions );
+    ok &= bench_lbt_run( "RSSI, busy then clear, send", LORA_RADIO_LBT_RSSI, 16, BENCH_LBT_BUSY_MS, true, len );
+    ok &= bench_lbt_run( "CAD, clear channel", LORA_RADIO_LBT_CAD, 1, 0, false, len );
+    ok &= bench_lbt_run( "CAD, busy then clear, send", LORA_RADIO_LBT_CAD, 16, BENCH_LBT_BUSY_MS, true, len );
+    ok &= bench_lbt_run( "CAD, always busy, 4 attempts", LORA_RADIO_LBT_CAD, 4, BENCH_LBT_ALWAYS_BUSY, true, len );
+    if( ok == false )
+    {
+        rx_errors++;
+    }
+    bench_set_rx_config( BENCH_PREAMBLE_LENGTH );
+    Radio.Standby( );
+}
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_SCAN
+#define BENCH_SCAN_CHANNELS             8
+#define BENCH_SCAN_STEP                 200000  // Hz
+#define BENCH_SCAN_DWELL_MS             10
+#define BENCH_SCAN_SWEEPS               4       // streaming sweeps before the stop
+#define BENCH_SCAN_QUIETEST             3
+
+static const int8_t bench_scan_rssi[BENCH_SCAN_CHANNELS] = { -80, -96, -70, -112, -102, -86, -60, -106 };
+static uint32_t bench_scan_freq[BENCH_SCAN_CHANNELS];
+static int16_t bench_scan_ref[BENCH_SCAN_CHANNELS];    //!< what Radio.Rssi reads on each channel
+static LoRaRadioScanChannel_t bench_scan_results[BENCH_SCAN_CHANNELS];
+static struct rt_semaphore scan_sem;
+static volatile uint32_t scan_rows;
+static volatile bool scan_stopped;
+
+static void OnScanChannel( void *context, uint32_t sweep, uint8_t index, const LoRaRadioScanChannel_t *channel )
+{
+    if( index == BENCH_SCAN_CHANNELS - 1 )
+    {
+        scan_rows++;
+        if( scan_rows == BENCH_SCAN_SWEEPS )
+        {
+            rt_sem_release( &scan_sem );
+        }
+    }
+}
+
+static void OnScanDone( void *context, bool stopped )
+{
+    scan_stopped = stopped;
+    rt_sem_release( &scan_sem );
+}
+
+/*!
+ * \brief Channels with distinct RSSI levels: Radio.IsChannelFree on each of
+ *        them against one sweep of the scan, then a streaming scan stopped
+ *        after a few sweeps
+ */
+static void bench_scan( void )
+{
+    struct rt_spi_device *spi = bench_sim_spi( );
+    LoRaRadioScanParams_t params;
+    uint32_t transactions;
+    uint64_t t0, t1, t2;
+    bool ok = true;
+    int best;
+    uint8_t i;
+
+    rt_sem_init( &scan_sem, "scan", 0, RT_IPC_FLAG_FIFO );
+    rt_kprintf( "spectrum scan, %u channels %u kHz apart, %u ms each\n",
+                BENCH_SCAN_CHANNELS, BENCH_SCAN_STEP / 1000, BENCH_SCAN_DWELL_MS );
+    for( i = 0; i < BENCH_SCAN_CHANNELS; i++ )
+    {
+        bench_scan_freq[i] = BENCH_FREQUENCY + i * BENCH_SCAN_STEP;
+        bench_sim_set_rssi_at( bench_scan_freq[i], bench_scan_rssi[i] );
+        lora_radio_chip_rssi_start( MODEM_LORA, bench_scan_freq[i] );
+        rt_thread_mdelay( 1 );
+        bench_scan_ref[i] = Radio.Rssi( MODEM_LORA );
+    }
+    Radio.Standby( );
+
+    sim_spi_reset_stats( spi );
+    t0 = sim_get_time_us( );
+    for( i = 0; i < BENCH_SCAN_CHANNELS; i++ )
+    {
+        Radio.IsChannelFree( MODEM_LORA, bench_scan_freq[i], -90, BENCH_SCAN_DWELL_MS );
+    }
+    t1 = sim_get_time_us( );
+    rt_kprintf( "  %-34s %6llu us, caller held throughout, SPI transactions %u\n", "Radio.IsChannelFree() per channel",
+                ( unsigned long long )( t1 - t0 ), spi->stats.transactions );
+
+    rt_memset( &params, 0, sizeof( params ) );
+    params.Modem = MODEM_LORA;
+    params.Frequencies = bench_scan_freq;
+    params.Count = BENCH_SCAN_CHANNELS;
+    params.DwellTime = BENCH_SCAN_DWELL_MS;
+    params.SamplePeriod = 1;
+    params.Percentile = 90;
+    params.OccupancyThresh = -90;
+    params.Sweeps = 1;
+    params.OnChannel = OnScanChannel;
+    params.OnDone = OnScanDone;
+
+    scan_rows = 0;
+    sim_spi_reset_stats( spi );
+    t0 = sim_get_time_us( );
+    ok &= ( lora_radio_scan_start( RT_NULL, &params, bench_scan_results ) == RT_EOK );
+    t1 = sim_get_time_us( );
+    ok &= ( lora_radio_scan_start( RT_NULL, &params, bench_scan_results ) == -RT_EBUSY );
+    ok &= ( rt_sem_take( &scan_sem, rt_tick_from_millisecond( 1000 ) ) == RT_EOK ) && ( scan_stopped == false );
+    t2 = sim_get_time_us( );
+    transactions = spi->stats.transactions;
+    rt_kprintf( "  %-34s %6llu us, caller held %llu us, SPI transactions %u\n", "lora_radio_scan_start(), 1 sweep",
+                ( unsigned long long )( t2 - t0 ), ( unsigned long long )( t1 - t0 ), transactions );
+
+    for( i = 0; i < BENCH_SCAN_CHANNELS; i++ )
+    {
+        LoRaRadioScanChannel_t *c = &bench_scan_results[i];
+        bool match = ( c->Frequency == bench_scan_freq[i] ) && ( c->Samples != 0 ) &&
+                     ( c->RssiMean == bench_scan_ref[i] ) && ( c->RssiPercentile == bench_scan_ref[i] ) &&
+                     ( c->Occupancy == ( ( bench_scan_ref[i] > -90 ) ? 100 : 0 ) );
+
+        rt_kprintf( "  %9u Hz  %3u samples  mean %4d  max %4d  p90 %4d dBm  busy %3u %%%s\n",
+                    c->Frequency, c->Samples, c->RssiMean, c->RssiMax, c->RssiPercentile, c->Occupancy,
+                    match ? "" : "  <- mismatch" );
+        ok &= match;
+    }
+    best = lora_radio_scan_best( bench_scan_results, BENCH_SCAN_CHANNELS );
+    rt_kprintf( "  %-34s %u Hz\n", "quietest channel", ( best >= 0 ) ? bench_scan_freq[best] : 0 );
+    ok &= ( best == BENCH_SCAN_QUIETEST );
+
+    params.Sweeps = 0;
+    scan_rows = 0;
+    t0 = sim_get_time_us( );
+    ok &= ( lora_radio_scan_start( RT_NULL, &params, bench_scan_results ) == RT_EOK );
+    ok &= ( rt_sem_take( &scan_sem, rt_tick_from_millisecond( 2000 ) ) == RT_EOK );
+    lora_radio_scan_stop( RT_NULL );
+    ok &= ( rt_sem_take( &scan_sem, rt_tick_from_millisecond( 100 ) ) == RT_EOK ) && ( scan_stopped == true );
+    t1 = sim_get_time_us( );
+    rt_kprintf( "  %-34s %u sweeps in %llu us, stopped\n", "streaming", scan_rows, ( unsigned long long )( t1 - t0 ) );
+
+    if( ok == false )
+    {
+        rx_errors++;
+    }
+    bench_sim_set_rssi_at( 0, 0 );
+    bench_set_rx_config( BENCH_PREAMBLE_LENGTH );
+    Radio.Standby( );
+}
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+#define BENCH_NF_WINDOWS                20
+#define BENCH_NF_QUIET_RSSI             -108    // dBm
+#define BENCH_NF_NOISY_RSSI             -84     // dBm, industrial site, above the usual fixed threshold
+#define BENCH_NF_FIXED_THRESH           -90     // dBm
+#define BENCH_NF_SENSE_MS               5
+
+/*!
+ * \brief What Radio.Rssi reads on \a freq, the estimate must converge to it
+ */
+static int16_t bench_nf_reference( uint32_t freq )
+{
+    int16_t rssi;
+
+    lora_radio_chip_rssi_start( MODEM_LORA, freq );
+    rt_thread_mdelay( 1 );
+    rssi = Radio.Rssi( MODEM_LORA );
+    Radio.Standby( );
+    return rssi;
+}
+
+/*!
+ * \brief A quiet and a noisy channel: cost of the reading taken when an RX
+ *        window ends, the estimates, Radio.IsChannelFree / LBT with a fixed
+ *        and the auto threshold, and no reading while a frame is received
+ */
+static void bench_noise_floor( uint8_t len )
+{
+    struct rt_spi_device *spi = bench_sim_spi( );
+    uint32_t freq[2] = { BENCH_FREQUENCY, BENCH_FREQUENCY + 400000 };
+    int16_t ref[2], floor;
+    LoRaRadioNoiseFloorStats_t stats;
+    uint64_t t0, rxTime = 0, stdbyTime = 0;
+    uint32_t rxSpi = 0, stdbySpi = 0;
+    uint8_t buffer[255];
+    bool ok = true, fixed, autoFree;
+    uint32_t i, w;
+
+    rt_kprintf( "noise floor, %u RX windows on %d dBm and %d dBm channels, margin %d dB\n",
+                BENCH_NF_WINDOWS, BENCH_NF_QUIET_RSSI, BENCH_NF_NOISY_RSSI, LORA_RADIO_NOISE_FLOOR_MARGIN );
+    bench_sim_set_rssi_at( freq[0], BENCH_NF_QUIET_RSSI );
+    bench_sim_set_rssi_at( freq[1], BENCH_NF_NOISY_RSSI );
+    for( i = 0; i < 2; i++ )
+    {
+        ref[i] = bench_nf_reference( freq[i] );
+    }
+    lora_radio_noise_floor_clear( RT_NULL );
+    lora_radio_noise_floor_stats_reset( RT_NULL );
+
+    bench_set_rx_config( BENCH_PREAMBLE_LENGTH );
+    for( i = 0; i < 2; i++ )
+    {
+        Radio.SetChannel( freq[i] );
+        for( w = 0; w < BENCH_NF_WINDOWS; w++ )
+        {
+            Radio.Rx( 0 );
+            rt_thread_mdelay( 2 );
+            // end of the window, the reading is taken here
+            sim_spi_reset_stats( spi );
+            t0 = sim_get_time_us( );
+            Radio.Standby( );
+            rxTime += sim_get_time_us( ) - t0;
+            rxSpi += spi->stats.transactions;
+            // same call with the receiver off, nothing to read
+            sim_spi_reset_stats( spi );
+            t0 = sim_get_time_us( );
+            Radio.Standby( );
+            stdbyTime += sim_get_time_us( ) - t0;
+            stdbySpi += spi->stats.transactions;
+        }
+    }
+    rt_kprintf( "  %-34s %4llu us, SPI transactions %u\n", "Radio.Standby() from RX",
+                ( unsigned long long )( rxTime / ( 2 * BENCH_NF_WINDOWS ) ), rxSpi / ( 2 * BENCH_NF_WINDOWS ) );
+    rt_kprintf( "  %-34s %4llu us, SPI transactions %u\n", "Radio.Standby() from standby",
+                ( unsigned long long )( stdbyTime / ( 2 * BENCH_NF_WINDOWS ) ), stdbySpi / ( 2 * BENCH_NF_WINDOWS ) );
+
+    for( i = 0; i < 2; i++ )
+    {
+        floor = lora_radio_noise_floor_get( RT_NULL, freq[i] );
+        rt_kprintf( "  %9u Hz  noise floor %4d dBm (reads %4d), auto threshold %4d dBm\n",
+                    freq[i], floor, ref[i], lora_radio_noise_floor_threshold( RT_NULL, freq[i] ) );
+        ok &= ( floor == ref[i] ) && ( lora_radio_noise_floor_threshold( RT_NULL, freq[i] ) == ref[i] + LORA_RADIO_NOISE_FLOOR_MARGIN );
+    }
+    lora_radio_noise_floor_stats_get( RT_NULL, &stats );
+    ok &= ( stats.Samples == 2 * BENCH_NF_WINDOWS ) && ( stats.Channels == 2 );
+
+    fixed = Radio.IsChannelFree( MODEM_LORA, freq[1], BENCH_NF_FIXED_THRESH, BENCH_NF_SENSE_MS );
+    autoFree = Radio.IsChannelFree( MODEM_LORA, freq[1], LORA_RADIO_RSSI_THRESH_AUTO, BENCH_NF_SENSE_MS );
+    rt_kprintf( "  %-34s fixed %d dBm: %s, auto: %s\n", "Radio.IsChannelFree() noisy", BENCH_NF_FIXED_THRESH,
+                fixed ? "clear" : "busy ", autoFree ? "clear" : "busy " );
+    ok &= ( fixed == false ) && ( autoFree == true );
+    // a frame of another network on the noisy channel
+    bench_sim_set_rssi_at( freq[1], -60 );
+    autoFree = Radio.IsChannelFree( MODEM_LORA, freq[1], LORA_RADIO_RSSI_THRESH_AUTO, BENCH_NF_SENSE_MS );
+    rt_kprintf( "  %-34s auto: %s, floor now %d dBm\n", "Radio.IsChannelFree() transmission",
+                autoFree ? "clear" : "busy ", lora_radio_noise_floor_get( RT_NULL, freq[1] ) );
+    ok &= ( autoFree == false );
+    bench_sim_set_rssi_at( freq[1], BENCH_NF_NOISY_RSSI );
+#ifdef LORA_RADIO_DRIVER_USING_LBT
+    {
+        LoRaRadioLbtParams_t params;
+
+        bench_lbt_params( &params, LORA_RADIO_LBT_RSSI, 1 );
+        params.Frequency = freq[1];
+        params.RssiThresh = LORA_RADIO_RSSI_THRESH_AUTO;
+        ok &= ( lora_radio_lbt_start( RT_NULL, &params ) == RT_EOK ) &&
+              ( rt_sem_take( &lbt_sem, rt_tick_from_millisecond( 1000 ) ) == RT_EOK );
+        rt_kprintf( "  %-34s auto: %s\n", "LBT RSSI noisy", ( lbt_result == LORA_RADIO_LBT_CLEAR ) ? "clear" : "busy " );
+        ok &= ( lbt_result == LORA_RADIO_LBT_CLEAR );
+    }
+#endif
+
+    // the receiver is left while a frame is received
+    lora_radio_noise_floor_stats_reset( RT_NULL );
+    rt_memset( buffer, 0x5A, sizeof( buffer ) );
+    Radio.SetChannel( freq[0] );
+    Radio.Rx( 0 );
+    rt_thread_mdelay( 1 );
+    bench_sim_inject( buffer, len );
+    rt_thread_mdelay( 1 );
+    Radio.Standby( );
+    lora_radio_noise_floor_stats_get( RT_NULL, &stats );
+    rt_kprintf( "  %-34s skipped %u, sampled %u, floor %d dBm\n", "Radio.Standby() during a frame",
+                stats.Skipped, stats.Samples, lora_radio_noise_floor_get( RT_NULL, freq[0] ) );
+#ifdef BENCH_SIM_HAS_SIGNAL_DETECT
+    ok &= ( stats.Skipped == 1 ) && ( stats.Samples == 0 );
+#else
+    // the model raises PreambleDetected with RxDone only, the reading is the channel RSSI
+    ok &= ( lora_radio_noise_floor_get( RT_NULL, freq[0] ) == ref[0] );
+#endif
+    // the frame ends before the next section
+    rt_thread_mdelay( Radio.TimeOnAir( MODEM_LORA, BENCH_BANDWIDTH, BENCH_SPREADING_FACTOR, BENCH_CODINGRATE,
+                                       BENCH_PREAMBLE_LENGTH, false, len, true ) + 2 );
+
+    if( ok == false )
+    {
+        rx_errors++;
+    }
+    bench_sim_set_rssi_at( 0, 0 );
+    bench_set_rx_config( BENCH_PREAMBLE_LENGTH );
+    Radio.Standby( );
+}
+#endif
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX127X ) && defined( LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE )
+#define BENCH_DC_PREAMBLE_LENGTH        64      // symbols, wake-on-radio frames
+#define BENCH_DC_SYMB_TIMEOUT           12      // symbols, ends a false wake up
+#define BENCH_DC_IDLE_MS                1000
+#define BENCH_SYMBOL_US                 ( ( 1000000U << BENCH_SPREADING_FACTOR ) / 125000 )
+
+/*!
+ * Sniff counters read from the bench thread, under the driver lock
+ */
+static void bench_dc_stats( SX127xRxDutyCycleStats_t *stats )
+{
+    LoRaRadio_t *previous = lora_radio_lock( lora_radio_get( 0 ) );
+
+    SX127xGetRxDutyCycleStats( stats );
+    lora_radio_unlock( previous );
+}
+
+static void bench_dc_reset( void )
+{
+    LoRaRadio_t *previous = lora_radio_lock( lora_radio_get( 0 ) );
+
+    SX127xResetRxDutyCycleStats( );
+    lora_radio_unlock( previous );
+}
+
+static void bench_rx_duty_cycle( uint8_t len )
+{
+    SX127xRxDutyCycleStats_t stats;
+    uint32_t timeoutsBefore = timeouts, expected, cads, i;
+    uint64_t t0, wake = 0;
+    bool ok = true, injected = false;
+
+    Radio.SetRxConfig( MODEM_LORA, BENCH_BANDWIDTH, BENCH_SPREADING_FACTOR, BENCH_CODINGRATE, 0,
+                       BENCH_DC_PREAMBLE_LENGTH, BENCH_DC_SYMB_TIMEOUT, false, 0, true, 0, 0, false, false );
+    rt_kprintf( "rx duty cycle (sniff), preamble %u symbols, symbol timeout %u\n",
+                BENCH_DC_PREAMBLE_LENGTH, BENCH_DC_SYMB_TIMEOUT );
+
+    // quiet channel, CAD and sleep only
+    bench_sim_set_channel( false );
+    bench_dc_reset( );
+    Radio.SetRxDutyCycle( 0, 0 );
+    rt_thread_mdelay( BENCH_DC_IDLE_MS );
+    bench_dc_stats( &stats );
+    expected = ( stats.SleepPeriod != 0 ) ? BENCH_DC_IDLE_MS / stats.SleepPeriod : 0;
+    rt_kprintf( "  %-20s sleep %u ms, %u CADs, CAD %llu us, sleep %llu us, average %u.%03u uA (RX %u.%u mA)\n",
+                "idle", stats.SleepPeriod, stats.Cads, ( unsigned long long )stats.CadUs,
+                ( unsigned long long )stats.SleepUs, stats.AverageCurrent / 1000, stats.AverageCurrent % 1000,
+                SX127X_RX_DUTY_CYCLE_RX_NA / 1000000, SX127X_RX_DUTY_CYCLE_RX_NA / 100000 % 10 );
+    ok &= ( expected != 0 ) && ( stats.Cads >= expected * 8 / 10 ) && ( stats.Cads <= expected + 1 ) &&
+          ( stats.Detections == 0 ) && ( stats.AverageCurrent < SX127X_RX_DUTY_CYCLE_RX_NA / 10 );
+
+    // activity with no frame: each detection is a false wake up
+    bench_dc_reset( );
+    bench_sim_set_channel( true );
+    for( i = 0; ( i < 4 * BENCH_DC_IDLE_MS ) && ( stats.FalseWakeups < 2 ); i++ )
+    {
+        rt_thread_mdelay( 1 );
+        bench_dc_stats( &stats );
+    }
+    bench_sim_set_channel( false );
+    cads = stats.Cads;
+    rt_thread_mdelay( 2 * stats.SleepPeriod + 10 );
+    bench_dc_stats( &stats );
+    rt_kprintf( "  %-20s %u detections, %u false wake ups, RxTimeout %u, sniffing %s\n", "activity, no frame",
+                stats.Detections, stats.FalseWakeups, timeouts - timeoutsBefore,
+                ( stats.Cads > cads ) ? "resumed" : "stopped" );
+    ok &= ( stats.FalseWakeups >= 2 ) && ( stats.Frames == 0 ) && ( timeouts == timeoutsBefore ) && ( stats.Cads > cads );
+
+    // a frame: the preamble wakes the receiver up, the payload follows
+    bench_dc_reset( );
+    bench_sim_set_channel( true );
+    t0 = sim_get_time_us( );
+    for( i = 0; ( i < 4 * BENCH_DC_IDLE_MS ) && ( injected == false ); i++ )
+    {
+        bench_dc_stats( &stats );
+        if( ( stats.Detections != 0 ) && ( bench_sim_inject( bench_payload, len ) == RT_EOK ) )
+        {
+            wake = sim_get_time_us( ) - t0;
+            injected = true;
+        }
+        else
+        {
+            rt_thread_mdelay( 1 );
+        }
+    }
+    bench_sim_set_channel( false );
+    ok &= ( injected == true ) && ( rt_sem_take( &rx_done_sem, BENCH_WAIT_TIMEOUT ) == RT_EOK ) && ( rx_size == len );
+    bench_dc_stats( &stats );
+    cads = stats.Cads;
+    rt_thread_mdelay( 2 * stats.SleepPeriod + 10 );
+    bench_dc_stats( &stats );
+    rt_kprintf( "  %-20s receiver on %llu us into a %u us preamble, %u frame, sniffing %s\n", "frame",
+                ( unsigned long long )wake, BENCH_DC_PREAMBLE_LENGTH * BENCH_SYMBOL_US, stats.Frames,
+                ( stats.Cads == cads ) ? "ended" : "running" );
+    ok &= ( wake < BENCH_DC_PREAMBLE_LENGTH * BENCH_SYMBOL_US ) && ( stats.Frames == 1 ) && ( stats.Cads == cads );
+
+    if( ok == false )
+    {
+        rx_errors++;
+    }
+    bench_set_rx_config( BENCH_PREAMBLE_LENGTH );
+    Radio.Standby( );
+}
+#endif
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X ) && defined( LORA_RADIO_DRIVER_USING_SX126X_CAD_RX )
+/*!
+ * CadDone log of bench_cad_rx. With bench_cad_then_rx the callback plays an
+ * application that opens the receiver itself on a detection.
+ */
+static struct rt_semaphore cad_done_sem;
+static volatile bool bench_cad_then_rx = false;
+static volatile bool cad_detected;
+static volatile uint64_t cad_irq_us;
+
+static void OnCadDone( bool channelActivityDetected )
+{
+    cad_irq_us = bench_sim_last_irq_us( );
+    cad_detected = channelActivityDetected;
+    if( ( channelActivityDetected == true ) && ( bench_cad_then_rx == true ) )
+    {
+        Radio.Rx( 0 );
+    }
+    rt_sem_release( &cad_done_sem );
+}
+
+/*!
+ * \brief One CAD with a frame on the air, the blind time is the end of the
+ *        CAD to the start of the receiver. The channel activity stands for
+ *        the preamble, the frame is injected once CadDone was called and
+ *        the receiver is open: the host may run the bench thread late.
+ */
+static bool bench_cad_rx_frame( bool cadRx, uint8_t len, bench_stat_t *blind )
+{
+    LoRaRadio_t *previous;
+    bool ok;
+
+    bench_sim_set_channel( true );
+    if( cadRx == true )
+    {
+        previous = lora_radio_lock( lora_radio_get( 0 ) );
+        SX126xStartCadRx( 0 );
+        lora_radio_unlock( previous );
+    }
+    else
+    {
+        Radio.StartCad( );
+    }
+    ok = ( rt_sem_take( &cad_done_sem, BENCH_WAIT_TIMEOUT ) == RT_EOK ) && ( cad_detected == true ) &&
+         ( bench_sim_inject( bench_payload, len ) == RT_EOK ) &&
+         ( rt_sem_take( &rx_done_sem, BENCH_WAIT_TIMEOUT ) == RT_EOK ) && ( rx_size == len );
+    bench_sim_set_channel( false );
+    if( ok == true )
+    {
+        // CAD_RX: the model starts the receiver as it raises CadDone
+        bench_stat_add( blind, ( sx126x_sim0.stats.last_rx_start_us > cad_irq_us ) ?
+                               sx126x_sim0.stats.last_rx_start_us - cad_irq_us : 0 );
+    }
+    return ok;
+}
+
+static void bench_cad_rx( uint32_t frames, uint8_t len )
+{
+    bench_stat_t app_blind = { "CadDone -> Radio.Rx(): CAD -> RX" };
+    bench_stat_t chip_blind = { "CAD_RX: CAD -> RX" };
+    SX126xCadRxStats_t stats;
+    LoRaRadio_t *previous;
+    uint32_t i, lost = 0;
+    bool ok = true, standby;
+
+    rt_sem_init( &cad_done_sem, "cad_done", 0, RT_IPC_FLAG_FIFO );
+    bench_events.CadDone = OnCadDone;
+    Radio.SetRxConfig( MODEM_LORA, BENCH_BANDWIDTH, BENCH_SPREADING_FACTOR, BENCH_CODINGRATE, 0,
+                       BENCH_PREAMBLE_LENGTH, 0, false, 0, true, 0, 0, false, false );
+    previous = lora_radio_lock( lora_radio_get( 0 ) );
+    SX126xResetCadRxStats( );
+    lora_radio_unlock( previous );
+
+    bench_cad_then_rx = true;
+    for( i = 0; i < frames; i++ )
+    {
+        bench_payload[0] = ( uint8_t )i;
+        lost += ( bench_cad_rx_frame( false, len, &app_blind ) == false ) ? 1 : 0;
+    }
+    bench_cad_then_rx = false;
+    for( i = 0; i < frames; i++ )
+    {
+        bench_payload[0] = ( uint8_t )i;
+        lost += ( bench_cad_rx_frame( true, len, &chip_blind ) == false ) ? 1 : 0;
+    }
+
+    previous = lora_radio_lock( lora_radio_get( 0 ) );
+    SX126xGetCadRxStats( &stats );
+    lora_radio_unlock( previous );
+    rt_kprintf( "CAD to RX, SF%u, %u frames per mode\n", BENCH_SPREADING_FACTOR, frames );
+    bench_stat_print( &app_blind );
+    bench_stat_print( &chip_blind );
+    rt_kprintf( "  %-34s %u CADs, %u detections, %u frames, %u misses, last %u us, max %u us, avg %llu us\n",
+                "CAD_RX: detection -> RxDone", stats.Cads, stats.Detections, stats.Frames, stats.Misses,
+                stats.LastUs, stats.MaxUs,
+                ( unsigned long long )( ( stats.Frames != 0 ) ? stats.TotalUs / stats.Frames : 0 ) );
+    ok &= ( lost == 0 ) && ( stats.Cads == frames ) && ( stats.Detections == frames ) &&
+          ( stats.Frames == frames ) && ( stats.Misses == 0 ) && ( chip_blind.max <= app_blind.min );
+
+    // clear channel: CadDone( false ), the chip goes back to standby
+    previous = lora_radio_lock( lora_radio_get( 0 ) );
+    SX126xStartCadRx( 0 );
+    lora_radio_unlock( previous );
+    ok &= ( rt_sem_take( &cad_done_sem, BENCH_WAIT_TIMEOUT ) == RT_EOK ) && ( cad_detected == false );
+    previous = lora_radio_lock( lora_radio_get( 0 ) );
+    SX126xGetCadRxStats( &stats );
+    standby = ( SX126xGetOperatingMode( ) == MODE_STDBY_RC );
+    lora_radio_unlock( previous );
+    rt_kprintf( "  %-34s CadDone(%s), %u detections, chip %s\n", "CAD_RX, clear channel",
+                cad_detected ? "true" : "false", stats.Detections - frames, standby ? "in standby" : "not in standby" );
+    ok &= ( stats.Detections == frames ) && ( standby == true );
+
+    if( lost != 0 )
+    {
+        timeouts += lost;
+    }
+    if( ok == false )
+    {
+        rx_errors++;
+    }
+    bench_events.CadDone = RT_NULL;
+    rt_sem_detach( &cad_done_sem );
+    bench_set_rx_config( BENCH_PREAMBLE_LENGTH );
+    Radio.Standby( );
+}
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+/*!
+ * \brief Continuous RX while the application does not consume: the first
+ *        LORA_RADIO_RX_POOL_SIZE frames stay queued intact in their slots, the
+ *        next ones are dropped. Then a consumer that takes and releases every
+ *        frame, which needs one slot.
+ */
+static void bench_rx_pool( uint32_t frames, uint8_t len )
+{
+    uint32_t expected_rate = ( bench_modem == MODEM_FSK ) ? BENCH_FSK_DATARATE : BENCH_SPREADING_FACTOR;
+    uint32_t stalled = LORA_RADIO_RX_POOL_SIZE + 4;
+    uint32_t queued = 0, intact = 0, consumed = 0;
+    LoRaRadioRxPoolStats_t held, steady;
+    LoRaRadioRxPacket_t *packet;
+    uint32_t i;
+
+    bench_pool_hold = true;
+    lora_radio_rx_pool_stats_reset( );
+    Radio.Rx( 0 );
+    for( i = 0; i < stalled; i++ )
+    {
+        bench_payload[0] = ( uint8_t )i;
+        rt_thread_mdelay( 1 );
+        if( ( bench_sim_inject( bench_payload, len ) != RT_EOK ) ||
+            ( rt_sem_take( &rx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK ) )
+        {
+            rt_kprintf( "  RxDone lost at frame %u\n", i );
+            timeouts++;
+            break;
+        }
+    }
+    lora_radio_rx_pool_stats_get( &held );
+    // the application catches up, every queued slot must still hold its own frame
+    while( ( packet = lora_radio_rx_pool_take( ) ) != RT_NULL )
+    {
+        bench_payload[0] = ( uint8_t )queued;
+        if( ( packet->Size == len ) && ( memcmp( packet->Payload, bench_payload, len ) == 0 ) &&
+            ( packet->Instance == 0 ) && ( packet->Modem == bench_modem ) &&
+            ( packet->Frequency == BENCH_FREQUENCY ) && ( packet->Datarate == expected_rate ) )
+        {
+            intact++;
+        }
+        queued++;
+        lora_radio_rx_pool_release( packet );
+    }
+
+    lora_radio_rx_pool_stats_reset( );
+    for( i = 0; i < frames; i++ )
+    {
+        bench_payload[0] = ( uint8_t )i;
+        rt_thread_mdelay( 1 );
+        if( ( bench_sim_inject( bench_payload, len ) != RT_EOK ) ||
+            ( rt_sem_take( &rx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK ) )
+        {
+            rt_kprintf( "  RxDone lost at frame %u\n", i );
+            timeouts++;
+            break;
+        }
+        while( ( packet = lora_radio_rx_pool_take( ) ) != RT_NULL )
+        {
+            if( memcmp( packet->Payload, bench_payload, packet->Size ) == 0 )
+            {
+                consumed++;
+            }
+            lora_radio_rx_pool_release( packet );
+        }
+    }
+    lora_radio_rx_pool_stats_get( &steady );
+    Radio.Standby( );
+    bench_pool_hold = false;
+
+    rt_kprintf( "RX pool, %u slots of %u bytes\n", LORA_RADIO_RX_POOL_SIZE, ( uint32_t )sizeof( packet->Payload ) );
+    rt_kprintf( "  consumer stalled, %u frames      queued %u (%u intact), dropped %u, high water %u\n",
+                stalled, queued, intact, held.Dropped, held.HighWater );
+    rt_kprintf( "  consumer keeping up, %u frames   consumed %u, dropped %u, high water %u\n",
+                frames, consumed, steady.Dropped, steady.HighWater );
+    if( ( queued != LORA_RADIO_RX_POOL_SIZE ) || ( intact != queued ) ||
+        ( held.Dropped != stalled - LORA_RADIO_RX_POOL_SIZE ) || ( consumed != frames ) || ( steady.Dropped != 0 ) )
+    {
+        rx_errors++;
+    }
+}
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_TX_QUEUE
+#define BENCH_TXQ_LOG                   32
+#define BENCH_TXQ_MIN_DEADLINE          2       // ms, shortest MaxDelay of the deadline case
+
+/*!
+ * Completion log of the queued frames, written by the frame callbacks
+ */
+static struct rt_semaphore txq_sem;
+static uint32_t txq_order[BENCH_TXQ_LOG];
+static LoRaRadioTxResult_t txq_result[BENCH_TXQ_LOG];
+static volatile uint32_t txq_reported;
+static bench_stat_t txq_gap = { "queue: TxDone IRQ -> next in TX" };
+
+static void OnQueuedTxDone( void *context, LoRaRadioTxResult_t result )
+{
+    uint32_t n = txq_reported;
+
+    // the next frame, if any, is already on air when the finished one reports
+    if( ( result == LORA_RADIO_TX_DONE ) && ( bench_sim_last_tx_start_us( ) > bench_sim_last_irq_us( ) ) )
+    {
+        bench_stat_add( &txq_gap, bench_sim_last_tx_start_us( ) - bench_sim_last_irq_us( ) );
+    }
+    if( n < BENCH_TXQ_LOG )
+    {
+        txq_order[n] = ( uint32_t )( uintptr_t )context;
+        txq_result[n] = result;
+    }
+    txq_reported = n + 1;
+    rt_sem_release( &txq_sem );
+}
+
+static rt_err_t bench_txq_send( uint32_t id, uint8_t priority, uint32_t maxDelay, uint8_t len )
+{
+    LoRaRadioTxFrame_t frame = { bench_payload, len, priority, maxDelay, OnQueuedTxDone, ( void * )( uintptr_t )id };
+
+    return lora_radio_tx_queue_send( RT_NULL, &frame );
+}
+
+static bool bench_txq_wait( uint32_t reports )
+{
+    while( txq_reported < reports )
+    {
+        if( rt_sem_take( &txq_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+        {
+            rt_kprintf( "  queued frame lost after %u reports\n", txq_reported );
+            timeouts++;
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief Gap on air between two frames: the application sending the next one
+ *        from its TxDone wait, then the driver queue starting it from the
+ *        PHY thread. Then the queue ordering: priorities, a frame whose
+ *        deadline passes behind a long one, a full queue and a flush.
+ */
+static void bench_tx_queue( uint32_t frames, uint8_t len, uint32_t scale )
+{
+    bench_stat_t app_gap = { "app: TxDone IRQ -> next in TX" };
+    LoRaRadioTxQueueStats_t stats;
+    uint64_t irq = 0;
+    uint32_t i, sent, fillers, toa, deadlineScale, maxDelay, errors = 0;
+
+    rt_sem_init( &txq_sem, "txq", 0, RT_IPC_FLAG_FIFO );
+
+    for( i = 0; i < frames; i++ )
+    {
+        Radio.Send( bench_payload, len );
+        if( i > 0 )
+        {
+            bench_stat_add( &app_gap, bench_sim_last_tx_start_us( ) - irq );
+        }
+        if( rt_sem_take( &tx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+        {
+            rt_kprintf( "  TxDone lost at frame %u\n", i );
+            timeouts++;
+            break;
+        }
+        irq = bench_sim_last_irq_us( );
+    }
+
+    // back-to-back, the application keeps the queue filled
+    lora_radio_tx_queue_stats_reset( RT_NULL );
+    txq_reported = 0;
+    for( sent = 0; sent < frames; )
+    {
+        if( bench_txq_send( sent, 0, 0, len ) == RT_EOK )
+        {
+            sent++;
+        }
+        else if( bench_txq_wait( txq_reported + 1 ) == false )
+        {
+            break;
+        }
+    }
+    bench_txq_wait( sent );
+    lora_radio_tx_queue_stats_get( RT_NULL, &stats );
+    for( i = 0; i < txq_reported && i < BENCH_TXQ_LOG; i++ )
+    {
+        if( ( txq_order[i] != i ) || ( txq_result[i] != LORA_RADIO_TX_DONE ) )
+        {
+            errors++;
+        }
+    }
+
+    rt_kprintf( "TX queue, %u frames of %u bytes, %u slots\n", frames, len, LORA_RADIO_TX_QUEUE_SIZE );
+    bench_stat_print( &app_gap );
+    bench_stat_print( &txq_gap );
+    if( stats.Gaps != 0 )
+    {
+        rt_kprintf( "  driver: Send() from the TxDone path    min %7u  avg %7llu  max %7u us\n",
+                    stats.GapMinUs, ( unsigned long long )( stats.GapTotalUs / stats.Gaps ), stats.GapMaxUs );
+    }
+    rt_kprintf( "  sent %u, high water %u\n", stats.Sent, stats.HighWater );
+    if( stats.Sent != frames )
+    {
+        errors++;
+    }
+
+    /*
+     * 0 goes on air at once. 1 waits behind it but may wait half of its air
+     * time only, it expires. 2 is prio 1, 3 prio 3, 4 prio 2 then fillers of
+     * prio 0 until the queue is full: 3, 4, 2, then the fillers in submission
+     * order. Checked on the first five reports, the rest by count. A frame
+     * too short for half of it to span timer ticks at the bench scale (FSK)
+     * is sent at real air time.
+     */
+    toa = ( bench_modem == MODEM_FSK ) ?
+          Radio.TimeOnAir( MODEM_FSK, BENCH_FSK_BANDWIDTH, BENCH_FSK_DATARATE, 0,
+                           BENCH_FSK_PREAMBLE_LENGTH, false, len, true ) :
+          Radio.TimeOnAir( MODEM_LORA, BENCH_BANDWIDTH, BENCH_SPREADING_FACTOR, BENCH_CODINGRATE,
+                           BENCH_PREAMBLE_LENGTH, false, len, true );
+    deadlineScale = ( toa * scale / 100 / 2 < BENCH_TXQ_MIN_DEADLINE ) ? 100 : scale;
+    maxDelay = toa * deadlineScale / 100 / 2;
+    if( maxDelay == 0 )
+    {
+        maxDelay = 1;
+    }
+    bench_sim_set_scale( deadlineScale );
+    lora_radio_tx_queue_stats_reset( RT_NULL );
+    txq_reported = 0;
+    bench_txq_send( 0, 0, 0, len );
+    bench_txq_send( 1, 7, maxDelay, len );
+    bench_txq_send( 2, 1, 0, len );
+    bench_txq_send( 3, 3, 0, len );
+    bench_txq_send( 4, 2, 0, len );
+    for( fillers = 0; bench_txq_send( 5 + fillers, 0, 0, len ) == RT_EOK; fillers++ );
+    bench_txq_wait( 5 + fillers );
+    lora_radio_tx_queue_stats_get( RT_NULL, &stats );
+    // the expired one reports once the first is done, before it
+    {
+        static const uint32_t order[] = { 1, 0, 3, 4, 2 };
+
+        for( i = 0; i < 5; i++ )
+        {
+            if( txq_order[i] != order[i] )
+            {
+                errors++;
+            }
+        }
+    }
+    if( ( txq_result[0] != LORA_RADIO_TX_EXPIRED ) || ( fillers != LORA_RADIO_TX_QUEUE_SIZE - 4 ) ||
+        ( stats.Expired != 1 ) || ( stats.Sent != 4 + fillers ) )
+    {
+        errors++;
+    }
+    bench_sim_set_scale( scale );
+    rt_kprintf( "  priorities 1 3 2 sent as %u %u %u, deadline %u ms missed %u, full after %u waiting\n",
+                txq_order[2], txq_order[3], txq_order[4], maxDelay, stats.Expired, stats.HighWater );
+
+    // the frame on air completes, the waiting ones are flushed
+    txq_reported = 0;
+    bench_txq_send( 0, 0, 0, len );
+    bench_txq_send( 1, 0, 0, len );
+    bench_txq_send( 2, 0, 0, len );
+    lora_radio_tx_queue_flush( RT_NULL );
+    bench_txq_wait( 3 );
+    if( ( txq_result[0] != LORA_RADIO_TX_FLUSHED ) || ( txq_result[1] != LORA_RADIO_TX_FLUSHED ) ||
+        ( txq_result[2] != LORA_RADIO_TX_DONE ) || ( txq_order[2] != 0 ) )
+    {
+        errors++;
+    }
+    rt_kprintf( "  flush with 2 waiting                reported %s, %s, on air one %s\n",
+                ( txq_result[0] == LORA_RADIO_TX_FLUSHED ) ? "flushed" : "?",
+                ( txq_result[1] == LORA_RADIO_TX_FLUSHED ) ? "flushed" : "?",
+                ( txq_result[2] == LORA_RADIO_TX_DONE ) ? "sent" : "?" );
+    if( errors != 0 )
+    {
+        rt_kprintf( "  %u ordering / result errors\n", errors );
+        rx_errors += errors;
+    }
+    rt_sem_detach( &txq_sem );
+}
+#endif
+
+/*!
+ * Parameter space of bench_toa, every payload size with each of them
+ */
+static const uint16_t bench_toa_preambles[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+                                                32, 64, 255, 1000, 65535 };
+static const uint32_t bench_toa_fsk_rates[] = { 600, 1200, 4800, 9600, 50000, 300000 };
+
+/*!
+ * \brief Reference LoRa time on air, SX126x / SX1276 datasheet formulas
+ *        evaluated in 64 bits, \a ms or us rounded up
+ */
+static uint64_t bench_toa_ref_lora( LoRaRadioToaRules_t rules, uint32_t bw, uint32_t sf, uint8_t cr,
+                                    uint32_t preamble, bool fixLen, uint8_t size, bool crcOn, bool ms )
+{
+    bool ldro = ( ( bw == 0 ) && ( sf >= 11 ) ) || ( ( bw == 1 ) && ( sf == 12 ) );
+    bool shortSf = ( rules == LORA_RADIO_TOA_SX126X ) && ( sf <= 6 );
+    int64_t bits = 8 * size + ( crcOn ? 16 : 0 ) - 4 * ( int64_t )sf + ( fixLen ? 0 : 20 ) + ( shortSf ? 0 : 8 );
+    int64_t per = 4 * ( sf - ( ldro ? 2 : 0 ) );
+    uint64_t blocks = ( bits > 0 ) ? ( uint64_t )( ( bits + per - 1 ) / per ) : 0;
+    uint64_t quarters;
+
+    if( shortSf == true )
+    {
+        // Npreamble + 6.25 + 8 + payload symbols, 12 preamble symbols at least
+        preamble = ( preamble < 12 ) ? 12 : preamble;
+        quarters = 4 * ( preamble + 6 + 8 + blocks * ( cr + 4 ) ) + 1;
+    }
+    else
+    {
+        // Npreamble + 4.25 + 8 + payload symbols
+        quarters = 4 * ( preamble + 4 + 8 + blocks * ( cr + 4 ) ) + 1;
+    }
+    // quarter symbol: 2^( SF - 2 ) / BW s
+    return ( ( quarters << ( sf - 2 ) ) * ( ms ? 1000U : 1000000U ) + ( 125000U << bw ) - 1 ) / ( 125000U << bw );
+}
+
+static uint64_t bench_toa_ref_fsk( uint32_t rate, uint32_t preamble, bool fixLen, uint8_t size, bool crcOn, bool ms )
+{
+    uint64_t bits = 8 * ( ( uint64_t )preamble + 3 + ( fixLen ? 0 : 1 ) + size + ( crcOn ? 2 : 0 ) );
+
+    return ( bits * ( ms ? 1000U : 1000000U ) + rate - 1 ) / rate;
+}
+
+/*!
+ * \brief Per size times and inverse queries of a prepared format against
+ *        the reference
+ *
+ * \retval errors
+ */
+static uint32_t bench_toa_check( const LoRaRadioToa_t *toa, const uint64_t *refUs, const uint64_t *refMs )
+{
+    uint32_t us[256];
+    uint64_t total = 0;
+    uint32_t errors = 0, size, last;
+    int16_t fits;
+
+    for( size = 0; size < 256; size++ )
+    {
+        total += refUs[size];
+        errors += ( lora_radio_toa_us( toa, ( uint8_t )size ) != refUs[size] ) ? 1 : 0;
+        errors += ( lora_radio_toa_ms( toa, ( uint8_t )size ) != refMs[size] ) ? 1 : 0;
+    }
+    errors += ( lora_radio_toa_range_us( toa, 0, 255, us ) != total ) ? 1 : 0;
+    for( size = 0; size < 256; size++ )
+    {
+        errors += ( us[size] != refUs[size] ) ? 1 : 0;
+    }
+    // a range that does not start at 0
+    lora_radio_toa_range_us( toa, 100, 110, us );
+    errors += ( ( us[0] != refUs[100] ) || ( us[10] != refUs[110] ) ) ? 1 : 0;
+
+    // budget of exactly a frame and 1 us less
+    for( size = 0; size < 256; size++ )
+    {
+        if( refUs[size] > 0xFFFFFFFFU )
+        {
+            continue;
+        }
+        for( last = size; ( last < 255 ) && ( refUs[last + 1] == refUs[size] ); last++ );
+        fits = lora_radio_toa_max_payload( toa, ( uint32_t )refUs[size] );
+        errors += ( fits != ( int16_t )last ) ? 1 : 0;
+        fits = lora_radio_toa_max_payload( toa, ( uint32_t )refUs[size] - 1 );
+        for( last = size; ( last > 0 ) && ( refUs[last] == refUs[size] ); last-- );
+        errors += ( fits != ( ( refUs[last] < refUs[size] ) ? ( int16_t )last : -1 ) ) ? 1 : 0;
+    }
+    return errors;
+}
+
+#define BENCH_TOA_CALLS                 2000000
+
+/*!
+ * \brief Prepared format of every LoRa and FSK parameter set against the
+ *        reference, Radio.TimeOnAir of the chip as well, then calls per second
+ */
+static void bench_toa( void )
+{
+    static uint64_t refUs[256], refMs[256];
+    static uint32_t us[256];
+    const uint32_t preambles = sizeof( bench_toa_preambles ) / sizeof( bench_toa_preambles[0] );
+    const uint32_t rates = sizeof( bench_toa_fsk_rates ) / sizeof( bench_toa_fsk_rates[0] );
+    uint32_t formats = 0, errors = 0, driver = 0, drift = 0;
+    uint32_t rules, bw, sf, cr, flags, p, r, n, size, i;
+    volatile uint32_t sink = 0;
+    LoRaRadioToa_t toa;
+    uint64_t t0, elapsed[4];
+    bool fixLen, crcOn;
+
+    // rules x bandwidth x SF5..SF12 x coderate x ( fixLen, crcOn ) x preamble
+    for( n = 0; n < 2 * 3 * 8 * 4 * 4 * preambles; n++ )
+    {
+        p = n % preambles;
+        flags = n / preambles % 4;
+        cr = n / preambles / 4 % 4 + 1;
+        sf = n / preambles / 16 % 8 + 5;
+        bw = n / preambles / 128 % 3;
+        rules = n / preambles / 384;
+        fixLen = ( flags & 1 ) != 0;
+        crcOn = ( flags & 2 ) != 0;
+        for( size = 0; size < 256; size++ )
+        {
+            refUs[size] = bench_toa_ref_lora( ( LoRaRadioToaRules_t )rules, bw, sf, cr, bench_toa_preambles[p],
+                                              fixLen, size, crcOn, false );
+            refMs[size] = bench_toa_ref_lora( ( LoRaRadioToaRules_t )rules, bw, sf, cr, bench_toa_preambles[p],
+                                              fixLen, size, crcOn, true );
+            if( ( rules == BENCH_TOA_RULES ) &&
+                ( Radio.TimeOnAir( MODEM_LORA, bw, sf, cr, bench_toa_preambles[p], fixLen, size, crcOn ) != refMs[size] ) )
+            {
+                driver++;
+            }
+            if( ( rules == LORA_RADIO_TOA_SX126X ) && ( refUs[size] !=
+                bench_toa_ref_lora( LORA_RADIO_TOA_SX127X, bw, sf, cr, bench_toa_preambles[p], fixLen, size, crcOn, false ) ) )
+            {
+                drift++;
+            }
+        }
+        if( lora_radio_toa_lora( &toa, ( LoRaRadioToaRules_t )rules, bw, sf, cr, bench_toa_preambles[p], fixLen, crcOn ) == false )
+        {
+            errors++;
+            continue;
+        }
+        errors += bench_toa_check( &toa, refUs, refMs );
+        formats++;
+    }
+
+    // datarate x ( fixLen, crcOn ) x preamble
+    for( n = 0; n < rates * 4 * preambles; n++ )
+    {
+        p = n % preambles;
+        flags = n / preambles % 4;
+        r = n / preambles / 4;
+        fixLen = ( flags & 1 ) != 0;
+        crcOn = ( flags & 2 ) != 0;
+        for( size = 0; size < 256; size++ )
+        {
+            refUs[size] = bench_toa_ref_fsk( bench_toa_fsk_rates[r], bench_toa_preambles[p], fixLen, size, crcOn, false );
+            refMs[size] = bench_toa_ref_fsk( bench_toa_fsk_rates[r], bench_toa_preambles[p], fixLen, size, crcOn, true );
+            if( Radio.TimeOnAir( MODEM_FSK, 0, bench_toa_fsk_rates[r], 0, bench_toa_preambles[p], fixLen, size, crcOn ) != refMs[size] )
+            {
+                driver++;
+            }
+        }
+        if( lora_radio_toa_fsk( &toa, bench_toa_fsk_rates[r], bench_toa_preambles[p], fixLen, crcOn ) == false )
+        {
+            errors++;
+            continue;
+        }
+        errors += bench_toa_check( &toa, refUs, refMs );
+        formats++;
+    }
+
+    // calls per second, SF7..SF10 and every payload size
+    t0 = sim_get_time_us( );
+    for( i = 0; i < BENCH_TOA_CALLS; i++ )
+    {
+        sink += ( uint32_t )bench_toa_ref_lora( LORA_RADIO_TOA_SX126X, 0, 7 + ( ( i >> 8 ) & 3 ), 1, 8, false, ( uint8_t )i, true, true );
+    }
+    elapsed[0] = sim_get_time_us( ) - t0;
+    t0 = sim_get_time_us( );
+    for( i = 0; i < BENCH_TOA_CALLS; i++ )
+    {
+        sink += Radio.TimeOnAir( MODEM_LORA, 0, 7 + ( ( i >> 8 ) & 3 ), 1, 8, false, ( uint8_t )i, true );
+    }
+    elapsed[1] = sim_get_time_us( ) - t0;
+    lora_radio_toa_lora( &toa, BENCH_TOA_RULES, 0, 7, 1, 8, false, true );
+    t0 = sim_get_time_us( );
+    for( i = 0; i < BENCH_TOA_CALLS; i++ )
+    {
+        sink += lora_radio_toa_ms( &toa, ( uint8_t )i );
+    }
+    elapsed[2] = sim_get_time_us( ) - t0;
+    t0 = sim_get_time_us( );
+    for( i = 0; i < BENCH_TOA_CALLS / 256; i++ )
+    {
+        sink += ( uint32_t )lora_radio_toa_range_us( &toa, 0, 255, us );
+    }
+    elapsed[3] = sim_get_time_us( ) - t0;
+
+    rt_kprintf( "time on air, %u formats x 256 sizes against the reference\n", formats );
+    rt_kprintf( "  %-34s %u errors, Radio.TimeOnAir %u mismatches\n", "times and inverse queries", errors, driver );
+    rt_kprintf( "  %-34s %u LoRa frames\n", "SX126x / SX127x formulas differ", drift );
+    rt_kprintf( "  %-34s %7llu k calls/s\n", "reference formula",
+                ( unsigned long long )( BENCH_TOA_CALLS * 1000ULL / ( elapsed[0] + 1 ) ) );
+    rt_kprintf( "  %-34s %7llu k calls/s\n", "Radio.TimeOnAir",
+                ( unsigned long long )( BENCH_TOA_CALLS * 1000ULL / ( elapsed[1] + 1 ) ) );
+    rt_kprintf( "  %-34s %7llu k calls/s\n", "lora_radio_toa_ms, prepared",
+                ( unsigned long long )( BENCH_TOA_CALLS * 1000ULL / ( elapsed[2] + 1 ) ) );
+    rt_kprintf( "  %-34s %7llu k sizes/s\n", "lora_radio_toa_range_us, 0..255",
+                ( unsigned long long )( BENCH_TOA_CALLS * 1000ULL / ( elapsed[3] + 1 ) ) );
+    ( void )sink;
+
+    if( ( errors != 0 ) || ( driver != 0 ) || ( drift == 0 ) )
+    {
+        rx_errors++;
+    }
+}
+
+/*!
+ * \brief Cost of the RX window / uplink setup: Radio.SetRxConfig and
+ *        Radio.SetTxConfig called again with the parameters in use, then
+ *        with the preamble length changing on every call (RX 4 symbols longer
+ *        than TX)
+ */
+static void bench_config( uint32_t calls )
+{
+    bench_stat_t call[4] = { { "SetRxConfig() unchanged" }, { "SetTxConfig() unchanged" },
+                             { "SetRxConfig() preamble changed" }, { "SetTxConfig() preamble changed" } };
+    uint32_t transactions[4] = { 0 }, bytes[4] = { 0 };
+    struct rt_spi_device *spi = bench_sim_spi( );
+    uint16_t preambleLen = ( bench_modem == MODEM_FSK ) ? BENCH_FSK_PREAMBLE_LENGTH : BENCH_PREAMBLE_LENGTH;
+    uint16_t len;
+    uint64_t t0;
+    uint32_t i, k;
+
+    bench_set_tx_config( preambleLen );
+    bench_set_rx_config( preambleLen );
+    for( i = 0; i < calls * 4; i++ )
+    {
+        // calls unchanged, then calls undoing the preamble length of the previous one
+        k = ( ( i < calls * 2 ) ? 0 : 2 ) + ( i & 1 );
+        len = ( k == 2 ) ? preambleLen + 4 : preambleLen;
+
+        sim_spi_reset_stats( spi );
+        t0 = sim_get_time_us( );
+        if( ( k & 1 ) == 0 )
+        {
+            bench_set_rx_config( len );
+        }
+        else
+        {
+            bench_set_tx_config( len );
+        }
+        bench_stat_add( &call[k], sim_get_time_us( ) - t0 );
+        transactions[k] += spi->stats.transactions;
+        bytes[k] += spi->stats.bytes;
+    }
+    bench_set_tx_config( preambleLen );
+    bench_set_rx_config( preambleLen );
+
+    rt_kprintf( "RX window / uplink setup, %u calls each\n", calls );
+    for( k = 0; k < 4; k++ )
+    {
+        bench_stat_print( &call[k] );
+        if( calls > 0 )
+        {
+            rt_kprintf( "  %-34s transactions %u, bytes %u\n", "  SPI per call", transactions[k] / calls, bytes[k] / calls );
+        }
+    }
+}
+
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+#define BENCH_PLAN_CHANNELS             96      // CN470 uplink, 470.3 MHz + n * 200 kHz
+#define BENCH_PLAN_SPACING              200000  // Hz
+#define BENCH_PLAN_HOPS                 960
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X )
+static SX126xChannel_t bench_plan[BENCH_PLAN_CHANNELS];
+#define bench_set_channel_plan( plan, count )   SX126xSetChannelPlan( plan, count )
+#else
+static SX127xChannel_t bench_plan[BENCH_PLAN_CHANNELS];
+#define bench_set_channel_plan( plan, count )   SX127xSetChannelPlan( plan, count )
+#endif
+
+/*!
+ * \brief Channel switch latency hopping over the CN470 uplink channels,
+ *        without then with the channel plan registered
+ */
+static void bench_channel( void )
+{
+    bench_stat_t call[2] = { { "Radio.SetChannel() computed FRF" }, { "Radio.SetChannel() channel plan" } };
+    uint32_t transactions[2] = { 0 }, bytes[2] = { 0 };
+    struct rt_spi_device *spi = bench_sim_spi( );
+    uint32_t i, planned, freq;
+    uint64_t t0;
+
+    for( i = 0; i < BENCH_PLAN_CHANNELS; i++ )
+    {
+        // registered in reverse order, the driver sorts the plan
+        bench_plan[i].Frequency = BENCH_FREQUENCY + ( BENCH_PLAN_CHANNELS - 1 - i ) * BENCH_PLAN_SPACING;
+    }
+    for( planned = 0; planned < 2; planned++ )
+    {
+        bench_set_channel_plan( planned ? bench_plan : RT_NULL, BENCH_PLAN_CHANNELS );
+        for( i = 0; i < BENCH_PLAN_HOPS; i++ )
+        {
+            freq = BENCH_FREQUENCY + ( ( i * 37 ) % BENCH_PLAN_CHANNELS ) * BENCH_PLAN_SPACING;
+            sim_spi_reset_stats( spi );
+            t0 = sim_get_time_us( );
+            Radio.SetChannel( freq );
+            bench_stat_add( &call[planned], sim_get_time_us( ) - t0 );
+            transactions[planned] += spi->stats.transactions;
+            bytes[planned] += spi->stats.bytes;
+        }
+    }
+    Radio.SetChannel( BENCH_FREQUENCY );
+
+    rt_kprintf( "channel switch, %u channel plan, %u hops each\n", BENCH_PLAN_CHANNELS, BENCH_PLAN_HOPS );
+    for( planned = 0; planned < 2; planned++ )
+    {
+        bench_stat_print( &call[planned] );
+        rt_kprintf( "  %-34s transactions %.2f, bytes %.2f\n", "  SPI per hop",
+                    transactions[planned] / ( double )BENCH_PLAN_HOPS, bytes[planned] / ( double )BENCH_PLAN_HOPS );
+    }
+}
+#endif
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X )
+/*!
+ * \brief RadioSend before the command batch: four blocking accesses, each
+ *        with its own device check and BUSY waits
+ */
+static void bench_send_unbatched( uint8_t *buffer, uint8_t size )
+{
+    SX126xSetDioIrqParams( IRQ_TX_DONE | IRQ_RX_TX_TIMEOUT,
+                           IRQ_TX_DONE | IRQ_RX_TX_TIMEOUT,
+                           IRQ_RADIO_NONE,
+                           IRQ_RADIO_NONE );
+    SX126x->PacketParams.Params.LoRa.PayloadLength = size;
+    SX126xSetPacketParams( &SX126x->PacketParams );
+    SX126xSendPayload( buffer, size, 0 );
+}
+
+/*!
+ * \brief TX start latency of Radio.Send() (batched) against the unbatched
+ *        sequence, frames alternate between the two
+ */
+static void bench_batch( uint32_t frames, uint8_t len )
+{
+    bench_stat_t call[2] = { { "unbatched call" }, { "batched Radio.Send() call" } };
+    bench_stat_t tx_start[2] = { { "unbatched -> chip in TX" }, { "batched Radio.Send() -> chip in TX" } };
+    uint32_t busy_waits[2] = { 0 }, transactions[2] = { 0 };
+    SX126xBusyStats_t busy;
+    uint64_t t0, t1;
+    uint32_t i, batched, waits;
+
+    for( i = 0; i < frames * 2; i++ )
+    {
+        batched = i & 1;
+        bench_payload[0] = ( uint8_t )i;
+        sim_spi_reset_stats( bench_sim_spi( ) );
+        SX126xGetBusyStats( &busy );
+        waits = busy.Waits;
+
+        t0 = sim_get_time_us( );
+        if( batched )
+        {
+            Radio.Send( bench_payload, len );
+        }
+        else
+        {
+            bench_send_unbatched( bench_payload, len );
+        }
+        t1 = sim_get_time_us( );
+        SX126xGetBusyStats( &busy );
+        busy_waits[batched] += busy.Waits - waits;
+        transactions[batched] += bench_sim_spi( )->stats.transactions;
+
+        if( rt_sem_take( &tx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+        {
+            rt_kprintf( "  TxDone lost at frame %u\n", i );
+            timeouts++;
+            break;
+        }
+        bench_stat_add( &call[batched], t1 - t0 );
+        bench_stat_add( &tx_start[batched], bench_sim_last_tx_start_us( ) - t0 );
+    }
+
+    rt_kprintf( "TX start, batched against unbatched command sequence, %u frames each\n", i / 2 );
+    for( batched = 0; batched < 2; batched++ )
+    {
+        bench_stat_print( &call[batched] );
+        bench_stat_print( &tx_start[batched] );
+        if( i > 1 )
+        {
+            rt_kprintf( "  %-34s BUSY waits %u, transactions %u\n", batched ? "batched, per frame" : "unbatched, per frame",
+                        busy_waits[batched] / ( i / 2 ), transactions[batched] / ( i / 2 ) );
+        }
+    }
+}
+#endif
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X )
+#define BENCH_IMAGE_CAL_FREQUENCY       868100000
+#define BENCH_IMAGE_CAL_IDLE_MS         5       // idle time between two frames
+
+/*!
+ * \brief TX start latency when every frame changes the image calibration
+ *        band (470 / 868 MHz), calibrating on Radio.SetChannel() against
+ *        SX126xPrepareImageCalibration() called while the previous frame is on air
+ */
+static void bench_image_calibration( uint32_t frames, uint8_t len )
+{
+    bench_stat_t call[2] = { { "Radio.SetChannel() calibrating" }, { "Radio.SetChannel() prepared" } };
+    bench_stat_t tx_start[2] = { { "  -> chip in TX" }, { "  -> chip in TX" } };
+    uint32_t calibrations[2];
+    uint32_t i, ahead, freq;
+    uint64_t t0, t1;
+
+    for( ahead = 0; ahead < 2; ahead++ )
+    {
+        calibrations[ahead] = sx126x_sim0.stats.image_calibrations;
+        for( i = 0; i < frames; i++ )
+        {
+            freq = ( i & 1 ) ? BENCH_IMAGE_CAL_FREQUENCY : BENCH_FREQUENCY;
+            bench_payload[0] = ( uint8_t )i;
+
+            t0 = sim_get_time_us( );
+            Radio.SetChannel( freq );
+            t1 = sim_get_time_us( );
+            Radio.Send( bench_payload, len );
+            if( ahead )
+            {
+                // the chip is in TX, the calibration runs once TxDone was handled
+                SX126xPrepareImageCalibration( ( i & 1 ) ? BENCH_FREQUENCY : BENCH_IMAGE_CAL_FREQUENCY );
+            }
+
+            if( rt_sem_take( &tx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+            {
+                rt_kprintf( "  TxDone lost at frame %u\n", i );
+                timeouts++;
+                break;
+            }
+            bench_stat_add( &call[ahead], t1 - t0 );
+            bench_stat_add( &tx_start[ahead], bench_sim_last_tx_start_us( ) - t0 );
+            rt_thread_mdelay( BENCH_IMAGE_CAL_IDLE_MS );
+        }
+        calibrations[ahead] = sx126x_sim0.stats.image_calibrations - calibrations[ahead];
+    }
+    Radio.SetChannel( BENCH_FREQUENCY );
+
+    rt_kprintf( "image calibration, band change every frame, %u frames each\n", frames );
+    for( ahead = 0; ahead < 2; ahead++ )
+    {
+        bench_stat_print( &call[ahead] );
+        bench_stat_print( &tx_start[ahead] );
+        rt_kprintf( "  %-34s %u\n", "  image calibrations", calibrations[ahead] );
+    }
+}
+#endif
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X ) && defined( LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC )
+#define BENCH_QUEUE_CHAINS              16
+
+static SX126xSpiXfer_t queue_xfer[BENCH_QUEUE_CHAINS][4];
+static uint8_t queue_tx[BENCH_QUEUE_CHAINS][255];
+static uint8_t queue_rx[BENCH_QUEUE_CHAINS][255];
+static volatile uint32_t queue_done;
+static uint32_t queue_order_errors;
+static uint32_t queue_data_errors;
+
+static void OnQueueXferDone( SX126xSpiXfer_t *xfer, void *arg )
+{
+    if( ( uint32_t )( uintptr_t )arg != queue_done )
+    {
+        queue_order_errors++;
+    }
+    queue_done++;
+}
+
+/*!
+ * \brief Asynchronous SPI queue: BENCH_QUEUE_CHAINS chains of "write the data
+ *        buffer, read it back" are submitted back to back, then RadioSend's
+ *        SetDioIrqParams / SetPacketParams / WriteBuffer / SetTx burst runs
+ *        as one chain
+ */
+static void bench_spi_queue( uint8_t len )
+{
+    bench_stat_t submit_call = { "SX126xSpiSubmit() TX chain" };
+    bench_stat_t tx_start = { "SX126xSpiSubmit() -> chip in TX" };
+    SX126xSpiQueueStats_t stats;
+    uint8_t irq[8], packet[6], timeout[3] = { 0 };
+    uint64_t t0, t1, t2;
+    uint32_t i, j, seq = 0;
+
+    Radio.Standby( );
+    SX126xResetSpiQueueStats( );
+    sim_spi_reset_stats( bench_sim_spi( ) );
+    queue_done = 0;
+
+    for( i = 0; i < BENCH_QUEUE_CHAINS; i++ )
+    {
+        for( j = 0; j < len; j++ )
+        {
+            queue_tx[i][j] = ( uint8_t )( i * 31 + j );
+        }
+        SX126xSpiPrepareWriteBuffer( &queue_xfer[i][0], 0, queue_tx[i], len );
+        SX126xSpiPrepareReadBuffer( &queue_xfer[i][1], 0, queue_rx[i], len );
+        queue_xfer[i][0].Next = &queue_xfer[i][1];
+        for( j = 0; j < 2; j++ )
+        {
+            queue_xfer[i][j].Done = OnQueueXferDone;
+            queue_xfer[i][j].Arg = ( void * )( uintptr_t )seq++;
+        }
+    }
+
+    t0 = sim_get_time_us( );
+    for( i = 0; i < BENCH_QUEUE_CHAINS; i++ )
+    {
+        SX126xSpiSubmit( &queue_xfer[i][0] );
+    }
+    t1 = sim_get_time_us( );
+    SX126xSpiFlush( );
+    t2 = sim_get_time_us( );
+
+    for( i = 0; i < BENCH_QUEUE_CHAINS; i++ )
+    {
+        if( memcmp( queue_tx[i], queue_rx[i], len ) != 0 )
+        {
+            queue_data_errors++;
+        }
+    }
+    SX126xGetSpiQueueStats( &stats );
+    rt_kprintf( "SPI queue, %u chains write + read back %u bytes\n", BENCH_QUEUE_CHAINS, len );
+    rt_kprintf( "  submit all %llu us, all done %llu us, max depth %u, completed %u/%u\n",
+                ( unsigned long long )( t1 - t0 ), ( unsigned long long )( t2 - t0 ),
+                stats.MaxDepth, stats.Completed, stats.Submitted );
+
+    // RadioSend's burst, encoded as RadioSend / SX126xSetPacketParams would
+    irq[0] = irq[2] = ( uint8_t )( ( ( IRQ_TX_DONE | IRQ_RX_TX_TIMEOUT ) >> 8 ) & 0x00FF );
+    irq[1] = irq[3] = ( uint8_t )( ( IRQ_TX_DONE | IRQ_RX_TX_TIMEOUT ) & 0x00FF );
+    irq[4] = irq[5] = irq[6] = irq[7] = 0;
+    packet[0] = ( SX126x->PacketParams.Params.LoRa.PreambleLength >> 8 ) & 0xFF;
+    packet[1] = SX126x->PacketParams.Params.LoRa.PreambleLength;
+    packet[2] = SX126x->PacketParams.Params.LoRa.HeaderType;
+    packet[3] = len;
+    packet[4] = SX126x->PacketParams.Params.LoRa.CrcMode;
+    packet[5] = SX126x->PacketParams.Params.LoRa.InvertIQ;
+
+    for( i = 0; i < 4; i++ )
+    {
+        SX126xSpiPrepareCommand( &queue_xfer[0][0], RADIO_CFG_DIOIRQ, irq, sizeof( irq ) );
+        SX126xSpiPrepareCommand( &queue_xfer[0][1], RADIO_SET_PACKETPARAMS, packet, sizeof( packet ) );
+        SX126xSpiPrepareWriteBuffer( &queue_xfer[0][2], 0, bench_payload, len );
+        SX126xSpiPrepareCommand( &queue_xfer[0][3], RADIO_SET_TX, timeout, sizeof( timeout ) );
+        queue_xfer[0][0].Next = &queue_xfer[0][1];
+        queue_xfer[0][1].Next = &queue_xfer[0][2];
+        queue_xfer[0][2].Next = &queue_xfer[0][3];
+        SX126xSetOperatingMode( MODE_TX );
+
+        t0 = sim_get_time_us( );
+        SX126xSpiSubmit( &queue_xfer[0][0] );
+        t1 = sim_get_time_us( );
+        if( rt_sem_take( &tx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK )
+        {
+            rt_kprintf( "  TxDone lost after the queued burst %u\n", i );
+            timeouts++;
+            break;
+        }
+        bench_stat_add( &submit_call, t1 - t0 );
+        bench_stat_add( &tx_start, bench_sim_last_tx_start_us( ) - t0 );
+    }
+    bench_stat_print( &submit_call );
+    bench_stat_print( &tx_start );
+    rt_kprintf( "  completion order errors %u, read back errors %u, DMA transfers %u\n",
+                queue_order_errors, queue_data_errors, bench_sim_spi( )->stats.dma_transfers );
+}
+#endif
+
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+/*!
+ * Radio 0 stays on the Radio shim and its callbacks, radio 1 goes through
+ * the lora_radio_xxx API, its callbacks find their state through the context
+ */
+typedef struct
+{
+    struct rt_semaphore done;
+    uint64_t done_us;
+    uint32_t frames;
+    uint32_t errors;
+}bench_radio_ctx_t;
+
+static bench_radio_ctx_t multi_ctx;
+
+static void OnMultiRxDone( void *context, uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
+{
+    bench_radio_ctx_t *ctx = context;
+
+    ctx->done_us = sim_get_time_us( );
+    ctx->frames++;
+    if( memcmp( payload, bench_payload, size ) != 0 )
+    {
+        ctx->errors++;
+    }
+    bench_rx_pool_drain( );
+    rt_sem_release( &ctx->done );
+}
+
+static void OnMultiRxError( void *context )
+{
+    bench_radio_ctx_t *ctx = context;
+
+    ctx->errors++;
+    rt_sem_release( &ctx->done );
+}
+
+static const LoRaRadioEvents_t multi_events =
+{
+    .RxDone = OnMultiRxDone,
+    .RxError = OnMultiRxError,
+};
+
+/*!
+ * \brief Both radios in continuous RX, every frame lands on both at the same
+ *        time. The two PHY threads serve their DIO independently, calls into
+ *        the driver are serialized by the driver lock.
+ */
+static void bench_multi( uint32_t frames, uint8_t len, uint32_t scale )
+{
+    bench_stat_t irq_to_cb[2] = { { "radio 0 DIO IRQ -> RxDone callback" }, { "radio 1 DIO IRQ -> RxDone callback" } };
+    bench_stat_t both = { "frame on air -> both RxDone" };
+    LoRaRadio_t *radio = lora_radio_get( 1 );
+    uint64_t t0;
+    uint32_t i;
+
+    rt_sem_init( &multi_ctx.done, "multi", 0, RT_IPC_FLAG_FIFO );
+    if( lora_radio_init( radio, &multi_events, &multi_ctx ) == false )
+    {
+        rt_kprintf( "lora_radio_init( radio 1 ) failed\n" );
+        timeouts++;
+        return;
+    }
+    bench_sim_n_set_scale( 1, scale );
+    lora_radio_set_channel( radio, BENCH_FREQUENCY );
+    if( bench_modem == MODEM_FSK )
+    {
+        lora_radio_set_rx_config( radio, MODEM_FSK, BENCH_FSK_BANDWIDTH, BENCH_FSK_DATARATE, 0, BENCH_FSK_BANDWIDTH_AFC,
+                                  BENCH_FSK_PREAMBLE_LENGTH, BENCH_FSK_SYNC_TIMEOUT, false, 0, true, 0, 0, false, true );
+    }
+    else
+    {
+        lora_radio_set_rx_config( radio, MODEM_LORA, BENCH_BANDWIDTH, BENCH_SPREADING_FACTOR, BENCH_CODINGRATE, 0,
+                                  BENCH_PREAMBLE_LENGTH, 0, false, 0, true, 0, 0, false, true );
+    }
+
+    Radio.SetChannel( BENCH_FREQUENCY );
+    bench_set_rx_config( ( bench_modem == MODEM_FSK ) ? BENCH_FSK_PREAMBLE_LENGTH : BENCH_PREAMBLE_LENGTH );
+    Radio.Rx( 0 );
+    lora_radio_rx( radio, 0 );
+    for( i = 0; i < frames; i++ )
+    {
+        bench_payload[0] = ( uint8_t )i;
+        rt_thread_mdelay( 1 );
+        t0 = sim_get_time_us( );
+        if( ( bench_sim_n_inject( 0, bench_payload, len ) != RT_EOK ) ||
+            ( bench_sim_n_inject( 1, bench_payload, len ) != RT_EOK ) )
+        {
+            rt_kprintf( "  receivers not listening at frame %u\n", i );
+            break;
+        }
+        if( ( rt_sem_take( &rx_done_sem, BENCH_WAIT_TIMEOUT ) != RT_EOK ) ||
+            ( rt_sem_take( &multi_ctx.done, BENCH_WAIT_TIMEOUT ) != RT_EOK ) )
+        {
+            rt_kprintf( "  RxDone lost at frame %u\n", i );
+            timeouts++;
+            break;
+        }
+        bench_stat_add( &irq_to_cb[0], rx_done_us - bench_sim_n_last_irq_us( 0 ) );
+        bench_stat_add( &irq_to_cb[1], multi_ctx.done_us - bench_sim_n_last_irq_us( 1 ) );
+        bench_stat_add( &both, ( ( rx_done_us > multi_ctx.done_us ) ? rx_done_us : multi_ctx.done_us ) - t0 );
+    }
+    Radio.Standby( );
+    lora_radio_standby( radio );
+
+    rt_kprintf( "two radios in parallel RX, %u frames of %u bytes each\n", i, len );
+    bench_stat_print( &irq_to_cb[0] );
+    bench_stat_print( &irq_to_cb[1] );
+    bench_stat_print( &both );
+    rt_kprintf( "  radio 1 frames %u, payload errors %u, %s %u\n",
+                multi_ctx.frames, multi_ctx.errors, BENCH_SIM_VIOLATIONS_NAME, bench_sim_n_violations( 1 ) );
+    rx_errors += multi_ctx.errors + bench_sim_n_violations( 1 );
+}
+#endif
+
+int main( int argc, char **argv )
+{
+    uint32_t frames = 100;
+    uint32_t scale = 10;
+    uint32_t len = 32;
+    uint32_t i;
+    int opt;
+
+    while( ( opt = getopt( argc, argv, "n:l:s:f" ) ) != -1 )
+    {
+        switch( opt )
+        {
+        case 'n': frames = strtoul( optarg, RT_NULL, 0 ); break;
+        case 'l': len = strtoul( optarg, RT_NULL, 0 ); break;
+        case 's': scale = strtoul( optarg, RT_NULL, 0 ); break;
+#ifdef BENCH_CHIP_HAS_FSK
+        case 'f': bench_modem = MODEM_FSK; break;
+#endif
+        default:
+            rt_kprintf( "usage: %s [-n frames] [-l payload] [-s air time scale %%] [-f]\n", argv[0] );
+            return 1;
+        }
+    }
+    if( len == 0 || len > 255 )
+    {
+        len = 32;
+    }
+    for( i = 0; i < sizeof( bench_payload ); i++ )
+    {
+        bench_payload[i] = ( uint8_t )( i * 7 + 1 );
+    }
+
+    rt_sem_init( &tx_done_sem, "tx_done", 0, RT_IPC_FLAG_FIFO );
+    rt_sem_init( &rx_done_sem, "rx_done", 0, RT_IPC_FLAG_FIFO );
+
+    bench_events.TxDone = OnTxDone;
+    bench_events.RxDone = OnRxDone;
+    bench_events.TxTimeout = OnTxTimeout;
+    bench_events.RxTimeout = OnRxTimeout;
+    bench_events.RxError = OnRxError;
+
+    if( Radio.Init( &bench_events ) == false )
+    {
+        rt_kprintf( "Radio.Init failed\n" );
+        return 1;
+    }
+    bench_sim_set_scale( scale );
+#ifdef LORA_RADIO_DRIVER_USING_CRITICAL_SECTION_STATS
+    lora_radio_critical_section_stats_reset( );
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX127X ) && defined( LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS )
+    SX127xResetShadowStats( );
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX127X )
+    SX127xResetDioStats( );
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X )
+    SX126xResetBusyStats( );
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X ) && defined( LORA_RADIO_DRIVER_USING_CONFIG_DIFF )
+    SX126xResetConfigStats( );
+#endif
+
+    Radio.SetChannel( BENCH_FREQUENCY );
+    if( bench_modem == MODEM_FSK )
+    {
+        bench_set_tx_config( BENCH_FSK_PREAMBLE_LENGTH );
+        bench_set_rx_config( BENCH_FSK_PREAMBLE_LENGTH );
+
+        rt_kprintf( "lora-radio host bench, chip %s, FSK %u bps, air time scale %u%%\n",
+                    BENCH_CHIP_NAME, BENCH_FSK_DATARATE, scale );
+    }
+    else
+    {
+        bench_set_tx_config( BENCH_PREAMBLE_LENGTH );
+        bench_set_rx_config( BENCH_PREAMBLE_LENGTH );
+
+        rt_kprintf( "lora-radio host bench, chip %s, SF%u BW125 CR4/5, air time scale %u%%\n",
+                    BENCH_CHIP_NAME, BENCH_SPREADING_FACTOR, scale );
+    }
+
+    bench_tx( frames, ( uint8_t )len );
+    bench_rx( frames, 255 );
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+    bench_timestamp( frames, ( uint8_t )len, scale );
+#endif
+    bench_timer( );
+#ifdef LORA_RADIO_DRIVER_USING_RX_POOL
+    bench_rx_pool( frames, ( uint8_t )len );
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_TX_QUEUE
+    bench_tx_queue( frames, ( uint8_t )len, scale );
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_EVENT_RING
+    bench_event_ring( );
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_CALLBACK_EXECUTOR
+    if( bench_modem == MODEM_LORA )
+    {
+        bench_executor( ( uint8_t )len, scale );
+    }
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_RX_POLICY
+    if( bench_modem == MODEM_LORA )
+    {
+        bench_rx_policy( ( uint8_t )len );
+    }
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_LBT
+    if( bench_modem == MODEM_LORA )
+    {
+        bench_lbt( ( uint8_t )len );
+    }
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_SCAN
+    if( bench_modem == MODEM_LORA )
+    {
+        bench_scan( );
+    }
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_NOISE_FLOOR
+    if( bench_modem == MODEM_LORA )
+    {
+        bench_noise_floor( ( uint8_t )len );
+    }
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX127X ) && defined( LORA_RADIO_DRIVER_USING_SX127X_RX_DUTY_CYCLE )
+    if( bench_modem == MODEM_LORA )
+    {
+        bench_rx_duty_cycle( ( uint8_t )len );
+    }
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X ) && defined( LORA_RADIO_DRIVER_USING_SX126X_CAD_RX )
+    if( bench_modem == MODEM_LORA )
+    {
+        bench_cad_rx( frames, ( uint8_t )len );
+    }
+#endif
+    bench_config( frames );
+    bench_toa( );
+#ifdef LORA_RADIO_DRIVER_USING_CHANNEL_PLAN
+    bench_channel( );
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X )
+    if( bench_modem == MODEM_LORA )
+    {
+        bench_batch( frames, ( uint8_t )len );
+        bench_image_calibration( frames, ( uint8_t )len );
+    }
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X ) && defined( LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC )
+    bench_spi_queue( ( uint8_t )len );
+#endif
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+    bench_multi( frames, ( uint8_t )len, scale );
+#endif
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X )
+    {
+        SX126xBusyStats_t busy;
+
+        SX126xGetBusyStats( &busy );
+        rt_kprintf( "BUSY waits %u, blocked %u, hung %u, max %u us, total %llu us\n",
+                    busy.Waits, busy.Blocked, busy.Timeouts, busy.MaxUs, ( unsigned long long )busy.TotalUs );
+    }
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X ) && defined( LORA_RADIO_DRIVER_USING_CONFIG_DIFF )
+    {
+        SX126xConfigStats_t config;
+
+        SX126xGetConfigStats( &config );
+        rt_kprintf( "configuration commands: sent %u, %u unchanged skipped (%u bytes)\n",
+                    config.Applied, config.Skipped, config.BytesSkipped );
+    }
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX127X ) && defined( LORA_RADIO_DRIVER_USING_SX127X_SHADOW_REGS )
+    {
+        SX127xShadowStats_t shadow;
+
+        SX127xGetShadowStats( &shadow );
+        rt_kprintf( "shadow registers: reads %u, %u served from RAM; writes %u, %u skipped\n",
+                    shadow.Reads, shadow.ReadsSaved, shadow.Writes, shadow.WritesSaved );
+    }
+#endif
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX127X )
+    {
+        SX127xDioStats_t dio;
+
+        SX127xGetDioStats( &dio );
+        rt_kprintf( "DIO wakeups %u; DIO0 %u (%u coalesced), DIO1 %u (%u coalesced), DIO2 %u (%u coalesced)\n",
+                    dio.Wakeups, dio.Events[0], dio.Coalesced[0], dio.Events[1], dio.Coalesced[1],
+                    dio.Events[2], dio.Coalesced[2] );
+    }
+#endif
+#ifdef LORA_RADIO_DRIVER_USING_CRITICAL_SECTION_STATS
+    {
+        LoRaRadioCriticalSectionStats_t critical;
+
+        lora_radio_critical_section_stats_get( &critical );
+        rt_kprintf( "interrupts disabled by the driver  %u times, max %u us (%s), total %llu us\n",
+                    critical.Count, critical.MaxUs, critical.MaxFunc ? critical.MaxFunc : "-",
+                    ( unsigned long long )critical.TotalUs );
+    }
+#endif
+    rt_kprintf( "timeouts %u, %s %u\n", timeouts, BENCH_SIM_VIOLATIONS_NAME, bench_sim_violations( ) );
+
+#if defined( LORA_RADIO_DRIVER_USING_LORA_CHIP_SX126X ) && defined( LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC )
+    if( queue_order_errors != 0 || queue_data_errors != 0 )
+    {
+        return 2;
+    }
+#endif
+    return ( rx_errors == 0 && timeouts == 0 && bench_sim_violations( ) == 0 ) ? 0 : 2;
+}
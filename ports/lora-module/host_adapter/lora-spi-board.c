@@ -0,0 +1,70 @@
+/*!
+ * \file      lora-spi-board.c
+ *
+ * \brief     spi device for the host build, attaches the simulated LoRa chip
+ *            on the bus instead of a physical one.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#include "lora-radio-rtos-config.h"
+
+#define LOG_TAG "LoRa.HOST.SPI"
+#define LOG_LEVEL  LOG_LVL_DBG 
+#include "lora-radio-debug.h"
+
+/*!
+ * \brief provided by the simulated module board file
+ */
+extern rt_err_t lora_radio_sim_device_attach( const char *bus_name, const char *lora_device_name );
+
+struct rt_spi_device *lora_radio_spi_init(const char *bus_name, const char *lora_device_name, rt_uint8_t param)
+{
+    rt_err_t res;
+    struct rt_spi_device *lora_radio_spi_device;
+    
+    RT_ASSERT(bus_name);
+    
+    lora_radio_spi_device = (struct rt_spi_device *)rt_device_find(lora_device_name);
+    if (!lora_radio_spi_device)
+    {
+        res = lora_radio_sim_device_attach( bus_name, lora_device_name );
+        if (res != RT_EOK)
+        {
+            LORA_RADIO_DEBUG_LOG(LR_DBG_SPI, LOG_LEVEL, "lora_radio_sim_device_attach failed!\n");
+            return RT_NULL;
+        }
+        lora_radio_spi_device = (struct rt_spi_device *)rt_device_find(lora_device_name);
+        if (!lora_radio_spi_device)
+        {
+            LORA_RADIO_DEBUG_LOG(LR_DBG_SPI, LOG_LEVEL, "cant't find %s device!\n", lora_device_name);
+            return RT_NULL;
+        }
+    }
+    
+    /* config spi */
+    {
+        struct rt_spi_configuration cfg;
+        cfg.data_width = 8;
+        cfg.mode = RT_SPI_MASTER | RT_SPI_MODE_0 | RT_SPI_MSB; /* SPI Compatible: Mode 0. */
+        cfg.max_hz = 8 * 1000000;             /* max 10M */
+        
+        res = rt_spi_configure(lora_radio_spi_device, &cfg);
+        if (res != RT_EOK)
+        {
+            LORA_RADIO_DEBUG_LOG(LR_DBG_SPI, LOG_LEVEL, "rt_spi_configure failed!\n");
+        }
+    }
+
+#if defined(BSP_SPI3_TX_USING_DMA) || defined(BSP_SPI3_RX_USING_DMA)
+    sim_spi_set_dma(lora_radio_spi_device, RT_TRUE);
+#endif
+	
+    return lora_radio_spi_device;
+} 
+
+void lora_radio_spi_deinit(struct rt_spi_device *dev)
+{
+    RT_ASSERT(dev);
+}
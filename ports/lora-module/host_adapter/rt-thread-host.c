@@ -0,0 +1,1028 @@
+/*!
+ * \file      rt-thread-host.c
+ *
+ * \brief     RT-Thread kernel, PIN and SPI subset on top of POSIX threads, so
+ *            the lora-radio driver can run unmodified against the chip models
+ *            in host_adapter/SX12XX-SIM.
+ *
+ *            Two scheduler threads drive everything that is asynchronous:
+ *            "hw" runs simulated interrupt sources (DIO edges, BUSY release)
+ *            with the interrupt lock held, "timer" runs RT_TIMER_FLAG_SOFT_TIMER
+ *            callbacks like the RT-Thread timer thread does.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+/*
+ * ============================================================================
+ * time base
+ * ============================================================================
+ */
+static uint64_t sim_now_ns(void)
+{
+    static uint64_t epoch_ns;
+    struct timespec ts;
+    uint64_t now;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    if (epoch_ns == 0)
+    {
+        epoch_ns = now;
+    }
+    return now - epoch_ns;
+}
+
+uint64_t sim_get_time_us(void)
+{
+    return sim_now_ns() / 1000;
+}
+
+static void sim_spin_until_ns(uint64_t deadline_ns)
+{
+    while (sim_now_ns() < deadline_ns);
+}
+
+static void sim_sleep_until_ns(uint64_t deadline_ns)
+{
+    struct timespec ts;
+    uint64_t now = sim_now_ns();
+
+    if (deadline_ns > now)
+    {
+        ts.tv_sec = (deadline_ns - now) / 1000000000ULL;
+        ts.tv_nsec = (deadline_ns - now) % 1000000000ULL;
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR);
+    }
+}
+
+static void sim_abstime_after_us(struct timespec *ts, uint64_t us)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += us / 1000000;
+    ts->tv_nsec += (us % 1000000) * 1000;
+    if (ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static void sim_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* wait on cond for at most timeout ticks, returns RT_ETIMEOUT on expiry */
+static rt_err_t sim_cond_wait_ticks(pthread_cond_t *cond, pthread_mutex_t *lock, rt_int32_t timeout)
+{
+    struct timespec ts;
+
+    if (timeout == RT_WAITING_FOREVER)
+    {
+        pthread_cond_wait(cond, lock);
+        return RT_EOK;
+    }
+    if (timeout == RT_WAITING_NO)
+    {
+        return -RT_ETIMEOUT;
+    }
+    sim_abstime_after_us(&ts, (uint64_t)timeout * (1000000 / RT_TICK_PER_SECOND));
+    if (pthread_cond_timedwait(cond, lock, &ts) == ETIMEDOUT)
+    {
+        return -RT_ETIMEOUT;
+    }
+    return RT_EOK;
+}
+
+rt_tick_t rt_tick_get(void)
+{
+    return (rt_tick_t)(sim_now_ns() / (1000000000ULL / RT_TICK_PER_SECOND));
+}
+
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms)
+{
+    return (rt_tick_t)(((uint64_t)ms * RT_TICK_PER_SECOND + 999) / 1000);
+}
+
+/*
+ * ============================================================================
+ * interrupt lock
+ * ============================================================================
+ */
+static pthread_mutex_t sim_irq_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static pthread_mutex_t sim_sched_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread rt_base_t sim_irq_nest;
+static __thread rt_uint8_t sim_isr_nest;
+
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    pthread_mutex_lock(&sim_irq_lock);
+    return sim_irq_nest++;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+    sim_irq_nest = level;
+    pthread_mutex_unlock(&sim_irq_lock);
+}
+
+rt_uint8_t rt_interrupt_get_nest(void)
+{
+    return sim_isr_nest;
+}
+
+void rt_enter_critical(void)
+{
+    pthread_mutex_lock(&sim_sched_lock);
+}
+
+void rt_exit_critical(void)
+{
+    pthread_mutex_unlock(&sim_sched_lock);
+}
+
+/*
+ * ============================================================================
+ * event schedulers: "hw" for simulated ISRs, "timer" for soft timers
+ * ============================================================================
+ */
+struct sim_sched
+{
+    const char *name;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t tid;
+    struct sim_hw_event *head;
+    int started;
+};
+
+static struct sim_sched sim_hw_sched = { "hw", PTHREAD_MUTEX_INITIALIZER };
+static struct sim_sched sim_timer_sched = { "timer", PTHREAD_MUTEX_INITIALIZER };
+static struct sim_sched sim_chip_sched = { "chip", PTHREAD_MUTEX_INITIALIZER };
+
+/* below this distance the schedulers spin instead of sleeping, for µs accuracy */
+#define SIM_SCHED_SPIN_US       150
+
+static void *sim_sched_entry(void *parameter)
+{
+    struct sim_sched *sched = parameter;
+    struct sim_hw_event *ev;
+    struct timespec ts;
+    uint64_t now;
+
+    pthread_mutex_lock(&sched->lock);
+    while (1)
+    {
+        ev = sched->head;
+        if (ev == RT_NULL)
+        {
+            pthread_cond_wait(&sched->cond, &sched->lock);
+            continue;
+        }
+
+        now = sim_get_time_us();
+        if (ev->expire_us > now + SIM_SCHED_SPIN_US)
+        {
+            sim_abstime_after_us(&ts, ev->expire_us - now - SIM_SCHED_SPIN_US);
+            pthread_cond_timedwait(&sched->cond, &sched->lock, &ts);
+            continue;
+        }
+        if (ev->expire_us > now)
+        {
+            pthread_mutex_unlock(&sched->lock);
+            sched_yield();
+            pthread_mutex_lock(&sched->lock);
+            continue;
+        }
+
+        sched->head = ev->next;
+        ev->next = RT_NULL;
+        ev->pending = 0;
+        pthread_mutex_unlock(&sched->lock);
+
+        if (ev->isr == SIM_HW_EVENT_ISR)
+        {
+            rt_base_t level = rt_hw_interrupt_disable();
+            sim_isr_nest++;
+            ev->handler(ev->parameter);
+            sim_isr_nest--;
+            rt_hw_interrupt_enable(level);
+        }
+        else
+        {
+            ev->handler(ev->parameter);
+        }
+
+        pthread_mutex_lock(&sched->lock);
+    }
+    return RT_NULL;
+}
+
+static struct sim_sched *sim_sched_of(struct sim_hw_event *ev)
+{
+    switch (ev->isr)
+    {
+    case SIM_HW_EVENT_ISR:
+        return &sim_hw_sched;
+    case SIM_HW_EVENT_CHIP:
+        return &sim_chip_sched;
+    default:
+        return &sim_timer_sched;
+    }
+}
+
+static void sim_sched_unlink(struct sim_sched *sched, struct sim_hw_event *ev)
+{
+    struct sim_hw_event **pp;
+
+    for (pp = &sched->head; *pp != RT_NULL; pp = &(*pp)->next)
+    {
+        if (*pp == ev)
+        {
+            *pp = ev->next;
+            ev->next = RT_NULL;
+            ev->pending = 0;
+            return;
+        }
+    }
+}
+
+void sim_hw_event_init(struct sim_hw_event *ev, void (*handler)(void *parameter),
+                       void *parameter, rt_uint8_t isr)
+{
+    memset(ev, 0, sizeof(*ev));
+    ev->handler = handler;
+    ev->parameter = parameter;
+    ev->isr = isr;
+}
+
+void sim_hw_event_schedule(struct sim_hw_event *ev, uint64_t expire_us)
+{
+    struct sim_sched *sched = sim_sched_of(ev);
+    struct sim_hw_event **pp;
+
+    pthread_mutex_lock(&sched->lock);
+    if (!sched->started)
+    {
+        sim_cond_init(&sched->cond);
+        pthread_create(&sched->tid, RT_NULL, sim_sched_entry, sched);
+        sched->started = 1;
+    }
+    if (ev->pending)
+    {
+        sim_sched_unlink(sched, ev);
+    }
+    ev->expire_us = expire_us;
+    for (pp = &sched->head; *pp != RT_NULL && (*pp)->expire_us <= expire_us; pp = &(*pp)->next);
+    ev->next = *pp;
+    *pp = ev;
+    ev->pending = 1;
+    pthread_cond_signal(&sched->cond);
+    pthread_mutex_unlock(&sched->lock);
+}
+
+void sim_hw_event_cancel(struct sim_hw_event *ev)
+{
+    struct sim_sched *sched = sim_sched_of(ev);
+
+    pthread_mutex_lock(&sched->lock);
+    if (ev->pending)
+    {
+        sim_sched_unlink(sched, ev);
+    }
+    pthread_mutex_unlock(&sched->lock);
+}
+
+/*
+ * ============================================================================
+ * thread
+ * ============================================================================
+ */
+static __thread rt_thread_t sim_thread_self;
+
+static void *sim_thread_entry(void *parameter)
+{
+    rt_thread_t thread = parameter;
+
+    sim_thread_self = thread;
+    thread->entry(thread->parameter);
+    return RT_NULL;
+}
+
+rt_err_t rt_thread_init(struct rt_thread *thread, const char *name,
+                        void (*entry)(void *parameter), void *parameter,
+                        void *stack_start, rt_uint32_t stack_size,
+                        rt_uint8_t priority, rt_uint32_t tick)
+{
+    RT_ASSERT(thread != RT_NULL);
+
+    memset(thread, 0, sizeof(*thread));
+    strncpy(thread->parent.name, name, RT_NAME_MAX - 1);
+    thread->entry = entry;
+    thread->parameter = parameter;
+    thread->current_priority = priority;
+    return RT_EOK;
+}
+
+rt_thread_t rt_thread_create(const char *name, void (*entry)(void *parameter), void *parameter,
+                             rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick)
+{
+    rt_thread_t thread = malloc(sizeof(struct rt_thread));
+
+    if (thread != RT_NULL)
+    {
+        rt_thread_init(thread, name, entry, parameter, RT_NULL, stack_size, priority, tick);
+    }
+    return thread;
+}
+
+rt_err_t rt_thread_startup(rt_thread_t thread)
+{
+    pthread_attr_t attr;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread->tid, &attr, sim_thread_entry, thread) != 0)
+    {
+        pthread_attr_destroy(&attr);
+        return -RT_ERROR;
+    }
+    pthread_attr_destroy(&attr);
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_mdelay(rt_int32_t ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR);
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_delay(rt_tick_t tick)
+{
+    return rt_thread_mdelay(tick * 1000 / RT_TICK_PER_SECOND);
+}
+
+rt_thread_t rt_thread_self(void)
+{
+    return sim_thread_self;
+}
+
+/*
+ * ============================================================================
+ * IPC
+ * ============================================================================
+ */
+rt_err_t rt_event_init(rt_event_t event, const char *name, rt_uint8_t flag)
+{
+    memset(event, 0, sizeof(*event));
+    strncpy(event->parent.name, name, RT_NAME_MAX - 1);
+    pthread_mutex_init(&event->lock, RT_NULL);
+    sim_cond_init(&event->cond);
+    return RT_EOK;
+}
+
+rt_err_t rt_event_send(rt_event_t event, rt_uint32_t set)
+{
+    pthread_mutex_lock(&event->lock);
+    event->set |= set;
+    pthread_cond_broadcast(&event->cond);
+    pthread_mutex_unlock(&event->lock);
+    return RT_EOK;
+}
+
+rt_err_t rt_event_recv(rt_event_t event, rt_uint32_t set, rt_uint8_t opt,
+                       rt_int32_t timeout, rt_uint32_t *recved)
+{
+    rt_err_t res = RT_EOK;
+    rt_uint32_t hit;
+
+    pthread_mutex_lock(&event->lock);
+    while (1)
+    {
+        hit = event->set & set;
+        if ((opt & RT_EVENT_FLAG_AND) ? (hit == set) : (hit != 0))
+        {
+            break;
+        }
+        res = sim_cond_wait_ticks(&event->cond, &event->lock, timeout);
+        if (res != RT_EOK)
+        {
+            break;
+        }
+    }
+    if (res == RT_EOK)
+    {
+        if (recved)
+        {
+            *recved = hit;
+        }
+        if (opt & RT_EVENT_FLAG_CLEAR)
+        {
+            event->set &= ~hit;
+        }
+    }
+    pthread_mutex_unlock(&event->lock);
+    return res;
+}
+
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag)
+{
+    memset(sem, 0, sizeof(*sem));
+    strncpy(sem->parent.name, name, RT_NAME_MAX - 1);
+    pthread_mutex_init(&sem->lock, RT_NULL);
+    sim_cond_init(&sem->cond);
+    sem->value = value;
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_detach(rt_sem_t sem)
+{
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
+{
+    rt_err_t res = RT_EOK;
+
+    pthread_mutex_lock(&sem->lock);
+    while (sem->value == 0 && res == RT_EOK)
+    {
+        res = sim_cond_wait_ticks(&sem->cond, &sem->lock, time);
+    }
+    if (sem->value > 0)
+    {
+        sem->value--;
+        res = RT_EOK;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return res;
+}
+
+rt_err_t rt_sem_trytake(rt_sem_t sem)
+{
+    return rt_sem_take(sem, RT_WAITING_NO);
+}
+
+rt_err_t rt_sem_release(rt_sem_t sem)
+{
+    pthread_mutex_lock(&sem->lock);
+    sem->value++;
+    pthread_cond_signal(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag)
+{
+    pthread_mutexattr_t attr;
+
+    memset(mutex, 0, sizeof(*mutex));
+    strncpy(mutex->parent.name, name, RT_NAME_MAX - 1);
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mutex->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
+{
+    if (time == RT_WAITING_NO)
+    {
+        return pthread_mutex_trylock(&mutex->lock) == 0 ? RT_EOK : -RT_ETIMEOUT;
+    }
+    pthread_mutex_lock(&mutex->lock);
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_release(rt_mutex_t mutex)
+{
+    pthread_mutex_unlock(&mutex->lock);
+    return RT_EOK;
+}
+
+rt_err_t rt_mq_init(rt_mq_t mq, const char *name, void *msgpool, rt_size_t msg_size,
+                    rt_size_t pool_size, rt_uint8_t flag)
+{
+    memset(mq, 0, sizeof(*mq));
+    strncpy(mq->parent.name, name, RT_NAME_MAX - 1);
+    pthread_mutex_init(&mq->lock, RT_NULL);
+    sim_cond_init(&mq->cond);
+    mq->msg_pool = msgpool;
+    mq->msg_size = msg_size;
+    mq->max_msgs = pool_size / msg_size;
+    return RT_EOK;
+}
+
+rt_err_t rt_mq_send(rt_mq_t mq, const void *buffer, rt_size_t size)
+{
+    rt_size_t tail;
+
+    if (size > mq->msg_size)
+    {
+        return -RT_ERROR;
+    }
+    pthread_mutex_lock(&mq->lock);
+    if (mq->entry >= mq->max_msgs)
+    {
+        pthread_mutex_unlock(&mq->lock);
+        return -RT_EFULL;
+    }
+    tail = (mq->head + mq->entry) % mq->max_msgs;
+    memcpy(mq->msg_pool + tail * mq->msg_size, buffer, size);
+    mq->entry++;
+    pthread_cond_signal(&mq->cond);
+    pthread_mutex_unlock(&mq->lock);
+    return RT_EOK;
+}
+
+rt_err_t rt_mq_recv(rt_mq_t mq, void *buffer, rt_size_t size, rt_int32_t timeout)
+{
+    rt_err_t res = RT_EOK;
+
+    pthread_mutex_lock(&mq->lock);
+    while (mq->entry == 0 && res == RT_EOK)
+    {
+        res = sim_cond_wait_ticks(&mq->cond, &mq->lock, timeout);
+    }
+    if (mq->entry > 0)
+    {
+        memcpy(buffer, mq->msg_pool + mq->head * mq->msg_size, size < mq->msg_size ? size : mq->msg_size);
+        mq->head = (mq->head + 1) % mq->max_msgs;
+        mq->entry--;
+        res = RT_EOK;
+    }
+    pthread_mutex_unlock(&mq->lock);
+    return res;
+}
+
+/*
+ * ============================================================================
+ * timer
+ * ============================================================================
+ */
+static void sim_timer_timeout(void *parameter)
+{
+    rt_timer_t timer = parameter;
+
+    if (timer->flag & RT_TIMER_FLAG_PERIODIC)
+    {
+        sim_hw_event_schedule(&timer->hw, timer->hw.expire_us +
+                              (uint64_t)timer->init_tick * (1000000 / RT_TICK_PER_SECOND));
+    }
+    else
+    {
+        timer->flag &= ~RT_TIMER_FLAG_ACTIVATED;
+    }
+    timer->timeout_func(timer->parameter);
+}
+
+void rt_timer_init(rt_timer_t timer, const char *name, void (*timeout)(void *parameter),
+                   void *parameter, rt_tick_t time, rt_uint8_t flag)
+{
+    memset(timer, 0, sizeof(*timer));
+    strncpy(timer->parent.name, name, RT_NAME_MAX - 1);
+    timer->timeout_func = timeout;
+    timer->parameter = parameter;
+    timer->init_tick = time;
+    timer->flag = flag & ~RT_TIMER_FLAG_ACTIVATED;
+    /* hard timers run in interrupt context on the target */
+    sim_hw_event_init(&timer->hw, sim_timer_timeout, timer,
+                      (flag & RT_TIMER_FLAG_SOFT_TIMER) ? SIM_HW_EVENT_SOFT : SIM_HW_EVENT_ISR);
+}
+
+rt_err_t rt_timer_start(rt_timer_t timer)
+{
+    const uint64_t tick_us = 1000000 / RT_TICK_PER_SECOND;
+
+    timer->flag |= RT_TIMER_FLAG_ACTIVATED;
+    /* as the kernel, the timeout is counted from the current tick and fires on a tick interrupt */
+    sim_hw_event_schedule(&timer->hw, (sim_get_time_us() / tick_us + timer->init_tick) * tick_us);
+    return RT_EOK;
+}
+
+rt_err_t rt_timer_stop(rt_timer_t timer)
+{
+    if (!(timer->flag & RT_TIMER_FLAG_ACTIVATED))
+    {
+        return -RT_ERROR;
+    }
+    timer->flag &= ~RT_TIMER_FLAG_ACTIVATED;
+    sim_hw_event_cancel(&timer->hw);
+    return RT_EOK;
+}
+
+rt_err_t rt_timer_control(rt_timer_t timer, int cmd, void *arg)
+{
+    switch (cmd)
+    {
+    case RT_TIMER_CTRL_SET_TIME:
+        timer->init_tick = *(rt_tick_t *)arg;
+        break;
+    case RT_TIMER_CTRL_GET_TIME:
+        *(rt_tick_t *)arg = timer->init_tick;
+        break;
+    case RT_TIMER_CTRL_SET_ONESHOT:
+        timer->flag &= ~RT_TIMER_FLAG_PERIODIC;
+        break;
+    case RT_TIMER_CTRL_SET_PERIODIC:
+        timer->flag |= RT_TIMER_FLAG_PERIODIC;
+        break;
+    default:
+        return -RT_EINVAL;
+    }
+    return RT_EOK;
+}
+
+/*
+ * ============================================================================
+ * PIN
+ * ============================================================================
+ */
+struct sim_pin
+{
+    rt_uint8_t mode;
+    rt_uint8_t out;
+    rt_uint8_t in;
+    rt_uint8_t irq_mode;
+    rt_uint8_t irq_enabled;
+    void (*hdr)(void *args);
+    void *args;
+    int (*reader)(void *ctx);
+    void *reader_ctx;
+    void (*writer)(void *ctx, rt_base_t value);
+    void *writer_ctx;
+};
+
+static struct sim_pin sim_pins[SIM_PIN_MAX];
+
+void rt_pin_mode(rt_base_t pin, rt_base_t mode)
+{
+    RT_ASSERT(pin >= 0 && pin < SIM_PIN_MAX);
+
+    sim_pins[pin].mode = mode;
+    /* an input with pull-up reads (and drives an open drain line) high */
+    if (mode == PIN_MODE_INPUT || mode == PIN_MODE_INPUT_PULLUP)
+    {
+        if (sim_pins[pin].writer)
+        {
+            sim_pins[pin].writer(sim_pins[pin].writer_ctx, PIN_HIGH);
+        }
+    }
+}
+
+void rt_pin_write(rt_base_t pin, rt_base_t value)
+{
+    RT_ASSERT(pin >= 0 && pin < SIM_PIN_MAX);
+
+    sim_pins[pin].out = value ? PIN_HIGH : PIN_LOW;
+    if (sim_pins[pin].writer)
+    {
+        sim_pins[pin].writer(sim_pins[pin].writer_ctx, sim_pins[pin].out);
+    }
+}
+
+int rt_pin_read(rt_base_t pin)
+{
+    RT_ASSERT(pin >= 0 && pin < SIM_PIN_MAX);
+
+    if (sim_pins[pin].reader)
+    {
+        return sim_pins[pin].reader(sim_pins[pin].reader_ctx);
+    }
+    if (sim_pins[pin].mode == PIN_MODE_OUTPUT || sim_pins[pin].mode == PIN_MODE_OUTPUT_OD)
+    {
+        return sim_pins[pin].out;
+    }
+    return sim_pins[pin].in;
+}
+
+rt_err_t rt_pin_attach_irq(rt_int32_t pin, rt_uint32_t mode,
+                           void (*hdr)(void *args), void *args)
+{
+    RT_ASSERT(pin >= 0 && pin < SIM_PIN_MAX);
+
+    sim_pins[pin].irq_mode = mode;
+    sim_pins[pin].hdr = hdr;
+    sim_pins[pin].args = args;
+    return RT_EOK;
+}
+
+rt_err_t rt_pin_detach_irq(rt_int32_t pin)
+{
+    RT_ASSERT(pin >= 0 && pin < SIM_PIN_MAX);
+
+    sim_pins[pin].irq_enabled = 0;
+    sim_pins[pin].hdr = RT_NULL;
+    return RT_EOK;
+}
+
+rt_err_t rt_pin_irq_enable(rt_base_t pin, rt_uint32_t enabled)
+{
+    RT_ASSERT(pin >= 0 && pin < SIM_PIN_MAX);
+
+    sim_pins[pin].irq_enabled = enabled;
+    return RT_EOK;
+}
+
+void sim_pin_set_input(rt_base_t pin, rt_base_t value)
+{
+    struct sim_pin *p;
+    rt_uint8_t old;
+    int fire = 0;
+
+    RT_ASSERT(pin >= 0 && pin < SIM_PIN_MAX);
+
+    p = &sim_pins[pin];
+    old = p->in;
+    p->in = value ? PIN_HIGH : PIN_LOW;
+
+    if (!p->irq_enabled || p->hdr == RT_NULL)
+    {
+        return;
+    }
+    switch (p->irq_mode)
+    {
+    case PIN_IRQ_MODE_RISING:
+        fire = (old == PIN_LOW && p->in == PIN_HIGH);
+        break;
+    case PIN_IRQ_MODE_FALLING:
+        fire = (old == PIN_HIGH && p->in == PIN_LOW);
+        break;
+    case PIN_IRQ_MODE_RISING_FALLING:
+        fire = (old != p->in);
+        break;
+    case PIN_IRQ_MODE_HIGH_LEVEL:
+        fire = (p->in == PIN_HIGH);
+        break;
+    case PIN_IRQ_MODE_LOW_LEVEL:
+        fire = (p->in == PIN_LOW);
+        break;
+    }
+    if (fire)
+    {
+        rt_base_t level = rt_hw_interrupt_disable();
+        sim_isr_nest++;
+        p->hdr(p->args);
+        sim_isr_nest--;
+        rt_hw_interrupt_enable(level);
+    }
+}
+
+void sim_pin_set_reader(rt_base_t pin, int (*reader)(void *ctx), void *ctx)
+{
+    RT_ASSERT(pin >= 0 && pin < SIM_PIN_MAX);
+
+    sim_pins[pin].reader = reader;
+    sim_pins[pin].reader_ctx = ctx;
+}
+
+void sim_pin_set_writer(rt_base_t pin, void (*writer)(void *ctx, rt_base_t value), void *ctx)
+{
+    RT_ASSERT(pin >= 0 && pin < SIM_PIN_MAX);
+
+    sim_pins[pin].writer = writer;
+    sim_pins[pin].writer_ctx = ctx;
+}
+
+/*
+ * ============================================================================
+ * SPI
+ * ============================================================================
+ */
+#define SIM_SPI_DEVICE_MAX      8
+
+static struct rt_spi_device *sim_spi_devices[SIM_SPI_DEVICE_MAX];
+
+rt_err_t sim_spi_device_register(struct rt_spi_device *device, const char *name,
+                                 const struct sim_spi_ops *ops, void *user_data)
+{
+    pthread_mutexattr_t attr;
+    int i;
+
+    for (i = 0; i < SIM_SPI_DEVICE_MAX; i++)
+    {
+        if (sim_spi_devices[i] == RT_NULL || sim_spi_devices[i] == device)
+        {
+            memset(device, 0, sizeof(*device));
+            strncpy(device->parent.name, name, RT_NAME_MAX - 1);
+            device->ops = ops;
+            device->user_data = user_data;
+            device->config.max_hz = 8 * 1000000;
+            pthread_mutexattr_init(&attr);
+            pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+            pthread_mutex_init(&device->bus_lock, &attr);
+            pthread_mutexattr_destroy(&attr);
+            sim_spi_devices[i] = device;
+            return RT_EOK;
+        }
+    }
+    return -RT_EFULL;
+}
+
+void sim_spi_reset_stats(struct rt_spi_device *device)
+{
+    memset(&device->stats, 0, sizeof(device->stats));
+}
+
+void sim_spi_set_dma(struct rt_spi_device *device, rt_bool_t enable)
+{
+    device->dma = enable;
+}
+
+void *rt_device_find(const char *name)
+{
+    int i;
+
+    for (i = 0; i < SIM_SPI_DEVICE_MAX; i++)
+    {
+        if (sim_spi_devices[i] && strncmp(sim_spi_devices[i]->parent.name, name, RT_NAME_MAX - 1) == 0)
+        {
+            return sim_spi_devices[i];
+        }
+    }
+    return RT_NULL;
+}
+
+rt_err_t rt_spi_configure(struct rt_spi_device *device, struct rt_spi_configuration *cfg)
+{
+    RT_ASSERT(device != RT_NULL);
+
+    device->config = *cfg;
+    return RT_EOK;
+}
+
+rt_err_t rt_spi_take_bus(struct rt_spi_device *device)
+{
+    pthread_mutex_lock(&device->bus_lock);
+    return RT_EOK;
+}
+
+rt_err_t rt_spi_release_bus(struct rt_spi_device *device)
+{
+    pthread_mutex_unlock(&device->bus_lock);
+    return RT_EOK;
+}
+
+rt_err_t rt_spi_take(struct rt_spi_device *device)
+{
+    if (!device->cs_active)
+    {
+        device->cs_active = RT_TRUE;
+        device->stats.transactions++;
+        device->ops->cs(device, RT_TRUE);
+    }
+    return RT_EOK;
+}
+
+rt_err_t rt_spi_release(struct rt_spi_device *device)
+{
+    if (device->cs_active)
+    {
+        device->cs_active = RT_FALSE;
+        device->ops->cs(device, RT_FALSE);
+    }
+    return RT_EOK;
+}
+
+struct rt_spi_message *rt_spi_transfer_message(struct rt_spi_device *device,
+                                               struct rt_spi_message *message)
+{
+    const rt_uint8_t *send;
+    rt_uint8_t *recv;
+    rt_uint8_t in;
+    uint64_t start_ns, wire_ns;
+    rt_size_t i;
+
+    RT_ASSERT(device != RT_NULL);
+
+    pthread_mutex_lock(&device->bus_lock);
+    for (; message != RT_NULL; message = message->next)
+    {
+        if (message->cs_take)
+        {
+            rt_spi_take(device);
+        }
+
+        start_ns = sim_now_ns();
+        send = message->send_buf;
+        recv = message->recv_buf;
+        for (i = 0; i < message->length; i++)
+        {
+            in = device->ops->xfer(device, send ? send[i] : 0x00);
+            if (recv)
+            {
+                recv[i] = in;
+            }
+        }
+        device->stats.bytes += message->length;
+
+        /* account for the time the bytes spend on the wire */
+        wire_ns = (uint64_t)message->length * 8 * 1000000000ULL / device->config.max_hz;
+        device->stats.wire_time_us += wire_ns / 1000;
+        if (device->dma && message->length >= SIM_SPI_DMA_MIN_LEN)
+        {
+            device->stats.dma_transfers++;
+            sim_sleep_until_ns(start_ns + wire_ns);
+        }
+        else
+        {
+            sim_spin_until_ns(start_ns + wire_ns);
+        }
+
+        if (message->cs_release)
+        {
+            rt_spi_release(device);
+        }
+    }
+    pthread_mutex_unlock(&device->bus_lock);
+
+    return RT_NULL;
+}
+
+rt_size_t rt_spi_transfer(struct rt_spi_device *device, const void *send_buf,
+                          void *recv_buf, rt_size_t length)
+{
+    struct rt_spi_message message;
+
+    message.send_buf = send_buf;
+    message.recv_buf = recv_buf;
+    message.length = length;
+    message.next = RT_NULL;
+    message.cs_take = 1;
+    message.cs_release = 1;
+    rt_spi_transfer_message(device, &message);
+    return length;
+}
+
+rt_err_t rt_spi_send_then_send(struct rt_spi_device *device,
+                               const void *send_buf1, rt_size_t send_length1,
+                               const void *send_buf2, rt_size_t send_length2)
+{
+    struct rt_spi_message message[2];
+
+    message[0].send_buf = send_buf1;
+    message[0].recv_buf = RT_NULL;
+    message[0].length = send_length1;
+    message[0].next = &message[1];
+    message[0].cs_take = 1;
+    message[0].cs_release = 0;
+
+    message[1].send_buf = send_buf2;
+    message[1].recv_buf = RT_NULL;
+    message[1].length = send_length2;
+    message[1].next = RT_NULL;
+    message[1].cs_take = 0;
+    message[1].cs_release = 1;
+
+    rt_spi_transfer_message(device, &message[0]);
+    return RT_EOK;
+}
+
+rt_err_t rt_spi_send_then_recv(struct rt_spi_device *device,
+                               const void *send_buf, rt_size_t send_length,
+                               void *recv_buf, rt_size_t recv_length)
+{
+    struct rt_spi_message message[2];
+
+    message[0].send_buf = send_buf;
+    message[0].recv_buf = RT_NULL;
+    message[0].length = send_length;
+    message[0].next = &message[1];
+    message[0].cs_take = 1;
+    message[0].cs_release = 0;
+
+    message[1].send_buf = RT_NULL;
+    message[1].recv_buf = recv_buf;
+    message[1].length = recv_length;
+    message[1].next = RT_NULL;
+    message[1].cs_take = 0;
+    message[1].cs_release = 1;
+
+    rt_spi_transfer_message(device, &message[0]);
+    return RT_EOK;
+}
@@ -62,6 +62,33 @@
     #endif
 #endif // end of LORA_RADIO_GPIO_SETUP_BY_PIN_NAME
 
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+/*!
+ * Several radios: the pins are the ones of the instance the driver works on,
+ * see lora_radio_hw[] and lora_radio_lock()
+ */
+#undef  LORA_RADIO_NSS_PIN
+#define LORA_RADIO_NSS_PIN   ( lora_radio_current( )->Hw->NssPin )
+#undef  LORA_RADIO_RESET_PIN
+#define LORA_RADIO_RESET_PIN ( lora_radio_current( )->Hw->ResetPin )
+#undef  LORA_RADIO_BUSY_PIN
+#define LORA_RADIO_BUSY_PIN  ( lora_radio_current( )->Hw->BusyPin )
+#undef  LORA_RADIO_DIO1_PIN
+#define LORA_RADIO_DIO1_PIN  ( lora_radio_current( )->Hw->DioPins[1] )
+#ifdef LORA_RADIO_DIO2_PIN
+#undef  LORA_RADIO_DIO2_PIN
+#define LORA_RADIO_DIO2_PIN  ( lora_radio_current( )->Hw->DioPins[2] )
+#endif
+#ifdef LORA_RADIO_RFSW1_PIN
+#undef  LORA_RADIO_RFSW1_PIN
+#define LORA_RADIO_RFSW1_PIN ( lora_radio_current( )->Hw->RfSw1Pin )
+#endif
+#ifdef LORA_RADIO_RFSW2_PIN
+#undef  LORA_RADIO_RFSW2_PIN
+#define LORA_RADIO_RFSW2_PIN ( lora_radio_current( )->Hw->RfSw2Pin )
+#endif
+#endif
+
 /*!
  * Defines the time required for the TCXO to wakeup [ms].
  */
@@ -104,10 +131,144 @@ void SX126xIoDbgInit( void );
 void SX126xReset( void );
 
 /*!
- * \brief Blocking loop to wait while the Busy pin in high
+ * \brief Time spent waiting on the BUSY line, see SX126xGetBusyStats()
+ */
+typedef struct
+{
+    uint32_t Waits;         //!< SX126xWaitOnBusy calls
+    uint32_t Blocked;       //!< waits that blocked on the BUSY falling edge instead of polling
+    uint32_t Timeouts;      //!< BUSY still high after SX126X_BUSY_TIMEOUT, chip hung
+    uint32_t MaxUs;         //!< longest wait
+    uint64_t TotalUs;       //!< cumulated wait time
+}SX126xBusyStats_t;
+
+/*!
+ * \brief Waits while the Busy pin is high: polls a few times, then blocks on
+ *        the BUSY falling edge interrupt up to SX126X_BUSY_TIMEOUT
  */
 void SX126xWaitOnBusy( void );
 
+/*!
+ * \brief Gets / clears the BUSY wait statistics
+ */
+void SX126xGetBusyStats( SX126xBusyStats_t *stats );
+void SX126xResetBusyStats( void );
+
+/*!
+ * Size of the batch buffer: SetDioIrqParams, SetPacketParams, a 255-byte
+ * WriteBuffer and SetTx fit, which is RadioSend's sequence
+ */
+#ifndef SX126X_BATCH_BUFFER_SIZE
+#define SX126X_BATCH_BUFFER_SIZE                        288
+#endif
+#ifndef SX126X_BATCH_MAX_COMMANDS
+#define SX126X_BATCH_MAX_COMMANDS                       12
+#endif
+
+/*!
+ * \brief Write commands captured between SX126xBatchBegin() and SX126xBatchEnd()
+ */
+typedef struct
+{
+    uint8_t Buffer[SX126X_BATCH_BUFFER_SIZE];           //!< encoded commands, back to back
+    uint16_t End[SX126X_BATCH_MAX_COMMANDS];            //!< end offset of each command in Buffer
+    uint8_t Count;
+    rt_thread_t Owner;                                  //!< thread whose accesses are captured
+    struct
+    {
+        uint32_t Runs;                                  //!< times the buffer was sent
+        uint32_t Commands;                              //!< commands sent from the buffer
+    }Stats;
+}SX126xBatch_t;
+
+/*!
+ * \brief Starts capturing the write accesses of the calling thread
+ *        (SX126xWriteCommand, SX126xWriteRegisters, SX126xWriteBuffer) into
+ *        \a batch instead of sending them one by one.
+ *
+ *        A read access sends the captured commands first, a full buffer is
+ *        sent and reused, so the order on the bus is always the call order.
+ */
+void SX126xBatchBegin( SX126xBatch_t *batch );
+
+/*!
+ * \brief Sends the captured commands back to back, one BUSY wait before
+ *        each, and stops capturing
+ */
+void SX126xBatchEnd( SX126xBatch_t *batch );
+
+#ifdef LORA_RADIO_DRIVER_USING_SX126X_SPI_ASYNC
+/*!
+ * Command parameters and register data up to this size are copied into the
+ * transaction, larger payloads are sent from the caller's buffer
+ */
+#define SX126X_SPI_XFER_INLINE_SIZE                     12
+
+/*!
+ * \brief One SPI transaction of the asynchronous queue, see SX126xSpiSubmit()
+ *
+ * \remark The structure and the buffers it refers to belong to the queue
+ *         until its Done callback ran
+ */
+typedef struct SX126xSpiXfer_s
+{
+    uint8_t Header[SX126X_SPI_XFER_INLINE_SIZE];        //!< opcode, address / offset and inlined data
+    uint8_t HeaderSize;
+    const uint8_t *TxBuffer;                            //!< data sent after the header
+    uint8_t *RxBuffer;                                  //!< data read after the header
+    uint16_t Size;                                      //!< size of TxBuffer / RxBuffer
+    void ( *Done )( struct SX126xSpiXfer_s *xfer, void *arg ); //!< called on the SPI thread once the transfer ended
+    void *Arg;
+    struct SX126xSpiXfer_s *Next;                       //!< next transaction of the chain
+
+    /* private, used by the queue */
+    struct SX126xSpiXfer_s *QueueNext;
+    struct rt_spi_message Msg[2];
+}SX126xSpiXfer_t;
+
+/*!
+ * \brief Asynchronous SPI queue counters, see SX126xGetSpiQueueStats()
+ */
+typedef struct
+{
+    uint32_t Chains;        //!< SX126xSpiSubmit calls
+    uint32_t Submitted;     //!< transactions submitted
+    uint32_t Completed;     //!< transactions whose Done callback returned
+    uint32_t Depth;         //!< transactions queued or in flight
+    uint32_t MaxDepth;      //!< high-water mark of Depth
+}SX126xSpiQueueStats_t;
+
+/*!
+ * \brief Fill \a xfer with a command, a register write, a data buffer write or read.
+ *        Done, Arg and Next are cleared.
+ */
+void SX126xSpiPrepareCommand( SX126xSpiXfer_t *xfer, RadioCommands_t opcode, const uint8_t *buffer, uint16_t size );
+void SX126xSpiPrepareWriteRegisters( SX126xSpiXfer_t *xfer, uint16_t address, const uint8_t *buffer, uint16_t size );
+void SX126xSpiPrepareWriteBuffer( SX126xSpiXfer_t *xfer, uint8_t offset, const uint8_t *buffer, uint8_t size );
+void SX126xSpiPrepareReadBuffer( SX126xSpiXfer_t *xfer, uint8_t offset, uint8_t *buffer, uint8_t size );
+
+/*!
+ * \brief Queues the chain \a xfer -> Next -> ... and returns at once.
+ *
+ *        The SPI thread runs the transactions back to back in submission
+ *        order, each one after BUSY went low, and calls their Done callback.
+ *        A chain is never interleaved with another one.
+ */
+void SX126xSpiSubmit( SX126xSpiXfer_t *xfer );
+
+/*!
+ * \brief Waits until every submitted transaction completed. The synchronous
+ *        accessors below call it first, so they never overtake the queue.
+ */
+void SX126xSpiFlush( void );
+
+/*!
+ * \brief Gets / clears the asynchronous SPI queue counters
+ */
+void SX126xGetSpiQueueStats( SX126xSpiQueueStats_t *stats );
+void SX126xResetSpiQueueStats( void );
+#endif
+
 /*!
  * \brief Wakes up the radio
  */
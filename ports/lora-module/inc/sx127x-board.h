@@ -28,7 +28,7 @@
 #include "lora-radio-rtos-config.h"
 #include <stdint.h>
 #include <stdbool.h>
-#include "SX127x/SX127x.h"
+#include "sx127x/sx127x.h"
 
 #ifdef LORA_RADIO_GPIO_SETUP_BY_PIN_NAME
     #define LORA_RADIO_NSS_PIN       stm32_pin_get(LORA_RADIO_NSS_PIN_NAME)
@@ -41,13 +41,13 @@
     #define LORA_RADIO_DIO2_PIN      stm32_pin_get(LORA_RADIO_DIO2_PIN_NAME)
     #endif
     #if defined( LORA_RADIO_DIO3_PIN_NAME ) 
-    #define LORA_RADIO_DIO1_PIN      stm32_pin_get(LORA_RADIO_DIO3_PIN_NAME)
+    #define LORA_RADIO_DIO3_PIN      stm32_pin_get(LORA_RADIO_DIO3_PIN_NAME)
     #endif
     #if defined( LORA_RADIO_DIO4_PIN_NAME ) 
-    #define LORA_RADIO_DIO2_PIN      stm32_pin_get(LORA_RADIO_DIO4_PIN_NAME)
+    #define LORA_RADIO_DIO4_PIN      stm32_pin_get(LORA_RADIO_DIO4_PIN_NAME)
     #endif
     #if defined( LORA_RADIO_DIO5_PIN_NAME ) 
-    #define LORA_RADIO_DIO1_PIN      stm32_pin_get(LORA_RADIO_DIO5_PIN_NAME)
+    #define LORA_RADIO_DIO5_PIN      stm32_pin_get(LORA_RADIO_DIO5_PIN_NAME)
     #endif
     #if defined( LORA_RADIO_RFSW1_PIN_NAME ) && defined ( LORA_RADIO_RFSW2_PIN_NAME )  
     #define LORA_RADIO_RFSW1_PIN     stm32_pin_get(LORA_RADIO_RFSW1_PIN_NAME)
@@ -69,10 +69,41 @@
 
 #endif // end of LORA_RADIO_GPIO_SETUP_BY_PIN_NAME
 
+#if LORA_RADIO_DRIVER_INSTANCE_NUM > 1
+/*!
+ * Several radios: the pins are the ones of the instance the driver works on,
+ * see lora_radio_hw[] and lora_radio_lock()
+ */
+#undef  LORA_RADIO_NSS_PIN
+#define LORA_RADIO_NSS_PIN   ( lora_radio_current( )->Hw->NssPin )
+#undef  LORA_RADIO_RESET_PIN
+#define LORA_RADIO_RESET_PIN ( lora_radio_current( )->Hw->ResetPin )
+#undef  LORA_RADIO_DIO0_PIN
+#define LORA_RADIO_DIO0_PIN  ( lora_radio_current( )->Hw->DioPins[0] )
+#undef  LORA_RADIO_DIO1_PIN
+#define LORA_RADIO_DIO1_PIN  ( lora_radio_current( )->Hw->DioPins[1] )
+#undef  LORA_RADIO_DIO2_PIN
+#define LORA_RADIO_DIO2_PIN  ( lora_radio_current( )->Hw->DioPins[2] )
+#undef  LORA_RADIO_DIO3_PIN
+#define LORA_RADIO_DIO3_PIN  ( lora_radio_current( )->Hw->DioPins[3] )
+#undef  LORA_RADIO_DIO4_PIN
+#define LORA_RADIO_DIO4_PIN  ( lora_radio_current( )->Hw->DioPins[4] )
+#undef  LORA_RADIO_DIO5_PIN
+#define LORA_RADIO_DIO5_PIN  ( lora_radio_current( )->Hw->DioPins[5] )
+#ifdef LORA_RADIO_RFSW1_PIN
+#undef  LORA_RADIO_RFSW1_PIN
+#define LORA_RADIO_RFSW1_PIN ( lora_radio_current( )->Hw->RfSw1Pin )
+#endif
+#ifdef LORA_RADIO_RFSW2_PIN
+#undef  LORA_RADIO_RFSW2_PIN
+#define LORA_RADIO_RFSW2_PIN ( lora_radio_current( )->Hw->RfSw2Pin )
+#endif
+#endif
+
 /*!
  * \brief delayms for radio access
  */
-#define DelayMs(x) 
+#define DelayMs( ms ) rt_thread_mdelay(ms)
 /*!
  * \brief Radio hardware registers initialization definition
  *
@@ -178,6 +209,13 @@ void SX127xSetAntSw( uint8_t opMode );
  */
 bool SX127xCheckRfFrequency( uint32_t frequency );
 
+/*!
+ * \brief Gets current state of DIO1 pin state.
+ *
+ * \retval state DIO1 pin current state.
+ */
+uint32_t SX127xGetDio1PinState( void );
+
 /*!
  * \brief Enables/disables the TCXO if available on board design.
  *
@@ -211,9 +249,4 @@ void SX127xDbgPinRxWrite( uint8_t state );
 int stm32_pin_get(char *pin_name);
 #endif
 
-/*!
- * Radio hardware and global parameters
- */
-extern SX127x_t SX127x;
-
 #endif // __SX127x_BOARD_H__
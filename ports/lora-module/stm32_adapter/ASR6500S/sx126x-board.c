@@ -22,7 +22,7 @@ void SX126xIoInit( void )
 void SX126xIoIrqInit( DioIrqHandler dioIrq )
 {
     rt_pin_mode(LORA_RADIO_DIO1_PIN, PIN_MODE_INPUT);
-    rt_pin_attach_irq(LORA_RADIO_DIO1_PIN, PIN_IRQ_MODE_RISING, RadioOnDioIrq,(void*)"callback args");
+    rt_pin_attach_irq(LORA_RADIO_DIO1_PIN, PIN_IRQ_MODE_RISING, RadioOnDioIrq, lora_radio_current( ));
     rt_pin_irq_enable(LORA_RADIO_DIO1_PIN, PIN_IRQ_ENABLE);
 }
 
@@ -57,11 +57,6 @@ void SX126xReset( void )
     DelayMs( 20 );
 }
 
-void SX126xWaitOnBusy( void )
-{
-    while( rt_pin_read( LORA_RADIO_BUSY_PIN ) == PIN_HIGH );
-}
-
 void SX126xAntSwOn( void )
 {
 }
@@ -115,15 +115,15 @@ void SX127xIoIrqInit( DioIrqHandler **irqHandlers )
 {
 #ifdef LORA_RADIO_DRIVER_USING_ON_RTOS_RT_THREAD
         #ifdef LORA_RADIO_DIO0_PIN
-        rt_pin_attach_irq(LORA_RADIO_DIO0_PIN, PIN_IRQ_MODE_RISING,SX127xOnDio0IrqEvent,(void*)"rf-dio0-int");
+        rt_pin_attach_irq(LORA_RADIO_DIO0_PIN, PIN_IRQ_MODE_RISING,SX127xOnDio0IrqEvent, lora_radio_current( ));
         rt_pin_irq_enable(LORA_RADIO_DIO0_PIN, PIN_IRQ_ENABLE);    
         #endif
         #ifdef LORA_RADIO_DIO1_PIN
-        rt_pin_attach_irq(LORA_RADIO_DIO1_PIN, PIN_IRQ_MODE_RISING,SX127xOnDio1IrqEvent,(void*)"rf-dio1-int");
+        rt_pin_attach_irq(LORA_RADIO_DIO1_PIN, PIN_IRQ_MODE_RISING,SX127xOnDio1IrqEvent, lora_radio_current( ));
         rt_pin_irq_enable(LORA_RADIO_DIO1_PIN, PIN_IRQ_ENABLE);    
         #endif
         #ifdef LORA_RADIO_DIO2_PIN
-        rt_pin_attach_irq(LORA_RADIO_DIO2_PIN, PIN_IRQ_MODE_RISING,SX127xOnDio2IrqEvent,(void*)"rf-dio2-int");
+        rt_pin_attach_irq(LORA_RADIO_DIO2_PIN, PIN_IRQ_MODE_RISING,SX127xOnDio2IrqEvent, lora_radio_current( ));
         rt_pin_irq_enable(LORA_RADIO_DIO2_PIN, PIN_IRQ_ENABLE);    
         #endif
 #else
@@ -295,4 +295,9 @@ bool SX127xCheckRfFrequency( uint32_t frequency )
     return true; 
 }
 
+uint32_t SX127xGetDio1PinState( void )
+{
+    return rt_pin_read( LORA_RADIO_DIO1_PIN );
+}
+
 
@@ -0,0 +1,96 @@
+/*!
+ * \file      lora-hrtimer-board.c
+ *
+ * \brief     compare interrupt of the high resolution driver timers on a
+ *            32 bits general purpose timer counting at 1 MHz (TIM2 by default).
+ *
+ *            The board rtconfig.h maps the driver time base on its counter:
+ *            #define LORA_RADIO_TIMESTAMP_US( ) ( LORA_RADIO_HRTIMER_TIM->CNT )
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * \author    Forest-Rain
+ */
+#include "lora-radio-rtos-config.h"
+#include "lora-radio.h"
+#include "lora-radio-timer.h"
+#include <board.h>
+
+#ifdef LORA_RADIO_DRIVER_USING_HRTIMER
+
+#ifdef LORA_RADIO_TIMESTAMP_US_FROM_TICK
+    #error "LORA_RADIO_DRIVER_USING_HRTIMER needs LORA_RADIO_TIMESTAMP_US( ) mapped on LORA_RADIO_HRTIMER_TIM->CNT in rtconfig.h"
+#endif
+
+#define LOG_TAG "LoRa.STM32.HRTIMER"
+#define LOG_LEVEL  LOG_LVL_DBG
+#include "lora-radio-debug.h"
+
+#ifndef LORA_RADIO_HRTIMER_TIM
+#define LORA_RADIO_HRTIMER_TIM                      TIM2
+#define LORA_RADIO_HRTIMER_IRQn                     TIM2_IRQn
+#define LORA_RADIO_HRTIMER_IRQHandler               TIM2_IRQHandler
+#define LORA_RADIO_HRTIMER_CLK_ENABLE( )            __HAL_RCC_TIM2_CLK_ENABLE( )
+#endif
+
+static TIM_HandleTypeDef lora_hrtimer_tim;
+
+static int lora_radio_hrtimer_port_init( void )
+{
+    uint32_t clock = HAL_RCC_GetPCLK1Freq( );
+
+    // APB1 timers run at twice PCLK1 when APB1 is divided
+    if( ( RCC->CFGR & RCC_CFGR_PPRE1 ) != RCC_CFGR_PPRE1_DIV1 )
+    {
+        clock *= 2;
+    }
+    LORA_RADIO_HRTIMER_CLK_ENABLE( );
+    lora_hrtimer_tim.Instance = LORA_RADIO_HRTIMER_TIM;
+    lora_hrtimer_tim.Init.Prescaler = clock / 1000000 - 1;
+    lora_hrtimer_tim.Init.CounterMode = TIM_COUNTERMODE_UP;
+    lora_hrtimer_tim.Init.Period = 0xFFFFFFFF;
+    lora_hrtimer_tim.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    if( HAL_TIM_Base_Init( &lora_hrtimer_tim ) != HAL_OK )
+    {
+        LORA_RADIO_DEBUG_LOG(LR_DBG_INTERFACE, LOG_LEVEL, "hrtimer init failed!\n");
+        return -RT_ERROR;
+    }
+    HAL_NVIC_SetPriority( LORA_RADIO_HRTIMER_IRQn, 1, 0 );
+    HAL_NVIC_EnableIRQ( LORA_RADIO_HRTIMER_IRQn );
+    HAL_TIM_Base_Start( &lora_hrtimer_tim );
+    return RT_EOK;
+}
+INIT_DEVICE_EXPORT( lora_radio_hrtimer_port_init );
+
+void lora_radio_hrtimer_port_set_compare( uint32_t deadlineUs )
+{
+    __HAL_TIM_SET_COMPARE( &lora_hrtimer_tim, TIM_CHANNEL_1, deadlineUs );
+    __HAL_TIM_CLEAR_FLAG( &lora_hrtimer_tim, TIM_FLAG_CC1 );
+    __HAL_TIM_ENABLE_IT( &lora_hrtimer_tim, TIM_IT_CC1 );
+    // the counter may have passed the deadline before the compare was written
+    if( ( int32_t )( deadlineUs - __HAL_TIM_GET_COUNTER( &lora_hrtimer_tim ) ) <= 0 )
+    {
+        HAL_NVIC_SetPendingIRQ( LORA_RADIO_HRTIMER_IRQn );
+    }
+}
+
+void lora_radio_hrtimer_port_cancel( void )
+{
+    __HAL_TIM_DISABLE_IT( &lora_hrtimer_tim, TIM_IT_CC1 );
+    __HAL_TIM_CLEAR_FLAG( &lora_hrtimer_tim, TIM_FLAG_CC1 );
+}
+
+void LORA_RADIO_HRTIMER_IRQHandler( void )
+{
+    rt_interrupt_enter( );
+    __HAL_TIM_CLEAR_FLAG( &lora_hrtimer_tim, TIM_FLAG_CC1 );
+    // also entered when set_compare pended it, the deadlines are checked there
+    if( __HAL_TIM_GET_IT_SOURCE( &lora_hrtimer_tim, TIM_IT_CC1 ) != RESET )
+    {
+        __HAL_TIM_DISABLE_IT( &lora_hrtimer_tim, TIM_IT_CC1 );
+        lora_radio_hrtimer_isr( );
+    }
+    rt_interrupt_leave( );
+}
+
+#endif
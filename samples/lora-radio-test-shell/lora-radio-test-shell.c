@@ -11,6 +11,7 @@
 #include "lora-radio.h"
 #include "lora-radio-timer.h"
 #include "lora-radio-test-shell.h"
+#include "lora-radio-scan.h"
 
 #define LOG_TAG "APP.LoRa.Radio.Shell"
 #define LOG_LEVEL  LOG_LVL_INFO
@@ -45,6 +46,22 @@ uint32_t rx_timeout_cnt = 0;
 
 uint32_t tx_timestamp;
 uint32_t rx_timestamp;
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+// frame timing latched at the DIO edge, us
+LoRaRadioTimestamp_t tx_frame_timestamp;
+LoRaRadioTimestamp_t rx_frame_timestamp;
+#endif
+
+#ifdef LORA_RADIO_DRIVER_USING_SCAN
+static uint32_t scan_frequencies[LORA_SCAN_CHANNELS_MAX];
+static LoRaRadioScanChannel_t scan_results[LORA_SCAN_CHANNELS_MAX];
+static uint8_t scan_channels = 0;
+static uint32_t scan_sweeps = 0;
+// one character per channel, built by OnChannel and printed by the test thread
+static char scan_row[LORA_SCAN_CHANNELS_MAX + 1];
+static char scan_row_ready[LORA_SCAN_CHANNELS_MAX + 1];
+static uint32_t scan_row_sweep = 0;
+#endif
 
 lora_radio_test_t lora_radio_test_paras = 
 {
@@ -116,12 +133,18 @@ void rx_only_thread_entry(void* parameter);
 
 void OnTxDone( void )
 {
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+    lora_radio_get_tx_timestamp( RT_NULL, &tx_frame_timestamp );
+#endif
     Radio.Sleep( );
     rt_event_send(&radio_event, EV_RADIO_TX_DONE);
 }
 
 void OnRxDone( uint8_t *payload, uint16_t size, int16_t rssi, int8_t snr )
 {
+#ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+    lora_radio_get_rx_timestamp( RT_NULL, &rx_frame_timestamp );
+#endif
     Radio.Sleep( );
     BufferSize = size;
     rt_memcpy( Buffer, payload, BufferSize );
@@ -183,6 +206,28 @@ void OnRxError( void )
     rt_event_send(&radio_event, EV_RADIO_RX_ERROR);
 }
 
+#ifdef LORA_RADIO_DRIVER_USING_SCAN
+static void OnScanChannel( void *context, uint32_t sweep, uint8_t index, const LoRaRadioScanChannel_t *channel )
+{
+    static const char levels[] = " .:-=+*#%@";
+    int32_t level = ( channel->RssiMax - LORA_SCAN_RSSI_FLOOR ) * ( int32_t )( sizeof(levels) - 1 ) / ( LORA_SCAN_RSSI_CEIL - LORA_SCAN_RSSI_FLOOR );
+
+    level = ( level < 0 ) ? 0 : ( level > ( int32_t )( sizeof(levels) - 2 ) ) ? ( int32_t )( sizeof(levels) - 2 ) : level;
+    scan_row[index] = levels[level];
+    if( index == ( scan_channels - 1 ) )
+    {
+        rt_memcpy(scan_row_ready, scan_row, scan_channels + 1);
+        scan_row_sweep = sweep;
+        rt_event_send(&radio_event, EV_RADIO_SCAN_ROW);
+    }
+}
+
+static void OnScanDone( void *context, bool stopped )
+{
+    rt_event_send(&radio_event, EV_RADIO_SCAN_DONE);
+}
+#endif
+
 void send_ping_packet(uint32_t src_addr,uint32_t dst_addr,uint8_t len)
 {
     tx_seq_cnt++;
@@ -380,6 +425,10 @@ void lora_radio_test_thread_entry(void* parameter)
                                 received_seqno |= Buffer[12] << 24;
                                 
                                LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "Reply from [0x%X]:seqno=%d, bytes=%d,total time=%d ms,rssi=%d,snr=%d",slaver_addr, received_seqno, BufferSize,( rx_timestamp - tx_timestamp ),rssi_value,snr_value );
+                               #ifdef LORA_RADIO_DRIVER_USING_IRQ_TIMESTAMP
+                               LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "On air: ping start -> reply end=%u us, ping %u us, reply %u us",
+                                                    ( rx_frame_timestamp.EndUs - tx_frame_timestamp.StartUs ), tx_frame_timestamp.TimeOnAirUs, rx_frame_timestamp.TimeOnAirUs );
+                               #endif
                                #ifndef RT_USING_ULOG
                                LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "\n");  
                                #endif                                
@@ -517,6 +566,29 @@ void lora_radio_test_thread_entry(void* parameter)
                 case EV_RADIO_TX_TIMEOUT:
                     radio_rx();
                     break;  
+#ifdef LORA_RADIO_DRIVER_USING_SCAN
+                case EV_RADIO_SCAN_ROW:
+                    // waterfall, one row per sweep, from LORA_SCAN_RSSI_FLOOR ' ' to LORA_SCAN_RSSI_CEIL '@'
+                    if( scan_sweeps != 1 )
+                    {
+                        LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "%5d |%s|\n", scan_row_sweep, scan_row_ready);
+                    }
+                    break;
+                case EV_RADIO_SCAN_DONE:
+                {
+                    int best = lora_radio_scan_best(scan_results, scan_channels);
+                    uint8_t i;
+
+                    LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "Frequency  Mean  Max  P90  Busy\n");
+                    for( i = 0; i < scan_channels; i++ )
+                    {
+                        LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "%9d %5d %4d %4d %4d%%%s\n",
+                                             scan_results[i].Frequency, scan_results[i].RssiMean, scan_results[i].RssiMax,
+                                             scan_results[i].RssiPercentile, scan_results[i].Occupancy, ( i == best ) ? " <- best" : "");
+                    }
+                    break;
+                }
+#endif
             }
         }
     } 
@@ -528,6 +600,8 @@ void lora_radio_test_thread_entry(void* parameter)
 #define CMD_TX_CW_INDEX                  2 // tx cw
 #define CMD_PING_INDEX                   3 // ping-pong
 #define CMD_RX_PACKET_INDEX              4 // rx packet only
+#define CMD_IRQ_OFF_INDEX                5 // interrupts-disabled windows
+#define CMD_SCAN_INDEX                   6 // spectrum scan
 
 const char* lora_help_info[] = 
 {
@@ -536,6 +610,8 @@ const char* lora_help_info[] =
     [CMD_TX_CW_INDEX]                 = "lora cw <freq>,<power> - tx carrier wave",
     [CMD_PING_INDEX]                  = "lora ping <para1>      - ping <-m: master,-s: slaver>",   
     [CMD_RX_PACKET_INDEX]             = "lora rx <timeout>      - rx data only(sniffer)",
+    [CMD_IRQ_OFF_INDEX]               = "lora irqoff <-r>       - longest interrupts-disabled window <-r: reset>",
+    [CMD_SCAN_INDEX]                  = "lora scan <freq>,<step>,<channels>,<dwell>,<sweeps> - rssi scan <sweeps 0: waterfall until 'lora scan stop'>",
 };
 
 /* LoRa Test function */
@@ -662,6 +738,97 @@ static int lora(int argc, char *argv[])
             
             LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "BW: %d\n",lora_radio_test_paras.bw);
         }
+        else if (!rt_strcmp(cmd, "irqoff")) 
+        {
+#ifdef LORA_RADIO_DRIVER_USING_CRITICAL_SECTION_STATS
+            LoRaRadioCriticalSectionStats_t stats;
+
+            lora_radio_critical_section_stats_get(&stats);
+            LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "Count: %d\n", stats.Count);
+            LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "Max  : %d us (%s)\n", stats.MaxUs, stats.MaxFunc ? stats.MaxFunc : "-");
+            
+            if (argc >= 3 && !rt_strcmp(argv[2], "-r")) 
+            {
+                lora_radio_critical_section_stats_reset();
+            }
+#else
+            LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "LORA_RADIO_DRIVER_USING_CRITICAL_SECTION_STATS is not enabled\n");
+#endif
+        }
+        else if (!rt_strcmp(cmd, "scan")) 
+        {
+#ifdef LORA_RADIO_DRIVER_USING_SCAN
+            LoRaRadioScanParams_t params;
+            uint32_t frequency = lora_radio_test_paras.frequency;
+            uint32_t step = 200000;
+            uint32_t dwell = 100;
+            uint8_t channels = 8;
+            uint8_t i;
+            rt_err_t result;
+
+            if (argc >= 3 && !rt_strcmp(argv[2], "stop")) 
+            {
+                lora_radio_scan_stop(RT_NULL);
+                return 1;
+            }
+            if (argc >= 3) 
+            {
+                frequency = atol(argv[2]);
+            }
+            if (argc >= 4) 
+            {
+                step = atol(argv[3]);
+            }
+            if (argc >= 5) 
+            {
+                channels = atol(argv[4]);
+            }
+            if (argc >= 6) 
+            {
+                dwell = atol(argv[5]);
+            }
+            scan_sweeps = 1;
+            if (argc >= 7) 
+            {
+                scan_sweeps = atol(argv[6]);
+            }
+            if( ( channels == 0 ) || ( channels > LORA_SCAN_CHANNELS_MAX ) )
+            {
+                channels = LORA_SCAN_CHANNELS_MAX;
+            }
+            
+            for( i = 0; i < channels; i++ )
+            {
+                scan_frequencies[i] = frequency + i * step;
+            }
+            scan_channels = channels;
+            rt_memset(scan_row, 0, sizeof(scan_row));
+            
+            rt_memset(&params, 0, sizeof(params));
+            params.Modem = lora_radio_test_paras.modem;
+            params.Frequencies = scan_frequencies;
+            params.Count = channels;
+            params.DwellTime = dwell;
+            params.SamplePeriod = 1;
+            params.Percentile = 90;
+            params.OccupancyThresh = -90;
+            params.Sweeps = scan_sweeps;
+            params.OnChannel = OnScanChannel;
+            params.OnDone = OnScanDone;
+            
+            result = lora_radio_scan_start(RT_NULL, &params, scan_results);
+            if( result == -RT_EBUSY )
+            {
+                LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "Scan running, 'lora scan stop' first\n");
+            }
+            else
+            {
+                LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "Scan %d channels from %d Hz, step %d Hz, %d ms each\n", channels, frequency, step, dwell);
+            }
+#else
+            LORA_RADIO_DEBUG_LOG(LR_DBG_APP, LOG_LEVEL, "LORA_RADIO_DRIVER_USING_SCAN is not enabled\n");
+#endif
+        }
     }
     return 1;
 }
@@ -107,7 +107,14 @@
 #define EV_RADIO_RX_DONE         0x0010
 #define EV_RADIO_RX_TIMEOUT      0x0020
 #define EV_RADIO_RX_ERROR        0x0040
-#define EV_RADIO_ALL             (EV_RADIO_INIT | EV_RADIO_TX_START | EV_RADIO_TX_DONE | EV_RADIO_TX_TIMEOUT | EV_RADIO_RX_DONE | EV_RADIO_RX_TIMEOUT | EV_RADIO_RX_ERROR)
+#define EV_RADIO_SCAN_ROW        0x0080
+#define EV_RADIO_SCAN_DONE       0x0100
+#define EV_RADIO_ALL             (EV_RADIO_INIT | EV_RADIO_TX_START | EV_RADIO_TX_DONE | EV_RADIO_TX_TIMEOUT | EV_RADIO_RX_DONE | EV_RADIO_RX_TIMEOUT | EV_RADIO_RX_ERROR | EV_RADIO_SCAN_ROW | EV_RADIO_SCAN_DONE)
+
+// lora scan
+#define LORA_SCAN_CHANNELS_MAX   64
+#define LORA_SCAN_RSSI_FLOOR     -130 // dBm, first level of the waterfall
+#define LORA_SCAN_RSSI_CEIL      -40  // dBm, last level of the waterfall
 
 typedef struct 
 {